@@ -0,0 +1,422 @@
+/******************************************************************************
+**  File:        clipPolygonArea.c
+**
+**  Purpose:     This file contains a standalone benchmark that compares the
+**               clipPolygonArea() function in src/grtsarea.c with the
+**               clipper that it replaced.  The previous clipper is copied
+**               below, with its helper functions, as oldClipPolygonArea().
+**               Both clippers are applied to every ring of the records
+**               of a polygon shapefile for grids of 4 to 256 cells laid
+**               over the bounding box of each record.  The elapsed time
+**               of each clipper and the sums of the clipped areas are
+**               printed for each grid, and the two sums are expected to
+**               be identical.
+**               The package does not include shapefiles, and its lake
+**               data sets are lake centroids, so by default the
+**               benchmark reads the Utah ecoregion polygons, which are
+**               written to a shapefile from R, as in the Area_Design
+**               vignette, with
+**                 library(spsurvey)
+**                 data(UT_ecoregions)
+**                 sp2shape(sp.obj=UT_ecoregions, shpfilename="UT_ecoregions")
+**               Any other polygon shapefile, such as a shapefile of lake
+**               polygons, can be named on the command line.
+**  Usage:       Compile this file together with every C source file in
+**               src other than init.c, with the R include directory and
+**               src on the include path, and link it against libR, e.g.
+**               from this directory with R_HOME set to the output of
+**               R RHOME:
+**                 cc -std=gnu99 -O2 -fopenmp -I$R_HOME/include -I../../src
+**                   -o clipPolygonArea clipPolygonArea.c <package sources>
+**                   -L$R_HOME/lib -lR -lm
+**               and run it as
+**                 ./clipPolygonArea [shapefile] [reps]
+**               shapefile is the name of the .shp file (default
+**               UT_ecoregions.shp) and reps is the number of times each
+**               grid is clipped (default 5).
+**  Programmer:  Tom Kincaid
+**  Created:     October 19, 2026
+******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <R.h>
+#include "shapeParser.h"
+#include "grts.h"
+
+/* sides of a grid cell */
+#define LEFT   1
+#define RIGHT  2
+#define BOTTOM 3
+#define TOP    4
+
+/* functions in src/shapeParser.c and src/pickAreaSamplePoints.c */
+extern int parseHeader( FILE * fptr, Shape * shape );
+extern int readShapeRecord( FILE * fptr, Polygon * poly, int * number,
+                            unsigned int * filePosition );
+
+/* functions in src/grtsarea.c */
+extern void initClipBuffer( ClipBuffer * buf );
+extern void freeClipBuffer( ClipBuffer * buf );
+extern double clipPolygonArea( Cell * cell, Point * points, int start,
+                               int end, ClipBuffer * buf );
+
+
+/**********************************************************
+** Function:   oldPolygonArea
+**
+** Purpose:    Previous version of polygonArea.
+** Arguments:  polygon, array of points defining the polygon
+**             size,  number of points in array
+** Return:     area,   area of polygon
+***********************************************************/
+double oldPolygonArea( Point * polygon, int size ) {
+
+   int i , j;
+   double area = 0;
+
+   for ( i = 0; i < size; i++ ) {
+      j = (i + 1) % size;
+      area += polygon[i].X * polygon[j].Y;
+      area -= polygon[i].Y * polygon[j].X;
+   }
+
+   area /= 2;
+   return -area;
+}
+
+
+/**********************************************************
+** Function:   oldIntersect
+**
+** Purpose:    Previous version of intersect, which returns the
+**             intersection of a segment with a side of a cell.
+***********************************************************/
+Point oldIntersect( Cell * cell, Point * p1, Point * p2, int side ) {
+
+  Point newPoint;
+  Point * z;
+  double slope = 0.0;
+
+   newPoint.X = 0.0;
+   newPoint.Y = 0.0;
+   z = &newPoint;
+
+  if ( p2->X != p1->X ) {
+    slope = (p2->Y - p1->Y) / ( p2->X - p1->X );
+  }
+
+  switch ( side ) {
+
+    case LEFT: z->X = cell->xMin;
+               z->Y = p2->Y + (cell->xMin - p2->X) * slope;
+               break;
+
+    case RIGHT: z->X = cell->xMax;
+                z->Y = p2->Y + (cell->xMax - p2->X) * slope;
+                break;
+
+    case BOTTOM: z->Y = cell->yMin;
+                 if ( p1->X == p2->X ) {
+                   z->X = p2->X;
+                 } else {
+                   z->X = p2->X + (cell->yMin - p2->Y)/slope;
+                 }
+                 break;
+
+    case TOP:  z->Y = cell->yMax;
+               if ( p1->X == p2->X ) {
+                 z->X = p2->X;
+               } else {
+                 z->X = p2->X + (cell->yMax - p2->Y)/slope;
+               }
+               break;
+
+  }
+
+
+  return newPoint;
+}
+
+
+/**********************************************************
+** Function:   oldInside
+**
+** Purpose:    Previous version of inside, which returns 1 if a
+**             point is on the inner side of a side of a cell.
+***********************************************************/
+int oldInside( Cell * cell, Point * p, int side ) {
+
+  int c = 1;
+
+  switch ( side ) {
+    case LEFT: if ( p->X < cell->xMin ) {
+                 c = 0;
+               }
+               break;
+
+    case RIGHT: if ( p->X > cell->xMax ) {
+                  c = 0;
+                }
+                break;
+
+    case BOTTOM: if ( p->Y < cell->yMin ) {
+                   c = 0;
+                 }
+                 break;
+
+    case TOP:  if ( p->Y > cell->yMax ) {
+                 c = 0;
+               }
+               break;
+  }
+
+  return c;
+}
+
+
+/**********************************************************
+** Function:   oldClipPolygonArea
+**
+** Purpose:    Previous version of clipPolygonArea.
+***********************************************************/
+double oldClipPolygonArea( Cell * cell, Point * points, int start, int end ) {
+
+  int i, j;
+  int side;
+  int cou;
+  int n = (end - start);    /* number of points in polygon part */
+  Point * clippedPoly;
+  Point * tempPoly;
+  Point z;
+  double area = 0.0;
+
+  clippedPoly = (Point *) malloc( sizeof(Point) * (( 2 * n ) + 1) );
+  tempPoly = (Point *) malloc( sizeof(Point) * (( 2 * n ) + 1) );
+
+  j = 0;
+  for ( i = start; i <= end; ++i ) {
+    clippedPoly[j].X = points[i].X;
+    clippedPoly[j].Y = points[i].Y;
+    tempPoly[j].X = points[i].X;
+    tempPoly[j].Y = points[i].Y;
+    ++j;
+  }
+
+  for ( side = LEFT; side <= TOP; ++side ) {
+    cou = -1;
+
+    for ( i = 0; i < n; ++i ) {
+
+      if ( (oldInside(cell, &(clippedPoly[i]), side) == 0)  &&
+           (oldInside(cell, &(clippedPoly[i+1]), side) == 1 ) ) {
+        z = oldIntersect( cell, &(clippedPoly[i]), &(clippedPoly[i+1]), side );
+        tempPoly[++cou].X = z.X;
+        tempPoly[cou].Y = z.Y;
+        tempPoly[++cou].X = clippedPoly[i+1].X;
+        tempPoly[cou].Y = clippedPoly[i+1].Y;
+      } else if ((oldInside(cell, &(clippedPoly[i]), side) == 1 ) &&
+                 (oldInside(cell, &(clippedPoly[i+1]), side) == 1 ) ){
+        tempPoly[++cou].X = clippedPoly[i+1].X;
+        tempPoly[cou].Y = clippedPoly[i+1].Y;
+      } else if ((oldInside(cell, &(clippedPoly[i]), side) == 1 ) &&
+                 (oldInside(cell, &(clippedPoly[i+1]), side)  == 0 ) ) {
+        z = oldIntersect( cell, &(clippedPoly[i]), &(clippedPoly[i+1]), side );
+        tempPoly[++cou].X = z.X;
+        tempPoly[cou].Y = z.Y;
+      }
+    }
+    tempPoly[++cou].X = tempPoly[0].X;
+    tempPoly[cou].Y = tempPoly[0].Y;
+    n = cou;
+
+    for ( i = 0; i <= n; ++i ) {
+      clippedPoly[i].X = tempPoly[i].X;
+      clippedPoly[i].Y = tempPoly[i].Y;
+    }
+  }
+
+  area = oldPolygonArea( clippedPoly, n+1 );
+
+  free( clippedPoly );
+  free( tempPoly );
+
+
+  return area;
+}
+
+
+/**********************************************************
+** Function:   readPolygons
+**
+** Purpose:    Read the records of a polygon shapefile.
+** Notes:      The parts and points arrays of each record are allocated
+**             by readShapeRecord and must be freed by the calling
+**             function.
+** Arguments:  fileName, name of the shapefile
+**             numPolys, set to the number of records read
+** Return:     array of records, or NULL on error
+***********************************************************/
+Polygon * readPolygons( char * fileName, int * numPolys ) {
+
+  int number;
+  int maxPolys = 16;
+  unsigned int filePosition = 100;
+  FILE * fptr;
+  Shape shape;
+  Polygon * polys;
+  Polygon * ptr;
+
+  *numPolys = 0;
+  if ( (fptr = fopen( fileName, "rb" )) == NULL ) {
+    printf( "Error: Couldn't open %s\n", fileName );
+    return NULL;
+  }
+  if ( parseHeader( fptr, &shape ) == -1 || (shape.shapeType != POLYGON &&
+       shape.shapeType != POLYGON_Z && shape.shapeType != POLYGON_M) ) {
+    printf( "Error: %s is not a polygon shapefile\n", fileName );
+    fclose( fptr );
+    return NULL;
+  }
+  if ( (polys = (Polygon *) malloc( sizeof(Polygon) * maxPolys )) == NULL ) {
+    fclose( fptr );
+    return NULL;
+  }
+
+  fseek( fptr, 100, SEEK_SET );
+  while ( filePosition < shape.fileLength*2 ) {
+    if ( *numPolys == maxPolys ) {
+      maxPolys *= 2;
+      if ( (ptr = (Polygon *) realloc( polys, sizeof(Polygon) * maxPolys ))
+           == NULL ) {
+        break;
+      }
+      polys = ptr;
+    }
+    if ( readShapeRecord( fptr, &(polys[*numPolys]), &number,
+                          &filePosition ) == -1 ) {
+      break;
+    }
+    ++(*numPolys);
+  }
+  fclose( fptr );
+
+  return polys;
+}
+
+
+/**********************************************************
+** Function:   elapsed
+**
+** Purpose:    Return the current time in seconds from a
+**             monotonic clock.
+***********************************************************/
+double elapsed() {
+
+  struct timespec t;
+
+  clock_gettime( CLOCK_MONOTONIC, &t );
+  return t.tv_sec + 1.0e-9 * t.tv_nsec;
+}
+
+
+int main( int argc, char ** argv ) {
+
+  char * fileName = argc > 1 ? argv[1] : "UT_ecoregions.shp";
+  int reps = argc > 2 ? atoi( argv[2] ) : 5;
+  int grids[] = { 2, 4, 8, 16 };
+  int g, p, k, rep, ix, iy;
+  int nc, numPolys, numPoints = 0;
+  int start, end;
+  Polygon * polys;
+  Cell cell;
+  ClipBuffer buf;
+  double xMin, xMax, yMin, yMax, w, h;
+  double t0, tOld, tNew;
+  double sumOld, sumNew;
+
+  if ( (polys = readPolygons( fileName, &numPolys )) == NULL ) {
+    return 1;
+  }
+  for ( p = 0; p < numPolys; ++p ) {
+    numPoints += polys[p].numPoints;
+  }
+
+  initClipBuffer( &buf );
+  printf( "%s: %d polygons, %d points, %d repetitions\n", fileName,
+          numPolys, numPoints, reps );
+  printf( "%6s %10s %10s %8s  %s\n", "cells", "old (s)", "new (s)",
+          "speedup", "areas identical" );
+
+  for ( g = 0; g < 4; ++g ) {
+    nc = grids[g];
+    sumOld = 0.0;
+    sumNew = 0.0;
+    tOld = 0.0;
+    tNew = 0.0;
+
+    for ( rep = 0; rep < reps; ++rep ) {
+      for ( p = 0; p < numPolys; ++p ) {
+
+        /* lay the grid over the bounding box of the polygon */
+        xMin = polys[p].box[0];
+        yMin = polys[p].box[1];
+        xMax = polys[p].box[2];
+        yMax = polys[p].box[3];
+        w = (xMax - xMin) / nc;
+        h = (yMax - yMin) / nc;
+
+        t0 = elapsed();
+        for ( iy = 0; iy < nc; ++iy ) {
+          for ( ix = 0; ix < nc; ++ix ) {
+            cell.xMin = xMin + ix * w;
+            cell.xMax = xMin + (ix + 1) * w;
+            cell.yMin = yMin + iy * h;
+            cell.yMax = yMin + (iy + 1) * h;
+            for ( k = 0; k < polys[p].numParts; ++k ) {
+              start = polys[p].parts[k];
+              end = k == polys[p].numParts - 1 ? polys[p].numPoints - 1 :
+                    polys[p].parts[k+1] - 1;
+              sumOld += oldClipPolygonArea( &cell, polys[p].points, start,
+                                            end );
+            }
+          }
+        }
+        tOld += elapsed() - t0;
+
+        t0 = elapsed();
+        for ( iy = 0; iy < nc; ++iy ) {
+          for ( ix = 0; ix < nc; ++ix ) {
+            cell.xMin = xMin + ix * w;
+            cell.xMax = xMin + (ix + 1) * w;
+            cell.yMin = yMin + iy * h;
+            cell.yMax = yMin + (iy + 1) * h;
+            for ( k = 0; k < polys[p].numParts; ++k ) {
+              start = polys[p].parts[k];
+              end = k == polys[p].numParts - 1 ? polys[p].numPoints - 1 :
+                    polys[p].parts[k+1] - 1;
+              sumNew += clipPolygonArea( &cell, polys[p].points, start, end,
+                                         &buf );
+            }
+          }
+        }
+        tNew += elapsed() - t0;
+      }
+    }
+
+    printf( "%6d %10.3f %10.3f %7.2fx  %s\n", nc * nc, tOld, tNew,
+            tOld / tNew, sumOld == sumNew ? "yes" : "no" );
+  }
+
+  freeClipBuffer( &buf );
+  for ( p = 0; p < numPolys; ++p ) {
+    free( polys[p].parts );
+    free( polys[p].points );
+  }
+  free( polys );
+
+  return 0;
+}
@@ -0,0 +1,450 @@
+/******************************************************************************
+**  File:        aliasTable.c
+**
+**  Purpose:     This file contains the functions that select records with
+**               probability proportional to a weight, such as the area,
+**               length or mdm value of the record multiplied by its mdm
+**               value, for the irspts, irsarea and irslin functions.  An
+**               alias table is built once from the weights in time
+**               proportional to the number of records, after which each
+**               record is selected in constant time.  The table can be kept
+**               in an R external pointer so that repeated samples from the
+**               same frame do not rebuild it.
+**  Programmer:  Tom Kincaid
+**  Algorithm:   The table is built by the method of Vose (1991), "A linear
+**               algorithm for generating random numbers with a given
+**               distribution", which is a version of the alias method of
+**               Walker (1977).  Sampling without replacement selects
+**               records from the table and rejects records that were
+**               already selected, which gives each draw the probabilities
+**               of the remaining records in proportion to their weights.
+**               When the selected records hold more than half of the weight
+**               in the table, the table is rebuilt without them.
+**  Created:     October 19, 2026
+******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <R.h>
+#include <Rdefines.h>
+#include <Rmath.h>
+#include "shapeParser.h"
+#include "grts.h"
+
+
+/**********************************************************
+** Function:   initAliasTable
+**
+** Purpose:    Initialize an empty alias table.
+** Arguments:  table, alias table to initialize
+** Return:     none
+***********************************************************/
+void initAliasTable( AliasTable * table ) {
+
+  table->numWts = 0;
+  table->numItems = 0;
+  table->wts = NULL;
+  table->item = NULL;
+  table->prob = NULL;
+  table->alias = NULL;
+
+  return;
+}
+
+
+/**********************************************************
+** Function:   freeAliasTable
+**
+** Purpose:    Free the memory used by an alias table and reset it to an
+**             empty table.
+** Arguments:  table, alias table to free
+** Return:     none
+***********************************************************/
+void freeAliasTable( AliasTable * table ) {
+
+  free( table->wts );
+  free( table->item );
+  free( table->prob );
+  free( table->alias );
+  initAliasTable( table );
+
+  return;
+}
+
+
+/**********************************************************
+** Function:   buildAliasTable
+**
+** Purpose:    Build an alias table from an array of weights.
+** Notes:      Items with zero weight and the items in the exclude array
+**             are never selected.  Rounding error can leave positions
+**             that were not paired when the loop ends, and those positions
+**             keep their item with probability one.
+** Arguments:  table,   alias table, which must be initialized or empty
+**             wts,     array of weights, which must be finite and not
+**                      negative
+**             numWts,  number of weights
+**             exclude, array that is TRUE for items that are left out of
+**                      the table, or NULL to include all of the items
+** Return:     1,  on success
+**             0,  if a weight is not valid or no item has positive weight
+**             -1, on error
+***********************************************************/
+int buildAliasTable( AliasTable * table, double * wts, int numWts,
+                     char * exclude ) {
+
+  int i, k;                 /* loop counters */
+  int numSmall = 0;         /* number of positions with scaled weight < 1 */
+  int numLarge = 0;         /* number of positions with scaled weight >= 1 */
+  int s, l;                 /* small and large positions that are paired */
+  long double total = 0.0;  /* total of the weights in the table */
+  double * scaled;          /* weights scaled so that their mean is one */
+  int * small = NULL;       /* stack of positions with scaled weight < 1 */
+  int * large = NULL;       /* stack of positions with scaled weight >= 1 */
+
+  freeAliasTable( table );
+
+  /* check the weights and count the items in the table */
+  for ( i = 0; i < numWts; ++i ) {
+    if ( !R_FINITE( wts[i] ) || wts[i] < 0.0 ) {
+      table->numItems = 0;
+      return 0;
+    }
+    if ( wts[i] > 0.0 && ( exclude == NULL || exclude[i] == FALSE ) ) {
+      ++table->numItems;
+      total += wts[i];
+    }
+  }
+  if ( table->numItems == 0 || !R_FINITE( (double) total ) ) {
+    table->numItems = 0;
+    return 0;
+  }
+
+  /* allocate the table */
+  table->numWts = numWts;
+  table->wts = (double *) malloc( sizeof(double) * numWts );
+  table->item = (int *) malloc( sizeof(int) * table->numItems );
+  table->prob = (double *) malloc( sizeof(double) * table->numItems );
+  table->alias = (int *) malloc( sizeof(int) * table->numItems );
+  small = (int *) malloc( sizeof(int) * table->numItems );
+  large = (int *) malloc( sizeof(int) * table->numItems );
+  if ( table->wts == NULL || table->item == NULL || table->prob == NULL ||
+       table->alias == NULL || small == NULL || large == NULL ) {
+    Rprintf( "Error: Allocating memory in C function buildAliasTable.\n" );
+    freeAliasTable( table );
+    free( small );
+    free( large );
+    return -1;
+  }
+  memcpy( table->wts, wts, sizeof(double) * numWts );
+
+  /* scale the weights, which are stored in prob until they are paired */
+  scaled = table->prob;
+  for ( i = 0, k = 0; i < numWts; ++i ) {
+    if ( wts[i] > 0.0 && ( exclude == NULL || exclude[i] == FALSE ) ) {
+      table->item[k] = i;
+      table->alias[k] = k;
+      scaled[k] = (double) ( wts[i] * table->numItems / total );
+      if ( scaled[k] < 1.0 ) {
+        small[numSmall++] = k;
+      } else {
+        large[numLarge++] = k;
+      }
+      ++k;
+    }
+  }
+
+  /* pair each small position with a large position, which gives the */
+  /* small position's missing probability to the large position */
+  while ( numSmall > 0 && numLarge > 0 ) {
+    s = small[--numSmall];
+    l = large[numLarge - 1];
+    table->alias[s] = l;
+    scaled[l] = ( scaled[l] + scaled[s] ) - 1.0;
+    if ( scaled[l] < 1.0 ) {
+      --numLarge;
+      small[numSmall++] = l;
+    }
+  }
+
+  /* the remaining positions keep their item */
+  while ( numLarge > 0 ) {
+    scaled[large[--numLarge]] = 1.0;
+  }
+  while ( numSmall > 0 ) {
+    scaled[small[--numSmall]] = 1.0;
+  }
+
+  free( small );
+  free( large );
+
+  return 1;
+}
+
+
+/**********************************************************
+** Function:   drawAliasTable
+**
+** Purpose:    Select an item from an alias table using R's random number
+**             generator.
+** Arguments:  table, alias table, which must have at least one item
+** Return:     index of the selected item in the array of weights
+***********************************************************/
+int drawAliasTable( AliasTable * table ) {
+
+  int k;   /* position in the table */
+
+  k = (int) ( unif_rand() * table->numItems );
+  if ( k >= table->numItems ) {
+    k = table->numItems - 1;
+  }
+  if ( unif_rand() >= table->prob[k] ) {
+    k = table->alias[k];
+  }
+
+  return table->item[k];
+}
+
+
+/**********************************************************
+** Function:   sampleAliasTable
+**
+** Purpose:    Select a sample of items from an alias table using R's
+**             random number generator.
+** Algorithm:  Without replacement, an item that was already selected is
+**             rejected and another item is drawn.  The table is rebuilt
+**             without the selected items whenever the weight of the items
+**             that were selected from the current table is more than half
+**             of the weight in that table, so that at least half of the
+**             draws are accepted.
+** Arguments:  table,   alias table
+**             size,    number of items to select
+**             replace, TRUE to select with replacement
+**             samp,    array of length size for the selected items
+** Return:     1,  on success
+**             0,  if too few items have positive weight to select the
+**                 sample without replacement
+**             -1, on error
+***********************************************************/
+int sampleAliasTable( AliasTable * table, int size, int replace, int * samp ) {
+
+  int i, k;                 /* loop counters */
+  char * selected = NULL;   /* TRUE for items that have been selected */
+  AliasTable rest;          /* table without the selected items */
+  AliasTable * cur;         /* table that items are drawn from */
+  double curWt = 0.0;       /* weight of the items in the current table */
+  double selWt = 0.0;       /* weight of the items selected from it */
+
+  if ( replace == TRUE ) {
+    for ( k = 0; k < size; ++k ) {
+      samp[k] = drawAliasTable( table );
+    }
+    return 1;
+  }
+
+  if ( size > table->numItems ) {
+    return 0;
+  }
+  if ( (selected = (char *) calloc( table->numWts, sizeof(char) )) == NULL ) {
+    Rprintf( "Error: Allocating memory in C function sampleAliasTable.\n" );
+    return -1;
+  }
+  for ( i = 0; i < table->numWts; ++i ) {
+    curWt += table->wts[i];
+  }
+
+  initAliasTable( &rest );
+  cur = table;
+  k = 0;
+  while ( k < size ) {
+    i = drawAliasTable( cur );
+    if ( selected[i] == TRUE ) {
+      continue;
+    }
+    selected[i] = TRUE;
+    samp[k++] = i;
+    selWt += table->wts[i];
+
+    /* rebuild the table when most of its weight has been selected */
+    if ( k < size && selWt > 0.5 * curWt ) {
+      if ( buildAliasTable( &rest, table->wts, table->numWts, selected )
+           != 1 ) {
+        Rprintf( "Error: Rebuilding the alias table in C function sampleAliasTable.\n" );
+        freeAliasTable( &rest );
+        free( selected );
+        return -1;
+      }
+      cur = &rest;
+      curWt -= selWt;
+      selWt = 0.0;
+    }
+  }
+
+  freeAliasTable( &rest );
+  free( selected );
+
+  return 1;
+}
+
+
+/**********************************************************
+** Function:   finalizeAliasTable
+**
+** Purpose:    Free the alias table held by an R external pointer when the
+**             pointer is garbage collected.
+** Arguments:  tablePtr, R external pointer to the alias table
+** Return:     none
+***********************************************************/
+static void finalizeAliasTable( SEXP tablePtr ) {
+
+  AliasTable * table = (AliasTable *) R_ExternalPtrAddr( tablePtr );
+
+  if ( table ) {
+    freeAliasTable( table );
+    free( table );
+    R_ClearExternalPtr( tablePtr );
+  }
+
+  return;
+}
+
+
+/**********************************************************
+** Function:   aliasTable
+**
+** Purpose:    Build an alias table from a vector of weights and keep it
+**             in an R external pointer, so that the aliasSample function
+**             can select repeated samples without rebuilding it.
+** Arguments:  wtVec, vector of weights
+** Return:     tablePtr, an R external pointer to the alias table.  If an
+**                       error occurs, a list whose single element is NULL
+**                       is returned.
+***********************************************************/
+SEXP aliasTable( SEXP wtVec ) {
+
+  int rslt;                    /* result of building the table */
+  AliasTable * table = NULL;   /* alias table */
+  SEXP tablePtr;               /* R external pointer to the table */
+  SEXP results = NULL;
+
+  if ( (table = (AliasTable *) malloc( sizeof(AliasTable) )) == NULL ) {
+    Rprintf( "Error: Allocating memory in C function aliasTable.\n" );
+    PROTECT( results = allocVector( VECSXP, 1 ) );
+    UNPROTECT(1);
+    return results;
+  }
+  initAliasTable( table );
+
+  PROTECT( wtVec = AS_NUMERIC( wtVec ) );
+  rslt = buildAliasTable( table, REAL( wtVec ), length( wtVec ), NULL );
+  UNPROTECT(1);
+  if ( rslt != 1 ) {
+    if ( rslt == 0 ) {
+      Rprintf( "Error: The weights must be finite, not negative, and not all zero in C function aliasTable.\n" );
+    }
+    freeAliasTable( table );
+    free( table );
+    PROTECT( results = allocVector( VECSXP, 1 ) );
+    UNPROTECT(1);
+    return results;
+  }
+
+  PROTECT( tablePtr = R_MakeExternalPtr( table, install( "aliasTable" ),
+                                         R_NilValue ) );
+  R_RegisterCFinalizerEx( tablePtr, finalizeAliasTable, TRUE );
+  UNPROTECT(1);
+
+  return tablePtr;
+}
+
+
+/**********************************************************
+** Function:   aliasSample
+**
+** Purpose:    Select a sample of positions in a vector of weights with
+**             probability proportional to the weights.
+** Notes:      The sample is selected from an alias table that is either
+**             built from the weights or was built by the aliasTable
+**             function.
+** Arguments:  wtVec,      vector of weights, or an R external pointer to an
+**                         alias table returned by the aliasTable function
+**             sizeVal,    number of positions to select
+**             replaceVal, TRUE to select the sample with replacement
+** Return:     sampVec, an R vector of the selected positions, which start
+**                      at one.  If an error occurs, a list whose single
+**                      element is NULL is returned.
+***********************************************************/
+SEXP aliasSample( SEXP wtVec, SEXP sizeVal, SEXP replaceVal ) {
+
+  int k;                       /* loop counter */
+  int size;                    /* number of positions to select */
+  int replace;                 /* TRUE to select with replacement */
+  int rslt;                    /* result of building or sampling */
+  AliasTable local;            /* table built from the weights */
+  AliasTable * table = NULL;   /* table the sample is selected from */
+  int * samp;                  /* selected positions */
+  SEXP sampVec;
+  SEXP results = NULL;
+
+  PROTECT( sizeVal = AS_INTEGER( sizeVal ) );
+  size = INTEGER( sizeVal )[0];
+  UNPROTECT(1);
+  PROTECT( replaceVal = AS_LOGICAL( replaceVal ) );
+  replace = LOGICAL( replaceVal )[0] == TRUE;
+  UNPROTECT(1);
+  if ( size < 0 || size == NA_INTEGER ) {
+    Rprintf( "Error: Invalid sample size in C function aliasSample.\n" );
+    PROTECT( results = allocVector( VECSXP, 1 ) );
+    UNPROTECT(1);
+    return results;
+  }
+
+  /* find or build the alias table */
+  initAliasTable( &local );
+  if ( TYPEOF( wtVec ) == EXTPTRSXP ) {
+    if ( R_ExternalPtrTag( wtVec ) != install( "aliasTable" ) ||
+         (table = (AliasTable *) R_ExternalPtrAddr( wtVec )) == NULL ) {
+      Rprintf( "Error: Invalid alias table in C function aliasSample.\n" );
+      PROTECT( results = allocVector( VECSXP, 1 ) );
+      UNPROTECT(1);
+      return results;
+    }
+  } else {
+    PROTECT( wtVec = AS_NUMERIC( wtVec ) );
+    rslt = buildAliasTable( &local, REAL( wtVec ), length( wtVec ), NULL );
+    UNPROTECT(1);
+    if ( rslt != 1 ) {
+      if ( rslt == 0 ) {
+        Rprintf( "Error: The weights must be finite, not negative, and not all zero in C function aliasSample.\n" );
+      }
+      PROTECT( results = allocVector( VECSXP, 1 ) );
+      UNPROTECT(1);
+      return results;
+    }
+    table = &local;
+  }
+
+  /* select the sample */
+  PROTECT( sampVec = allocVector( INTSXP, size ) );
+  samp = INTEGER( sampVec );
+  GetRNGstate();
+  rslt = sampleAliasTable( table, size, replace, samp );
+  PutRNGstate();
+  freeAliasTable( &local );
+  if ( rslt != 1 ) {
+    if ( rslt == 0 ) {
+      Rprintf( "Error: Too few positive weights in C function aliasSample.\n" );
+    }
+    PROTECT( results = allocVector( VECSXP, 1 ) );
+    UNPROTECT(2);
+    return results;
+  }
+  for ( k = 0; k < size; ++k ) {
+    ++samp[k];
+  }
+  UNPROTECT(1);
+
+  return sampVec;
+}
@@ -0,0 +1,318 @@
+/****************************************************************************** 
+**  File:        frameStore.c
+**  
+**  Purpose:     This file contains the functions that decode the records of
+**               the temporary shapefile into a FrameStore struct, so that
+**               the numLevels function can compute the cell weights for
+**               every level of the grid without reading and allocating the
+**               records from the file again at each level.
+**  Programmer:  Tom Kincaid
+**  Algorithm:   The file is read twice.  The first pass only reads the
+**               record headers and the number of parts and points in each
+**               record, which gives the exact amount of memory that is
+**               required.  If that amount is within the memory budget, the
+**               second pass reads the parts and points of each record into
+**               flat arrays.  Otherwise the store is left unloaded and the
+**               calling function reads the file one record at a time.
+**  Created:     October 19, 2026
+******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <R.h>
+#include <Rdefines.h>
+#include "shapeParser.h"
+#include "grts.h"
+
+/* these functions are found in shapeParser.c */
+extern unsigned int readLittleEndian( unsigned char * buffer, int length );
+extern unsigned int readBigEndian( unsigned char * buffer, int length );
+
+/* struct used to look up the dsgnmd array position of a record ID */
+typedef struct idIndexStruct IdIndex;
+struct idIndexStruct {
+  unsigned int id;
+  int index;
+};
+
+
+/**********************************************************
+** Function:   compareIdIndex
+**
+** Purpose:    qsort comparison function that orders IdIndex structs by
+**             ID and then by position in the dsgnmdID array.
+***********************************************************/
+int compareIdIndex( const void * a, const void * b ) {
+
+  const IdIndex * pa = (const IdIndex *) a;
+  const IdIndex * pb = (const IdIndex *) b;
+
+  if ( pa->id != pb->id ) {
+    return pa->id < pb->id ? -1 : 1;
+  }
+  if ( pa->index != pb->index ) {
+    return pa->index < pb->index ? -1 : 1;
+  }
+  return 0;
+}
+
+
+/**********************************************************
+** Function:   findIdIndex
+**
+** Purpose:    Find the first position of a record ID in the dsgnmdID
+**             array using a sorted copy of the array.
+** Arguments:  ids,   sorted array of IDs and positions
+**             numIDs, number of IDs in the array
+**             id,    record ID to find
+** Return:     position of the ID in the dsgnmdID array, or
+**             -1 if the ID is not found
+***********************************************************/
+int findIdIndex( IdIndex * ids, int numIDs, unsigned int id ) {
+
+  int lo = 0;
+  int hi = numIDs;
+  int mid;
+
+  /* find the first entry with an ID that is not less than id */
+  while ( lo < hi ) {
+    mid = lo + (hi - lo) / 2;
+    if ( ids[mid].id < id ) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+
+  if ( lo < numIDs && ids[lo].id == id ) {
+    return ids[lo].index;
+  }
+  return -1;
+}
+
+
+/**********************************************************
+** Function:   initFrameStore
+**
+** Purpose:    Initialize an empty, unloaded frame store.
+** Arguments:  store, frame store to initialize
+** Return:     none
+***********************************************************/
+void initFrameStore( FrameStore * store ) {
+
+  store->shapeType = 0;
+  store->numRecords = -1;
+  store->recNum = NULL;
+  store->dsgIdx = NULL;
+  store->numParts = NULL;
+  store->partStart = NULL;
+  store->numPts = NULL;
+  store->pointStart = NULL;
+  store->parts = NULL;
+  store->points = NULL;
+
+  return;
+}
+
+
+/**********************************************************
+** Function:   freeFrameStore
+**
+** Purpose:    Free the memory used by a frame store and reset it to an
+**             unloaded store.
+** Arguments:  store, frame store to free
+** Return:     none
+***********************************************************/
+void freeFrameStore( FrameStore * store ) {
+
+  free( store->recNum );
+  free( store->dsgIdx );
+  free( store->numParts );
+  free( store->partStart );
+  free( store->numPts );
+  free( store->pointStart );
+  free( store->parts );
+  free( store->points );
+  initFrameStore( store );
+
+  return;
+}
+
+
+/**********************************************************
+** Function:   loadFrameStore
+**
+** Purpose:    Decode the records of a shapefile into a frame store when
+**             the records fit within the memory budget.
+** Notes:      Records that have ID numbers not found in the dsgnmdID
+**             array are not stored.  The Z and M values of the records
+**             are not stored.
+** Arguments:  store,    frame store to load, which must be initialized
+**             shape,    shape struct that contains the header info for the
+**                       shapefile
+**             fptr,     pointer to the shapefile
+**             dsgnmdID, array of record IDs which have weights and should be
+**                       used in the calculations
+**             dsgSize,  number of IDs in the dsgnmdID array
+**             budget,   memory budget in megabytes
+** Return:     1,  if the store was loaded
+**             0,  if the records do not fit within the budget, in which
+**                 case the store is left unloaded
+**             -1, on error
+***********************************************************/
+int loadFrameStore( FrameStore * store, Shape * shape, FILE * fptr,
+                    unsigned int * dsgnmdID, int dsgSize, double budget ) {
+
+  int i;                        /* loop counter */
+  int w;                        /* position of a record in the dsgnmd array */
+  int r;                        /* record index in the store */
+  int pointType;                /* TRUE for points shapefiles */
+  unsigned int filePosition;    /* byte offset within the shape file */
+  unsigned int recNumber;       /* record number */
+  unsigned int contentLength;   /* record content length in bytes */
+  unsigned char buffer[4];      /* temp buffer for reading from file */
+  int numParts;                 /* number of parts in a record */
+  int numPoints;                /* number of points in a record */
+  int numRecords = 0;           /* number of stored records */
+  double totParts = 0.0;        /* number of stored parts */
+  double totPoints = 0.0;       /* number of stored points */
+  double bytes;                 /* memory required by the store */
+  IdIndex * ids = NULL;         /* sorted copy of the dsgnmdID array */
+
+  pointType = ( shape->shapeType == POINTS || shape->shapeType == POINTS_Z ||
+                shape->shapeType == POINTS_M );
+
+  /* sort the record IDs so that each record can be found quickly */
+  if ( (ids = (IdIndex *) malloc( sizeof(IdIndex) * (dsgSize + 1) )) 
+       == NULL ) {
+    Rprintf( "Error: Allocating memory in C function loadFrameStore.\n" );
+    return -1;
+  }
+  for ( i = 0; i < dsgSize; ++i ) {
+    ids[i].id = dsgnmdID[i];
+    ids[i].index = i;
+  }
+  qsort( ids, dsgSize, sizeof(IdIndex), compareIdIndex );
+
+  /* first pass, count the records, parts and points that will be stored */
+  fseek( fptr, 100, SEEK_SET );
+  filePosition = 100;
+  while ( filePosition < shape->fileLength*2 ) {
+    fread( buffer, sizeof(char), 4, fptr );
+    recNumber = readBigEndian( buffer, 4 );
+    if ( fread( buffer, sizeof(char), 4, fptr ) == 0 ) {
+      Rprintf( "Error: Reading shape file in C function loadFrameStore.\n" );
+      free( ids );
+      return -1;
+    }
+    contentLength = readBigEndian( buffer, 4 ) * 2;
+    if ( findIdIndex( ids, dsgSize, recNumber ) >= 0 ) {
+      if ( pointType ) {
+        numParts = 1;
+        numPoints = 1;
+      } else {
+
+        /* skip the shape type and box, then read the counts */
+        fseek( fptr, 36, SEEK_CUR );
+        fread( buffer, sizeof(char), 4, fptr );
+        numParts = readLittleEndian( buffer, 4 );
+        fread( buffer, sizeof(char), 4, fptr );
+        numPoints = readLittleEndian( buffer, 4 );
+      }
+      ++numRecords;
+      totParts += numParts;
+      totPoints += numPoints;
+    }
+    filePosition += 8 + contentLength;
+    fseek( fptr, filePosition, SEEK_SET );
+  }
+
+  /* see whether the records fit within the budget */
+  bytes = numRecords * (7.0 * sizeof(int)) + totParts * sizeof(int) +
+          totPoints * sizeof(Point);
+  if ( bytes > budget * 1048576.0 || totPoints > 2147483647.0 ) {
+    free( ids );
+    return 0;
+  }
+
+  /* allocate the store */
+  store->recNum = (int *) malloc( sizeof(int) * (numRecords + 1) );
+  store->dsgIdx = (int *) malloc( sizeof(int) * (numRecords + 1) );
+  store->numParts = (int *) malloc( sizeof(int) * (numRecords + 1) );
+  store->partStart = (int *) malloc( sizeof(int) * (numRecords + 1) );
+  store->numPts = (int *) malloc( sizeof(int) * (numRecords + 1) );
+  store->pointStart = (int *) malloc( sizeof(int) * (numRecords + 1) );
+  store->parts = (int *) malloc( sizeof(int) * ((size_t) totParts + 1) );
+  store->points = (Point *) malloc( sizeof(Point) * ((size_t) totPoints + 1) );
+  if ( store->recNum == NULL || store->dsgIdx == NULL || 
+       store->numParts == NULL || store->partStart == NULL ||
+       store->numPts == NULL || store->pointStart == NULL ||
+       store->parts == NULL || store->points == NULL ) {
+    freeFrameStore( store );
+    free( ids );
+    return 0;
+  }
+
+  /* second pass, read the records into the store */
+  fseek( fptr, 100, SEEK_SET );
+  filePosition = 100;
+  r = 0;
+  store->numRecords = 0;
+  while ( filePosition < shape->fileLength*2 && r < numRecords ) {
+    fread( buffer, sizeof(char), 4, fptr );
+    recNumber = readBigEndian( buffer, 4 );
+    fread( buffer, sizeof(char), 4, fptr );
+    contentLength = readBigEndian( buffer, 4 ) * 2;
+    if ( (w = findIdIndex( ids, dsgSize, recNumber )) >= 0 ) {
+      store->recNum[r] = recNumber;
+      store->dsgIdx[r] = w;
+      store->partStart[r] = r > 0 ? store->partStart[r-1] + 
+                                    store->numParts[r-1] : 0;
+      store->pointStart[r] = r > 0 ? store->pointStart[r-1] +
+                                     store->numPts[r-1] : 0;
+      if ( pointType ) {
+
+        /* skip the shape type and read the point coordinates */
+        fseek( fptr, 4, SEEK_CUR );
+        store->numParts[r] = 1;
+        store->numPts[r] = 1;
+        store->parts[store->partStart[r]] = 0;
+        if ( fread( &(store->points[store->pointStart[r]]), sizeof(double),
+                    2, fptr ) != 2 ) {
+          Rprintf( "Error: Reading shape file in C function loadFrameStore.\n" );
+          freeFrameStore( store );
+          free( ids );
+          return -1;
+        }
+      } else {
+
+        /* skip the shape type and box, then read the counts */
+        fseek( fptr, 36, SEEK_CUR );
+        fread( buffer, sizeof(char), 4, fptr );
+        store->numParts[r] = readLittleEndian( buffer, 4 );
+        fread( buffer, sizeof(char), 4, fptr );
+        store->numPts[r] = readLittleEndian( buffer, 4 );
+
+        /* read the parts and points data */
+        fread( &(store->parts[store->partStart[r]]), sizeof(int),
+               store->numParts[r], fptr );
+        if ( fread( &(store->points[store->pointStart[r]]), sizeof(double),
+                    2 * store->numPts[r], fptr ) != 2 * store->numPts[r] ) {
+          Rprintf( "Error: Reading shape file in C function loadFrameStore.\n" );
+          freeFrameStore( store );
+          free( ids );
+          return -1;
+        }
+      }
+      ++r;
+      store->numRecords = r;
+    }
+    filePosition += 8 + contentLength;
+    fseek( fptr, filePosition, SEEK_SET );
+  }
+  store->shapeType = shape->shapeType;
+  free( ids );
+
+  return 1;
+}
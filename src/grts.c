@@ -19,6 +19,7 @@
 **  Revised:     June 15, 2015
 **  Revised:     November 5, 2015
 **  Revised:     August 10, 2017
+**  Revised:     October 19, 2026
 ******************************************************************************/
 
 #include <stdio.h>
@@ -30,8 +31,12 @@
 #include <Rmath.h>           /* for runif function */
 #include <sys/types.h>
 #include <dirent.h>
+#include <unistd.h>          /* for getpid function */
 #include "shapeParser.h"
 #include "grts.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 #define MIN(x,y) (x < y ? x : y)
 #define MAX(x,y) (x > y ? x : y)
@@ -42,21 +47,59 @@ extern int parseHeader( FILE * fptr, Shape * shape );
 extern unsigned int readLittleEndian( unsigned char * buffer, int length );
 extern unsigned int readBigEndian( unsigned char * buffer, int length );
 
-/* this function is found in grtsarea.c */
-extern int areaIntersection( double ** celWts, double * xc, double * yc,
-                     double dx , double dy, int size, Shape * shape, 
+/* these functions are found in grtsarea.c */
+extern int areaIntersection( CellWts * celWts, Grid * grid, Shape * shape, 
                      FILE * fptr, unsigned int * dsgnmdID, double * dsgnmd, 
-                     int dsgSize );
+                     int dsgSize, FragTable * frags, FrameStore * store,
+                     BlockWts * blocks );
+extern int areaRefinement( CellWts * celWts, Grid * grid, FragTable * frags,
+                     double * dsgnmd, BlockWts * blocks );
+extern int areaExtents( CellExtents * ext, Grid * grid, FragTable * frags,
+                     Shape * shape, FILE * fptr, unsigned int * dsgnmdID,
+                     int dsgSize, FrameStore * store );
+extern void initFragTable( FragTable * frags );
+extern void freeFragTable( FragTable * frags );
+extern int addFragment( FragTable * frags, int cellIdx, int dsgIdx,
+                     int multiPart, Point * pts, int n, double area );
+extern void initClipBuffer( ClipBuffer * buf );
+extern void freeClipBuffer( ClipBuffer * buf );
 
 /* this function is found in grtslin.c */
-extern int lintFcn ( double ** celWts, double * xc, double * yc, double dx
-                         , double dy, int size, Shape * shape, FILE * fptr,
-                   unsigned int * dsgnmdID, double * dsgnmd, int dsgSize );
+extern int lintFcn ( CellWts * celWts, Grid * grid, Shape * shape, FILE * fptr,
+                   unsigned int * dsgnmdID, double * dsgnmd, int dsgSize,
+                   FrameStore * store, BlockWts * blocks,
+                   CellExtents * ext );
 
 /* this function is found in grtspts.c */
-extern int cWtFcn ( double ** celWts, double * xc, double * yc, double dx,
-                    double dy, int size, Shape * shape, FILE * fptr,
-                    unsigned int * dsgnmdID, double * dsgnmd, int dsgSize );
+extern int cWtFcn ( CellWts * celWts, Grid * grid, Shape * shape, FILE * fptr,
+                    unsigned int * dsgnmdID, double * dsgnmd, int dsgSize,
+                    FrameStore * store, BlockWts * blocks );
+
+/* these functions are found in frameStore.c */
+extern void initFrameStore( FrameStore * store );
+extern void freeFrameStore( FrameStore * store );
+extern int loadFrameStore( FrameStore * store, Shape * shape, FILE * fptr,
+                    unsigned int * dsgnmdID, int dsgSize, double budget );
+
+
+/**********************************************************
+** Function:   tempShpFileName
+**
+** Purpose:    Return the name of the temporary shapefile for the current
+**             process.
+** Notes:      The name is built at each call, so a process that was forked
+**             from another process gets its own name.
+** Arguments:  none
+** Return:     the file name, which is stored in a static buffer
+***********************************************************/
+const char * tempShpFileName( void ) {
+
+  static char fileName[64];     /* temporary shapefile name */
+
+  sprintf( fileName, "shapefile1021_%d.shp", (int) getpid() );
+
+  return fileName;
+}
 
 
 /**********************************************************
@@ -174,8 +217,9 @@ int seq( double ** seqVec, double min, double max, int length ) {
 **
 ** Purpose:    This function checks to see if any of the sent cell
 **             weights divided by sint are greater than the sent value.
-** Arguments:  celWts,  array of cell weights
-**             size,  size of celWts array
+** Notes:      Cells that are not in the sparse cell weights have zero
+**             weight, so they do not need to be checked.
+** Arguments:  celWts,  sparse cell weights
 **             sint,  value to divide celWts by
 **             value, value that we are checking to see if any celWts/sint
 **                    is greater than
@@ -184,15 +228,15 @@ int seq( double ** seqVec, double min, double max, int length ) {
 **             0,  if none are greater
 **             -1, if error
 ***********************************************************/
-int any( double * celWts, int size, double sint, int value ) {
+int any( CellWts * celWts, double sint, int value ) {
   int i;
 
   if ( celWts == NULL ) {
     return -1;
   }
 
-  for ( i = 0; i < size; ++i ) {
-    if ( (celWts[i]/sint) > value ) {
+  for ( i = 0; i < celWts->numCells; ++i ) {
+    if ( (celWts->cells[i].wt/sint) > value ) {
       return 1;
     }
   }
@@ -205,24 +249,24 @@ int any( double * celWts, int size, double sint, int value ) {
 /**********************************************************
 ** Function:   sum 
 **
-** Purpose:    This function sums up all the values in the sent 
-**             vec array and returns the result
-** Arguments:  vec, array of doubles
-**             size, size of vec array
-** Return:     result,  the sum of all the values in the sent 
-**                      vec array
+** Purpose:    This function sums up all the sent cell weights and 
+**             returns the result
+** Notes:      The weights are summed in order of cell index, which gives
+**             the same result as summing a dense array of cell weights.
+** Arguments:  celWts, sparse cell weights
+** Return:     result,  the sum of all the cell weights
 ***********************************************************/
-double sum( double * vec, int size ) {
+double sum( CellWts * celWts ) {
   int i;
   double result = 0.0;
 
   /* error check */
-  if ( vec == NULL || size < 0 ) {
+  if ( celWts == NULL ) {
     return result;
   }
 
-  for ( i = 0; i < size; ++i ) {
-    result += vec[i];
+  for ( i = 0; i < celWts->numCells; ++i ) {
+    result += celWts->cells[i].wt;
   }
 
   return result;
@@ -234,25 +278,731 @@ double sum( double * vec, int size ) {
 ** Function:   maxWt
 **
 ** Purpose:    This function returns the largest weight value in
-**             the sent array of weight values.
-** Arguments:  wts, array of weight values
-**             size, size of vec array
-** Return:     max,  the largest weight value in the sent array
+**             the sent cell weights.
+** Arguments:  celWts, sparse cell weights
+**             size, number of cells in the grid, which is larger than the
+**                   number of sparse cell weights when some cells have
+**                   zero weight
+** Return:     max,  the largest weight value in the grid
 ***********************************************************/
-double maxWt( double * wts, int size ) {
+double maxWt( CellWts * celWts, double size ) {
   int i;
-  double max = wts[0];
+  double max;
 
-  for ( i = 1; i < size; ++i ) {
-    if ( wts[i] > max ) {
-      max = wts[i];
+  if ( celWts->numCells == 0 ) {
+    return 0.0;
+  }
+  max = celWts->cells[0].wt;
+  for ( i = 1; i < celWts->numCells; ++i ) {
+    if ( celWts->cells[i].wt > max ) {
+      max = celWts->cells[i].wt;
     }
   }
+  if ( celWts->numCells < size && max < 0.0 ) {
+    max = 0.0;
+  }
 
   return max;
 }
 
 
+/**********************************************************
+** Function:   initCellWts
+**
+** Purpose:    Initialize an empty set of sparse cell weights.
+** Arguments:  celWts, sparse cell weights to initialize
+** Return:     none
+***********************************************************/
+void initCellWts( CellWts * celWts ) {
+
+  celWts->numCells = 0;
+  celWts->maxCells = 0;
+  celWts->numMerged = 0;
+  celWts->merge = 1;
+  celWts->nextSeq = 0.0;
+  celWts->cells = NULL;
+
+  return;
+}
+
+
+/**********************************************************
+** Function:   freeCellWts
+**
+** Purpose:    Free the memory used by a set of sparse cell weights and
+**             reset it to an empty set that is merged when full.
+** Arguments:  celWts, sparse cell weights to free
+** Return:     none
+***********************************************************/
+void freeCellWts( CellWts * celWts ) {
+
+  free( celWts->cells );
+  initCellWts( celWts );
+
+  return;
+}
+
+
+/**********************************************************
+** Function:   clearCellWts
+**
+** Purpose:    Remove all the entries from a set of sparse cell weights
+**             without freeing its memory.
+** Arguments:  celWts, sparse cell weights to clear
+** Return:     none
+***********************************************************/
+void clearCellWts( CellWts * celWts ) {
+
+  celWts->numCells = 0;
+  celWts->numMerged = 0;
+  celWts->nextSeq = 0.0;
+
+  return;
+}
+
+
+/**********************************************************
+** Function:   compareCellWt
+**
+** Purpose:    qsort comparison function that orders CellWt structs by
+**             cell index and then by sequence number.
+***********************************************************/
+int compareCellWt( const void * a, const void * b ) {
+
+  const CellWt * pa = (const CellWt *) a;
+  const CellWt * pb = (const CellWt *) b;
+
+  if ( pa->idx != pb->idx ) {
+    return pa->idx < pb->idx ? -1 : 1;
+  }
+  if ( pa->seq != pb->seq ) {
+    return pa->seq < pb->seq ? -1 : 1;
+  }
+  return 0;
+}
+
+
+/**********************************************************
+** Function:   compactCellWts
+**
+** Purpose:    Merge the entries of a set of sparse cell weights so that
+**             there is one entry for each cell, in order of cell index.
+** Algorithm:  The entries are sorted by cell index and sequence number, 
+**             and the weights for each cell are summed in the order they
+**             were added starting from zero, as they would be in a dense
+**             array of cell weights.  Cells whose weight is zero are
+**             removed.
+** Arguments:  celWts, sparse cell weights
+** Return:     none
+***********************************************************/
+void compactCellWts( CellWts * celWts ) {
+
+  int i, j;           /* loop counters */
+  int n = 0;          /* number of merged entries */
+  double total;       /* weight for a cell */
+  CellWt * cells = celWts->cells;
+
+  if ( celWts->numMerged == celWts->numCells ) {
+    return;
+  }
+  qsort( cells, celWts->numCells, sizeof(CellWt), compareCellWt );
+  for ( i = 0; i < celWts->numCells; i = j ) {
+    total = 0.0;
+    for ( j = i; j < celWts->numCells && cells[j].idx == cells[i].idx; ++j ) {
+      total += cells[j].wt;
+    }
+    if ( total != 0.0 ) {
+      cells[n].idx = cells[i].idx;
+      cells[n].seq = cells[i].seq;
+      cells[n].wt = total;
+      ++n;
+    }
+  }
+  celWts->numCells = n;
+  celWts->numMerged = n;
+
+  return;
+}
+
+
+/**********************************************************
+** Function:   addCellWt
+**
+** Purpose:    Add a weight to a cell in a set of sparse cell weights.
+** Notes:      When the array of entries is full the entries are merged,
+**             and the array is enlarged only if merging did not free at
+**             least half of it.  The memory used is therefore
+**             proportional to the number of cells with nonzero weight.
+**             When merge is 0 the array is always enlarged instead.
+** Arguments:  celWts, sparse cell weights
+**             idx,    cell index
+**             wt,     weight to add to the cell
+** Return:     1,  on success
+**             -1, on error
+***********************************************************/
+int addCellWt( CellWts * celWts, int idx, double wt ) {
+
+  int newMax;         /* new allocated length */
+  CellWt * ptr;       /* temp pointer for reallocated memory */
+
+  if ( celWts->numCells == celWts->maxCells ) {
+    if ( celWts->merge == 1 ) {
+      compactCellWts( celWts );
+    }
+    if ( celWts->merge == 0 || celWts->maxCells == 0 ||
+         celWts->numCells > celWts->maxCells / 2 ) {
+      newMax = celWts->maxCells > 0 ? 2 * celWts->maxCells : 1024;
+      if ( (ptr = (CellWt *) realloc( celWts->cells, sizeof(CellWt) * newMax))
+           == NULL ) {
+        return -1;
+      }
+      celWts->cells = ptr;
+      celWts->maxCells = newMax;
+    }
+  }
+
+  celWts->cells[celWts->numCells].idx = idx;
+  celWts->cells[celWts->numCells].seq = celWts->nextSeq;
+  celWts->cells[celWts->numCells].wt = wt;
+  ++celWts->numCells;
+  celWts->nextSeq += 1.0;
+
+  return 1;
+}
+
+
+/**********************************************************
+** Function:   findCellWt
+**
+** Purpose:    Return the weight of a cell from a set of merged sparse
+**             cell weights.
+** Arguments:  celWts, sparse cell weights, which must be merged by
+**                     compactCellWts
+**             idx,    cell index
+** Return:     weight of the cell, which is zero for cells not found
+***********************************************************/
+double findCellWt( CellWts * celWts, int idx ) {
+
+  int lo = 0;
+  int hi = celWts->numCells - 1;
+  int mid;
+
+  while ( lo <= hi ) {
+    mid = lo + (hi - lo) / 2;
+    if ( celWts->cells[mid].idx == idx ) {
+      return celWts->cells[mid].wt;
+    } else if ( celWts->cells[mid].idx < idx ) {
+      lo = mid + 1;
+    } else {
+      hi = mid - 1;
+    }
+  }
+
+  return 0.0;
+}
+
+
+/**********************************************************
+** Function:   cellRange
+**
+** Purpose:    Find the range of grid columns or rows that can overlap an
+**             interval of x or y values.
+** Notes:      The range is widened by one cell on each side, so that
+**             cells whose edges differ from the computed position by
+**             rounding error are included.
+** Arguments:  edges,  right edges of the columns or top edges of the rows
+**             numCols, number of columns or rows in the grid
+**             width,  width or height of a cell
+**             min,    lower end of the interval
+**             max,    upper end of the interval
+**             first,  first column or row of the range
+**             last,   last column or row of the range
+** Return:     none
+***********************************************************/
+void cellRange( double * edges, int numCols, double width, double min,
+                double max, int * first, int * last ) {
+
+  double origin = edges[0] - width;   /* left or bottom edge of the grid */
+  double lo = floor( (min - origin) / width ) - 1.0;
+  double hi = floor( (max - origin) / width ) + 1.0;
+
+  *first = lo < 0.0 ? 0 : ( lo > numCols - 1 ? numCols : (int) lo );
+  *last = hi > numCols - 1 ? numCols - 1 : ( hi < 0.0 ? -1 : (int) hi );
+
+  return;
+}
+
+
+/**********************************************************
+** Function:   initCellExtents
+**
+** Purpose:    Initialize an empty set of (cell, record, extent) triples.
+** Arguments:  ext, triples to initialize
+** Return:     none
+***********************************************************/
+void initCellExtents( CellExtents * ext ) {
+
+  ext->numItems = 0;
+  ext->maxItems = 0;
+  ext->items = NULL;
+
+  return;
+}
+
+
+/**********************************************************
+** Function:   freeCellExtents
+**
+** Purpose:    Free the memory used by a set of (cell, record, extent)
+**             triples and reset it to an empty set.
+** Arguments:  ext, triples to free
+** Return:     none
+***********************************************************/
+void freeCellExtents( CellExtents * ext ) {
+
+  free( ext->items );
+  initCellExtents( ext );
+
+  return;
+}
+
+
+/**********************************************************
+** Function:   addCellExtent
+**
+** Purpose:    Append a (cell, record, extent) triple, doubling the length
+**             of the array of triples when it is full.
+** Arguments:  ext,    triples
+**             cell,   position of the cell in the list of cells
+**             id,     record ID
+**             extent, clipped area or length of the record in the cell
+** Return:     1,  on success
+**             -1, on error
+***********************************************************/
+int addCellExtent( CellExtents * ext, int cell, unsigned int id,
+                   double extent ) {
+
+  int newMax;           /* new allocated length */
+  CellExtent * ptr;     /* temp pointer for reallocated memory */
+
+  if ( ext->numItems == ext->maxItems ) {
+    newMax = ext->maxItems > 0 ? 2 * ext->maxItems : 1024;
+    if ( (ptr = (CellExtent *) realloc( ext->items,
+                                        sizeof(CellExtent) * newMax )) 
+         == NULL ) {
+      return -1;
+    }
+    ext->items = ptr;
+    ext->maxItems = newMax;
+  }
+
+  ext->items[ext->numItems].cell = cell;
+  ext->items[ext->numItems].seq = ext->numItems;
+  ext->items[ext->numItems].id = id;
+  ext->items[ext->numItems].extent = extent;
+  ++ext->numItems;
+
+  return 1;
+}
+
+
+/**********************************************************
+** Function:   compareCellExtent
+**
+** Purpose:    qsort comparison function that orders CellExtent structs by
+**             cell and then by sequence number.
+***********************************************************/
+int compareCellExtent( const void * a, const void * b ) {
+
+  const CellExtent * pa = (const CellExtent *) a;
+  const CellExtent * pb = (const CellExtent *) b;
+
+  if ( pa->cell != pb->cell ) {
+    return pa->cell < pb->cell ? -1 : 1;
+  }
+  if ( pa->seq != pb->seq ) {
+    return pa->seq < pb->seq ? -1 : 1;
+  }
+  return 0;
+}
+
+
+/**********************************************************
+** Function:   sortCellExtents
+**
+** Purpose:    Put a set of (cell, record, extent) triples in order of
+**             cell and, within a cell, in the order they were added.
+** Arguments:  ext, triples
+** Return:     none
+***********************************************************/
+void sortCellExtents( CellExtents * ext ) {
+
+  qsort( ext->items, ext->numItems, sizeof(CellExtent), compareCellExtent );
+
+  return;
+}
+
+
+/**********************************************************
+** Function:   mergeCellExtents
+**
+** Purpose:    Merge the (cell, record, extent) triples kept by numLevels
+**             for the final grid into one triple for each record within
+**             each cell that has positive weight.
+** Algorithm:  The triples are sorted by cell index and sequence number.
+**             Since the records are processed one at a time, the triples
+**             of a record within a cell are then consecutive, and their
+**             extents are summed in the order they were added starting
+**             from zero.  Records whose total extent is not positive are
+**             removed.
+** Arguments:  ext,    triples, where cell is the index of a cell in the
+**                     grid.  On return cell is the position of the cell,
+**                     counting from one, among the cells with positive
+**                     weight.
+**             celWts, sparse cell weights for the grid, which must be
+**                     merged by compactCellWts
+** Return:     none
+***********************************************************/
+void mergeCellExtents( CellExtents * ext, CellWts * celWts ) {
+
+  int i, j, k;        /* loop counters */
+  int n = 0;          /* number of merged triples */
+  int pos = 0;        /* number of positive cells before the current cell */
+  int found;          /* TRUE if the current cell has positive weight */
+  double total;       /* extent of a record within a cell */
+  CellExtent * items = ext->items;
+
+  sortCellExtents( ext );
+  k = 0;
+  for ( i = 0; i < ext->numItems; i = j ) {
+
+    /* find the position of the cell among the cells with positive weight */
+    while ( k < celWts->numCells && celWts->cells[k].idx < items[i].cell ) {
+      if ( celWts->cells[k].wt > 0.0 ) {
+        ++pos;
+      }
+      ++k;
+    }
+    found = k < celWts->numCells && celWts->cells[k].idx == items[i].cell &&
+            celWts->cells[k].wt > 0.0;
+
+    /* sum the extents of the record within the cell */
+    total = 0.0;
+    for ( j = i; j < ext->numItems && items[j].cell == items[i].cell &&
+                 items[j].id == items[i].id; ++j ) {
+      total += items[j].extent;
+    }
+    if ( found && total > 0.0 ) {
+      items[n].cell = pos + 1;
+      items[n].seq = n;
+      items[n].id = items[i].id;
+      items[n].extent = total;
+      ++n;
+    }
+  }
+  ext->numItems = n;
+
+  return;
+}
+
+
+/**********************************************************
+** Function:   compareCellListX
+**
+** Purpose:    qsort comparison function that orders the cells of a
+**             CellList, stored as pairs of an x coordinate and a
+**             position, by x coordinate and then by position.
+***********************************************************/
+int compareCellListX( const void * a, const void * b ) {
+
+  const double * pa = (const double *) a;
+  const double * pb = (const double *) b;
+
+  if ( pa[0] != pb[0] ) {
+    return pa[0] < pb[0] ? -1 : 1;
+  }
+  if ( pa[1] != pb[1] ) {
+    return pa[1] < pb[1] ? -1 : 1;
+  }
+  return 0;
+}
+
+
+/**********************************************************
+** Function:   initCellList
+**
+** Purpose:    Build the index used to find the cells in a list of grid
+**             cells that can overlap a box.
+** Arguments:  index,    cell list to build
+**             xc,       x coordinates of the right edges of the cells,
+**                       which are referenced by the cell list
+**             yc,       y coordinates of the top edges of the cells, which
+**                       are referenced by the index
+**             numCells, number of cells
+**             dx,       width of a cell
+**             dy,       height of a cell
+** Return:     1,  on success
+**             -1, on error
+***********************************************************/
+int initCellList( CellList * index, double * xc, double * yc,
+                   int numCells, double dx, double dy ) {
+
+  int i;                /* loop counter */
+  double * pairs;       /* x coordinate and position of each cell */
+
+  index->numCells = numCells;
+  index->dx = dx;
+  index->dy = dy;
+  index->xc = xc;
+  index->yc = yc;
+  if ( (index->order = (int *) malloc( sizeof(int) * (numCells + 1) ))
+       == NULL ) {
+    return -1;
+  }
+  if ( (pairs = (double *) malloc( sizeof(double) * 2 * (numCells + 1) ))
+       == NULL ) {
+    free( index->order );
+    index->order = NULL;
+    return -1;
+  }
+  for ( i = 0; i < numCells; ++i ) {
+    pairs[2*i] = xc[i];
+    pairs[2*i + 1] = i;
+  }
+  qsort( pairs, numCells, 2 * sizeof(double), compareCellListX );
+  for ( i = 0; i < numCells; ++i ) {
+    index->order[i] = (int) pairs[2*i + 1];
+  }
+  free( pairs );
+
+  return 1;
+}
+
+
+/**********************************************************
+** Function:   freeCellList
+**
+** Purpose:    Free the memory used by a cell list.
+** Arguments:  index, cell list to free
+** Return:     none
+***********************************************************/
+void freeCellList( CellList * index ) {
+
+  free( index->order );
+  index->order = NULL;
+  index->numCells = 0;
+
+  return;
+}
+
+
+/**********************************************************
+** Function:   findCellList
+**
+** Purpose:    Find the range of the cell list that holds the cells whose
+**             x extent can overlap an interval of x values.
+** Notes:      A cell is in the range when its right edge is not less than
+**             the lower end of the interval and its left edge is not
+**             greater than the upper end, so cells that only touch the
+**             interval are included.  The y extent of the cells in the
+**             range still needs to be checked.
+** Arguments:  index, cell list
+**             min,   lower end of the interval
+**             max,   upper end of the interval
+**             first, first position of the range in index->order
+**             last,  one past the last position of the range
+** Return:     none
+***********************************************************/
+void findCellList( CellList * index, double min, double max, int * first,
+                    int * last ) {
+
+  int lo, hi, mid;      /* binary search bounds */
+
+  /* first cell whose right edge is not less than min */
+  lo = 0;
+  hi = index->numCells;
+  while ( lo < hi ) {
+    mid = lo + (hi - lo) / 2;
+    if ( index->xc[index->order[mid]] < min ) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  *first = lo;
+
+  /* first cell whose left edge is greater than max */
+  hi = index->numCells;
+  while ( lo < hi ) {
+    mid = lo + (hi - lo) / 2;
+    if ( index->xc[index->order[mid]] - index->dx <= max ) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  *last = lo;
+
+  return;
+}
+
+
+/**********************************************************
+** Function:   initBlockWts
+**
+** Purpose:    Allocate the storage used to compute cell weights with more
+**             than one thread.
+** Notes:      Four slots are used for each thread, so that threads that
+**             finish a block early can start another block in the same
+**             round.
+** Arguments:  blocks,     block storage to initialize
+**             numThreads, number of threads
+** Return:     1,  on success
+**             -1, on error
+***********************************************************/
+int initBlockWts( BlockWts * blocks, int numThreads ) {
+
+  int i;              /* loop counter */
+
+  blocks->numThreads = numThreads;
+  blocks->numSlots = 4 * numThreads;
+  blocks->error = (int *) calloc( blocks->numSlots, sizeof(int) );
+  blocks->wts = (CellWts *) malloc( sizeof(CellWts) * blocks->numSlots );
+  blocks->partWts = (CellWts *) malloc( sizeof(CellWts) * blocks->numSlots );
+  blocks->frags = (FragTable *) malloc( sizeof(FragTable) * blocks->numSlots );
+  blocks->clip = (ClipBuffer *) malloc( sizeof(ClipBuffer) * blocks->numSlots );
+  blocks->ext = (CellExtents *) malloc( sizeof(CellExtents) * blocks->numSlots );
+  if ( blocks->error == NULL || blocks->wts == NULL ||
+       blocks->partWts == NULL || blocks->frags == NULL ||
+       blocks->clip == NULL || blocks->ext == NULL ) {
+    free( blocks->error );
+    free( blocks->wts );
+    free( blocks->partWts );
+    free( blocks->frags );
+    free( blocks->clip );
+    free( blocks->ext );
+    blocks->numSlots = 0;
+    blocks->error = NULL;
+    blocks->wts = NULL;
+    blocks->partWts = NULL;
+    blocks->frags = NULL;
+    blocks->clip = NULL;
+    blocks->ext = NULL;
+    return -1;
+  }
+  for ( i = 0; i < blocks->numSlots; ++i ) {
+    initCellWts( &(blocks->wts[i]) );
+    blocks->wts[i].merge = 0;
+    initCellWts( &(blocks->partWts[i]) );
+    initFragTable( &(blocks->frags[i]) );
+    initClipBuffer( &(blocks->clip[i]) );
+    initCellExtents( &(blocks->ext[i]) );
+  }
+
+  return 1;
+}
+
+
+/**********************************************************
+** Function:   freeBlockWts
+**
+** Purpose:    Free the storage used to compute cell weights with more
+**             than one thread.
+** Arguments:  blocks, block storage to free
+** Return:     none
+***********************************************************/
+void freeBlockWts( BlockWts * blocks ) {
+
+  int i;              /* loop counter */
+
+  for ( i = 0; i < blocks->numSlots; ++i ) {
+    freeCellWts( &(blocks->wts[i]) );
+    freeCellWts( &(blocks->partWts[i]) );
+    freeFragTable( &(blocks->frags[i]) );
+    freeClipBuffer( &(blocks->clip[i]) );
+    freeCellExtents( &(blocks->ext[i]) );
+  }
+  free( blocks->error );
+  free( blocks->wts );
+  free( blocks->partWts );
+  free( blocks->frags );
+  free( blocks->clip );
+  free( blocks->ext );
+  blocks->numSlots = 0;
+  blocks->error = NULL;
+  blocks->wts = NULL;
+  blocks->partWts = NULL;
+  blocks->frags = NULL;
+  blocks->clip = NULL;
+  blocks->ext = NULL;
+
+  return;
+}
+
+
+/**********************************************************
+** Function:   mergeBlockWts
+**
+** Purpose:    Add the cell weights, fragments, and (cell, record, extent)
+**             triples computed for the blocks of one round to the results,
+**             and empty the slots for the next round.
+** Notes:      The entries of each slot are added in the order they were
+**             computed and the slots are taken in block order, so the
+**             results receive exactly the same sequence of entries as
+**             when the records are processed by a single thread.
+** Arguments:  celWts,   sparse cell weights for the results
+**             frags,    fragment table for the results, or NULL
+**             ext,      triples for the results, or NULL
+**             blocks,   block storage
+**             numSlots, number of slots used in the round
+** Return:     1,  on success
+**             -1, on error
+***********************************************************/
+int mergeBlockWts( CellWts * celWts, FragTable * frags, CellExtents * ext,
+                   BlockWts * blocks, int numSlots ) {
+
+  int b, i;           /* loop counters */
+  int error = 0;      /* error indicator */
+  CellWts * wts;      /* cell weights of a slot */
+  FragTable * bf;     /* fragments of a slot */
+  CellExtents * be;   /* triples of a slot */
+
+  for ( b = 0; b < numSlots; ++b ) {
+    if ( blocks->error[b] ) {
+      error = 1;
+    }
+    wts = &(blocks->wts[b]);
+    for ( i = 0; i < wts->numCells && error == 0; ++i ) {
+      if ( addCellWt( celWts, wts->cells[i].idx, wts->cells[i].wt ) == -1 ) {
+        error = 1;
+      }
+    }
+    bf = &(blocks->frags[b]);
+    for ( i = 0; frags != NULL && i < bf->numFrags && error == 0; ++i ) {
+      if ( addFragment( frags, bf->cell[i], bf->dsgIdx[i], bf->multiPart[i],
+             &(bf->points[bf->start[i]]), bf->numPts[i], bf->area[i] )
+           == -1 ) {
+        error = 1;
+      }
+    }
+    be = &(blocks->ext[b]);
+    for ( i = 0; ext != NULL && i < be->numItems && error == 0; ++i ) {
+      if ( addCellExtent( ext, be->items[i].cell, be->items[i].id,
+                          be->items[i].extent ) == -1 ) {
+        error = 1;
+      }
+    }
+    clearCellWts( wts );
+    bf->numFrags = 0;
+    bf->numPoints = 0;
+    be->numItems = 0;
+    blocks->error[b] = 0;
+  }
+
+  return error ? -1 : 1;
+}
+
+
 /**********************************************************
 ** Function:   combineShpFiles
 **
@@ -1201,89 +1951,30 @@ int createNewTempShpFile( FILE * newShp, char * shapeFileName,
 
 
 /**********************************************************
-** Function:   numLevels
+** Function:   openTempShpFile
 **
-** Purpose:    This function does the "Determine the number of levels for
-**             hierarchical randomization" part of the grts function.
-**             It works for points, polylines, and polygon shape types.
-** Algorithm:  It uses the same algorithm that is inplemented in the
-**             R version.  For determining the weight values, areaIntersection
-**             is called for a polygon shapefile, lintFcn is called for a
-**             polylines shapefile, and cWtFcn is called for a points
-**             shapefile.
-** Notes:      Before the algorithm is run a temporary .shp file is created
-**             and sent to the combineShpFiles() function.  This function will
-**             combine the data found in all the .shp files in the current
-**             working directory into one large .shp file.  This one combined
-**             .shp file is then used in the algorithm.
-**             Records that have ID numbers not found in the sent dsgnmdIDVec
-**             vector are ignored.
-** Arguments:  nsmpVec,  number of points to select in the sample
-**             shiftGridVec,  flag signalling whether to do random shift of
-**                            grid,  1 shift, 0 don't shift
-**             startLevVec,  starting value to use for the number of levels
-**                           of the grid.
-**             maxLevVec,  maximum value to use for the number of levels of the
-**                         grid.
-**             dsgnmdIDVec, vector of record IDs that have weights and should
-**                          be used in the calculations 
-**             dsgnmdVec,  vector of weights corresponding to the aboe IDs
-** Return:     results, an R object containing the final cell weights, sint,
-**                      xc and yc vectors, dx, dy, and nlev
-**                      If an error occurs results will return set to NULL
+** Purpose:    Create the temporary .shp file that contains the records of
+**             the frame, open it for reading, and parse its main file
+**             header.
+** Notes:      When a file name is not sent, the temporary .shp file
+**             combines the data found in all the .shp files in the current
+**             working directory.  Records that have ID numbers not found
+**             in the ids array are not copied.  On error the temporary
+**             .shp file is removed.
+** Arguments:  fileNamePrefix,  name of the shapefile without the .shp
+**                              extension, or R_NilValue
+**             ids,     array of the record IDs to copy
+**             numIDs,  number of IDs in the ids array
+**             shape,   shape struct in which the header info is stored
+**             fcnName, name of the calling C function, which is used in
+**                      error messages
+** Return:     pointer to the temporary .shp file, positioned after the
+**             main file header, or NULL on error
 ***********************************************************/
-SEXP numLevels( SEXP fileNamePrefix, SEXP nsmpVec, SEXP shiftGridVec, 
-                SEXP startLevVec, SEXP maxLevVec, SEXP dsgnmdIDVec, 
-                SEXP dsgnmdVec ) {
-
-  int i;            /* loop counter */
-  Shape shape;      /* shape struct for holding a section of the records from*/
-                    /* the file */
-  FILE * fptr;      /* ptr to the shapefile */
-  int maxlev;
-
-  /* vars for calculating the cell weights, names taken from R version */
-  int nlev = 0;
-  int nlv2;
-  double dx = 0.0;
-  double dy = 0.0;
-  double sint;
-  double roffX = 0.0;
-  double roffY = 0.0;
-  double * xc = NULL;
-  double * yc = NULL;
-  double * tempXc = NULL;
-  double * tempYc = NULL;
-  double * celWts = NULL;   /* cell weights */
-  int celWtsSize = 0;       /* size of cell weights array */
-  double celMax = 0.0;      /* maximum cell total inclusion probability */
-  int celMaxInd = 0;        /* indicator for whether celMax is unchanged */
-
-  /* C versions of sent vars */
-  int nsmp;
-  int shiftGrid = 0;  
-
-  /* shape maxs, mins, and extents */
-  double gridXMin;
-  double gridYMin;
-  double gridXMax;
-  double gridYMax;
-  double gridExtent;
-
-  int inc;         /* amount to increase nlev by for each round */
-
-  /* temp pointer for converting sent R objects to C vars */
-  int * intPtr;
+FILE * openTempShpFile( SEXP fileNamePrefix, unsigned int * ids, int numIDs,
+                        Shape * shape, const char * fcnName ) {
 
-  /* vars for converting results into an R object */
-  SEXP nlevVec, dxVec, dyVec, xcVec, ycVec, celWtsVec, sintVec;
-  SEXP colNamesVec;
-
-  SEXP results = NULL;    /* R object for returning final results to R */
-  unsigned int * dsgnmdID = NULL; /*array of the ID numbers that have weights */
-  double * dsgnmd = NULL;       /* array of weights that corresponde to the */
-                                /* to the array of ID numbers */
-  unsigned int dsgSize = length( dsgnmdIDVec ); /* number of IDs in the dsgnmdID array */
+  FILE * fptr;            /* pointer to the temporary .shp file */
   FILE * newShp = NULL;   /* pointer to the temp .shp file that will consist */
                           /* of the data found in all the .shp files found in */
                           /* the current working directory */
@@ -1298,10 +1989,8 @@ SEXP numLevels( SEXP fileNamePrefix, SEXP nsmpVec, SEXP shiftGridVec,
     /* create the full .shp file name */
     fileNameLen = strlen(CHAR(STRING_ELT(fileNamePrefix, 0))) + strlen(shpExt);
     if ((shpFileName = (char * restrict) malloc(fileNameLen + 1)) == NULL ) {
-      Rprintf( "Error: Allocating memory in C function numLevels\n" );
-      PROTECT( results = allocVector( VECSXP, 1 ) );
-      UNPROTECT( 1 );
-      return results;
+      Rprintf( "Error: Allocating memory in C function %s\n", fcnName );
+      return NULL;
     }
     strcpy( shpFileName, CHAR(STRING_ELT(fileNamePrefix, 0)));
     strcat( shpFileName, shpExt );
@@ -1310,139 +1999,237 @@ SEXP numLevels( SEXP fileNamePrefix, SEXP nsmpVec, SEXP shiftGridVec,
 
   /* open the new temporary .shp file */
   if ( ( newShp = fopen( TEMP_SHP_FILE, "wb" )) == NULL ) {
-    Rprintf( "Error: Creating temporary .shp file %s in C function numLevels.\n", TEMP_SHP_FILE );
-    free( shpFileName );
-    PROTECT( results = allocVector( VECSXP, 1 ) );
-    UNPROTECT(1);
-    return results;
-  }
-
-  /* copy the dsgnmd poly IDs into a C array */
-  if ( (dsgnmdID = (unsigned int *) malloc( sizeof( unsigned int ) * dsgSize))
-                                                         == NULL ) {
-    Rprintf( "Error: Allocating memory in C function numLevels.\n" );
+    Rprintf( "Error: Creating temporary .shp file %s in C function %s.\n", TEMP_SHP_FILE, fcnName );
     free( shpFileName );
-    fclose( newShp );
-    remove( TEMP_SHP_FILE );
-    PROTECT( results = allocVector( VECSXP, 1 ) );
-    UNPROTECT(1);
-    return results;
-  }
-  for ( i = 0; i < dsgSize; ++i ) {
-    dsgnmdID[i] = INTEGER( dsgnmdIDVec )[i];
+    return NULL;
   }
 
   if ( singleFile == FALSE ) {
 
     /* create a temporary .shp file containing all the .shp files */
-    if ( combineShpFiles( newShp, dsgnmdID, dsgSize ) == -1 ) {
-      Rprintf( "Error: Combining multiple shapefiles in C function numLevels.\n" );
+    if ( combineShpFiles( newShp, ids, numIDs ) == -1 ) {
+      Rprintf( "Error: Combining multiple shapefiles in C function %s.\n", fcnName );
       free( shpFileName );
       fclose( newShp );
       remove( TEMP_SHP_FILE );
-      PROTECT( results = allocVector( VECSXP, 1 ) );
-      UNPROTECT(1);
-      return results; 
+      return NULL;
     }
 
   } else {
 
     /* create a temporary .shp file containing the sent .shp file */
-    if (createNewTempShpFile(newShp,shpFileName,dsgnmdID,dsgSize) == -1 ){
-      Rprintf( "Error: Creating temporary shapefile in C function numLevels.\n" );
+    if ( createNewTempShpFile( newShp, shpFileName, ids, numIDs ) == -1 ) {
+      Rprintf( "Error: Creating temporary shapefile in C function %s.\n", fcnName );
       free( shpFileName );
       fclose( newShp );
       remove( TEMP_SHP_FILE );
-      PROTECT( results = allocVector( VECSXP, 1 ) );
-      UNPROTECT(1);
-      return results; 
+      return NULL;
     }
   }
   free( shpFileName );
   fclose( newShp );
 
   /* initialize the shape struct */
-  shape.records = NULL;
-  shape.numRecords = 0;
+  shape->records = NULL;
+  shape->numRecords = 0;
 
   /* open the temporary .shp file */
   if ( (fptr = fopen( TEMP_SHP_FILE, "rb" )) == NULL ) {
-    Rprintf( "Error: Opening shapefile in C function numLevels.\n" );
-    PROTECT( results = allocVector( VECSXP, 1 ) );
-    UNPROTECT(1);
-    return results;
+    Rprintf( "Error: Opening shapefile in C function %s.\n", fcnName );
+    remove( TEMP_SHP_FILE );
+    return NULL;
   }
 
   /* parse main file header */
-  if ( parseHeader( fptr, &shape ) == -1 ) {
-    Rprintf( "Error: Reading main file header in C function numLevels.\n" );
+  if ( parseHeader( fptr, shape ) == -1 ) {
+    Rprintf( "Error: Reading main file header in C function %s.\n", fcnName );
     fclose( fptr );
     remove( TEMP_SHP_FILE );
-    PROTECT( results = allocVector( VECSXP, 1 ) );
-    UNPROTECT(1);
-    return results;
+    return NULL;
   }
 
+  return fptr;
+}
+
+
+/**********************************************************
+** Function:   initGridLevels
+**
+** Purpose:    Initialize an empty set of results for determining the
+**             number of levels.
+** Arguments:  lev, results to initialize
+** Return:     none
+***********************************************************/
+void initGridLevels( GridLevels * lev ) {
+
+  lev->nlev = 0;
+  lev->sint = 1.0;
+  lev->keepExtents = 0;
+  lev->isArea = FALSE;
+  lev->grid.numCols = 0;
+  lev->grid.dx = 0.0;
+  lev->grid.dy = 0.0;
+  lev->grid.colX = NULL;
+  lev->grid.rowY = NULL;
+  initCellWts( &(lev->celWts) );
+  initCellExtents( &(lev->ext) );
+
+  return;
+}
+
+
+/**********************************************************
+** Function:   freeGridLevels
+**
+** Purpose:    Free the memory used by the results for determining the
+**             number of levels and reset them to an empty set.
+** Arguments:  lev, results to free
+** Return:     none
+***********************************************************/
+void freeGridLevels( GridLevels * lev ) {
+
+  free( lev->grid.colX );
+  free( lev->grid.rowY );
+  freeCellWts( &(lev->celWts) );
+  freeCellExtents( &(lev->ext) );
+  initGridLevels( lev );
+
+  return;
+}
+
+
+/**********************************************************
+** Function:   findGridLevels
+**
+** Purpose:    Determine the number of levels for hierarchical
+**             randomization and the cell weights of the final grid for the
+**             records of an open shapefile.
+** Algorithm:  It uses the same algorithm that is inplemented in the
+**             R version, as described for the numLevels function.
+** Notes:      The records are taken from the frame store when it is
+**             loaded and are otherwise read from the file at each level.
+**             R's random number generator is used to shift the grid, so
+**             the calling function must bracket the call with GetRNGstate
+**             and PutRNGstate.
+** Arguments:  lev,      results, which must be initialized.  On return
+**                       they contain the value of nlev returned by
+**                       numLevels, the sampling interval, the grid and the
+**                       cell weights of the final level and, when they are
+**                       kept, the extents of the records within the cells
+**                       of the final grid as merged by mergeCellExtents.
+**             shape,    shape struct that contains the header info for the
+**                       shapefile
+**             fptr,     pointer to the shapefile
+**             store,    frame store, which is loaded or not
+**             dsgnmdID, array of record IDs which have weights and should
+**                       be used in the calculations
+**             dsgnmd,   array of weights corresponding to the above IDs
+**             dsgSize,  number of IDs in the dsgnmdID array
+**             nsmp,     number of points to select in the sample
+**             shiftGrid,  1 to randomly shift the grid, 0 otherwise
+**             startLev, starting value for the number of levels, or
+**                       NA_INTEGER to compute it from nsmp
+**             maxlev,   maximum value for the number of levels
+**             refineGrid,  1 to refine polygon cell weights from the
+**                          fragments of the previous level, 0 otherwise
+**             keepExtents, 1 to keep the extents of polygon or polyline
+**                          records within the cells of the final grid
+**             numThreads,  number of threads used to compute the cell
+**                          weights
+** Return:     1,  on success
+**             -1, on error
+***********************************************************/
+int findGridLevels( GridLevels * lev, Shape * shape, FILE * fptr,
+                    FrameStore * store, unsigned int * dsgnmdID,
+                    double * dsgnmd, int dsgSize, int nsmp, int shiftGrid,
+                    int startLev, int maxlev, int refineGrid, int keepExtents,
+                    int numThreads ) {
+
+  int i;            /* loop counter */
+
+  /* vars for calculating the cell weights, names taken from R version */
+  int nlev = 0;
+  int nlv2;
+  double dx = 0.0;
+  double dy = 0.0;
+  double sint;
+  double roffX = 0.0;
+  double roffY = 0.0;
+  Grid * grid = &(lev->grid);   /* grid for the current level */
+  CellWts * celWts = &(lev->celWts);  /* sparse cell weights */
+  CellExtents * ext = &(lev->ext);    /* extents of the records */
+  double gridSize = 0.0;    /* number of cells in the grid */
+  double celMax = 0.0;      /* maximum cell total inclusion probability */
+  int celMaxInd = 0;        /* indicator for whether celMax is unchanged */
+
+  /* polygon fragments clipped to the cells of the previous level */
+  FragTable frags;
+  int haveFrags = FALSE;
+  int refined = FALSE;      /* TRUE if the fragments have been refined */
+  int isArea;
+
+  /* storage for computing the cell weights with more than one thread */
+  BlockWts blocks;
+  BlockWts * blockPtr = NULL;
+
+  /* shape maxs, mins, and extents */
+  double gridXMin;
+  double gridYMin;
+  double gridXMax;
+  double gridYMax;
+  double gridExtent;
+
+  int inc;         /* amount to increase nlev by for each round */
+
   /* get the min and max for x and y and determine grid extent */
-  gridXMin = shape.Xmin;
-  gridYMin = shape.Ymin;
-  gridXMax = shape.Xmax;
-  gridYMax = shape.Ymax;
+  gridXMin = shape->Xmin;
+  gridYMin = shape->Ymin;
+  gridXMax = shape->Xmax;
+  gridYMax = shape->Ymax;
   gridExtent = MAX( (gridXMax - gridXMin), (gridYMax - gridYMin) );
   gridXMin = gridXMin - gridExtent * 0.04;
   gridYMin = gridYMin - gridExtent * 0.04;
   gridXMax = gridXMin + gridExtent * 1.08;
   gridYMax = gridYMin + gridExtent * 1.08;
 
-  /* copy incoming R arguments to C variables */
-  PROTECT( nsmpVec = AS_INTEGER( nsmpVec ) );
-  intPtr = INTEGER_POINTER( nsmpVec );
-  nsmp = *intPtr;
-  UNPROTECT(1);
-
-  /* grid shift flag */
-  PROTECT( shiftGridVec = AS_INTEGER( shiftGridVec ) );
-  intPtr = INTEGER_POINTER( shiftGridVec );
-  shiftGrid = *intPtr;
-  UNPROTECT(1);
-
-  /* copy the dsgnmd mdm weights into an C array */
-  if ( (dsgnmd = (double *) malloc( sizeof( double ) * dsgSize )) == NULL ) {
-    Rprintf( "Error: Allocating memory in C function numLevels.\n" );
-    fclose( fptr );
-    remove( TEMP_SHP_FILE );
-    PROTECT( results = allocVector( VECSXP, 1 ) );
-    UNPROTECT(1);
-    return results;
+  /* the extents are only kept for polygons and polylines */
+  isArea = shape->shapeType == POLYGON || shape->shapeType == POLYGON_Z ||
+           shape->shapeType == POLYGON_M;
+  if ( shape->shapeType != POLYLINE && shape->shapeType != POLYLINE_Z &&
+       shape->shapeType != POLYLINE_M && isArea == FALSE ) {
+    keepExtents = 0;
   }
-  for ( i = 0; i < dsgSize; ++i ) {
-    dsgnmd[i] = REAL( dsgnmdVec )[i];
+  lev->isArea = isArea;
+  lev->keepExtents = keepExtents;
+  initFragTable( &frags );
+  blocks.numSlots = 0;
+  blocks.error = NULL;
+  blocks.wts = NULL;
+  blocks.partWts = NULL;
+  blocks.frags = NULL;
+  blocks.clip = NULL;
+  blocks.ext = NULL;
+
+  /* the records can only be processed in parallel from the store */
+  if ( numThreads > 1 && store->numRecords > RECORD_BLOCK_SIZE ) {
+    if ( initBlockWts( &blocks, numThreads ) == -1 ) {
+      Rprintf( "Error: Allocating memory in C function numLevels.\n" );
+      return -1;
+    }
+    blockPtr = &blocks;
   }
 
-  /* allocate memory for initial cell weights */
-  if ( (celWts = (double *) malloc( sizeof(double) ) ) == NULL ) {
+  /* set the initial cell weights */
+  if ( addCellWt( celWts, 0, 99999.0 ) == -1 ) {
     Rprintf( "Error: Allocating memory in C function numLevels.\n" );
-    fclose( fptr );
-    remove( TEMP_SHP_FILE );
-    PROTECT( results = allocVector( VECSXP, 1 ) );
-    UNPROTECT(1);
-    return results;
+    freeBlockWts( &blocks );
+    return -1;
   }
-  celWtsSize = 1;
-
-  /* input the RNG state */
-  GetRNGstate();
+  gridSize = 1.0;
 
   /* start algorithm */
-  PROTECT( maxLevVec = AS_INTEGER( maxLevVec ) );
-  intPtr = INTEGER_POINTER( maxLevVec );
-  maxlev = *intPtr;
-  UNPROTECT(1);
-  if ( startLevVec != R_NilValue ) {
-    PROTECT( startLevVec = AS_INTEGER( startLevVec ) );
-    intPtr = INTEGER_POINTER( startLevVec );
-    nlev = *intPtr;
-    UNPROTECT(1);
+  if ( startLev != NA_INTEGER ) {
+    nlev = startLev;
   } else {
     nlev = ceil( log(nsmp)/log(4) );
     if ( nlev == 0 ) {
@@ -1453,153 +2240,106 @@ SEXP numLevels( SEXP fileNamePrefix, SEXP nsmpVec, SEXP shiftGridVec,
   	nlev = maxlev;
   }
   Rprintf( "Initial number of levels: %i \n", nlev );
-  celWts[0] = 99999.0;
   sint = 1.0;
   if ( shiftGrid == 1 ) {
     roffX = runif( 0.0, 1.0 );
     roffY = runif( 0.0, 1.0 );
   }
-  while ( any( celWts, celWtsSize, sint, 1 ) && 
+  while ( any( celWts, sint, 1 ) && 
         ( celMaxInd < 2 ) &&
         ( nlev <= maxlev ) ) {
     Rprintf( "Current number of levels: %i \n", nlev );
-    celMax = maxWt( celWts, celWtsSize );
+    celMax = maxWt( celWts, gridSize );
     nlv2 = pow( 2, nlev );
     dx = gridExtent * 1.08 / nlv2;
     dy = gridExtent * 1.08 / nlv2;
 
-    /* allocate memory for tempXc */
-    if ( tempXc ) {
-      free( tempXc );
-    }
-    if ( (tempXc = (double *) malloc( sizeof(double) * (nlv2+1) )) == NULL ) {
+    /* allocate memory for the column and row edges of the grid */
+    free( grid->colX );
+    free( grid->rowY );
+    grid->colX = (double *) malloc( sizeof(double) * (nlv2+1) );
+    grid->rowY = (double *) malloc( sizeof(double) * (nlv2+1) );
+    if ( grid->colX == NULL || grid->rowY == NULL ) {
       Rprintf( "Error: Allocating memory in C function numLevels.\n" );
-      fclose( fptr );
-      remove( TEMP_SHP_FILE );
-      PROTECT( results = allocVector( VECSXP, 1 ) );
-      UNPROTECT(1);
-      return results;
-    }
-
-    /* allocate memory for tempYc */
-    if ( tempYc ) {
-      free( tempYc );
-    }
-    if ( (tempYc = (double *) malloc( sizeof(double) * (nlv2+1) )) == NULL ) {
-      Rprintf( "Error: Allocating memory in C function numLevels.\n" );
-      fclose( fptr );
-      remove( TEMP_SHP_FILE );
-      PROTECT( results = allocVector( VECSXP, 1 ) );
-      UNPROTECT(1);
-      return results;
-    }
-
-    seq( &tempXc, gridXMin, gridXMax, nlv2+1 );
-    seq( &tempYc, gridYMin, gridYMax, nlv2+1 );
-
-    /* allocate memory for xc */
-    if ( xc ) {
-      free( xc );
-    }
-    if ( (xc = (double *) malloc( sizeof(double) * (nlv2+1) * (nlv2+1) )) 
-                                                              == NULL ) {
-      Rprintf( "Error: Allocating memory in C function numLevels.\n" );
-      fclose( fptr );
-      remove( TEMP_SHP_FILE );
-      PROTECT( results = allocVector( VECSXP, 1 ) );
-      UNPROTECT(1);
-      return results;
-    }
-
-    /* allocate memory for yc */
-    if ( yc ) {
-      free( yc );
-    }
-    if ( (yc = (double *) malloc( sizeof(double) * (nlv2+1) * (nlv2+1) )) 
-                                                               == NULL ) {
-      Rprintf( "Error: Allocating memory in C function numLevels.\n" );
-      fclose( fptr );
-      remove( TEMP_SHP_FILE );
-      PROTECT( results = allocVector( VECSXP, 1 ) );
-      UNPROTECT(1);
-      return results;
+      freeFragTable( &frags );
+      freeBlockWts( &blocks );
+      return -1;
     }
+    grid->numCols = nlv2 + 1;
+    grid->dx = dx;
+    grid->dy = dy;
+    gridSize = (double) (nlv2+1) * (double) (nlv2+1);
 
     /* as necessary, do the random shift of the grid */
+    seq( &(grid->colX), gridXMin, gridXMax, nlv2+1 );
+    seq( &(grid->rowY), gridYMin, gridYMax, nlv2+1 );
     if ( shiftGrid == 1 ) {
-      rep( &xc, tempXc, nlv2+1, roffX*dx ); 
-      rep2( &yc, tempYc, nlv2+1, roffY*dy );
-    } else {
-      rep( &xc, tempXc, nlv2+1, 0 ); 
-      rep2( &yc, tempYc, nlv2+1, 0 );
-    }
-
-    /* reallocate memory for the cell weights */
-    if ( celWts ) {
-      free( celWts );
-    }
-    celWtsSize = (nlv2+1) * (nlv2+1);
-    if ( (celWts = (double *) malloc( sizeof(double) * celWtsSize ) ) == NULL){
-      Rprintf( "Error: Allocating memory in C function numLevels.\n" );
-      fclose( fptr );
-      remove( TEMP_SHP_FILE );
-      PROTECT( results = allocVector( VECSXP, 1 ) );
-      UNPROTECT(1);
-      return results;
+      for ( i = 0; i <= nlv2; ++i ) {
+        grid->colX[i] = grid->colX[i] + roffX*dx;
+        grid->rowY[i] = grid->rowY[i] + roffY*dy;
+      }
     }
 
     /* see if this is a Polygon shape type */
-    if ( shape.shapeType == POLYGON || shape.shapeType == POLYGON_Z ||
-    	    shape.shapeType == POLYGON_M ) { 
-      if ( areaIntersection( &celWts, xc, yc, dx, dy, celWtsSize , &shape, fptr,
-           dsgnmdID, dsgnmd, dsgSize ) == - 1) {
-        Rprintf( "Error: In C function areaIntersection.\n" ); 
-        fclose( fptr );
-        remove( TEMP_SHP_FILE );
-        PROTECT( results = allocVector( VECSXP, 1 ) );
-        UNPROTECT(1);
-        return results;
+    if ( isArea ) { 
+      if ( haveFrags == TRUE ) {
+        if ( areaRefinement( celWts, grid, &frags, dsgnmd,
+                             blockPtr ) == -1 ) {
+          Rprintf( "Error: In C function areaRefinement.\n" ); 
+          freeFragTable( &frags );
+          freeBlockWts( &blocks );
+          return -1;
+        }
+        refined = TRUE;
+      } else {
+
+        /* without refinement, the fragments are only kept for the */
+        /* extents of the final level */
+        frags.numFrags = 0;
+        frags.numPoints = 0;
+        if ( areaIntersection( celWts, grid, shape, fptr, dsgnmdID,
+             dsgnmd, dsgSize, refineGrid == 1 || keepExtents == 1 ?
+             &frags : NULL, store, blockPtr ) == - 1) {
+          Rprintf( "Error: In C function areaIntersection.\n" ); 
+          freeFragTable( &frags );
+          freeBlockWts( &blocks );
+          return -1;
+        }
+        haveFrags = refineGrid == 1 ? TRUE : FALSE;
       }
    
     /* see if this is a Polyline shape type */
-    } else if ( shape.shapeType == POLYLINE || shape.shapeType == POLYLINE_Z ||
-    	           shape.shapeType == POLYLINE_M ) {
-      if ( lintFcn ( &celWts, xc, yc, dx , dy, celWtsSize, &shape, fptr,
-           dsgnmdID, dsgnmd, dsgSize ) == -1 ) {
+    } else if ( shape->shapeType == POLYLINE ||
+                shape->shapeType == POLYLINE_Z ||
+                shape->shapeType == POLYLINE_M ) {
+      if ( lintFcn ( celWts, grid, shape, fptr, dsgnmdID, dsgnmd, dsgSize,
+                     store, blockPtr, keepExtents == 1 ? ext : NULL )
+           == -1 ) {
         Rprintf( "Error: In C function lintFcn.\n" ); 
-        fclose( fptr );
-        remove( TEMP_SHP_FILE );
-        PROTECT( results = allocVector( VECSXP, 1 ) );
-        UNPROTECT(1); 
-        return results;
+        freeBlockWts( &blocks );
+        return -1;
       }
 
     /* see if this is a Point shape type */
-    } else if ( shape.shapeType == POINTS || shape.shapeType == POINTS_Z ||
-    	           shape.shapeType == POINTS_M ) {
-      if ( cWtFcn( &celWts, xc, yc, dx , dy, celWtsSize, &shape, fptr,
-                   dsgnmdID, dsgnmd, dsgSize ) == -1 ) {
+    } else if ( shape->shapeType == POINTS || shape->shapeType == POINTS_Z ||
+    	           shape->shapeType == POINTS_M ) {
+      if ( cWtFcn( celWts, grid, shape, fptr, dsgnmdID, dsgnmd, dsgSize,
+                   store, blockPtr ) == -1 ) {
         Rprintf( "Error: In C function cWtFcn.\n" ); 
-        fclose( fptr );
-        remove( TEMP_SHP_FILE );
-        PROTECT( results = allocVector( VECSXP, 1 ) );
-        UNPROTECT(1); 
-        return results;
+        freeBlockWts( &blocks );
+        return -1;
       }
 
     /* else unrecognized shape type */
     } else {
       Rprintf( "Error: Invalid shapefile type in C function numLevels.\n" ); 
-      fclose( fptr );
-      remove( TEMP_SHP_FILE );
-      PROTECT( results = allocVector( VECSXP, 1 ) );
-      UNPROTECT(1); 
-      return results;
+      freeBlockWts( &blocks );
+      return -1;
     }
-    sint = sum( celWts, celWtsSize ) / nsmp; 
+    sint = sum( celWts ) / nsmp; 
 
     /* as, necessary, increment celMaxInd */
-    if ( maxWt( celWts, celWtsSize ) == celMax ) {
+    if ( maxWt( celWts, gridSize ) == celMax ) {
     	 ++celMaxInd;
     	 if ( celMaxInd == 2 ) {
     	   Rprintf( "Since the maximum value of total inclusion probability for the grid cells was \nnot changing, the algorithm for determining the number of levels for \nhierarchical randomization was terminated.\n" );
@@ -1609,9 +2349,9 @@ SEXP numLevels( SEXP fileNamePrefix, SEXP nsmpVec, SEXP shiftGridVec,
     /* determine the increment for nlev */
     inc = 1;
     if ( nlev < (maxlev - 1) ) {
-      for ( i = 0; i < celWtsSize; ++i ) {
-        if ( celWts[i] > 0 ) {
-          inc = MAX( inc, ceil( log(celWts[i]/sint )/log(4) ) );
+      for ( i = 0; i < celWts->numCells; ++i ) {
+        if ( celWts->cells[i].wt > 0 ) {
+          inc = MAX( inc, ceil( log(celWts->cells[i].wt/sint )/log(4) ) );
         }
       }
       if ( (nlev + inc) > maxlev ) {
@@ -1622,24 +2362,350 @@ SEXP numLevels( SEXP fileNamePrefix, SEXP nsmpVec, SEXP shiftGridVec,
   }
   Rprintf( "Final number of levels: %i \n", nlev-1 );
 
+  /* merge the extents of the records within the final cells, where */
+  /* refined fragments give only the cells that each record occupies */
+  if ( keepExtents == 1 ) {
+    if ( refined == TRUE && areaExtents( ext, grid, &frags, shape, fptr,
+           dsgnmdID, dsgSize, store ) == -1 ) {
+      freeFragTable( &frags );
+      freeBlockWts( &blocks );
+      return -1;
+    }
+    for ( i = 0; isArea && refined == FALSE && i < frags.numFrags; ++i ) {
+      if ( addCellExtent( ext, frags.cell[i], frags.dsgIdx[i],
+                          frags.area[i] ) == -1 ) {
+        Rprintf( "Error: Allocating memory in C function numLevels.\n" );
+        freeFragTable( &frags );
+        freeBlockWts( &blocks );
+        return -1;
+      }
+    }
+    mergeCellExtents( ext, celWts );
+  }
+  lev->nlev = nlev;
+  lev->sint = sint;
+
+  /* clean up */
+  freeFragTable( &frags );
+  freeBlockWts( &blocks );
+
+  return 1;
+}
+
+
+/**********************************************************
+** Function:   numLevels
+**
+** Purpose:    This function does the "Determine the number of levels for
+**             hierarchical randomization" part of the grts function.
+**             It works for points, polylines, and polygon shape types.
+** Algorithm:  It uses the same algorithm that is inplemented in the
+**             R version.  For determining the weight values, areaIntersection
+**             is called for a polygon shapefile, lintFcn is called for a
+**             polylines shapefile, and cWtFcn is called for a points
+**             shapefile.
+** Notes:      Before the algorithm is run a temporary .shp file is created
+**             and sent to the combineShpFiles() function.  This function will
+**             combine the data found in all the .shp files in the current
+**             working directory into one large .shp file.  This one combined
+**             .shp file is then used in the algorithm.
+**             Records that have ID numbers not found in the sent dsgnmdIDVec
+**             vector are ignored.
+**             For polygons, when refineGridVec is TRUE only the first level
+**             clips the records to the whole grid.  The clipped fragments
+**             in cells with positive weight are kept and each later level
+**             is computed by areaRefinement from those fragments, so that
+**             grid cells with zero weight are never visited again.
+**             When the records of the temporary .shp file fit within the
+**             memory budget they are decoded once into a frame store and
+**             every level takes the records from the store.  Otherwise the
+**             records are read from the file at each level.
+**             The cell weights are kept in sparse form, so that memory is
+**             proportional to the number of cells with nonzero weight
+**             rather than to the number of cells in the grid.
+**             When the records are held in memory and more than one thread
+**             is requested, blocks of records are processed in parallel.
+**             The results do not depend on the number of threads.
+**             For polygons and polylines, when keepExtentsVec is TRUE the
+**             clipped area or length of each record within each cell of
+**             the final grid is kept as it is computed, so that the
+**             records in the cells selected for the sample can be looked
+**             up without clipping the records to those cells again.
+**             Polygon areas are summed from the fragments of the final
+**             level.  When the grid is refined, the fragments only give
+**             the cells that each record occupies, and areaExtents clips
+**             the record directly to those cells, since the areas of
+**             refined fragments can differ in the last bits.
+**             The levels are determined by findGridLevels, which is also
+**             used by the functions that select a GRTS sample in one call.
+** Arguments:  nsmpVec,  number of points to select in the sample
+**             shiftGridVec,  flag signalling whether to do random shift of
+**                            grid,  1 shift, 0 don't shift
+**             startLevVec,  starting value to use for the number of levels
+**                           of the grid.
+**             maxLevVec,  maximum value to use for the number of levels of the
+**                         grid.
+**             dsgnmdIDVec, vector of record IDs that have weights and should
+**                          be used in the calculations 
+**             dsgnmdVec,  vector of weights corresponding to the aboe IDs
+**             refineGridVec,  flag signalling whether to refine polygon cell
+**                             weights from the fragments of the previous
+**                             level, TRUE refine, FALSE clip every record
+**                             against the full grid at each level
+**             frameBudgetVec,  memory budget in megabytes for holding the
+**                              records in memory, where NULL uses the
+**                              default of FRAME_STORE_BUDGET and 0 always
+**                              reads the records from the file
+**             threadsVec,  number of threads used to compute the cell
+**                          weights, where NULL uses the OpenMP default
+**             keepExtentsVec,  flag signalling whether to return the
+**                              clipped extent of the records within the
+**                              cells of the final grid, TRUE return them,
+**                              FALSE or NULL don't return them
+** Return:     results, an R object containing the final cell weights, sint,
+**                      xc and yc vectors, dx, dy, nlev, the cell indices,
+**                      and cell.df.  Only the cells with positive weight
+**                      are returned, in increasing order of cell index,
+**                      where the index of the cell in column i and row j of
+**                      the grid is j*(2^nlev + 1) + i counting from zero.
+**                      When the extents are kept, cell.df is a list
+**                      containing cellID, the position of a cell among the
+**                      returned cells, recordID, the ID of a record with
+**                      positive area or length within that cell, and
+**                      recordArea or recordLength, its clipped area or
+**                      length, in order of cell and then of the record IDs
+**                      in dsgnmdIDVec.  Otherwise cell.df is NULL.
+**                      If an error occurs results will return set to NULL
+***********************************************************/
+SEXP numLevels( SEXP fileNamePrefix, SEXP nsmpVec, SEXP shiftGridVec, 
+                SEXP startLevVec, SEXP maxLevVec, SEXP dsgnmdIDVec, 
+                SEXP dsgnmdVec, SEXP refineGridVec, SEXP frameBudgetVec,
+                SEXP threadsVec, SEXP keepExtentsVec ) {
+
+  int i;            /* loop counter */
+  Shape shape;      /* shape struct for holding a section of the records from*/
+                    /* the file */
+  FILE * fptr;      /* ptr to the shapefile */
+  int maxlev;
+  int startLev = NA_INTEGER;
+  GridLevels lev;           /* results for the final level */
+  int numCells;             /* number of cells with positive weight */
+  int j;                    /* index of a cell in the results */
+
+  /* C versions of sent vars */
+  int nsmp;
+  int shiftGrid = 0;  
+  int refineGrid = 0;
+  int keepExtents = 0;
+
+  /* records of the temporary .shp file held in memory */
+  FrameStore store;
+  double frameBudget = FRAME_STORE_BUDGET;
+  int numThreads = 1;
+
+  /* temp pointer for converting sent R objects to C vars */
+  int * intPtr;
+
+  /* vars for converting results into an R object */
+  SEXP nlevVec, dxVec, dyVec, xcVec, ycVec, celWtsVec, sintVec, celIdxVec;
+  SEXP colNamesVec;
+  SEXP cellDfVec, cellIDVec, recordIDVec, recordExtVec, dfNamesVec;
+
+  SEXP results = NULL;    /* R object for returning final results to R */
+  unsigned int * dsgnmdID = NULL; /*array of the ID numbers that have weights */
+  double * dsgnmd = NULL;       /* array of weights that corresponde to the */
+                                /* to the array of ID numbers */
+  unsigned int dsgSize = length( dsgnmdIDVec ); /* number of IDs in the dsgnmdID array */
+
+  /* copy the dsgnmd poly IDs into a C array */
+  if ( (dsgnmdID = (unsigned int *) malloc( sizeof( unsigned int ) * dsgSize))
+                                                         == NULL ) {
+    Rprintf( "Error: Allocating memory in C function numLevels.\n" );
+    PROTECT( results = allocVector( VECSXP, 1 ) );
+    UNPROTECT(1);
+    return results;
+  }
+  for ( i = 0; i < dsgSize; ++i ) {
+    dsgnmdID[i] = INTEGER( dsgnmdIDVec )[i];
+  }
+
+  /* create and open the temporary .shp file */
+  if ( (fptr = openTempShpFile( fileNamePrefix, dsgnmdID, dsgSize, &shape,
+                                "numLevels" )) == NULL ) {
+    free( dsgnmdID );
+    PROTECT( results = allocVector( VECSXP, 1 ) );
+    UNPROTECT(1);
+    return results;
+  }
+
+  /* copy incoming R arguments to C variables */
+  PROTECT( nsmpVec = AS_INTEGER( nsmpVec ) );
+  intPtr = INTEGER_POINTER( nsmpVec );
+  nsmp = *intPtr;
+  UNPROTECT(1);
+
+  /* grid shift flag */
+  PROTECT( shiftGridVec = AS_INTEGER( shiftGridVec ) );
+  intPtr = INTEGER_POINTER( shiftGridVec );
+  shiftGrid = *intPtr;
+  UNPROTECT(1);
+
+  /* polygon refinement flag */
+  if ( refineGridVec != R_NilValue ) {
+    PROTECT( refineGridVec = AS_INTEGER( refineGridVec ) );
+    intPtr = INTEGER_POINTER( refineGridVec );
+    refineGrid = *intPtr;
+    UNPROTECT(1);
+  }
+
+  /* flag for keeping the extents of the records within the final cells */
+  if ( keepExtentsVec != R_NilValue ) {
+    PROTECT( keepExtentsVec = AS_INTEGER( keepExtentsVec ) );
+    intPtr = INTEGER_POINTER( keepExtentsVec );
+    keepExtents = *intPtr == 1 ? 1 : 0;
+    UNPROTECT(1);
+  }
+
+  /* starting and maximum number of levels */
+  PROTECT( maxLevVec = AS_INTEGER( maxLevVec ) );
+  intPtr = INTEGER_POINTER( maxLevVec );
+  maxlev = *intPtr;
+  UNPROTECT(1);
+  if ( startLevVec != R_NilValue ) {
+    PROTECT( startLevVec = AS_INTEGER( startLevVec ) );
+    intPtr = INTEGER_POINTER( startLevVec );
+    startLev = *intPtr;
+    UNPROTECT(1);
+  }
+
+  /* number of threads */
+#ifdef _OPENMP
+  numThreads = omp_get_max_threads();
+#endif
+  if ( threadsVec != R_NilValue ) {
+    PROTECT( threadsVec = AS_INTEGER( threadsVec ) );
+    numThreads = INTEGER( threadsVec )[0];
+    UNPROTECT(1);
+  }
+  if ( numThreads == NA_INTEGER || numThreads < 1 ) {
+    numThreads = 1;
+  }
+
+  /* memory budget for the frame store */
+  if ( frameBudgetVec != R_NilValue ) {
+    PROTECT( frameBudgetVec = AS_NUMERIC( frameBudgetVec ) );
+    frameBudget = REAL( frameBudgetVec )[0];
+    UNPROTECT(1);
+  }
+
+  /* copy the dsgnmd mdm weights into an C array */
+  if ( (dsgnmd = (double *) malloc( sizeof( double ) * dsgSize )) == NULL ) {
+    Rprintf( "Error: Allocating memory in C function numLevels.\n" );
+    free( dsgnmdID );
+    fclose( fptr );
+    remove( TEMP_SHP_FILE );
+    PROTECT( results = allocVector( VECSXP, 1 ) );
+    UNPROTECT(1);
+    return results;
+  }
+  for ( i = 0; i < dsgSize; ++i ) {
+    dsgnmd[i] = REAL( dsgnmdVec )[i];
+  }
+
+  /* decode the records once if they fit within the memory budget */
+  initFrameStore( &store );
+  if ( loadFrameStore( &store, &shape, fptr, dsgnmdID, dsgSize,
+                       frameBudget ) == -1 ) {
+    Rprintf( "Error: Reading the records in C function numLevels.\n" );
+    free( dsgnmdID );
+    free( dsgnmd );
+    fclose( fptr );
+    remove( TEMP_SHP_FILE );
+    PROTECT( results = allocVector( VECSXP, 1 ) );
+    UNPROTECT(1);
+    return results;
+  }
+
+  /* input the RNG state */
+  GetRNGstate();
+
+  /* determine the number of levels and the final cell weights */
+  initGridLevels( &lev );
+  if ( findGridLevels( &lev, &shape, fptr, &store, dsgnmdID, dsgnmd, dsgSize,
+                       nsmp, shiftGrid, startLev, maxlev, refineGrid,
+                       keepExtents, numThreads ) == -1 ) {
+    PutRNGstate();
+    freeGridLevels( &lev );
+    free( dsgnmdID );
+    free( dsgnmd );
+    freeFrameStore( &store );
+    fclose( fptr );
+    remove( TEMP_SHP_FILE );
+    PROTECT( results = allocVector( VECSXP, 1 ) );
+    UNPROTECT(1);
+    return results;
+  }
+  keepExtents = lev.keepExtents;
+
+  /* count the cells with positive weight */
+  numCells = 0;
+  for ( i = 0; i < lev.celWts.numCells; ++i ) {
+    if ( lev.celWts.cells[i].wt > 0.0 ) {
+      ++numCells;
+    }
+  }
+
   /* write final results to the R objects */
-  PROTECT( results = allocVector( VECSXP, 7 ) );
+  PROTECT( results = allocVector( VECSXP, 9 ) );
   PROTECT( nlevVec = allocVector( INTSXP, 1 ) );
-  INTEGER( nlevVec )[0] = nlev;
+  INTEGER( nlevVec )[0] = lev.nlev;
   PROTECT( dxVec = allocVector( REALSXP, 1 ) );
-  REAL( dxVec )[0] = dx;
+  REAL( dxVec )[0] = lev.grid.dx;
   PROTECT( dyVec = allocVector( REALSXP, 1 ) );
-  REAL( dyVec )[0] = dy;
-  PROTECT( xcVec = allocVector( REALSXP, celWtsSize ) );
-  PROTECT( ycVec = allocVector( REALSXP, celWtsSize ) );
-  PROTECT( celWtsVec = allocVector( REALSXP, celWtsSize ) );
-  for ( i = 0; i < celWtsSize; ++i ) {
-    REAL( xcVec )[i] = xc[i];
-    REAL( ycVec )[i] = yc[i];
-    REAL( celWtsVec )[i] = celWts[i];
+  REAL( dyVec )[0] = lev.grid.dy;
+  PROTECT( xcVec = allocVector( REALSXP, numCells ) );
+  PROTECT( ycVec = allocVector( REALSXP, numCells ) );
+  PROTECT( celWtsVec = allocVector( REALSXP, numCells ) );
+  PROTECT( celIdxVec = allocVector( INTSXP, numCells ) );
+  j = 0;
+  for ( i = 0; i < lev.celWts.numCells; ++i ) {
+    if ( lev.celWts.cells[i].wt > 0.0 ) {
+      REAL( xcVec )[j] =
+        lev.grid.colX[lev.celWts.cells[i].idx % lev.grid.numCols];
+      REAL( ycVec )[j] =
+        lev.grid.rowY[lev.celWts.cells[i].idx / lev.grid.numCols];
+      REAL( celWtsVec )[j] = lev.celWts.cells[i].wt;
+      INTEGER( celIdxVec )[j] = lev.celWts.cells[i].idx;
+      ++j;
+    }
   }
   PROTECT( sintVec = allocVector( REALSXP, 1 ) );
-  REAL( sintVec )[0] = sint;
+  REAL( sintVec )[0] = lev.sint;
+
+  /* create the list of record extents within the cells */
+  if ( keepExtents == 1 ) {
+    PROTECT( cellDfVec = allocVector( VECSXP, 3 ) );
+    PROTECT( cellIDVec = allocVector( INTSXP, lev.ext.numItems ) );
+    PROTECT( recordIDVec = allocVector( INTSXP, lev.ext.numItems ) );
+    PROTECT( recordExtVec = allocVector( REALSXP, lev.ext.numItems ) );
+    for ( i = 0; i < lev.ext.numItems; ++i ) {
+      INTEGER( cellIDVec )[i] = lev.ext.items[i].cell;
+      INTEGER( recordIDVec )[i] = dsgnmdID[lev.ext.items[i].id];
+      REAL( recordExtVec )[i] = lev.ext.items[i].extent;
+    }
+    SET_VECTOR_ELT( cellDfVec, 0, cellIDVec );
+    SET_VECTOR_ELT( cellDfVec, 1, recordIDVec );
+    SET_VECTOR_ELT( cellDfVec, 2, recordExtVec );
+    PROTECT( dfNamesVec = allocVector( STRSXP, 3 ) );
+    SET_STRING_ELT( dfNamesVec, 0, mkChar( "cellID" ) );
+    SET_STRING_ELT( dfNamesVec, 1, mkChar( "recordID" ) );
+    SET_STRING_ELT( dfNamesVec, 2,
+                    mkChar( lev.isArea ? "recordArea" : "recordLength" ) );
+    setAttrib( cellDfVec, R_NamesSymbol, dfNamesVec );
+    UNPROTECT(4);
+  } else {
+    PROTECT( cellDfVec = R_NilValue );
+  }
 
   /* copy each data vector into the final results vector */  
   SET_VECTOR_ELT( results, 0, nlevVec); 
@@ -1649,9 +2715,11 @@ SEXP numLevels( SEXP fileNamePrefix, SEXP nsmpVec, SEXP shiftGridVec,
   SET_VECTOR_ELT( results, 4, ycVec ); 
   SET_VECTOR_ELT( results, 5, celWtsVec ); 
   SET_VECTOR_ELT( results, 6, sintVec ); 
+  SET_VECTOR_ELT( results, 7, celIdxVec ); 
+  SET_VECTOR_ELT( results, 8, cellDfVec ); 
 
   /* create vector labels */
-  PROTECT( colNamesVec = allocVector( STRSXP, 7 ) );
+  PROTECT( colNamesVec = allocVector( STRSXP, 9 ) );
   SET_STRING_ELT( colNamesVec, 0, mkChar( "nlev" ) );
   SET_STRING_ELT( colNamesVec, 1, mkChar( "dx" ) );
   SET_STRING_ELT( colNamesVec, 2, mkChar( "dy" ) );
@@ -1659,40 +2727,25 @@ SEXP numLevels( SEXP fileNamePrefix, SEXP nsmpVec, SEXP shiftGridVec,
   SET_STRING_ELT( colNamesVec, 4, mkChar( "yc" ) );
   SET_STRING_ELT( colNamesVec, 5, mkChar( "cel.wt" ) );
   SET_STRING_ELT( colNamesVec, 6, mkChar( "sint" ) );
+  SET_STRING_ELT( colNamesVec, 7, mkChar( "cel.idx" ) );
+  SET_STRING_ELT( colNamesVec, 8, mkChar( "cell.df" ) );
   setAttrib( results, R_NamesSymbol, colNamesVec );
 
   /* output the RNG state */
   PutRNGstate();
   
   /* clean up */
-  if ( celWts ) {
-    free( celWts );
-  }
-  if ( tempXc ) {
-    free( tempXc );
-  }
-  if ( tempYc ) {
-    free( tempYc );
-  }
-  if ( xc ) {
-    free( xc );
-  }
-  if ( yc ) {
-    free( yc );
-  }
+  freeGridLevels( &lev );
   if ( dsgnmdID ) {
     free( dsgnmdID );
   }
   if ( dsgnmd ) {
     free( dsgnmd );
   }
+  freeFrameStore( &store );
   fclose( fptr );
   remove( TEMP_SHP_FILE );
-  UNPROTECT(9);
+  UNPROTECT(11);
 
   return results;
 }
-
-
-
-
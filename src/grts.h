@@ -4,14 +4,17 @@
 **  Purpose:      Contains defines for grts.c
 **  Programmer:   Christian Platt
 **  Created:      11/17/2004
-**  Last Revised: November 10, 2010
+**  Last Revised: October 19, 2026
 ******************************************************************************/
 
 #ifndef GRTS_H 
 #define GRTS_H
 
-/* temporary shapefile name */
-#define TEMP_SHP_FILE  "shapefile1021.shp"
+/* temporary shapefile name, which contains the process ID so that */
+/* processes that share the working directory, such as the workers that */
+/* select replicate designs, do not overwrite each other's file */
+#define TEMP_SHP_FILE  tempShpFileName()
+const char * tempShpFileName( void );
 
 /* struct for storing a cell's coordinates */
 typedef struct cellStruct Cell;
@@ -22,4 +25,275 @@ struct cellStruct {
   double yMax;
 };
 
+/* struct for describing one level of the hierarchical grid.  Cell i of the */
+/* grid is in column i % numCols and row i / numCols, and covers x values */
+/* from colX[column] - dx to colX[column] and y values from rowY[row] - dy */
+/* to rowY[row]. */
+typedef struct gridStruct Grid;
+struct gridStruct {
+  int numCols;       /* number of columns and of rows in the grid */
+  double dx;         /* width of a cell */
+  double dy;         /* height of a cell */
+  double * colX;     /* x coordinate of the right edge of each column */
+  double * rowY;     /* y coordinate of the top edge of each row */
+};
+
+/* struct for storing the grid cells that have nonzero weight in sparse */
+/* form.  Weights are appended as they are computed, each with a sequence */
+/* number, and are merged by cell index in the order they were added, so */
+/* that each cell's weight is summed in the same order as for a dense array */
+/* of cell weights.  After compactCellWts the cells are in increasing order */
+/* of cell index with one entry per cell.  When merge is 0 the entries are */
+/* only appended, which is used for the weights computed by one block of */
+/* records so that they can later be added to the weights for the whole */
+/* frame in record order. */
+typedef struct cellWtStruct CellWt;
+struct cellWtStruct {
+  int idx;           /* cell index */
+  double seq;        /* sequence number */
+  double wt;         /* weight */
+};
+typedef struct cellWtsStruct CellWts;
+struct cellWtsStruct {
+  int numCells;      /* number of entries */
+  int maxCells;      /* allocated length of the cells array */
+  int numMerged;     /* number of leading entries that are already merged */
+  int merge;         /* 1 if entries are merged when the array is full */
+  double nextSeq;    /* next sequence number */
+  CellWt * cells;    /* array of entries */
+};
+
+/* default memory budget in megabytes for holding the records of the */
+/* temporary shapefile in memory while the number of levels is determined */
+#define FRAME_STORE_BUDGET  512.0
+
+/* struct for storing the records of a shapefile in flat arrays, so that the */
+/* file is decoded once and then reused.  Only records that have an ID in */
+/* the dsgnmdID array are stored, and the matching index into the dsgnmd */
+/* array is saved with each record.  Point records are stored as a record */
+/* with one part and one point.  Part offsets are relative to the first */
+/* point of the record, as they are in the shapefile. */
+typedef struct frameStoreStruct FrameStore;
+struct frameStoreStruct {
+  int shapeType;     /* shape type of the records */
+  int numRecords;    /* number of records in the store, -1 if not loaded */
+  int * recNum;      /* record number of each record */
+  int * dsgIdx;      /* index into the dsgnmd array for each record */
+  int * numParts;    /* number of parts in each record */
+  int * partStart;   /* index in parts of each record's first part */
+  int * numPts;      /* number of points in each record */
+  int * pointStart;  /* index in points of each record's first point */
+  int * parts;       /* part offsets for all of the records */
+  Point * points;    /* points for all of the records */
+};
+
+/* struct for storing the pieces of polygon records that were clipped to the */
+/* grid cells of one level of the hierarchical grid.  Each fragment is a */
+/* closed ring whose signed area was computed when it was clipped, so that */
+/* holes keep their negative area.  Note that shapeParser.h must be */
+/* included before this file. */
+typedef struct fragTableStruct FragTable;
+struct fragTableStruct {
+  int numFrags;      /* number of fragments in the table */
+  int maxFrags;      /* allocated length of the fragment arrays */
+  int * cell;        /* index of the grid cell containing each fragment */
+  int * dsgIdx;      /* index into the dsgnmd array of each fragment's record */
+  int * multiPart;   /* 1 if the fragment's record has more than one part */
+  int * start;       /* index in points of each fragment's first point */
+  int * numPts;      /* number of points in each fragment */
+  double * area;     /* signed area of each fragment */
+  int numPoints;     /* number of points in the table */
+  int maxPoints;     /* allocated length of the points array */
+  Point * points;    /* points for all of the fragments */
+};
+
+/* struct for the scratch storage used to clip a polygon ring to a grid */
+/* cell.  The x and y coordinates are kept in separate arrays so that the */
+/* loops over the vertices can be vectorized, and the buffer is reused for */
+/* every ring and cell so that memory is only allocated when it grows. */
+typedef struct clipBufferStruct ClipBuffer;
+struct clipBufferStruct {
+  int size;          /* allocated length of each array */
+  int numPts;        /* number of points in the clipped ring, -1 on error */
+  double * x;        /* x coordinates of the clipped ring */
+  double * y;        /* y coordinates of the clipped ring */
+  double * tx;       /* scratch x coordinates */
+  double * ty;       /* scratch y coordinates */
+  int * in;          /* inside indicators for the vertices */
+};
+
+/* struct for storing the polyline segments, clipped to a grid cell or not, */
+/* from which sample points are located.  The segments are kept in a flat */
+/* array, and after sumSegments is called they are in the reverse of the */
+/* order in which they were added, with the cumulative sum of their lengths, */
+/* so that the segment containing a position along the segments is found by */
+/* a binary search.  The arrays are reused so that memory is only allocated */
+/* when they grow.  Note that shapeParser.h must be included before this */
+/* file. */
+typedef struct segmentTableStruct SegmentTable;
+struct segmentTableStruct {
+  int numSegs;       /* number of segments */
+  int maxSegs;       /* allocated length of the arrays */
+  Segment * segs;    /* segments, whose next pointers are not used */
+  double * cumLen;   /* cumulative sum of the segment lengths */
+};
+
+/* minimum number of points in a polygon record before the record is */
+/* prepared for repeated point in polygon tests */
+#define PREPARED_MIN_POINTS  32
+
+/* average number of edges in each slab of a prepared polygon and the */
+/* maximum average number of slabs that an edge is listed in */
+#define PREPARED_SLAB_EDGES  4
+#define PREPARED_EDGE_SLABS  8
+
+/* struct for a polygon record that is prepared for repeated point in */
+/* polygon tests.  The edges of all of the parts that are not horizontal */
+/* are stored in the order of the points, and the range of y values of the */
+/* edges is divided into slabs of equal height.  Each slab has the list of */
+/* edges whose y range overlaps the slab, so a test only crosses the edges */
+/* in the slab that contains the point.  The arrays are reused for every */
+/* record so that memory is only allocated when they grow. */
+typedef struct preparedPolygonStruct PreparedPolygon;
+struct preparedPolygonStruct {
+  int numEdges;      /* number of edges */
+  int maxEdges;      /* allocated length of the edge arrays */
+  double * x0;       /* x coordinate of the first point of each edge */
+  double * y0;       /* y coordinate of the first point of each edge */
+  double * x1;       /* x coordinate of the second point of each edge */
+  double * y1;       /* y coordinate of the second point of each edge */
+  double yMin;       /* minimum y value of the edges */
+  double yMax;       /* maximum y value of the edges */
+  double height;     /* height of a slab */
+  int numSlabs;      /* number of slabs */
+  int maxSlabs;      /* allocated length of the slabStart array */
+  int * slabStart;   /* index in slabEdges of the first edge of each slab, */
+                     /* with numSlabs+1 values */
+  int maxEntries;    /* allocated length of the slabEdges array */
+  int * slabEdges;   /* edge indices for all of the slabs */
+};
+
+/* struct for an edge of a clipped record, where y0 is less than y1 */
+typedef struct edgeStruct Edge;
+struct edgeStruct {
+  double x0;
+  double y0;
+  double x1;
+  double y1;
+};
+
+/* struct for an edge that crosses a slab between two y values */
+typedef struct slabEdgeStruct SlabEdge;
+struct slabEdgeStruct {
+  double xMid;     /* x value at the middle of the slab */
+  double xLo;      /* x value at the bottom of the slab */
+  double xHi;      /* x value at the top of the slab */
+};
+
+/* struct for the triangles that cover the intersection of a record and a */
+/* grid cell, together with the scratch storage used to find them.  The */
+/* set is reused for every cell so that memory is only allocated when it */
+/* grows.  The triangles are found by triangulateRecord in */
+/* pickAreaSamplePoints.c. */
+typedef struct triangleSetStruct TriangleSet;
+struct triangleSetStruct {
+  int numTris;       /* number of triangles */
+  int maxTris;       /* allocated number of triangles */
+  double * tri;      /* vertices of each triangle as x0 y0 x1 y1 x2 y2 */
+  double * cumArea;  /* cumulative area of the triangles */
+  int numEdges;      /* number of edges */
+  int maxEdges;      /* allocated number of edges */
+  Edge * edges;      /* edges of the clipped record */
+  double * ys;       /* y values of the slab boundaries */
+  int * live;        /* edges that have not ended below the current slab */
+  SlabEdge * active; /* edges that cross the current slab */
+  ClipBuffer clip;   /* buffer used to clip the parts to the cell */
+};
+
+/* struct for storing the extent of the records within a set of grid cells */
+/* as (cell, record, extent) triples, where the extent is the clipped area */
+/* of a polygon or the clipped length of a polyline.  Triples are appended */
+/* as they are computed, each with a sequence number, and sortCellExtents */
+/* puts them in order of cell and then of sequence number. */
+typedef struct cellExtentStruct CellExtent;
+struct cellExtentStruct {
+  int cell;          /* position of the cell in the list of cells, or the */
+                     /* index of the cell in the grid */
+  int seq;           /* sequence number */
+  unsigned int id;   /* record ID, or index of the record in the design */
+  double extent;     /* clipped area or length of the record in the cell */
+};
+typedef struct cellExtentsStruct CellExtents;
+struct cellExtentsStruct {
+  int numItems;      /* number of triples */
+  int maxItems;      /* allocated length of the items array */
+  CellExtent * items;  /* array of triples */
+};
+
+/* struct for the results of determining the number of levels for */
+/* hierarchical randomization, which are the grid and the cell weights of */
+/* the final level and, when they are kept, the extent of the records */
+/* within the cells of the final grid that have positive weight */
+typedef struct gridLevelsStruct GridLevels;
+struct gridLevelsStruct {
+  int nlev;          /* final number of levels plus one */
+  double sint;       /* sampling interval */
+  int keepExtents;   /* 1 if the extents of the records were kept */
+  int isArea;        /* 1 for a polygon shapefile */
+  Grid grid;         /* grid of the final level */
+  CellWts celWts;    /* cell weights of the final level */
+  CellExtents ext;   /* extents of the records, as merged by */
+                     /* mergeCellExtents */
+};
+
+/* number of records in each block of records processed by one thread */
+#define RECORD_BLOCK_SIZE  64
+
+/* struct for the storage used to compute cell weights with more than one */
+/* thread.  Each round, consecutive blocks of RECORD_BLOCK_SIZE records are */
+/* processed in parallel, one block per slot.  The weights, fragments, and */
+/* (cell, record, extent) triples of each block are kept unmerged and are */
+/* then added to the results in block order, so the results are the same */
+/* for any number of threads. */
+typedef struct blockWtsStruct BlockWts;
+struct blockWtsStruct {
+  int numThreads;    /* number of threads */
+  int numSlots;      /* number of blocks processed in each round */
+  int * error;       /* 1 if an error occurred for the block in a slot */
+  CellWts * wts;     /* unmerged cell weights for each slot */
+  CellWts * partWts; /* scratch cell weights for each slot */
+  FragTable * frags; /* fragments clipped by each slot */
+  ClipBuffer * clip; /* clipping buffer for each slot */
+  CellExtents * ext; /* (cell, record, extent) triples for each slot */
+};
+
+/* struct for an alias table, which selects an item with probability */
+/* proportional to its weight using two random numbers.  Only the items */
+/* with positive weight are in the table.  Position k of the table selects */
+/* item[k] with probability prob[k] and otherwise selects the item in */
+/* position alias[k].  The weights are kept so that the table can be */
+/* rebuilt without the items already selected when sampling without */
+/* replacement. */
+typedef struct aliasTableStruct AliasTable;
+struct aliasTableStruct {
+  int numWts;        /* number of weights, including zero weights */
+  int numItems;      /* number of items with positive weight */
+  double * wts;      /* weights of all of the items */
+  int * item;        /* item for each position of the table */
+  double * prob;     /* probability of keeping the item in each position */
+  int * alias;       /* alternate position for each position of the table */
+};
+
+/* struct for finding the cells in a list of grid cells that can overlap */
+/* a box.  The cells are ordered by the x coordinate of their right edge. */
+typedef struct cellListStruct CellList;
+struct cellListStruct {
+  int numCells;      /* number of cells */
+  double dx;         /* width of a cell */
+  double dy;         /* height of a cell */
+  double * xc;       /* x coordinate of the right edge of each cell */
+  double * yc;       /* y coordinate of the top edge of each cell */
+  int * order;       /* cells in increasing order of xc */
+};
+
 #endif
@@ -0,0 +1,849 @@
+/******************************************************************************
+**  File:        grtsAreaSample.c
+**
+**  Purpose:     This file contains the grtsAreaSample function, which
+**               selects a GRTS sample of an area resource for the grtsarea
+**               function in a single call.  It determines the number of
+**               levels for hierarchical randomization, selects the grid
+**               cells that get a sample point, selects a shapefile record
+**               in each of those cells, picks a sample point in each cell,
+**               and returns the data frame of sample sites.
+**  Programmer:  Tom Kincaid
+**  Algorithm:   It uses the same algorithm that is implemented by the
+**               chain of numLevels, selectGridCells, selectrecordID, and
+**               pickAreaSamplePoints calls in the R version, and it uses
+**               R's random number generator in the same order, so the
+**               sample is the same.  The temporary .shp file is created
+**               and parsed once.  When its records fit within the memory
+**               budget they are decoded once into a frame store, which is
+**               used both to determine the number of levels and to pick the
+**               sample points.  Otherwise the records are read from the
+**               file, and the points are picked by pickFilePoints from the
+**               same file.
+**               The clipped area of each record within each cell of the
+**               final grid is kept by findGridLevels, so the records of the
+**               selected cells are not clipped again.
+**  Created:     October 19, 2026
+******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <R.h>
+#include <Rdefines.h>
+#include <Rmath.h>
+#include "shapeParser.h"
+#include "grts.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/* these functions are found in grts.c */
+extern FILE * openTempShpFile( SEXP fileNamePrefix, unsigned int * ids,
+                               int numIDs, Shape * shape,
+                               const char * fcnName );
+extern void initGridLevels( GridLevels * lev );
+extern void freeGridLevels( GridLevels * lev );
+extern int findGridLevels( GridLevels * lev, Shape * shape, FILE * fptr,
+                           FrameStore * store, unsigned int * dsgnmdID,
+                           double * dsgnmd, int dsgSize, int nsmp,
+                           int shiftGrid, int startLev, int maxlev,
+                           int refineGrid, int keepExtents, int numThreads );
+
+/* these functions are found in frameStore.c */
+extern void initFrameStore( FrameStore * store );
+extern void freeFrameStore( FrameStore * store );
+extern int loadFrameStore( FrameStore * store, Shape * shape, FILE * fptr,
+                           unsigned int * dsgnmdID, int dsgSize,
+                           double budget );
+
+/* these functions are found in pickAreaSamplePoints.c */
+extern int pickStorePoints( FrameStore * store, unsigned int * recordIDs,
+                            double * xc, double * yc, int sampleSize,
+                            double dx, double dy, unsigned int maxTry,
+                            int useStreams, unsigned long long seed,
+                            int exact, int numThreads, int * bp,
+                            double * xcs, double * ycs );
+extern int pickFilePoints( FILE * fptr, Shape * shape,
+                           unsigned int * recordIDs, double * xc,
+                           double * yc, int sampleSize, double dx,
+                           double dy, unsigned int maxTry, int useStreams,
+                           unsigned long long seed, int exact,
+                           double frameBudget, int numThreads, int * bp,
+                           double * xcs, double * ycs );
+
+/* this function is found in selectGridCells.c */
+extern SEXP selectGridCells( SEXP xcVec, SEXP ycVec, SEXP celWtVec,
+                             SEXP dxVec, SEXP dyVec, SEXP nlevVec,
+                             SEXP samplesize, SEXP sintVec,
+                             SEXP doSampleVec );
+
+/* this function is found in rngStream.c */
+extern unsigned long long rngStreamSeed( void );
+
+/* this function is found in grtspts.c */
+extern int probSampleNoReplace( double * p, int * perm, int n, int nans,
+                                int * ans, const char * fcnName );
+
+
+/**********************************************************
+** Function:   selectCellRecords
+**
+** Purpose:    Select a shapefile record in each grid cell that gets a
+**             sample point, as the selectrecordID function does.
+** Notes:      A record is selected with probability proportional to its
+**             clipped extent within the cell times its multidensity
+**             multiplier, using the FixupProb and ProbSampleNoReplace code
+**             of sample by way of probSampleNoReplace, so that the same
+**             random number selects the same record as sample.  The
+**             calling function must bracket the call with GetRNGstate and
+**             PutRNGstate.
+** Arguments:  ext,        extents of the records within the cells with
+**                         positive weight, as merged by mergeCellExtents,
+**                         where the id of an extent is an index into the
+**                         dsgnmd array
+**             numCells,   number of cells with positive weight
+**             rdx,        position of the cell among the cells with
+**                         positive weight for each sample point, counting
+**                         from one
+**             sampleSize, number of sample points
+**             dsgnmd,     array of multidensity multipliers of the records
+**             dsgIdx,     set to the index into the dsgnmd array of the
+**                         record selected for each sample point
+**             fcnName,    name of the calling C function, which is used in
+**                         error messages
+** Return:     1,  on success
+**             -1, on error
+***********************************************************/
+int selectCellRecords( CellExtents * ext, int numCells, int * rdx,
+                       int sampleSize, double * dsgnmd, int * dsgIdx,
+                       const char * fcnName ) {
+
+  int i, k;                  /* loop counters */
+  int * cellStart = NULL;    /* index in ext of each cell's first extent */
+  int maxRecs = 1;           /* largest number of records in a cell */
+  int first;                 /* first extent of the selected cell */
+  int nrec;                  /* number of records in the selected cell */
+  double * p = NULL;         /* selection weights of the records */
+  int * perm = NULL;         /* identities of the weights */
+  long double total;         /* sum of the weights */
+
+  if ( (cellStart = (int *) malloc( sizeof(int) * (numCells + 2) ))
+                                                              == NULL ) {
+    Rprintf( "Error: Allocating memory in C function %s.\n", fcnName );
+    return -1;
+  }
+  for ( i = 0; i <= numCells + 1; ++i ) {
+    cellStart[i] = 0;
+  }
+  for ( k = 0; k < ext->numItems; ++k ) {
+    if ( ext->items[k].cell < 1 || ext->items[k].cell > numCells ) {
+      Rprintf( "Error: Invalid grid cell position in C function %s.\n", fcnName );
+      free( cellStart );
+      return -1;
+    }
+    ++cellStart[ext->items[k].cell + 1];
+  }
+  for ( i = 1; i <= numCells + 1; ++i ) {
+    if ( cellStart[i] > maxRecs ) {
+      maxRecs = cellStart[i];
+    }
+    cellStart[i] += cellStart[i - 1];
+  }
+
+  p = (double *) malloc( sizeof(double) * maxRecs );
+  perm = (int *) malloc( sizeof(int) * maxRecs );
+  if ( p == NULL || perm == NULL ) {
+    Rprintf( "Error: Allocating memory in C function %s.\n", fcnName );
+    free( cellStart );
+    free( p );
+    free( perm );
+    return -1;
+  }
+
+  for ( i = 0; i < sampleSize; ++i ) {
+    if ( rdx[i] < 1 || rdx[i] > numCells ) {
+      Rprintf( "Error: Invalid grid cell position in C function %s.\n", fcnName );
+      break;
+    }
+    first = cellStart[rdx[i]];
+    nrec = cellStart[rdx[i] + 1] - first;
+    if ( nrec == 0 ) {
+      Rprintf( "Error: A selected grid cell does not contain a record in C function %s.\n", fcnName );
+      break;
+    }
+
+    /* a cell with one record does not call sample */
+    if ( nrec == 1 ) {
+      dsgIdx[i] = ext->items[first].id;
+      continue;
+    }
+
+    /* scale the weights as selectrecordID does before calling sample */
+    total = 0.0;
+    for ( k = 0; k < nrec; ++k ) {
+      p[k] = ext->items[first + k].extent *
+             dsgnmd[ext->items[first + k].id];
+      total += p[k];
+    }
+    for ( k = 0; k < nrec; ++k ) {
+      p[k] = p[k] / (double) total;
+      perm[k] = k;
+    }
+
+    /* select the record as sample does for a size of one without */
+    /* replacement */
+    if ( probSampleNoReplace( p, perm, nrec, 1, &k, fcnName ) == -1 ) {
+      break;
+    }
+    dsgIdx[i] = ext->items[first + k].id;
+  }
+
+  free( cellStart );
+  free( p );
+  free( perm );
+
+  return i < sampleSize ? -1 : 1;
+}
+
+
+/**********************************************************
+** Function:   subsetVector
+**
+** Purpose:    Create the subset of a vector given by an array of indices,
+**             keeping attributes such as the levels of a factor, as the
+**             R subscript operator does.
+** Arguments:  vec,   vector to subset, which must be a logical, integer,
+**                    double, or character vector
+**             index, array of indices counting from zero
+**             n,     number of indices
+** Return:     the subset, which is not protected, or R_NilValue if the
+**             type of the vector is not supported
+***********************************************************/
+SEXP subsetVector( SEXP vec, int * index, int n ) {
+
+  int i;             /* loop counter */
+  SEXP result;       /* subset of the vector */
+
+  switch ( TYPEOF( vec ) ) {
+    case LGLSXP:
+    case INTSXP:
+      PROTECT( result = allocVector( TYPEOF( vec ), n ) );
+      for ( i = 0; i < n; ++i ) {
+        INTEGER( result )[i] = INTEGER( vec )[index[i]];
+      }
+      break;
+    case REALSXP:
+      PROTECT( result = allocVector( REALSXP, n ) );
+      for ( i = 0; i < n; ++i ) {
+        REAL( result )[i] = REAL( vec )[index[i]];
+      }
+      break;
+    case STRSXP:
+      PROTECT( result = allocVector( STRSXP, n ) );
+      for ( i = 0; i < n; ++i ) {
+        SET_STRING_ELT( result, i, STRING_ELT( vec, index[i] ) );
+      }
+      break;
+    default:
+      return R_NilValue;
+  }
+  copyMostAttrib( vec, result );
+  UNPROTECT(1);
+
+  return result;
+}
+
+
+/**********************************************************
+** Function:   reverseHierarchicalOrder
+**
+** Purpose:    Determine the reverse hierarchical order of the sample
+**             points, as the grtsarea and grtslin functions do.
+** Algorithm:  With nlv4 the smallest number of base 4 digits that can
+**             count the points, the order is the unique values of
+**             floor(rho4*n/4^nlv4), in order of appearance, where rho4 is
+**             the value of the digits of 0, 1, ..., 4^nlv4 - 1 reversed.
+** Arguments:  order, set to the index of the point in each position of
+**                    the order, counting from zero, which must have
+**                    length n
+**             n,     number of points
+** Return:     1,  on success
+**             -1, if memory could not be allocated
+***********************************************************/
+int reverseHierarchicalOrder( int * order, int n ) {
+
+  int i, r;          /* loop counters */
+  int nlv4;          /* number of base 4 digits */
+  double pwr;        /* 4^nlv4 */
+  double rho4;       /* reversed value of the digits of r */
+  int digits;        /* remaining digits of r */
+  int pos;           /* position of the point on the line */
+  int count = 0;     /* number of points placed in the order */
+  int * seen;        /* 1 if a point has been placed in the order */
+
+  if ( n < 1 ) {
+    return 1;
+  }
+  if ( (seen = (int *) malloc( sizeof(int) * n )) == NULL ) {
+    return -1;
+  }
+  for ( i = 0; i < n; ++i ) {
+    seen[i] = 0;
+  }
+
+  nlv4 = (int) ceil( log( (double) n ) / log( 4.0 ) );
+  if ( nlv4 < 1 ) {
+    nlv4 = 1;
+  }
+  pwr = pow( 4.0, (double) nlv4 );
+
+  for ( r = 0; r < (int) pwr && count < n; ++r ) {
+    rho4 = 0.0;
+    digits = r;
+    for ( i = 0; i < nlv4; ++i ) {
+      rho4 = 4.0 * rho4 + (double) (digits % 4);
+      digits /= 4;
+    }
+    pos = (int) floor( rho4 * n / pwr );
+    if ( seen[pos] == 0 ) {
+      seen[pos] = 1;
+      order[count++] = pos;
+    }
+  }
+
+  free( seen );
+
+  return 1;
+}
+
+
+/**********************************************************
+** Function:   countGridCells
+**
+** Purpose:    Count the grid cells that get a sample point and the cells
+**             that get more than one sample point.
+** Arguments:  rdx,        position of the cell for each sample point,
+**                         counting from one
+**             sampleSize, number of sample points
+**             numCells,   number of cells
+**             numSel,     set to the number of cells that get a point
+**             numMulti,   set to the number of cells that get more than
+**                         one point
+** Return:     1,  on success
+**             -1, if memory could not be allocated
+***********************************************************/
+int countGridCells( int * rdx, int sampleSize, int numCells, int * numSel,
+                    int * numMulti ) {
+
+  int i;             /* loop counter */
+  int * count;       /* number of points in each cell */
+
+  if ( (count = (int *) malloc( sizeof(int) * (numCells + 1) )) == NULL ) {
+    return -1;
+  }
+  for ( i = 0; i <= numCells; ++i ) {
+    count[i] = 0;
+  }
+  for ( i = 0; i < sampleSize; ++i ) {
+    if ( rdx[i] >= 1 && rdx[i] <= numCells ) {
+      ++count[rdx[i]];
+    }
+  }
+  *numSel = 0;
+  *numMulti = 0;
+  for ( i = 1; i <= numCells; ++i ) {
+    if ( count[i] > 0 ) {
+      ++(*numSel);
+    }
+    if ( count[i] > 1 ) {
+      ++(*numMulti);
+    }
+  }
+
+  free( count );
+
+  return 1;
+}
+
+
+/**********************************************************
+** Function:   createSampleSites
+**
+** Purpose:    Create the results returned by the functions that select a
+**             GRTS sample in one call, which contain the data frame of
+**             sample sites in reverse hierarchical order.
+** Arguments:  keep,       positions of the sample points that are kept
+**             numKeep,    number of sample points that are kept
+**             recordIDs,  shapefile record ID of each sample point
+**             dsgIdx,     index into dsgnmd of each sample point's record
+**             dsgnmd,     array of multidensity multipliers of the records
+**             xcs,        x-coordinates of the sample points
+**             ycs,        y-coordinates of the sample points
+**             mdcatyVec,  vector of multidensity categories of the records
+**             siteBegin,  first number to use for the site IDs
+**             nlev,       value of nlev returned by numLevels
+**             numSel,     number of cells that get a point
+**             numMulti,   number of cells that get more than one point
+**             fcnName,    name of the calling C function, which is used in
+**                         error messages
+** Return:     an unprotected R list containing sites, the data frame of
+**             sample sites with variables siteID, id, xcoord, ycoord,
+**             mdcaty, and wgt and with attribute nlev, and cells, an
+**             integer vector containing numSel and numMulti, or
+**             R_NilValue on error
+***********************************************************/
+SEXP createSampleSites( int * keep, int numKeep, unsigned int * recordIDs,
+                        int * dsgIdx, double * dsgnmd, double * xcs,
+                        double * ycs, SEXP mdcatyVec, double siteBegin,
+                        int nlev, int numSel, int numMulti,
+                        const char * fcnName ) {
+
+  int i;                    /* loop counter */
+  int * order;              /* reverse hierarchical order of the points */
+  int * mdcatyIdx;          /* index into mdcatyVec of each site */
+  SEXP sitesVec, siteIDVec, idVec, xcoordVec, ycoordVec, mdcatyCol, wgtVec;
+  SEXP namesVec, rowNamesVec, classVec, nlevAttr, countVec;
+  SEXP results;
+
+  /* determine the reverse hierarchical order of the points */
+  order = (int *) malloc( sizeof(int) * (numKeep + 1) );
+  mdcatyIdx = (int *) malloc( sizeof(int) * (numKeep + 1) );
+  if ( order == NULL || mdcatyIdx == NULL ||
+       reverseHierarchicalOrder( order, numKeep ) == -1 ) {
+    Rprintf( "Error: Allocating memory in C function %s.\n", fcnName );
+    free( order );
+    free( mdcatyIdx );
+    return R_NilValue;
+  }
+  for ( i = 0; i < numKeep; ++i ) {
+    order[i] = keep[order[i]];
+    mdcatyIdx[i] = dsgIdx[order[i]];
+  }
+
+  PROTECT( mdcatyCol = subsetVector( mdcatyVec, mdcatyIdx, numKeep ) );
+  free( mdcatyIdx );
+  if ( mdcatyCol == R_NilValue ) {
+    Rprintf( "Error: The multidensity categories must be a vector in C function %s.\n", fcnName );
+    free( order );
+    UNPROTECT(1);
+    return R_NilValue;
+  }
+
+  /* create the data frame */
+  PROTECT( siteIDVec = allocVector( REALSXP, numKeep ) );
+  PROTECT( idVec = allocVector( INTSXP, numKeep ) );
+  PROTECT( xcoordVec = allocVector( REALSXP, numKeep ) );
+  PROTECT( ycoordVec = allocVector( REALSXP, numKeep ) );
+  PROTECT( wgtVec = allocVector( REALSXP, numKeep ) );
+  PROTECT( rowNamesVec = allocVector( INTSXP, numKeep ) );
+  for ( i = 0; i < numKeep; ++i ) {
+    REAL( siteIDVec )[i] = siteBegin - 1.0 + (i + 1);
+    INTEGER( idVec )[i] = recordIDs[order[i]];
+    REAL( xcoordVec )[i] = xcs[order[i]];
+    REAL( ycoordVec )[i] = ycs[order[i]];
+    REAL( wgtVec )[i] = 1.0/dsgnmd[dsgIdx[order[i]]];
+    INTEGER( rowNamesVec )[i] = i + 1;
+  }
+  free( order );
+  PROTECT( sitesVec = allocVector( VECSXP, 6 ) );
+  SET_VECTOR_ELT( sitesVec, 0, siteIDVec );
+  SET_VECTOR_ELT( sitesVec, 1, idVec );
+  SET_VECTOR_ELT( sitesVec, 2, xcoordVec );
+  SET_VECTOR_ELT( sitesVec, 3, ycoordVec );
+  SET_VECTOR_ELT( sitesVec, 4, mdcatyCol );
+  SET_VECTOR_ELT( sitesVec, 5, wgtVec );
+  PROTECT( namesVec = allocVector( STRSXP, 6 ) );
+  SET_STRING_ELT( namesVec, 0, mkChar( "siteID" ) );
+  SET_STRING_ELT( namesVec, 1, mkChar( "id" ) );
+  SET_STRING_ELT( namesVec, 2, mkChar( "xcoord" ) );
+  SET_STRING_ELT( namesVec, 3, mkChar( "ycoord" ) );
+  SET_STRING_ELT( namesVec, 4, mkChar( "mdcaty" ) );
+  SET_STRING_ELT( namesVec, 5, mkChar( "wgt" ) );
+  setAttrib( sitesVec, R_NamesSymbol, namesVec );
+  PROTECT( classVec = mkString( "data.frame" ) );
+  setAttrib( sitesVec, R_ClassSymbol, classVec );
+  setAttrib( sitesVec, R_RowNamesSymbol, rowNamesVec );
+  PROTECT( nlevAttr = allocVector( REALSXP, 1 ) );
+  REAL( nlevAttr )[0] = nlev - 1.0;
+  setAttrib( sitesVec, install( "nlev" ), nlevAttr );
+
+  /* create the list of results */
+  PROTECT( countVec = allocVector( INTSXP, 2 ) );
+  INTEGER( countVec )[0] = numSel;
+  INTEGER( countVec )[1] = numMulti;
+  PROTECT( results = allocVector( VECSXP, 2 ) );
+  SET_VECTOR_ELT( results, 0, sitesVec );
+  SET_VECTOR_ELT( results, 1, countVec );
+  PROTECT( namesVec = allocVector( STRSXP, 2 ) );
+  SET_STRING_ELT( namesVec, 0, mkChar( "sites" ) );
+  SET_STRING_ELT( namesVec, 1, mkChar( "cells" ) );
+  setAttrib( results, R_NamesSymbol, namesVec );
+  UNPROTECT(14);
+
+  return results;
+}
+
+
+/**********************************************************
+** Function:   grtsAreaSample
+**
+** Purpose:    Select a GRTS sample of an area resource.
+** Notes:      When a file name is not sent, the temporary .shp file
+**             combines the data found in all the .shp files in the current
+**             working directory.  Records that have ID numbers not found
+**             in the sent dsgnmdIDVec vector are ignored.
+**             When a sample point is not found in a cell, the cell is
+**             dropped from the sample.
+** Arguments:  fileNamePrefix,  name of the shapefile without the .shp
+**                              extension, or NULL
+**             dsgnmdIDVec,  vector of record IDs of the frame
+**             dsgnmdVec,  vector of multidensity multipliers corresponding
+**                         to the above IDs
+**             mdcatyVec,  vector of multidensity categories corresponding
+**                         to the above IDs
+**             nsmpVec,  number of points to select in the sample
+**             siteBeginVec,  first number to use for the site IDs
+**             shiftGridVec,  flag signalling whether to do random shift of
+**                            grid,  1 shift, 0 don't shift
+**             startLevVec,  starting value to use for the number of levels
+**                           of the grid, or NULL
+**             maxLevVec,  maximum value to use for the number of levels of
+**                         the grid
+**             maxTryVal,  maximum number of tries to obtain a sample point
+**             refineGridVec,  flag signalling whether to refine polygon
+**                             cell weights from the fragments of the
+**                             previous level
+**             rngStreamsVal,  TRUE to pick the points using random number
+**                             streams, FALSE or NULL to use R's random
+**                             number generator
+**             frameBudgetVal,  memory budget in megabytes for holding the
+**                              records in memory, where NULL uses the
+**                              default of FRAME_STORE_BUDGET and 0 always
+**                              reads the records from the file
+**             threadsVal,  number of threads, where NULL uses the OpenMP
+**                          default
+**             exactVal,  TRUE to pick each point exactly from triangles,
+**                        FALSE or NULL to pick the point by rejection
+**                        sampling
+** Return:     results, an R list containing sites, the data frame of sample
+**                      sites with variables siteID, id, xcoord, ycoord,
+**                      mdcaty, and wgt in reverse hierarchical order and
+**                      with attribute nlev, and cells, an integer vector
+**                      containing the number of grid cells from which
+**                      sample points were selected and the number of those
+**                      cells that contained more than one sample point.
+**                      If an error occurs results will return set to NULL
+***********************************************************/
+SEXP grtsAreaSample( SEXP fileNamePrefix, SEXP dsgnmdIDVec, SEXP dsgnmdVec,
+                     SEXP mdcatyVec, SEXP nsmpVec, SEXP siteBeginVec,
+                     SEXP shiftGridVec, SEXP startLevVec, SEXP maxLevVec,
+                     SEXP maxTryVal, SEXP refineGridVec, SEXP rngStreamsVal,
+                     SEXP frameBudgetVal, SEXP threadsVal, SEXP exactVal ) {
+
+  int i, j;                 /* loop counters */
+  Shape shape;              /* shape struct for the temporary .shp file */
+  FILE * fptr = NULL;       /* pointer to the temporary .shp file */
+  FrameStore store;         /* records of the temporary .shp file */
+  int loaded = 0;           /* 1 if the records are held in the store */
+  GridLevels lev;           /* results for the final level */
+  int numCells;             /* number of cells with positive weight */
+  int error = FALSE;        /* TRUE if an error occurred */
+  int status;               /* result of picking the points in the store */
+  unsigned long long seed = 0;  /* seed for the random number streams */
+
+  /* C versions of sent vars */
+  unsigned int * dsgnmdID = NULL;
+  double * dsgnmd = NULL;
+  unsigned int dsgSize = length( dsgnmdIDVec );
+  int nsmp;
+  double siteBegin;
+  int shiftGrid;
+  int startLev = NA_INTEGER;
+  int maxlev;
+  unsigned int maxTry;
+  int refineGrid = 0;
+  int useStreams = FALSE;
+  double frameBudget = FRAME_STORE_BUDGET;
+  int numThreads = 1;
+  int exact = FALSE;
+
+  /* selected cells and sample points */
+  int sampleSize = 0;       /* number of selected cells */
+  int * rdx = NULL;              /* position of each selected cell */
+  int * dsgIdx = NULL;      /* index into dsgnmd of each selected record */
+  unsigned int * recordIDs = NULL;  /* ID of each selected record */
+  double * xc = NULL;       /* x-coordinate of each selected cell */
+  double * yc = NULL;       /* y-coordinate of each selected cell */
+  int * bp = NULL;          /* TRUE if a cell did not get a sample point */
+  double * xcs = NULL;      /* x-coordinates of the sample points */
+  double * ycs = NULL;      /* y-coordinates of the sample points */
+  int * keep = NULL;        /* cells that got a sample point */
+  int numKeep = 0;          /* number of cells that got a sample point */
+  int numSelCells = 0;      /* number of distinct selected cells */
+  int numMulti = 0;         /* number of cells with more than one point */
+
+  /* R objects */
+  SEXP dxVec, dyVec, nlevVec, sintVec, doSampleVec;
+  SEXP xcVec, ycVec, celWtVec, cellsVec;
+  SEXP results = NULL;
+
+  /* copy the IDs and multidensity multipliers into C arrays */
+  dsgnmdID = (unsigned int *) malloc( sizeof(unsigned int) * (dsgSize + 1) );
+  dsgnmd = (double *) malloc( sizeof(double) * (dsgSize + 1) );
+  if ( dsgnmdID == NULL || dsgnmd == NULL ) {
+    Rprintf( "Error: Allocating memory in C function grtsAreaSample.\n" );
+    free( dsgnmdID );
+    free( dsgnmd );
+    PROTECT( results = allocVector( VECSXP, 1 ) );
+    UNPROTECT(1);
+    return results;
+  }
+  PROTECT( dsgnmdIDVec = AS_INTEGER( dsgnmdIDVec ) );
+  PROTECT( dsgnmdVec = AS_NUMERIC( dsgnmdVec ) );
+  for ( i = 0; i < dsgSize; ++i ) {
+    dsgnmdID[i] = INTEGER( dsgnmdIDVec )[i];
+    dsgnmd[i] = REAL( dsgnmdVec )[i];
+  }
+
+  /* copy the remaining arguments to C variables */
+  nsmp = asInteger( nsmpVec );
+  siteBegin = asReal( siteBeginVec );
+  shiftGrid = asInteger( shiftGridVec );
+  if ( startLevVec != R_NilValue ) {
+    startLev = asInteger( startLevVec );
+  }
+  maxlev = asInteger( maxLevVec );
+  maxTry = (unsigned int) asInteger( maxTryVal );
+  if ( refineGridVec != R_NilValue ) {
+    refineGrid = asInteger( refineGridVec );
+  }
+  if ( rngStreamsVal != R_NilValue ) {
+    useStreams = asLogical( rngStreamsVal ) == TRUE;
+  }
+  if ( frameBudgetVal != R_NilValue ) {
+    frameBudget = asReal( frameBudgetVal );
+  }
+#ifdef _OPENMP
+  numThreads = omp_get_max_threads();
+#endif
+  if ( threadsVal != R_NilValue ) {
+    numThreads = asInteger( threadsVal );
+  }
+  if ( numThreads == NA_INTEGER || numThreads < 1 ) {
+    numThreads = 1;
+  }
+  if ( exactVal != R_NilValue ) {
+    exact = asLogical( exactVal ) == TRUE;
+  }
+
+  /* create and open the temporary .shp file */
+  if ( (fptr = openTempShpFile( fileNamePrefix, dsgnmdID, dsgSize, &shape,
+                                "grtsAreaSample" )) == NULL ) {
+    free( dsgnmdID );
+    free( dsgnmd );
+    PROTECT( results = allocVector( VECSXP, 1 ) );
+    UNPROTECT(3);
+    return results;
+  }
+  if ( shape.shapeType != POLYGON ) {
+    Rprintf( "Error: The shapefile type must be polygon in C function grtsAreaSample.\n" );
+    free( dsgnmdID );
+    free( dsgnmd );
+    fclose( fptr );
+    remove( TEMP_SHP_FILE );
+    PROTECT( results = allocVector( VECSXP, 1 ) );
+    UNPROTECT(3);
+    return results;
+  }
+
+  /* decode the records once if they fit within the memory budget */
+  initFrameStore( &store );
+  initGridLevels( &lev );
+  loaded = loadFrameStore( &store, &shape, fptr, dsgnmdID, dsgSize,
+                           frameBudget );
+  if ( loaded == -1 ) {
+    Rprintf( "Error: Reading the records in C function grtsAreaSample.\n" );
+    error = TRUE;
+  }
+
+  /* determine the number of levels and the final cell weights, keeping the */
+  /* clipped area of the records within the cells */
+  if ( !error ) {
+    GetRNGstate();
+    if ( findGridLevels( &lev, &shape, fptr, &store, dsgnmdID, dsgnmd,
+                         dsgSize, nsmp, shiftGrid, startLev, maxlev,
+                         refineGrid, TRUE, numThreads ) == -1 ) {
+      error = TRUE;
+    }
+    PutRNGstate();
+  }
+
+  /* construct randomized hierarchical addresses for the cells with */
+  /* positive weight and select the grid cells that get a sample point */
+  numCells = 0;
+  if ( !error ) {
+    for ( i = 0; i < lev.celWts.numCells; ++i ) {
+      if ( lev.celWts.cells[i].wt > 0.0 ) {
+        ++numCells;
+      }
+    }
+  }
+  PROTECT( dxVec = allocVector( REALSXP, 1 ) );
+  PROTECT( dyVec = allocVector( REALSXP, 1 ) );
+  PROTECT( nlevVec = allocVector( INTSXP, 1 ) );
+  PROTECT( sintVec = allocVector( REALSXP, 1 ) );
+  PROTECT( doSampleVec = allocVector( LGLSXP, 1 ) );
+  REAL( dxVec )[0] = lev.grid.dx;
+  REAL( dyVec )[0] = lev.grid.dy;
+  INTEGER( nlevVec )[0] = lev.nlev;
+  REAL( sintVec )[0] = lev.sint;
+  LOGICAL( doSampleVec )[0] = TRUE;
+  PROTECT( xcVec = allocVector( REALSXP, numCells ) );
+  PROTECT( ycVec = allocVector( REALSXP, numCells ) );
+  PROTECT( celWtVec = allocVector( REALSXP, numCells ) );
+  if ( !error ) {
+    j = 0;
+    for ( i = 0; i < lev.celWts.numCells; ++i ) {
+      if ( lev.celWts.cells[i].wt > 0.0 ) {
+        REAL( xcVec )[j] =
+          lev.grid.colX[lev.celWts.cells[i].idx % lev.grid.numCols];
+        REAL( ycVec )[j] =
+          lev.grid.rowY[lev.celWts.cells[i].idx / lev.grid.numCols];
+        REAL( celWtVec )[j] = lev.celWts.cells[i].wt;
+        ++j;
+      }
+    }
+    PROTECT( cellsVec = selectGridCells( xcVec, ycVec, celWtVec, dxVec,
+                                         dyVec, nlevVec, nsmpVec, sintVec,
+                                         doSampleVec ) );
+    if ( length( cellsVec ) < 2 || VECTOR_ELT( cellsVec, 1 ) == R_NilValue ) {
+      error = TRUE;
+    }
+  } else {
+    PROTECT( cellsVec = R_NilValue );
+  }
+
+  /* allocate the arrays for the sample points */
+  if ( !error ) {
+    rdx = INTEGER( VECTOR_ELT( cellsVec, 1 ) );
+    sampleSize = length( VECTOR_ELT( cellsVec, 1 ) );
+    dsgIdx = (int *) malloc( sizeof(int) * (sampleSize + 1) );
+    recordIDs = (unsigned int *) malloc( sizeof(unsigned int) *
+                                         (sampleSize + 1) );
+    xc = (double *) malloc( sizeof(double) * (sampleSize + 1) );
+    yc = (double *) malloc( sizeof(double) * (sampleSize + 1) );
+    bp = (int *) malloc( sizeof(int) * (sampleSize + 1) );
+    xcs = (double *) malloc( sizeof(double) * (sampleSize + 1) );
+    ycs = (double *) malloc( sizeof(double) * (sampleSize + 1) );
+    keep = (int *) malloc( sizeof(int) * (sampleSize + 1) );
+    if ( dsgIdx == NULL || recordIDs == NULL || xc == NULL || yc == NULL ||
+         bp == NULL || xcs == NULL || ycs == NULL || keep == NULL ) {
+      Rprintf( "Error: Allocating memory in C function grtsAreaSample.\n" );
+      error = TRUE;
+    }
+  }
+
+  /* count the selected cells and the cells with more than one point */
+  if ( !error ) {
+    if ( countGridCells( rdx, sampleSize, numCells, &numSelCells,
+                         &numMulti ) == -1 ) {
+      Rprintf( "Error: Allocating memory in C function grtsAreaSample.\n" );
+      error = TRUE;
+    }
+  }
+
+  /* select a record in each selected cell and, when the records are held */
+  /* in memory, pick a sample point in each cell */
+  if ( !error ) {
+    GetRNGstate();
+    if ( selectCellRecords( &lev.ext, numCells, rdx, sampleSize, dsgnmd,
+                            dsgIdx, "grtsAreaSample" ) == -1 ) {
+      error = TRUE;
+    }
+    if ( !error ) {
+      for ( i = 0; i < sampleSize; ++i ) {
+        recordIDs[i] = dsgnmdID[dsgIdx[i]];
+        xc[i] = REAL( xcVec )[rdx[i] - 1];
+        yc[i] = REAL( ycVec )[rdx[i] - 1];
+        bp[i] = TRUE;
+        xcs[i] = 0.0;
+        ycs[i] = 0.0;
+      }
+    }
+    if ( !error && useStreams ) {
+      seed = rngStreamSeed();
+    }
+    if ( !error && loaded == 1 ) {
+      status = pickStorePoints( &store, recordIDs, xc, yc, sampleSize,
+                                lev.grid.dx, lev.grid.dy, maxTry, useStreams,
+                                seed, exact, numThreads, bp, xcs, ycs );
+      if ( status == -1 ) {
+        Rprintf( "Error: Picking the sample points in C function grtsAreaSample.\n" );
+        error = TRUE;
+      } else if ( status == 0 ) {
+        Rprintf( "Error: Allocating memory in C function grtsAreaSample.\n" );
+        error = TRUE;
+      }
+    }
+
+    /* when the records are not held in memory, pick the sample points by */
+    /* reading the records of the selected cells from the temporary .shp */
+    /* file, which holds the records in the same order as the file that */
+    /* pickAreaSamplePoints creates for the selected records */
+    if ( !error && loaded != 1 ) {
+      if ( pickFilePoints( fptr, &shape, recordIDs, xc, yc, sampleSize,
+                           lev.grid.dx, lev.grid.dy, maxTry, useStreams,
+                           seed, exact, frameBudget, numThreads, bp, xcs,
+                           ycs ) == -1 ) {
+        Rprintf( "Error: Picking the sample points in C function grtsAreaSample.\n" );
+        error = TRUE;
+      }
+    }
+    PutRNGstate();
+  }
+
+  /* the temporary .shp file is no longer needed */
+  freeFrameStore( &store );
+  fclose( fptr );
+  remove( TEMP_SHP_FILE );
+
+  /* remove the cells that did not get a sample point and create the data */
+  /* frame of sample sites */
+  if ( !error ) {
+    for ( i = 0; i < sampleSize; ++i ) {
+      if ( !bp[i] ) {
+        keep[numKeep++] = i;
+      }
+    }
+    PROTECT( results = createSampleSites( keep, numKeep, recordIDs, dsgIdx,
+                                          dsgnmd, xcs, ycs, mdcatyVec,
+                                          siteBegin, lev.nlev, numSelCells,
+                                          numMulti, "grtsAreaSample" ) );
+    if ( results == R_NilValue ) {
+      error = TRUE;
+    }
+    UNPROTECT(1);
+  }
+  if ( error ) {
+    PROTECT( results = allocVector( VECSXP, 1 ) );
+    UNPROTECT(1);
+  }
+  UNPROTECT(11);
+
+  /* clean up */
+  freeGridLevels( &lev );
+  free( dsgnmdID );
+  free( dsgnmd );
+  free( dsgIdx );
+  free( recordIDs );
+  free( xc );
+  free( yc );
+  free( bp );
+  free( xcs );
+  free( ycs );
+  free( keep );
+
+  return results;
+}
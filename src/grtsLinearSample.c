@@ -0,0 +1,409 @@
+/******************************************************************************
+**  File:        grtsLinearSample.c
+**
+**  Purpose:     This file contains the grtsLinearSample function, which
+**               selects a GRTS sample of a linear resource for the grtslin
+**               function in a single call.  It determines the number of
+**               levels for hierarchical randomization, selects the grid
+**               cells that get a sample point, selects a shapefile record
+**               in each of those cells, picks a sample point in each cell,
+**               and returns the data frame of sample sites.
+**  Programmer:  Tom Kincaid
+**  Algorithm:   It uses the same algorithm that is implemented by the
+**               chain of numLevels, selectGridCells, selectrecordID, and
+**               pickLinearSamplePoints calls in the R version, and it uses
+**               R's random number generator in the same order, so the
+**               sample is the same.  The temporary .shp file is created
+**               and parsed once.  When its records fit within the memory
+**               budget the polylines are decoded once into a frame store,
+**               which holds the points of every record in one array with
+**               the offsets of each record and part, so that the segments
+**               of a record are consecutive pairs of points within a part.
+**               The store is used by lintFcn to compute the cell lengths at
+**               each level, which also keeps the clipped length of each
+**               record within each cell of the final grid for selecting the
+**               records, and by pickStoreLinePoints to place the sample
+**               points.  Otherwise the records are read from the file, and
+**               the points are picked by pickFileLinePoints from the same
+**               file.  The record of each selected cell is chosen by
+**               selectCellRecords, which uses the FixupProb and
+**               ProbSampleNoReplace code of sample, as selectrecordID does.
+**  Created:     October 19, 2026
+******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <R.h>
+#include <Rdefines.h>
+#include <Rmath.h>
+#include "shapeParser.h"
+#include "grts.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/* these functions are found in grts.c */
+extern FILE * openTempShpFile( SEXP fileNamePrefix, unsigned int * ids,
+                               int numIDs, Shape * shape,
+                               const char * fcnName );
+extern void initGridLevels( GridLevels * lev );
+extern void freeGridLevels( GridLevels * lev );
+extern int findGridLevels( GridLevels * lev, Shape * shape, FILE * fptr,
+                           FrameStore * store, unsigned int * dsgnmdID,
+                           double * dsgnmd, int dsgSize, int nsmp,
+                           int shiftGrid, int startLev, int maxlev,
+                           int refineGrid, int keepExtents, int numThreads );
+
+/* these functions are found in frameStore.c */
+extern void initFrameStore( FrameStore * store );
+extern void freeFrameStore( FrameStore * store );
+extern int loadFrameStore( FrameStore * store, Shape * shape, FILE * fptr,
+                           unsigned int * dsgnmdID, int dsgSize,
+                           double budget );
+
+/* these functions are found in grtsAreaSample.c */
+extern int selectCellRecords( CellExtents * ext, int numCells, int * rdx,
+                              int sampleSize, double * dsgnmd, int * dsgIdx,
+                              const char * fcnName );
+extern int countGridCells( int * rdx, int sampleSize, int numCells,
+                           int * numSel, int * numMulti );
+extern SEXP createSampleSites( int * keep, int numKeep,
+                               unsigned int * recordIDs, int * dsgIdx,
+                               double * dsgnmd, double * xcs, double * ycs,
+                               SEXP mdcatyVec, double siteBegin, int nlev,
+                               int numSel, int numMulti,
+                               const char * fcnName );
+
+/* these functions are found in pickLinearSamplePoints.c */
+extern int pickStoreLinePoints( FrameStore * store, unsigned int * recordIDs,
+                                double * xc, double * yc, int sampleSize,
+                                double dx, double dy, double * xcs,
+                                double * ycs );
+extern int pickFileLinePoints( FILE * fptr, Shape * shape,
+                               unsigned int * recordIDs, double * xc,
+                               double * yc, int sampleSize, double dx,
+                               double dy, double * xcs, double * ycs );
+
+/* this function is found in selectGridCells.c */
+extern SEXP selectGridCells( SEXP xcVec, SEXP ycVec, SEXP celWtVec,
+                             SEXP dxVec, SEXP dyVec, SEXP nlevVec,
+                             SEXP samplesize, SEXP sintVec,
+                             SEXP doSampleVec );
+
+
+/**********************************************************
+** Function:   grtsLinearSample
+**
+** Purpose:    Select a GRTS sample of a linear resource.
+** Notes:      When a file name is not sent, the temporary .shp file
+**             combines the data found in all the .shp files in the current
+**             working directory.  Records that have ID numbers not found
+**             in the sent dsgnmdIDVec vector are ignored.
+** Arguments:  fileNamePrefix,  name of the shapefile without the .shp
+**                              extension, or NULL
+**             dsgnmdIDVec,  vector of record IDs of the frame
+**             dsgnmdVec,  vector of multidensity multipliers corresponding
+**                         to the above IDs
+**             mdcatyVec,  vector of multidensity categories corresponding
+**                         to the above IDs
+**             nsmpVec,  number of points to select in the sample
+**             siteBeginVec,  first number to use for the site IDs
+**             shiftGridVec,  flag signalling whether to do random shift of
+**                            grid,  1 shift, 0 don't shift
+**             startLevVec,  starting value to use for the number of levels
+**                           of the grid, or NULL
+**             maxLevVec,  maximum value to use for the number of levels of
+**                         the grid
+**             frameBudgetVal,  memory budget in megabytes for holding the
+**                              records in memory, where NULL uses the
+**                              default of FRAME_STORE_BUDGET and 0 always
+**                              reads the records from the file
+**             threadsVal,  number of threads used to compute the cell
+**                          lengths, where NULL uses the OpenMP default
+** Return:     results, an R list containing sites, the data frame of sample
+**                      sites with variables siteID, id, xcoord, ycoord,
+**                      mdcaty, and wgt in reverse hierarchical order and
+**                      with attribute nlev, and cells, an integer vector
+**                      containing the number of grid cells from which
+**                      sample points were selected and the number of those
+**                      cells that contained more than one sample point.
+**                      If an error occurs results will return set to NULL
+***********************************************************/
+SEXP grtsLinearSample( SEXP fileNamePrefix, SEXP dsgnmdIDVec, SEXP dsgnmdVec,
+                       SEXP mdcatyVec, SEXP nsmpVec, SEXP siteBeginVec,
+                       SEXP shiftGridVec, SEXP startLevVec, SEXP maxLevVec,
+                       SEXP frameBudgetVal, SEXP threadsVal ) {
+
+  int i, j;                 /* loop counters */
+  Shape shape;              /* shape struct for the temporary .shp file */
+  FILE * fptr = NULL;       /* pointer to the temporary .shp file */
+  FrameStore store;         /* records of the temporary .shp file */
+  int loaded = 0;           /* 1 if the records are held in the store */
+  GridLevels lev;           /* results for the final level */
+  int numCells;             /* number of cells with positive weight */
+  int error = FALSE;        /* TRUE if an error occurred */
+
+  /* C versions of sent vars */
+  unsigned int * dsgnmdID = NULL;
+  double * dsgnmd = NULL;
+  unsigned int dsgSize = length( dsgnmdIDVec );
+  int nsmp;
+  double siteBegin;
+  int shiftGrid;
+  int startLev = NA_INTEGER;
+  int maxlev;
+  double frameBudget = FRAME_STORE_BUDGET;
+  int numThreads = 1;
+
+  /* selected cells and sample points */
+  int sampleSize = 0;       /* number of selected cells */
+  int * rdx = NULL;         /* position of each selected cell */
+  int * dsgIdx = NULL;      /* index into dsgnmd of each selected record */
+  unsigned int * recordIDs = NULL;  /* ID of each selected record */
+  double * xc = NULL;       /* x-coordinate of each selected cell */
+  double * yc = NULL;       /* y-coordinate of each selected cell */
+  double * xcs = NULL;      /* x-coordinates of the sample points */
+  double * ycs = NULL;      /* y-coordinates of the sample points */
+  int * keep = NULL;        /* positions of the sample points */
+  int numSelCells = 0;      /* number of distinct selected cells */
+  int numMulti = 0;         /* number of cells with more than one point */
+
+  /* R objects */
+  SEXP dxVec, dyVec, nlevVec, sintVec, doSampleVec;
+  SEXP xcVec, ycVec, celWtVec, cellsVec;
+  SEXP results = NULL;
+
+  /* copy the IDs and multidensity multipliers into C arrays */
+  dsgnmdID = (unsigned int *) malloc( sizeof(unsigned int) * (dsgSize + 1) );
+  dsgnmd = (double *) malloc( sizeof(double) * (dsgSize + 1) );
+  if ( dsgnmdID == NULL || dsgnmd == NULL ) {
+    Rprintf( "Error: Allocating memory in C function grtsLinearSample.\n" );
+    free( dsgnmdID );
+    free( dsgnmd );
+    PROTECT( results = allocVector( VECSXP, 1 ) );
+    UNPROTECT(1);
+    return results;
+  }
+  PROTECT( dsgnmdIDVec = AS_INTEGER( dsgnmdIDVec ) );
+  PROTECT( dsgnmdVec = AS_NUMERIC( dsgnmdVec ) );
+  for ( i = 0; i < dsgSize; ++i ) {
+    dsgnmdID[i] = INTEGER( dsgnmdIDVec )[i];
+    dsgnmd[i] = REAL( dsgnmdVec )[i];
+  }
+
+  /* copy the remaining arguments to C variables */
+  nsmp = asInteger( nsmpVec );
+  siteBegin = asReal( siteBeginVec );
+  shiftGrid = asInteger( shiftGridVec );
+  if ( startLevVec != R_NilValue ) {
+    startLev = asInteger( startLevVec );
+  }
+  maxlev = asInteger( maxLevVec );
+  if ( frameBudgetVal != R_NilValue ) {
+    frameBudget = asReal( frameBudgetVal );
+  }
+#ifdef _OPENMP
+  numThreads = omp_get_max_threads();
+#endif
+  if ( threadsVal != R_NilValue ) {
+    numThreads = asInteger( threadsVal );
+  }
+  if ( numThreads == NA_INTEGER || numThreads < 1 ) {
+    numThreads = 1;
+  }
+
+  /* create and open the temporary .shp file */
+  if ( (fptr = openTempShpFile( fileNamePrefix, dsgnmdID, dsgSize, &shape,
+                                "grtsLinearSample" )) == NULL ) {
+    free( dsgnmdID );
+    free( dsgnmd );
+    PROTECT( results = allocVector( VECSXP, 1 ) );
+    UNPROTECT(3);
+    return results;
+  }
+  if ( shape.shapeType != POLYLINE && shape.shapeType != POLYLINE_Z &&
+       shape.shapeType != POLYLINE_M ) {
+    Rprintf( "Error: The shapefile type must be polyline in C function grtsLinearSample.\n" );
+    free( dsgnmdID );
+    free( dsgnmd );
+    fclose( fptr );
+    remove( TEMP_SHP_FILE );
+    PROTECT( results = allocVector( VECSXP, 1 ) );
+    UNPROTECT(3);
+    return results;
+  }
+
+  /* decode the polylines once if they fit within the memory budget */
+  initFrameStore( &store );
+  initGridLevels( &lev );
+  loaded = loadFrameStore( &store, &shape, fptr, dsgnmdID, dsgSize,
+                           frameBudget );
+  if ( loaded == -1 ) {
+    Rprintf( "Error: Reading the records in C function grtsLinearSample.\n" );
+    error = TRUE;
+  }
+
+  /* determine the number of levels and the final cell lengths, keeping the */
+  /* clipped length of the records within the cells */
+  if ( !error ) {
+    GetRNGstate();
+    if ( findGridLevels( &lev, &shape, fptr, &store, dsgnmdID, dsgnmd,
+                         dsgSize, nsmp, shiftGrid, startLev, maxlev, FALSE,
+                         TRUE, numThreads ) == -1 ) {
+      error = TRUE;
+    }
+    PutRNGstate();
+  }
+
+  /* construct randomized hierarchical addresses for the cells with */
+  /* positive weight and select the grid cells that get a sample point */
+  numCells = 0;
+  if ( !error ) {
+    for ( i = 0; i < lev.celWts.numCells; ++i ) {
+      if ( lev.celWts.cells[i].wt > 0.0 ) {
+        ++numCells;
+      }
+    }
+  }
+  PROTECT( dxVec = allocVector( REALSXP, 1 ) );
+  PROTECT( dyVec = allocVector( REALSXP, 1 ) );
+  PROTECT( nlevVec = allocVector( INTSXP, 1 ) );
+  PROTECT( sintVec = allocVector( REALSXP, 1 ) );
+  PROTECT( doSampleVec = allocVector( LGLSXP, 1 ) );
+  REAL( dxVec )[0] = lev.grid.dx;
+  REAL( dyVec )[0] = lev.grid.dy;
+  INTEGER( nlevVec )[0] = lev.nlev;
+  REAL( sintVec )[0] = lev.sint;
+  LOGICAL( doSampleVec )[0] = TRUE;
+  PROTECT( xcVec = allocVector( REALSXP, numCells ) );
+  PROTECT( ycVec = allocVector( REALSXP, numCells ) );
+  PROTECT( celWtVec = allocVector( REALSXP, numCells ) );
+  if ( !error ) {
+    j = 0;
+    for ( i = 0; i < lev.celWts.numCells; ++i ) {
+      if ( lev.celWts.cells[i].wt > 0.0 ) {
+        REAL( xcVec )[j] =
+          lev.grid.colX[lev.celWts.cells[i].idx % lev.grid.numCols];
+        REAL( ycVec )[j] =
+          lev.grid.rowY[lev.celWts.cells[i].idx / lev.grid.numCols];
+        REAL( celWtVec )[j] = lev.celWts.cells[i].wt;
+        ++j;
+      }
+    }
+    PROTECT( cellsVec = selectGridCells( xcVec, ycVec, celWtVec, dxVec,
+                                         dyVec, nlevVec, nsmpVec, sintVec,
+                                         doSampleVec ) );
+    if ( length( cellsVec ) < 2 || VECTOR_ELT( cellsVec, 1 ) == R_NilValue ) {
+      error = TRUE;
+    }
+  } else {
+    PROTECT( cellsVec = R_NilValue );
+  }
+
+  /* allocate the arrays for the sample points */
+  if ( !error ) {
+    rdx = INTEGER( VECTOR_ELT( cellsVec, 1 ) );
+    sampleSize = length( VECTOR_ELT( cellsVec, 1 ) );
+    dsgIdx = (int *) malloc( sizeof(int) * (sampleSize + 1) );
+    recordIDs = (unsigned int *) malloc( sizeof(unsigned int) *
+                                         (sampleSize + 1) );
+    xc = (double *) malloc( sizeof(double) * (sampleSize + 1) );
+    yc = (double *) malloc( sizeof(double) * (sampleSize + 1) );
+    xcs = (double *) malloc( sizeof(double) * (sampleSize + 1) );
+    ycs = (double *) malloc( sizeof(double) * (sampleSize + 1) );
+    keep = (int *) malloc( sizeof(int) * (sampleSize + 1) );
+    if ( dsgIdx == NULL || recordIDs == NULL || xc == NULL || yc == NULL ||
+         xcs == NULL || ycs == NULL || keep == NULL ) {
+      Rprintf( "Error: Allocating memory in C function grtsLinearSample.\n" );
+      error = TRUE;
+    }
+  }
+
+  /* count the selected cells and the cells with more than one point */
+  if ( !error ) {
+    if ( countGridCells( rdx, sampleSize, numCells, &numSelCells,
+                         &numMulti ) == -1 ) {
+      Rprintf( "Error: Allocating memory in C function grtsLinearSample.\n" );
+      error = TRUE;
+    }
+  }
+
+  /* select a record in each selected cell and, when the polylines are */
+  /* held in memory, pick a sample point in each cell */
+  if ( !error ) {
+    GetRNGstate();
+    if ( selectCellRecords( &lev.ext, numCells, rdx, sampleSize, dsgnmd,
+                            dsgIdx, "grtsLinearSample" ) == -1 ) {
+      error = TRUE;
+    }
+    if ( !error ) {
+      for ( i = 0; i < sampleSize; ++i ) {
+        recordIDs[i] = dsgnmdID[dsgIdx[i]];
+        xc[i] = REAL( xcVec )[rdx[i] - 1];
+        yc[i] = REAL( ycVec )[rdx[i] - 1];
+        keep[i] = i;
+      }
+    }
+    if ( !error && loaded == 1 ) {
+      if ( pickStoreLinePoints( &store, recordIDs, xc, yc, sampleSize,
+                                lev.grid.dx, lev.grid.dy, xcs,
+                                ycs ) == -1 ) {
+        Rprintf( "Error: Allocating memory in C function grtsLinearSample.\n" );
+        error = TRUE;
+      }
+    }
+
+    /* when the polylines are not held in memory, pick the sample points */
+    /* by reading the records of the selected cells from the temporary */
+    /* .shp file, which holds the records in the same order as the file */
+    /* that pickLinearSamplePoints creates for the selected records */
+    if ( !error && loaded != 1 ) {
+      if ( pickFileLinePoints( fptr, &shape, recordIDs, xc, yc, sampleSize,
+                               lev.grid.dx, lev.grid.dy, xcs,
+                               ycs ) == -1 ) {
+        Rprintf( "Error: Picking the sample points in C function grtsLinearSample.\n" );
+        error = TRUE;
+      }
+    }
+    PutRNGstate();
+  }
+
+  /* the temporary .shp file is no longer needed */
+  freeFrameStore( &store );
+  fclose( fptr );
+  remove( TEMP_SHP_FILE );
+
+  /* create the data frame of sample sites */
+  if ( !error ) {
+    PROTECT( results = createSampleSites( keep, sampleSize, recordIDs,
+                                          dsgIdx, dsgnmd, xcs, ycs,
+                                          mdcatyVec, siteBegin, lev.nlev,
+                                          numSelCells, numMulti,
+                                          "grtsLinearSample" ) );
+    if ( results == R_NilValue ) {
+      error = TRUE;
+    }
+    UNPROTECT(1);
+  }
+  if ( error ) {
+    PROTECT( results = allocVector( VECSXP, 1 ) );
+    UNPROTECT(1);
+  }
+  UNPROTECT(11);
+
+  /* clean up */
+  freeGridLevels( &lev );
+  free( dsgnmdID );
+  free( dsgnmd );
+  free( dsgIdx );
+  free( recordIDs );
+  free( xc );
+  free( yc );
+  free( xcs );
+  free( ycs );
+  free( keep );
+
+  return results;
+}
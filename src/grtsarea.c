@@ -14,6 +14,7 @@
 **  Revised:     May 5, 2015
 **  Revised:     June 15, 2015
 **  Revised:     August 10, 2017
+**  Revised:     October 19, 2026
 ******************************************************************************/
 
 #include <stdio.h>
@@ -40,8 +41,25 @@ extern unsigned int readBigEndian( unsigned char * buffer, int length );
 
 /* these functions are found in grts.c */
 extern int combineShpFiles( FILE * newShp, unsigned int * ids, int numIDs );
+extern void initCellWts( CellWts * celWts );
+extern void freeCellWts( CellWts * celWts );
+extern void clearCellWts( CellWts * celWts );
+extern void compactCellWts( CellWts * celWts );
+extern int addCellWt( CellWts * celWts, int idx, double wt );
+extern double findCellWt( CellWts * celWts, int idx );
+extern int mergeBlockWts( CellWts * celWts, FragTable * frags,
+                          CellExtents * ext, BlockWts * blocks,
+                          int numSlots );
+extern void cellRange( double * edges, int numCols, double width, double min,
+                       double max, int * first, int * last );
 extern int createNewTempShpFile( FILE * newShp, char * shapeFileName, 
 		                       unsigned int * ids, int numIDs );
+extern int addCellExtent( CellExtents * ext, int cell, unsigned int id,
+                          double extent );
+
+/* this function is found in pickAreaSamplePoints.c */
+extern int readShapeRecord( FILE * fptr, Polygon * poly, int * number,
+                            unsigned int * filePosition );
 
 
 /**********************************************************
@@ -99,6 +117,300 @@ int insidePolygon(Point * polygon, int N , double x, double y ) {
 }
 
 
+/**********************************************************
+** Function:   initPreparedPolygon
+**
+** Purpose:    Initialize an empty prepared polygon.
+** Arguments:  prep, prepared polygon to initialize
+** Return:     none
+***********************************************************/
+void initPreparedPolygon( PreparedPolygon * prep ) {
+
+  prep->numEdges = 0;
+  prep->maxEdges = 0;
+  prep->x0 = NULL;
+  prep->y0 = NULL;
+  prep->x1 = NULL;
+  prep->y1 = NULL;
+  prep->yMin = 0.0;
+  prep->yMax = 0.0;
+  prep->height = 0.0;
+  prep->numSlabs = 0;
+  prep->maxSlabs = 0;
+  prep->slabStart = NULL;
+  prep->maxEntries = 0;
+  prep->slabEdges = NULL;
+
+  return;
+}
+
+
+/**********************************************************
+** Function:   freePreparedPolygon
+**
+** Purpose:    Free the memory used by a prepared polygon and reset it to
+**             an empty prepared polygon.
+** Arguments:  prep, prepared polygon to free
+** Return:     none
+***********************************************************/
+void freePreparedPolygon( PreparedPolygon * prep ) {
+
+  free( prep->x0 );
+  free( prep->y0 );
+  free( prep->x1 );
+  free( prep->y1 );
+  free( prep->slabStart );
+  free( prep->slabEdges );
+  initPreparedPolygon( prep );
+
+  return;
+}
+
+
+/**********************************************************
+** Function:   preparedSlab
+**
+** Purpose:    Return the slab of a prepared polygon that contains the sent
+**             y value.
+** Notes:      The slab is a nondecreasing function of y, so an edge that
+**             is listed in the slabs of both of its end points is listed
+**             in the slab of every y value between them.
+** Arguments:  prep, prepared polygon
+**             y,    y value
+** Return:     the index of the slab
+***********************************************************/
+int preparedSlab( PreparedPolygon * prep, double y ) {
+
+  double s;           /* slab position of the y value */
+
+  s = floor( (y - prep->yMin) / prep->height );
+  if ( !(s >= 0.0) ) {
+    return 0;
+  }
+  if ( s > prep->numSlabs - 1 ) {
+    return prep->numSlabs - 1;
+  }
+  return (int) s;
+}
+
+
+/**********************************************************
+** Function:   preparePolygon
+**
+** Purpose:    Prepare a polygon record for repeated point in polygon
+**             tests.
+** Algorithm:  The edges of each part, including the edge from the last
+**             point of the part back to its first point, are stored in
+**             the same order and direction that insidePolygon uses, and
+**             horizontal edges are dropped since they are never crossed,
+**             as are edges with a missing y value.
+**             The number of slabs is chosen so that each slab has about
+**             PREPARED_SLAB_EDGES edges, but it is reduced when the edges
+**             are tall enough that the lists would hold more than
+**             PREPARED_EDGE_SLABS entries per edge.  The slab lists are
+**             built by counting the entries for each slab and then
+**             filling them, so an edge keeps its order within each slab.
+** Arguments:  prep,      prepared polygon, whose arrays are reused
+**             points,    points of the record
+**             numPoints, number of points in the record
+**             parts,     offsets of the first point of each part, or NULL
+**                        when the record is treated as a single part,
+**                        which is also done when there is one part
+**             numParts,  number of parts in the record
+** Return:     1,  on success
+**             -1, on error
+***********************************************************/
+int preparePolygon( PreparedPolygon * prep, Point * points, int numPoints,
+                    int * parts, int numParts ) {
+
+  int i, k, s;        /* loop counters */
+  int first, last;    /* first and last slabs of an edge */
+  int start, size;    /* first point and number of points of a part */
+  int numEntries;     /* number of entries in the slab lists */
+  int newSize;        /* new allocated length */
+  double span;        /* total height of the edges in units of the range */
+  Point * p1;         /* first point of an edge */
+  Point * p2;         /* second point of an edge */
+  void * ptr;         /* temp pointer for reallocated memory */
+
+  /* make sure the edge arrays can hold every edge */
+  prep->numEdges = 0;
+  prep->numSlabs = 0;
+  if ( numPoints > prep->maxEdges ) {
+    newSize = prep->maxEdges > 0 ? prep->maxEdges : 64;
+    while ( newSize < numPoints ) {
+      newSize *= 2;
+    }
+    if ( (ptr = realloc( prep->x0, sizeof(double) * newSize )) == NULL ) {
+      return -1;
+    }
+    prep->x0 = (double *) ptr;
+    if ( (ptr = realloc( prep->y0, sizeof(double) * newSize )) == NULL ) {
+      return -1;
+    }
+    prep->y0 = (double *) ptr;
+    if ( (ptr = realloc( prep->x1, sizeof(double) * newSize )) == NULL ) {
+      return -1;
+    }
+    prep->x1 = (double *) ptr;
+    if ( (ptr = realloc( prep->y1, sizeof(double) * newSize )) == NULL ) {
+      return -1;
+    }
+    prep->y1 = (double *) ptr;
+    prep->maxEdges = newSize;
+  }
+
+  /* store the edges that are not horizontal */
+  if ( parts == NULL || numParts <= 1 ) {
+    parts = NULL;
+    numParts = 1;
+  }
+  for ( k = 0; k < numParts; ++k ) {
+    start = parts == NULL ? 0 : parts[k];
+    size = (k == numParts - 1 ? numPoints : parts[k+1]) - start;
+    if ( size < 1 ) {
+      continue;
+    }
+    p1 = &(points[start]);
+    for ( i = 1; i <= size; ++i ) {
+      p2 = &(points[start + i % size]);
+      if ( p1->Y < p2->Y || p1->Y > p2->Y ) {
+        prep->x0[prep->numEdges] = p1->X;
+        prep->y0[prep->numEdges] = p1->Y;
+        prep->x1[prep->numEdges] = p2->X;
+        prep->y1[prep->numEdges] = p2->Y;
+        if ( prep->numEdges == 0 ) {
+          prep->yMin = MIN( p1->Y, p2->Y );
+          prep->yMax = MAX( p1->Y, p2->Y );
+        } else {
+          prep->yMin = MIN( prep->yMin, MIN( p1->Y, p2->Y ) );
+          prep->yMax = MAX( prep->yMax, MAX( p1->Y, p2->Y ) );
+        }
+        ++prep->numEdges;
+      }
+      p1 = p2;
+    }
+  }
+  if ( prep->numEdges == 0 ) {
+    return 1;
+  }
+
+  /* determine the number of slabs */
+  span = 0.0;
+  for ( i = 0; i < prep->numEdges; ++i ) {
+    span += fabs( prep->y1[i] - prep->y0[i] );
+  }
+  span /= prep->yMax - prep->yMin;
+  prep->numSlabs = prep->numEdges / PREPARED_SLAB_EDGES;
+  if ( span * prep->numSlabs > (double) PREPARED_EDGE_SLABS * prep->numEdges ) {
+    prep->numSlabs = (int) ( PREPARED_EDGE_SLABS * prep->numEdges / span );
+  }
+  if ( prep->numSlabs < 1 ) {
+    prep->numSlabs = 1;
+  }
+  prep->height = (prep->yMax - prep->yMin) / prep->numSlabs;
+  if ( !(prep->height > 0.0) ) {
+    prep->numSlabs = 1;
+    prep->height = 1.0;
+  }
+  if ( prep->numSlabs + 1 > prep->maxSlabs ) {
+    if ( (ptr = realloc( prep->slabStart, sizeof(int) * (prep->numSlabs + 1) ))
+         == NULL ) {
+      prep->numSlabs = 0;
+      return -1;
+    }
+    prep->slabStart = (int *) ptr;
+    prep->maxSlabs = prep->numSlabs + 1;
+  }
+
+  /* count the entries for each slab */
+  for ( s = 0; s <= prep->numSlabs; ++s ) {
+    prep->slabStart[s] = 0;
+  }
+  for ( i = 0; i < prep->numEdges; ++i ) {
+    first = preparedSlab( prep, MIN( prep->y0[i], prep->y1[i] ) );
+    last = preparedSlab( prep, MAX( prep->y0[i], prep->y1[i] ) );
+    for ( s = first; s <= last; ++s ) {
+      ++prep->slabStart[s + 1];
+    }
+  }
+  for ( s = 0; s < prep->numSlabs; ++s ) {
+    prep->slabStart[s + 1] += prep->slabStart[s];
+  }
+  numEntries = prep->slabStart[prep->numSlabs];
+  if ( numEntries > prep->maxEntries ) {
+    if ( (ptr = realloc( prep->slabEdges, sizeof(int) * numEntries ))
+         == NULL ) {
+      prep->numSlabs = 0;
+      return -1;
+    }
+    prep->slabEdges = (int *) ptr;
+    prep->maxEntries = numEntries;
+  }
+
+  /* fill the slab lists, using the start of the next slab as the fill */
+  /* position and then shifting the starts back */
+  for ( i = 0; i < prep->numEdges; ++i ) {
+    first = preparedSlab( prep, MIN( prep->y0[i], prep->y1[i] ) );
+    last = preparedSlab( prep, MAX( prep->y0[i], prep->y1[i] ) );
+    for ( s = first; s <= last; ++s ) {
+      prep->slabEdges[prep->slabStart[s]++] = i;
+    }
+  }
+  for ( s = prep->numSlabs; s > 0; --s ) {
+    prep->slabStart[s] = prep->slabStart[s - 1];
+  }
+  prep->slabStart[0] = 0;
+
+  return 1;
+}
+
+
+/**********************************************************
+** Function:   insidePrepared
+**
+** Purpose:    To determine if the sent point is inside a prepared
+**             polygon.
+** Notes:      Each edge in the slab that contains the point is tested in
+**             the same way as in insidePolygon, so the result is the same
+**             as the parity of the number of parts of the record that
+**             insidePolygon finds contain the point.
+** Arguments:  prep, prepared polygon
+**             x,    x coordinate of the point
+**             y,    y coordinate of the point
+** Return:     1, if the sent point is inside the prepared polygon
+**             0, if the sent point is outside the prepared polygon
+***********************************************************/
+int insidePrepared( PreparedPolygon * prep, double x, double y ) {
+
+  int i, e;           /* loop counter and edge index */
+  int s;              /* slab containing the point */
+  int counter = 0;    /* number of edges crossed */
+  double xinters;     /* x value where the edge crosses the y value */
+
+  if ( prep->numSlabs == 0 || !(y > prep->yMin) || !(y <= prep->yMax) ) {
+    return 0;
+  }
+  s = preparedSlab( prep, y );
+  for ( i = prep->slabStart[s]; i < prep->slabStart[s + 1]; ++i ) {
+    e = prep->slabEdges[i];
+    if ( y > MIN(prep->y0[e], prep->y1[e]) ) {
+      if ( y <= MAX(prep->y0[e], prep->y1[e]) ) {
+        if ( x <= MAX(prep->x0[e], prep->x1[e]) ) {
+          xinters = (y - prep->y0[e]) * (prep->x1[e] - prep->x0[e]) /
+                    (prep->y1[e] - prep->y0[e]) + prep->x0[e];
+          if ( prep->x0[e] == prep->x1[e] || x <= xinters ) {
+            ++counter;
+          }
+        }
+      }
+    }
+  }
+
+  return counter % 2;
+}
+
+
 /**********************************************************
 ** Function:   insideShape
 **
@@ -122,6 +434,9 @@ int insidePolygon(Point * polygon, int N , double x, double y ) {
 **             overall were in the shape or not.  The matrix value is then
 **             multiplied by the sent dsgnmd weight value that correspondes
 **             to the record ID the point was found to be inside of.
+**             A record is prepared by preparePolygon the first time a
+**             point is inside its bounding box, so that each point is
+**             only tested against the edges near its y value.
 ** Notes:      The matrix, x, and y arrays are all of the same size
 **             which is sent in the size argument.
 **             If a point is not in a record a -1 is written to the 
@@ -151,13 +466,11 @@ int insideShape( double ** matrix, unsigned int ** matrixIDs, double * x,
                  double * y, int size, Shape * shape, FILE * fptr, 
                  unsigned int * dsgnmdID, double * dsgnmd, int dsgSize ) {
 
-  int i, j, k;                      /* loop counters */
+  int i, j;                         /* loop counters */
 
-  /* variable used to iterate through the differnet parts for records */
-  /* with more than one part */
-  Point * part = NULL;              /* stores points makeing up the part */
-  int partSize;                     /* number of points in part */
-  int pidx;                         /* index into part array */
+  /* record prepared for testing the points against all of its parts */
+  PreparedPolygon prep;             /* prepared record */
+  int prepared;                     /* 1 if the current record is prepared */
 
   Point bdrBox[5];                  /* temp storage for the record bounding */
                                     /* boxes */
@@ -175,6 +488,7 @@ int insideShape( double ** matrix, unsigned int ** matrixIDs, double * x,
 
   /* initialize the shape struct */
   shape->records = NULL;
+  initPreparedPolygon( &prep );
 
   /* initialize the matrix to all 0's */
   for ( i = 0; i < size; ++i ) {
@@ -416,6 +730,7 @@ int insideShape( double ** matrix, unsigned int ** matrixIDs, double * x,
     }
 
     /* build the point in polygon matrix */
+    prepared = 0;
     for ( i = 0; i < size; ++i ) {
 
       /* check to see if this point was already found in a record */
@@ -483,170 +798,34 @@ int insideShape( double ** matrix, unsigned int ** matrixIDs, double * x,
       /* checking the record */
       if ( insidePolygon( bdrBox, 5, x[i], y[i] ) == 1 ) {
 
-        if ( shape->shapeType == POLYGON ) {
-
-        /* if there are more than one part we need to check them separately*/
-          if ( temp->poly->numParts > 1 ) {
-              for ( k = 0; k < temp->poly->numParts; ++k ) {
-              if ( part ) {
-                free( part );
-              }
-
-              /* check to see if this is the last part */ 
-              if ( k == temp->poly->numParts - 1 ) {
-
-                /* store part data into part array */
-                partSize = temp->poly->numPoints - temp->poly->parts[k];
-                if ( (part = (Point *) malloc( sizeof( Point ) * partSize )) 
-                   == NULL ) {
-                  Rprintf( "Error: Allocating memory in C function insideShape.\n" );
-                  return -1;
-                }
-                pidx = 0;
-                for(j=temp->poly->parts[k]; j < temp->poly->numPoints; ++j){
-                  part[pidx] = temp->poly->points[j];
-                  ++pidx; 
-                }
-
-              /* not the last part */
-              } else {
-
-                /* store part data into part array */
-                partSize = temp->poly->parts[k+1] - temp->poly->parts[k];
-                part = (Point *) malloc( sizeof( Point ) * partSize );
-                pidx = 0;
-                for(j=temp->poly->parts[k]; j < temp->poly->parts[k+1]; ++j){
-                  part[pidx] = temp->poly->points[j];
-                  ++pidx; 
-                }
-
-              }
-
-              /* see if the point is inside this part */
-              if( insidePolygon(part,partSize, x[i], y[i] ) == 1 ){
-                ++((*matrix)[i]);
-              }
-            }  
-
-          /* only one part so check the entire record */
+        /* prepare the record the first time a point is in its bounding */
+        /* box and then check the point against all of its parts */
+        if ( prepared == 0 ) {
+          if ( shape->shapeType == POLYGON ) {
+            prepared = preparePolygon( &prep, temp->poly->points,
+                                       temp->poly->numPoints,
+                                       temp->poly->parts,
+                                       temp->poly->numParts );
+          } else if ( shape->shapeType == POLYGON_Z ) {
+            prepared = preparePolygon( &prep, temp->polyZ->points,
+                                       temp->polyZ->numPoints,
+                                       temp->polyZ->parts,
+                                       temp->polyZ->numParts );
           } else {
-
-            /* now check the polygon */
-            if( insidePolygon( temp->poly->points, temp->poly->numPoints,
-               x[i], y[i]) == 1 ) {
-              ++((*matrix)[i]);
-            }
+            prepared = preparePolygon( &prep, temp->polyM->points,
+                                       temp->polyM->numPoints,
+                                       temp->polyM->parts,
+                                       temp->polyM->numParts );
           }
-
-        } else if ( shape->shapeType == POLYGON_Z ) {
-
-        /* if there are more than one part we need to check them separately*/
-          if ( temp->polyZ->numParts > 1 ) {
-              for ( k = 0; k < temp->polyZ->numParts; ++k ) {
-              if ( part ) {
-                free( part );
-              }
-
-              /* check to see if this is the last part */ 
-              if ( k == temp->polyZ->numParts - 1 ) {
-
-                /* store part data into part array */
-                partSize = temp->polyZ->numPoints - temp->polyZ->parts[k];
-                if ( (part = (Point *) malloc( sizeof( Point ) * partSize )) 
-                   == NULL ) {
-                  Rprintf( "Error: Allocating memory in C function insideShape.\n" );
-                  return -1;
-                }
-                pidx = 0;
-                for(j=temp->polyZ->parts[k]; j < temp->polyZ->numPoints; ++j){
-                  part[pidx] = temp->polyZ->points[j];
-                  ++pidx; 
-                }
-
-              /* not the last part */
-              } else {
-
-                /* store part data into part array */
-                partSize = temp->polyZ->parts[k+1] - temp->polyZ->parts[k];
-                part = (Point *) malloc( sizeof( Point ) * partSize );
-                pidx = 0;
-                for(j=temp->polyZ->parts[k]; j < temp->polyZ->parts[k+1]; ++j){
-                  part[pidx] = temp->polyZ->points[j];
-                  ++pidx; 
-                }
-
-              }
-
-              /* see if the point is inside this part */
-              if( insidePolygon(part,partSize, x[i], y[i] ) == 1 ){
-                ++((*matrix)[i]);
-              }
-            }  
-
-          /* only one part so check the entire record */
-          } else {
-
-            /* now check the polygon */
-            if( insidePolygon( temp->polyZ->points, temp->polyZ->numPoints,
-               x[i], y[i]) == 1 ) {
-              ++((*matrix)[i]);
-            }
-          }
-        } else {
-
-        /* if there are more than one part we need to check them separately*/
-          if ( temp->polyM->numParts > 1 ) {
-              for ( k = 0; k < temp->polyM->numParts; ++k ) {
-              if ( part ) {
-                free( part );
-              }
-
-              /* check to see if this is the last part */ 
-              if ( k == temp->polyM->numParts - 1 ) {
-
-                /* store part data into part array */
-                partSize = temp->polyM->numPoints - temp->polyM->parts[k];
-                if ( (part = (Point *) malloc( sizeof( Point ) * partSize )) 
-                   == NULL ) {
-                  Rprintf( "Error: Allocating memory in C function insideShape.\n" );
-                  return -1;
-                }
-                pidx = 0;
-                for(j=temp->polyM->parts[k]; j < temp->polyM->numPoints; ++j){
-                  part[pidx] = temp->polyM->points[j];
-                  ++pidx; 
-                }
-
-              /* not the last part */
-              } else {
-
-                /* store part data into part array */
-                partSize = temp->polyM->parts[k+1] - temp->polyM->parts[k];
-                part = (Point *) malloc( sizeof( Point ) * partSize );
-                pidx = 0;
-                for(j=temp->polyM->parts[k]; j < temp->polyM->parts[k+1]; ++j){
-                  part[pidx] = temp->polyM->points[j];
-                  ++pidx; 
-                }
-
-              }
-
-              /* see if the point is inside this part */
-              if( insidePolygon(part,partSize, x[i], y[i] ) == 1 ){
-                ++((*matrix)[i]);
-              }
-            }  
-
-          /* only one part so check the entire record */
-          } else {
-
-            /* now check the polygon */
-            if( insidePolygon( temp->polyM->points, temp->polyM->numPoints,
-               x[i], y[i]) == 1 ) {
-              ++((*matrix)[i]);
-            }
+          if ( prepared == -1 ) {
+            Rprintf( "Error: Allocating memory in C function insideShape.\n" );
+            freePreparedPolygon( &prep );
+            return -1;
           }
-        } 
+        }
+        if ( insidePrepared( &prep, x[i], y[i] ) == 1 ) {
+          ++((*matrix)[i]);
+        }
       }
 
       /* finalize the matrix values to either in or out */
@@ -680,186 +859,1147 @@ int insideShape( double ** matrix, unsigned int ** matrixIDs, double * x,
       free( temp->polyM->points );
       free( temp->polyM );
     }
-
-  }
-
-  /* do cleanup */
-  if ( part ) {
-    free( part );
+
+  }
+
+  /* do cleanup */
+  freePreparedPolygon( &prep );
+
+  return 1;
+}
+
+
+/**********************************************************
+** Function:  polygonArea
+**
+** Purpose:   returns the area of the polygon defined by
+**            the sent array of points (polygon).
+** Notes:     This function was found online at 
+**            http://astronomy.swin.edu.au/~pbourke/geometry/polyarea/source1.c
+**            by Paul Bourke, July 1988
+** Arguments: polygon, array of points defining the polygon
+**            size,  number of points in array
+** Return:    area,   area of polygon
+***********************************************************/
+double polygonArea( Point * polygon, int size ) {
+
+   int i , j;
+   double area = 0;
+
+   for ( i = 0; i < size; i++ ) {
+      j = (i + 1) % size;
+      area += polygon[i].X * polygon[j].Y;
+      area -= polygon[i].Y * polygon[j].X;
+   }
+
+   area /= 2;
+   return -area;
+}
+
+
+/**********************************************************
+** Function:   initClipBuffer
+**
+** Purpose:    Initialize an empty clipping buffer.
+** Arguments:  buf, clipping buffer to initialize
+** Return:     none
+***********************************************************/
+void initClipBuffer( ClipBuffer * buf ) {
+
+  buf->size = 0;
+  buf->numPts = 0;
+  buf->x = NULL;
+  buf->y = NULL;
+  buf->tx = NULL;
+  buf->ty = NULL;
+  buf->in = NULL;
+
+  return;
+}
+
+
+/**********************************************************
+** Function:   freeClipBuffer
+**
+** Purpose:    Free the memory used by a clipping buffer and reset it to
+**             an empty buffer.
+** Arguments:  buf, clipping buffer to free
+** Return:     none
+***********************************************************/
+void freeClipBuffer( ClipBuffer * buf ) {
+
+  free( buf->x );
+  free( buf->y );
+  free( buf->tx );
+  free( buf->ty );
+  free( buf->in );
+  initClipBuffer( buf );
+
+  return;
+}
+
+
+/**********************************************************
+** Function:   growClipBuffer
+**
+** Purpose:    Make sure each array of a clipping buffer can hold at least
+**             the sent number of values, keeping the values that are
+**             already stored.
+** Arguments:  buf,  clipping buffer
+**             size, required length of the arrays
+** Return:     1,  on success
+**             -1, on error
+***********************************************************/
+int growClipBuffer( ClipBuffer * buf, int size ) {
+
+  int newSize;        /* new allocated length */
+  void * ptr;         /* temp pointer for reallocated memory */
+
+  if ( size <= buf->size ) {
+    return 1;
+  }
+  newSize = buf->size > 0 ? buf->size : 64;
+  while ( newSize < size ) {
+    newSize *= 2;
+  }
+  if ( (ptr = realloc( buf->x, sizeof(double) * newSize )) == NULL ) {
+    return -1;
+  }
+  buf->x = (double *) ptr;
+  if ( (ptr = realloc( buf->y, sizeof(double) * newSize )) == NULL ) {
+    return -1;
+  }
+  buf->y = (double *) ptr;
+  if ( (ptr = realloc( buf->tx, sizeof(double) * newSize )) == NULL ) {
+    return -1;
+  }
+  buf->tx = (double *) ptr;
+  if ( (ptr = realloc( buf->ty, sizeof(double) * newSize )) == NULL ) {
+    return -1;
+  }
+  buf->ty = (double *) ptr;
+  if ( (ptr = realloc( buf->in, sizeof(int) * newSize )) == NULL ) {
+    return -1;
+  }
+  buf->in = (int *) ptr;
+  buf->size = newSize;
+
+  return 1;
+}
+
+
+/**********************************************************
+** Function:   clipSideX
+**
+** Purpose:    Clip the ring in a clipping buffer against the left or
+**             right side of a grid cell.
+** Algorithm:  The inside test for every vertex is done first in a
+**             separate loop.  Each edge then writes both its intersection
+**             with the side and its end point, and the output count is
+**             advanced only past the points that are kept, so the loop
+**             has no branches.  A vertex on the side is treated as inside
+**             the cell, and the intersection is calculated from the slope
+**             of the edge.
+** Arguments:  buf,   clipping buffer holding a closed ring of n+1 points,
+**                    which must hold at least 2n+2 values
+**             n,     number of edges in the ring
+**             c,     x coordinate of the side
+**             lower, 1 for the left side, 0 for the right side
+** Return:     number of points written to the tx and ty arrays
+***********************************************************/
+int clipSideX( ClipBuffer * buf, int n, double c, int lower ) {
+
+  int i;
+  int cou = 0;
+  double * x = buf->x;
+  double * y = buf->y;
+  double * tx = buf->tx;
+  double * ty = buf->ty;
+  int * in = buf->in;
+  double dx, slope;
+
+  if ( lower ) {
+    for ( i = 0; i <= n; ++i ) {
+      in[i] = !( x[i] < c );
+    }
+  } else {
+    for ( i = 0; i <= n; ++i ) {
+      in[i] = !( x[i] > c );
+    }
+  }
+
+  for ( i = 0; i < n; ++i ) {
+    dx = x[i+1] - x[i];
+    slope = dx != 0.0 ? (y[i+1] - y[i]) / dx : 0.0;
+    tx[cou] = c;
+    ty[cou] = y[i+1] + (c - x[i+1]) * slope;
+    cou += in[i] ^ in[i+1];
+    tx[cou] = x[i+1];
+    ty[cou] = y[i+1];
+    cou += in[i+1];
+  }
+
+  return cou;
+}
+
+
+/**********************************************************
+** Function:   clipSideY
+**
+** Purpose:    Clip the ring in a clipping buffer against the bottom or
+**             top side of a grid cell.
+** Algorithm:  Same as clipSideX.
+** Arguments:  buf,   clipping buffer holding a closed ring of n+1 points,
+**                    which must hold at least 2n+2 values
+**             n,     number of edges in the ring
+**             c,     y coordinate of the side
+**             lower, 1 for the bottom side, 0 for the top side
+** Return:     number of points written to the tx and ty arrays
+***********************************************************/
+int clipSideY( ClipBuffer * buf, int n, double c, int lower ) {
+
+  int i;
+  int cou = 0;
+  double * x = buf->x;
+  double * y = buf->y;
+  double * tx = buf->tx;
+  double * ty = buf->ty;
+  int * in = buf->in;
+  double dx, slope;
+
+  if ( lower ) {
+    for ( i = 0; i <= n; ++i ) {
+      in[i] = !( y[i] < c );
+    }
+  } else {
+    for ( i = 0; i <= n; ++i ) {
+      in[i] = !( y[i] > c );
+    }
+  }
+
+  for ( i = 0; i < n; ++i ) {
+    dx = x[i+1] - x[i];
+    slope = dx != 0.0 ? (y[i+1] - y[i]) / dx : 0.0;
+    tx[cou] = dx != 0.0 ? x[i+1] + (c - y[i+1]) / slope : x[i+1];
+    ty[cou] = c;
+    cou += in[i] ^ in[i+1];
+    tx[cou] = x[i+1];
+    ty[cou] = y[i+1];
+    cou += in[i+1];
+  }
+
+  return cou;
+}
+
+
+/**********************************************************
+** Function:   clipPolygonArea
+**
+** Purpose:    Clip a polygon ring to a grid cell and calculate the area
+**             of the clipped polygon.
+** Algorithm:  Sutherland-Hodgman clipping against the left, right, bottom
+**             and top sides of the cell in turn.  The coordinates are
+**             held in separate x and y arrays, the output of each side is
+**             swapped with its input rather than copied, and the area is
+**             calculated from the arrays using the same sums in the same
+**             order as polygonArea.
+** Notes:      No memory is allocated unless the buffer is too small for
+**             the ring, so a buffer that is reused for many calls only
+**             grows to the size of the largest ring.  On return the
+**             clipped polygon is left in buf->x and buf->y as a closed
+**             ring of buf->numPts points.  buf->numPts is 0 when the ring
+**             does not intersect the cell and -1 if memory could not be
+**             allocated.
+** Arguments:  cell,   grid cell to clip to
+**             points, array of points containing the ring
+**             start,  index of the first point of the ring
+**             end,    index of the last point of the ring
+**             buf,    clipping buffer
+** Return:     area of the clipped polygon
+***********************************************************/
+double clipPolygonArea( Cell * cell, Point * points, int start, int end,
+                        ClipBuffer * buf ) {
+
+  int i, j;
+  int side;
+  int n = (end - start);    /* number of edges in polygon part */
+  double * swap;
+  double area = 0.0;
+
+  buf->numPts = 0;
+  if ( n < 1 ) {
+    return 0.0;
+  }
+
+  /* copy the ring into the buffer */
+  if ( growClipBuffer( buf, 2 * n + 2 ) == -1 ) {
+    buf->numPts = -1;
+    return 0.0;
+  }
+  for ( i = 0; i <= n; ++i ) {
+    buf->x[i] = points[start+i].X;
+    buf->y[i] = points[start+i].Y;
+  }
+
+  for ( side = LEFT; side <= TOP; ++side ) {
+
+    /* make sure the output of this side has room for the new vertices */
+    if ( growClipBuffer( buf, 2 * n + 2 ) == -1 ) {
+      buf->numPts = -1;
+      return 0.0;
+    }
+
+    switch ( side ) {
+      case LEFT:   n = clipSideX( buf, n, cell->xMin, 1 );
+                   break;
+      case RIGHT:  n = clipSideX( buf, n, cell->xMax, 0 );
+                   break;
+      case BOTTOM: n = clipSideY( buf, n, cell->yMin, 1 );
+                   break;
+      case TOP:    n = clipSideY( buf, n, cell->yMax, 0 );
+                   break;
+    }
+
+    /* the ring lies entirely outside this side of the cell */
+    if ( n == 0 ) {
+      return 0.0;
+    }
+    buf->tx[n] = buf->tx[0];
+    buf->ty[n] = buf->ty[0];
+
+    /* the output of this side is the input of the next side */
+    swap = buf->x;
+    buf->x = buf->tx;
+    buf->tx = swap;
+    swap = buf->y;
+    buf->y = buf->ty;
+    buf->ty = swap;
+  }
+
+  for ( i = 0; i <= n; ++i ) {
+    j = i < n ? i + 1 : 0;
+    area += buf->x[i] * buf->y[j];
+    area -= buf->y[i] * buf->x[j];
+  }
+  buf->numPts = n + 1;
+
+  area /= 2;
+  return -area;
+}
+
+
+/**********************************************************
+** Function:   initFragTable
+**
+** Purpose:    Initialize an empty fragment table.
+** Arguments:  frags, fragment table to initialize
+** Return:     none
+***********************************************************/
+void initFragTable( FragTable * frags ) {
+
+  frags->numFrags = 0;
+  frags->maxFrags = 0;
+  frags->cell = NULL;
+  frags->dsgIdx = NULL;
+  frags->multiPart = NULL;
+  frags->start = NULL;
+  frags->numPts = NULL;
+  frags->area = NULL;
+  frags->numPoints = 0;
+  frags->maxPoints = 0;
+  frags->points = NULL;
+
+  return;
+}
+
+
+/**********************************************************
+** Function:   freeFragTable
+**
+** Purpose:    Free the memory used by a fragment table and reset it to
+**             an empty table.
+** Arguments:  frags, fragment table to free
+** Return:     none
+***********************************************************/
+void freeFragTable( FragTable * frags ) {
+
+  free( frags->cell );
+  free( frags->dsgIdx );
+  free( frags->multiPart );
+  free( frags->start );
+  free( frags->numPts );
+  free( frags->area );
+  free( frags->points );
+  initFragTable( frags );
+
+  return;
+}
+
+
+/**********************************************************
+** Function:   newFragment
+**
+** Purpose:    Append a fragment to a fragment table, growing the table as
+**             necessary, and return the storage for its points.
+** Arguments:  frags,  fragment table
+**             cellIdx, index of the grid cell containing the fragment
+**             dsgIdx,  index into the dsgnmd array for the fragment's record
+**             multiPart, 1 if the record has more than one part
+**             n,      number of points in the fragment
+**             area,   signed area of the fragment
+** Return:     pointer to the storage for the n points of the fragment, 
+**             NULL on error
+***********************************************************/
+Point * newFragment( FragTable * frags, int cellIdx, int dsgIdx,
+                     int multiPart, int n, double area ) {
+
+  int i;          /* index of the new fragment */
+  int newMax;     /* new allocated length */
+  void * ptr;     /* temp pointer for reallocated memory */
+
+  /* as necessary, grow the fragment arrays */
+  if ( frags->numFrags == frags->maxFrags ) {
+    newMax = frags->maxFrags > 0 ? 2 * frags->maxFrags : 256;
+    if ( (ptr = realloc( frags->cell, sizeof(int) * newMax )) == NULL ) {
+      return NULL;
+    }
+    frags->cell = (int *) ptr;
+    if ( (ptr = realloc( frags->dsgIdx, sizeof(int) * newMax )) == NULL ) {
+      return NULL;
+    }
+    frags->dsgIdx = (int *) ptr;
+    if ( (ptr = realloc( frags->multiPart, sizeof(int) * newMax )) == NULL ) {
+      return NULL;
+    }
+    frags->multiPart = (int *) ptr;
+    if ( (ptr = realloc( frags->start, sizeof(int) * newMax )) == NULL ) {
+      return NULL;
+    }
+    frags->start = (int *) ptr;
+    if ( (ptr = realloc( frags->numPts, sizeof(int) * newMax )) == NULL ) {
+      return NULL;
+    }
+    frags->numPts = (int *) ptr;
+    if ( (ptr = realloc( frags->area, sizeof(double) * newMax )) == NULL ) {
+      return NULL;
+    }
+    frags->area = (double *) ptr;
+    frags->maxFrags = newMax;
+  }
+
+  /* as necessary, grow the points array */
+  if ( frags->numPoints + n > frags->maxPoints ) {
+    newMax = frags->maxPoints > 0 ? 2 * frags->maxPoints : 4096;
+    while ( newMax < frags->numPoints + n ) {
+      newMax *= 2;
+    }
+    if ( (ptr = realloc( frags->points, sizeof(Point) * newMax )) == NULL ) {
+      return NULL;
+    }
+    frags->points = (Point *) ptr;
+    frags->maxPoints = newMax;
+  }
+
+  i = frags->numFrags;
+  frags->cell[i] = cellIdx;
+  frags->dsgIdx[i] = dsgIdx;
+  frags->multiPart[i] = multiPart;
+  frags->start[i] = frags->numPoints;
+  frags->numPts[i] = n;
+  frags->area[i] = area;
+  frags->numPoints += n;
+  ++frags->numFrags;
+
+  return &(frags->points[frags->start[i]]);
+}
+
+
+/**********************************************************
+** Function:   addFragment
+**
+** Purpose:    Append a clipped polygon fragment to a fragment table,
+**             growing the table as necessary.
+** Arguments:  frags,  fragment table
+**             cellIdx, index of the grid cell containing the fragment
+**             dsgIdx,  index into the dsgnmd array for the fragment's record
+**             multiPart, 1 if the record has more than one part
+**             pts,    points of the fragment, which is a closed ring
+**             n,      number of points in pts
+**             area,   signed area of the fragment
+** Return:     1,  on success
+**             -1, on error
+***********************************************************/
+int addFragment( FragTable * frags, int cellIdx, int dsgIdx, int multiPart,
+                 Point * pts, int n, double area ) {
+
+  Point * dest;   /* storage for the points of the fragment */
+
+  if ( (dest = newFragment( frags, cellIdx, dsgIdx, multiPart, n, area ))
+       == NULL ) {
+    return -1;
+  }
+  memcpy( dest, pts, sizeof(Point) * n );
+
+  return 1;
+}
+
+
+/**********************************************************
+** Function:   clipAndStore
+**
+** Purpose:    Calculate the area of a polygon ring within a grid cell
+**             and, when a fragment table is sent, store the clipped
+**             ring in the table.
+** Notes:      Fragments with zero area are not stored since they cannot
+**             contribute area to any cell of a finer grid.
+** Arguments:  cell,   grid cell to clip to
+**             points, array of points containing the ring
+**             start,  index of the first point of the ring
+**             end,    index of the last point of the ring
+**             cellIdx, index of the grid cell
+**             dsgIdx,  index into the dsgnmd array for the ring's record
+**             multiPart, 1 if the record has more than one part
+**             buf,    clipping buffer
+**             frags,  fragment table, or NULL
+**             error,  set to 1 if an error occurs
+** Return:     area of the ring within the cell
+***********************************************************/
+double clipAndStore( Cell * cell, Point * points, int start, int end,
+                     int cellIdx, int dsgIdx, int multiPart,
+                     ClipBuffer * buf, FragTable * frags, int * error ) {
+
+  int i;              /* loop counter */
+  double area;        /* area of the clipped ring */
+  Point * dest;       /* storage for the points of the fragment */
+
+  area = clipPolygonArea( cell, points, start, end, buf );
+  if ( buf->numPts < 0 ) {
+    *error = 1;
+    return 0.0;
+  }
+  if ( frags != NULL && buf->numPts > 0 && area != 0.0 ) {
+    if ( (dest = newFragment( frags, cellIdx, dsgIdx, multiPart,
+                              buf->numPts, area )) == NULL ) {
+      *error = 1;
+      return area;
+    }
+    for ( i = 0; i < buf->numPts; ++i ) {
+      dest[i].X = buf->x[i];
+      dest[i].Y = buf->y[i];
+    }
+  }
+
+  return area;
+}
+
+
+/**********************************************************
+** Function:   pruneFragments
+**
+** Purpose:    Remove the fragments that are located in grid cells with
+**             zero weight, since no cell of a finer grid that is inside
+**             those cells can have positive weight.
+** Arguments:  frags,  fragment table
+**             celWts, sparse cell weights for the grid of the fragments,
+**                     which must be merged by compactCellWts
+** Return:     none
+***********************************************************/
+void pruneFragments( FragTable * frags, CellWts * celWts ) {
+
+  int i;              /* loop counter */
+  int j = 0;          /* index of the next kept fragment */
+  int np = 0;         /* number of points kept */
+
+  for ( i = 0; i < frags->numFrags; ++i ) {
+    if ( findCellWt( celWts, frags->cell[i] ) > 0.0 ) {
+      if ( frags->start[i] != np ) {
+        memmove( &(frags->points[np]), &(frags->points[frags->start[i]]),
+                 sizeof(Point) * frags->numPts[i] );
+      }
+      frags->cell[j] = frags->cell[i];
+      frags->dsgIdx[j] = frags->dsgIdx[i];
+      frags->multiPart[j] = frags->multiPart[i];
+      frags->start[j] = np;
+      frags->numPts[j] = frags->numPts[i];
+      frags->area[j] = frags->area[i];
+      np += frags->numPts[i];
+      ++j;
+    }
+  }
+  frags->numFrags = j;
+  frags->numPoints = np;
+
+  return;
+}
+
+
+/* struct used to sum the areas of multipart records within a cell */
+typedef struct partAreaStruct PartArea;
+struct partAreaStruct {
+  int dsgIdx;
+  int cell;
+  double area;
+};
+
+
+/**********************************************************
+** Function:   comparePartArea
+**
+** Purpose:    qsort comparison function that orders PartArea structs by
+**             record and then by cell.
+***********************************************************/
+int comparePartArea( const void * a, const void * b ) {
+
+  const PartArea * pa = (const PartArea *) a;
+  const PartArea * pb = (const PartArea *) b;
+
+  if ( pa->dsgIdx != pb->dsgIdx ) {
+    return pa->dsgIdx < pb->dsgIdx ? -1 : 1;
+  }
+  if ( pa->cell != pb->cell ) {
+    return pa->cell < pb->cell ? -1 : 1;
+  }
+  return 0;
+}
+
+
+/**********************************************************
+** Function:   refineFragment
+**
+** Purpose:    Clip one fragment of the previous level to the cells of the
+**             new grid that overlap it.
+** Notes:      The area of a fragment of a single part record is added to
+**             the cell weights.  The fragments of multipart records are
+**             only stored, since their areas are summed by areaRefinement.
+** Arguments:  celWts, sparse cell weights
+**             grid,   grid for the new level
+**             frags,  fragment table for the previous level
+**             f,      index of the fragment in frags
+**             newFrags, fragment table that receives the new fragments
+**             dsgnmd, array of weights for the records
+**             buf,    clipping buffer
+** Return:     1,   on success
+**             -1,  on error
+***********************************************************/
+int refineFragment( CellWts * celWts, Grid * grid, FragTable * frags, int f,
+    FragTable * newFrags, double * dsgnmd, ClipBuffer * buf ) {
+
+  int i;                        /* loop counter */
+  int ix, iy;                   /* grid column and row */
+  int ixLo, ixHi, iyLo, iyHi;   /* range of columns and rows to visit */
+  int idx;                      /* cell index */
+  int error = 0;                /* error indicator */
+  double bxMin, bxMax, byMin, byMax;  /* bounding box of the fragment */
+  double area;                  /* area of a clipped fragment */
+  Point * pts;                  /* points of the fragment */
+  Cell cell;                    /* temp storage for a cell */
+
+  pts = &(frags->points[frags->start[f]]);
+  bxMin = bxMax = pts[0].X;
+  byMin = byMax = pts[0].Y;
+  for ( i = 1; i < frags->numPts[f]; ++i ) {
+    bxMin = MIN( bxMin, pts[i].X );
+    bxMax = MAX( bxMax, pts[i].X );
+    byMin = MIN( byMin, pts[i].Y );
+    byMax = MAX( byMax, pts[i].Y );
+  }
+  cellRange( grid->colX, grid->numCols, grid->dx, bxMin, bxMax, &ixLo,
+             &ixHi );
+  cellRange( grid->rowY, grid->numCols, grid->dy, byMin, byMax, &iyLo,
+             &iyHi );
+
+  for ( iy = iyLo; iy <= iyHi && error == 0; ++iy ) {
+    for ( ix = ixLo; ix <= ixHi; ++ix ) {
+      idx = iy * grid->numCols + ix;
+      cell.xMin = grid->colX[ix] - grid->dx;
+      cell.yMin = grid->rowY[iy] - grid->dy;
+      cell.xMax = grid->colX[ix];
+      cell.yMax = grid->rowY[iy];
+      if ( cell.xMax < bxMin || cell.xMin > bxMax ||
+           cell.yMax < byMin || cell.yMin > byMax ) {
+        continue;
+      }
+      area = clipAndStore( &cell, pts, 0, frags->numPts[f] - 1, idx,
+                 frags->dsgIdx[f], frags->multiPart[f], buf, newFrags,
+                 &error );
+      if ( error ) {
+        break;
+      }
+      if ( frags->multiPart[f] == 0 && area != 0.0 &&
+           addCellWt( celWts, idx, area * dsgnmd[frags->dsgIdx[f]] ) == -1 ) {
+        error = 1;
+        break;
+      }
+    }
   }
 
-  return 1;
+  return error ? -1 : 1;
 }
 
 
 /**********************************************************
-** Function:  polygonArea
+** Function:   areaRefinement
 **
-** Purpose:   returns the area of the polygon defined by
-**            the sent array of points (polygon).
-** Notes:     This function was found online at 
-**            http://astronomy.swin.edu.au/~pbourke/geometry/polyarea/source1.c
-**            by Paul Bourke, July 1988
-** Arguments: polygon, array of points defining the polygon
-**            size,  number of points in array
-** Return:    area,   area of polygon
+** Purpose:    Calculate the cell weights for a finer level of the
+**             hierarchical grid from the polygon fragments that were
+**             clipped to the cells of the previous level.
+** Algorithm:  Only cells of the previous level that have positive weight
+**             keep fragments, so only the part of the new grid that is
+**             covered by those cells is visited.  Each fragment is clipped
+**             to the new cells that overlap its bounding box.  Since the
+**             random shift of the grid is proportional to the cell size,
+**             grids at different levels are not nested and a new cell may
+**             receive fragments from as many as four previous cells.  The
+**             areas of a single part record are added to the cell weights
+**             directly.  The areas of the parts of a multipart record are
+**             summed within each cell and added only if the total is
+**             positive, which is the rule used by areaIntersection.
+** Notes:      On return the fragment table holds the fragments clipped to
+**             the cells of the new grid that have positive weight, so that
+**             it can be used to refine the next level.
+**             When block storage is provided the fragments are clipped in
+**             parallel in blocks, and the results are the same as when
+**             they are clipped in order.
+** Arguments:  celWts, sparse cell weights, which receive the weights of the
+**                     cells with nonzero weight
+**             grid,   grid for the new level
+**             frags,  fragment table for the previous level
+**             dsgnmd, array of weights for the records
+**             blocks, block storage for processing the fragments with more
+**                     than one thread, or NULL
+** Return:     1,   on success
+**             -1,  on error
 ***********************************************************/
-double polygonArea( Point * polygon, int size ) {
+int areaRefinement( CellWts * celWts, Grid * grid, FragTable * frags,
+    double * dsgnmd, BlockWts * blocks ) {
+
+  int i, j, f;                  /* loop counters */
+  int b;                        /* slot of a block */
+  int first;                    /* first fragment of a round */
+  int numSlots;                 /* number of slots used in a round */
+  int error = 0;                /* error indicator */
+  int numMulti = 0;             /* number of multipart fragments */
+  double sumArea;               /* sum of areas for a record in a cell */
+  FragTable newFrags;           /* fragments clipped to the new grid */
+  PartArea * multi = NULL;      /* areas for multipart records */
+  ClipBuffer buf;               /* clipping buffer */
 
-   int i , j;
-   double area = 0;
+  /* initialize all the cell weights */
+  clearCellWts( celWts );
 
-   for ( i = 0; i < size; i++ ) {
-      j = (i + 1) % size;
-      area += polygon[i].X * polygon[j].Y;
-      area -= polygon[i].Y * polygon[j].X;
-   }
+  initFragTable( &newFrags );
+  initClipBuffer( &buf );
 
-   area /= 2;
-   return -area;
-}
+  /* clip each fragment to the new cells that overlap it */
+  if ( blocks == NULL ) {
+    for ( f = 0; f < frags->numFrags && error == 0; ++f ) {
+      if ( refineFragment( celWts, grid, frags, f, &newFrags, dsgnmd,
+                           &buf ) == -1 ) {
+        error = 1;
+      }
+    }
+  } else {
+    for ( first = 0; first < frags->numFrags && error == 0;
+          first += blocks->numSlots * RECORD_BLOCK_SIZE ) {
+      numSlots = MIN( blocks->numSlots, (frags->numFrags - first +
+                      RECORD_BLOCK_SIZE - 1) / RECORD_BLOCK_SIZE );
+#ifdef _OPENMP
+#pragma omp parallel for private(f) schedule(dynamic) \
+        num_threads(blocks->numThreads)
+#endif
+      for ( b = 0; b < numSlots; ++b ) {
+        for ( f = first + b * RECORD_BLOCK_SIZE; f < frags->numFrags &&
+              f < first + (b + 1) * RECORD_BLOCK_SIZE; ++f ) {
+          if ( refineFragment( &(blocks->wts[b]), grid, frags, f,
+                 &(blocks->frags[b]), dsgnmd, &(blocks->clip[b]) ) == -1 ) {
+            blocks->error[b] = 1;
+            break;
+          }
+        }
+      }
+      if ( mergeBlockWts( celWts, &newFrags, NULL, blocks,
+                          numSlots ) == -1 ) {
+        error = 1;
+      }
+    }
+  }
+  freeClipBuffer( &buf );
+  if ( error ) {
+    Rprintf( "Error: Allocating memory in C function areaRefinement.\n" );
+    freeFragTable( &newFrags );
+    return -1;
+  }
 
+  /* sum the areas of multipart records within each cell */
+  for ( f = 0; f < newFrags.numFrags; ++f ) {
+    if ( newFrags.multiPart[f] == 1 ) {
+      ++numMulti;
+    }
+  }
+  if ( numMulti > 0 ) {
+    if ( (multi = (PartArea *) malloc( sizeof(PartArea) * numMulti ))
+         == NULL ) {
+      Rprintf( "Error: Allocating memory in C function areaRefinement.\n" );
+      freeFragTable( &newFrags );
+      return -1;
+    }
+    j = 0;
+    for ( f = 0; f < newFrags.numFrags; ++f ) {
+      if ( newFrags.multiPart[f] == 1 ) {
+        multi[j].dsgIdx = newFrags.dsgIdx[f];
+        multi[j].cell = newFrags.cell[f];
+        multi[j].area = newFrags.area[f];
+        ++j;
+      }
+    }
+    qsort( multi, j, sizeof(PartArea), comparePartArea );
+
+    /* if the total area for all the parts is negative, don't add it */
+    for ( i = 0; i < j; i = f ) {
+      sumArea = 0.0;
+      for ( f = i; f < j && multi[f].dsgIdx == multi[i].dsgIdx &&
+                    multi[f].cell == multi[i].cell; ++f ) {
+        sumArea += multi[f].area * dsgnmd[multi[f].dsgIdx];
+      }
+      if ( sumArea > 0.0 && 
+           addCellWt( celWts, multi[i].cell, sumArea ) == -1 ) {
+        Rprintf( "Error: Allocating memory in C function areaRefinement.\n" );
+        free( multi );
+        freeFragTable( &newFrags );
+        return -1;
+      }
+    }
+    free( multi );
+  }
+  compactCellWts( celWts );
 
-Point intersect( Cell * cell, Point * p1, Point * p2, int side ) {
+  /* keep the fragments in cells with positive weight for the next level */
+  pruneFragments( &newFrags, celWts );
+  freeFragTable( frags );
+  *frags = newFrags;
 
-  Point newPoint;
-  Point * z;
-  double slope = 0.0;
+  return 1;
+}
 
-   newPoint.X = 0.0;
-   newPoint.Y = 0.0;
-   z = &newPoint;
 
-  if ( p2->X != p1->X ) {
-    slope = (p2->Y - p1->Y) / ( p2->X - p1->X );
-  }
+/* struct used to find the cells of the final grid occupied by each record */
+typedef struct recordCellStruct RecordCell;
+struct recordCellStruct {
+  int dsgIdx;
+  int cell;
+};
 
-  switch ( side ) {
 
-    case LEFT: z->X = cell->xMin;
-               z->Y = p2->Y + (cell->xMin - p2->X) * slope;
-               break;
+/**********************************************************
+** Function:   compareRecordCell
+**
+** Purpose:    qsort comparison function that orders RecordCell structs by
+**             record and then by cell.
+***********************************************************/
+int compareRecordCell( const void * a, const void * b ) {
 
-    case RIGHT: z->X = cell->xMax;
-                z->Y = p2->Y + (cell->xMax - p2->X) * slope;
-                break;
+  const RecordCell * pa = (const RecordCell *) a;
+  const RecordCell * pb = (const RecordCell *) b;
 
-    case BOTTOM: z->Y = cell->yMin;
-                 if ( p1->X == p2->X ) {
-                   z->X = p2->X;
-                 } else {
-                   z->X = p2->X + (cell->yMin - p2->Y)/slope;
-                 }
-                 break;
+  if ( pa->dsgIdx != pb->dsgIdx ) {
+    return pa->dsgIdx < pb->dsgIdx ? -1 : 1;
+  }
+  if ( pa->cell != pb->cell ) {
+    return pa->cell < pb->cell ? -1 : 1;
+  }
+  return 0;
+}
 
-    case TOP:  z->Y = cell->yMax;
-               if ( p1->X == p2->X ) {
-                 z->X = p2->X;
-               } else {
-                 z->X = p2->X + (cell->yMax - p2->Y)/slope;
-               }
-               break;
 
-  } 
+/**********************************************************
+** Function:   recordExtents
+**
+** Purpose:    Add the area of one polygon record within each of a set of
+**             grid cells to the extents.
+** Algorithm:  Each part of the record is clipped to the cell in the same
+**             way as areaRecord, and the areas are added in the order of
+**             the parts.
+** Arguments:  ext,    extents that receive the areas
+**             grid,   grid for the final level
+**             points, points of the record
+**             numPoints, number of points in the record
+**             parts,  part offsets of the record
+**             numParts, number of parts in the record
+**             w,      index into the dsgnmd array for the record
+**             cells,  record and cell pairs for the record
+**             numCells, number of pairs
+**             buf,    clipping buffer
+** Return:     1,   on success
+**             -1,  on error
+***********************************************************/
+int recordExtents( CellExtents * ext, Grid * grid, Point * points,
+    int numPoints, int * parts, int numParts, int w, RecordCell * cells,
+    int numCells, ClipBuffer * buf ) {
+
+  int i, k;                     /* loop counters */
+  int ix, iy;                   /* grid column and row */
+  int start, end;               /* first and last points of a part */
+  double area;                  /* area of a part within a cell */
+  Cell cell;                    /* temp storage for a cell */
 
+  for ( i = 0; i < numCells; ++i ) {
+    ix = cells[i].cell % grid->numCols;
+    iy = cells[i].cell / grid->numCols;
+    cell.xMin = grid->colX[ix] - grid->dx;
+    cell.yMin = grid->rowY[iy] - grid->dy;
+    cell.xMax = grid->colX[ix];
+    cell.yMax = grid->rowY[iy];
+    for ( k = 0; k < numParts; ++k ) {
+      start = numParts > 1 ? parts[k] : 0;
+      end = ( k == numParts - 1 ) ? numPoints - 1 : parts[k+1] - 1;
+      area = clipPolygonArea( &cell, points, start, end, buf );
+      if ( buf->numPts < 0 ) {
+        return -1;
+      }
+      if ( buf->numPts > 0 && area != 0.0 &&
+           addCellExtent( ext, cells[i].cell, w, area ) == -1 ) {
+        return -1;
+      }
+    }
+  }
 
-  return newPoint;
+  return 1;
 }
 
 
-int inside( Cell * cell, Point * p, int side ) {
+/**********************************************************
+** Function:   areaExtents
+**
+** Purpose:    Calculate the area of each record within the cells of the
+**             final grid by clipping the record directly to the cells.
+** Algorithm:  The fragments kept by areaRefinement give the cells of the
+**             final grid that each record occupies.  The areas of the
+**             fragments can differ in the last bits from the area of the
+**             record clipped to the cell, so each record is clipped again
+**             to only those cells.  The records are visited in the same
+**             order as areaIntersection, so the extents are the same as
+**             when the grid is not refined.
+** Notes:      This function is called from findGridLevels found in grts.c.
+** Arguments:  ext,    extents that receive the (cell, record, area) triples,
+**                     where cell is the index of a cell in the grid
+**             grid,   grid for the final level
+**             frags,  fragment table for the final level
+**             shape,  shape struct for the shape file
+**             fptr,   pointer to the shape file
+**             dsgnmdID, array of record IDs which have weights
+**             dsgSize,  number of IDs in the dsgnmdID array
+**             store,    frame store holding the records of the shape file,
+**                       or NULL
+** Return:     1,   on success
+**             -1,  on error
+***********************************************************/
+int areaExtents( CellExtents * ext, Grid * grid, FragTable * frags,
+    Shape * shape, FILE * fptr, unsigned int * dsgnmdID, int dsgSize,
+    FrameStore * store ) {
+
+  int f, r, w;                  /* loop counters */
+  int n = 0;                    /* number of distinct pairs */
+  int number;                   /* record number */
+  int error = 0;                /* error indicator */
+  int * first = NULL;           /* first pair of each record */
+  unsigned int filePosition;    /* byte offset within the shape file */
+  RecordCell * cells = NULL;    /* record and cell pairs */
+  Polygon poly;                 /* temp Polygon storage */
+  ClipBuffer buf;               /* clipping buffer */
+
+  if ( frags->numFrags == 0 ) {
+    return 1;
+  }
 
-  int c = 1;
+  /* find the distinct cells of each record */
+  cells = (RecordCell *) malloc( sizeof(RecordCell) * frags->numFrags );
+  first = (int *) malloc( sizeof(int) * (dsgSize + 1) );
+  if ( cells == NULL || first == NULL ) {
+    Rprintf( "Error: Allocating memory in C function areaExtents.\n" );
+    free( cells );
+    free( first );
+    return -1;
+  }
+  for ( f = 0; f < frags->numFrags; ++f ) {
+    cells[f].dsgIdx = frags->dsgIdx[f];
+    cells[f].cell = frags->cell[f];
+  }
+  qsort( cells, frags->numFrags, sizeof(RecordCell), compareRecordCell );
+  for ( f = 0; f < frags->numFrags; ++f ) {
+    if ( n == 0 || cells[f].dsgIdx != cells[n-1].dsgIdx ||
+         cells[f].cell != cells[n-1].cell ) {
+      cells[n] = cells[f];
+      ++n;
+    }
+  }
+  for ( w = 0, f = 0; w <= dsgSize; ++w ) {
+    while ( f < n && cells[f].dsgIdx < w ) {
+      ++f;
+    }
+    first[w] = f;
+  }
 
-  switch ( side ) {
-    case LEFT: if ( p->X < cell->xMin ) {
-                 c = 0;
-               }
-               break;
+  initClipBuffer( &buf );
+
+  /* when the records are held in memory, take them from the store */
+  if ( store != NULL && store->numRecords >= 0 ) {
+    for ( r = 0; r < store->numRecords && error == 0; ++r ) {
+      w = store->dsgIdx[r];
+      if ( recordExtents( ext, grid, &(store->points[store->pointStart[r]]),
+             store->numPts[r], &(store->parts[store->partStart[r]]),
+             store->numParts[r], w, &(cells[first[w]]),
+             first[w+1] - first[w], &buf ) == -1 ) {
+        error = 1;
+      }
+    }
 
-    case RIGHT: if ( p->X > cell->xMax ) {
-                  c = 0;
-                }
-                break;
+  /* otherwise read all the records found in the file */
+  } else {
+    fseek( fptr, 100, SEEK_SET );
+    filePosition = 100;
+    while ( filePosition < shape->fileLength*2 && error == 0 ) {
+      if ( readShapeRecord( fptr, &poly, &number, &filePosition ) == -1 ) {
+        error = 1;
+        break;
+      }
 
-    case BOTTOM: if ( p->Y < cell->yMin ) {
-                   c = 0;
-                 }
-                 break;
+      /* find the dsgnmd weight array position for this record ID */
+      for ( w = 0; w < dsgSize; ++w ) {
+        if ( dsgnmdID[w] == number ) {
+          break;
+        }
+      }
+      if ( w < dsgSize && recordExtents( ext, grid, poly.points,
+             poly.numPoints, poly.parts, poly.numParts, w,
+             &(cells[first[w]]), first[w+1] - first[w], &buf ) == -1 ) {
+        error = 1;
+      }
+      free( poly.parts );
+      free( poly.points );
+    }
+  }
+  freeClipBuffer( &buf );
+  free( cells );
+  free( first );
 
-    case TOP:  if ( p->Y > cell->yMax ) {
-                 c = 0;
-               }
-               break;
+  if ( error ) {
+    Rprintf( "Error: In C function areaExtents.\n" );
+    return -1;
   }
 
-  return c;
+  return 1;
 }
 
 
-double clipPolygonArea( Cell * cell, Point * points, int start, int end ) {
-
-  int i, j;
-  int side;
-  int cou;
-  int n = (end - start);    /* number of points in polygon part */
-  Point * clippedPoly;
-  Point * tempPoly;
-  Point z;
-  double area = 0.0;
-
-  clippedPoly = (Point *) malloc( sizeof(Point) * (( 2 * n ) + 1) );
-  tempPoly = (Point *) malloc( sizeof(Point) * (( 2 * n ) + 1) );
+/**********************************************************
+** Function:   areaRecord
+**
+** Purpose:    Add the area of one polygon record within each grid cell
+**             to the cell weights.
+** Algorithm:  Follows the same algorithm that was used by areaIntersection
+**             for the dense grid, except that the record is only clipped
+**             to the cells that overlap its bounding box.  When the record
+**             has more than one part the areas of the parts are summed
+**             within each cell and the total is added only if it is
+**             positive.
+** Arguments:  celWts, sparse cell weights
+**             partWts, sparse cell weights used to sum the part areas
+**             grid,   grid for the current level
+**             points, points of the record
+**             numPoints, number of points in the record
+**             parts,  part offsets of the record
+**             numParts, number of parts in the record
+**             w,      index into the dsgnmd array for the record
+**             dsgnmd, array of weights for the records
+**             buf,    clipping buffer
+**             frags,  fragment table that receives the clipped polygon
+**                     fragments, or NULL
+** Return:     1,   on success
+**             -1,  on error
+***********************************************************/
+int areaRecord( CellWts * celWts, CellWts * partWts, Grid * grid,
+    Point * points, int numPoints, int * parts, int numParts, int w,
+    double * dsgnmd, ClipBuffer * buf, FragTable * frags ) {
+
+  int i, k;                     /* loop counters */
+  int ix, iy;                   /* grid column and row */
+  int ixLo, ixHi, iyLo, iyHi;   /* range of columns and rows to visit */
+  int idx;                      /* cell index */
+  int end;                      /* index of the last point of a part */
+  int error = 0;                /* error indicator */
+  double bxMin, bxMax, byMin, byMax;  /* bounding box of the record */
+  double area;                  /* area of the record within a cell */
+  Cell cell;                    /* temp storage for a cell */
 
-  j = 0;
-  for ( i = start; i <= end; ++i ) {
-    clippedPoly[j].X = points[i].X; 
-    clippedPoly[j].Y = points[i].Y; 
-    tempPoly[j].X = points[i].X; 
-    tempPoly[j].Y = points[i].Y; 
-    ++j;
+  if ( numPoints < 1 ) {
+    return 1;
   }
 
-  for ( side = LEFT; side <= TOP; ++side ) {
-    cou = -1;
-
-    for ( i = 0; i < n; ++i ) {
-  
-      if ( (inside(cell, &(clippedPoly[i]), side) == 0)  &&
-           (inside(cell, &(clippedPoly[i+1]), side) == 1 ) ) {
-        z = intersect( cell, &(clippedPoly[i]), &(clippedPoly[i+1]), side );
-        tempPoly[++cou].X = z.X;
-        tempPoly[cou].Y = z.Y;
-        tempPoly[++cou].X = clippedPoly[i+1].X;
-        tempPoly[cou].Y = clippedPoly[i+1].Y;
-      } else if ((inside(cell, &(clippedPoly[i]), side) == 1 ) &&
-                 (inside(cell, &(clippedPoly[i+1]), side) == 1 ) ){
-        tempPoly[++cou].X = clippedPoly[i+1].X;
-        tempPoly[cou].Y = clippedPoly[i+1].Y;
-      } else if ((inside(cell, &(clippedPoly[i]), side) == 1 ) &&
-                 (inside(cell, &(clippedPoly[i+1]), side)  == 0 ) ) {
-        z = intersect( cell, &(clippedPoly[i]), &(clippedPoly[i+1]), side );
-        tempPoly[++cou].X = z.X;
-        tempPoly[cou].Y = z.Y;
+  /* find the cells that overlap the bounding box of the record */
+  bxMin = bxMax = points[0].X;
+  byMin = byMax = points[0].Y;
+  for ( i = 1; i < numPoints; ++i ) {
+    bxMin = MIN( bxMin, points[i].X );
+    bxMax = MAX( bxMax, points[i].X );
+    byMin = MIN( byMin, points[i].Y );
+    byMax = MAX( byMax, points[i].Y );
+  }
+  cellRange( grid->colX, grid->numCols, grid->dx, bxMin, bxMax, &ixLo, &ixHi );
+  cellRange( grid->rowY, grid->numCols, grid->dy, byMin, byMax, &iyLo, &iyHi );
+
+  if ( numParts > 1 ) {
+    clearCellWts( partWts );
+
+    for ( k = 0; k < numParts && error == 0; ++k ) {
+      end = ( k == numParts - 1 ) ? numPoints - 1 : parts[k+1] - 1;
+
+      /* go through each cell and calc the area within that cell */
+      for ( iy = iyLo; iy <= iyHi; ++iy ) {
+        for ( ix = ixLo; ix <= ixHi; ++ix ) {
+          idx = iy * grid->numCols + ix;
+          cell.xMin = grid->colX[ix] - grid->dx;
+          cell.yMin = grid->rowY[iy] - grid->dy;
+          cell.xMax = grid->colX[ix];
+          cell.yMax = grid->rowY[iy];
+          area = clipAndStore( &cell, points, parts[k], end, idx, w, 1,
+                               buf, frags, &error ) * dsgnmd[w];
+          if ( area != 0.0 && addCellWt( partWts, idx, area ) == -1 ) {
+            error = 1;
+          }
+        }
       }
     }
-    tempPoly[++cou].X = tempPoly[0].X;
-    tempPoly[cou].Y = tempPoly[0].Y;
-    n = cou;
 
-    for ( i = 0; i <= n; ++i ) {
-      clippedPoly[i].X = tempPoly[i].X;
-      clippedPoly[i].Y = tempPoly[i].Y;
+    /* if the total area for all the parts is negative, don't add it */
+    compactCellWts( partWts );
+    for ( i = 0; i < partWts->numCells && error == 0; ++i ) {
+      if ( partWts->cells[i].wt > 0.0 ) {
+        if ( addCellWt( celWts, partWts->cells[i].idx, 
+                        partWts->cells[i].wt ) == -1 ) {
+          error = 1;
+        }
+      } 
     }
-  }
-
-  area = polygonArea( clippedPoly, n+1 );
-
-  free( clippedPoly );
-  free( tempPoly );
 
+  /* only one part so according to the ESRI docs it must be positive area*/
+  } else {
+    for ( iy = iyLo; iy <= iyHi && error == 0; ++iy ) {
+      for ( ix = ixLo; ix <= ixHi; ++ix ) {
+        idx = iy * grid->numCols + ix;
+        cell.xMin = grid->colX[ix] - grid->dx;
+        cell.yMin = grid->rowY[iy] - grid->dy;
+        cell.xMax = grid->colX[ix];
+        cell.yMax = grid->rowY[iy];
+        area = clipAndStore( &cell, points, 0, numPoints - 1, idx, w, 0,
+                             buf, frags, &error ) * dsgnmd[w];
+        if ( area != 0.0 && addCellWt( celWts, idx, area ) == -1 ) {
+          error = 1;
+        }
+      }
+    }
+  }
 
-  return area;
+  return error ? -1 : 1;
 }
 
 
@@ -870,14 +2010,13 @@ double clipPolygonArea( Cell * cell, Point * points, int start, int end ) {
 **             rule integration using npt^2 points that are found in the
 **             R code equivalents.  
 ** Algorithm:  Follows the same algorithm used in the R code versions.
+**             Each record is only clipped to the grid cells that overlap
+**             its bounding box.
 ** Notes:      This function is called from the numLevels function found in
 **             grts.c and is used on polygons shapefiles.
-** Arguments:  celWts, array of doubles representing the cell weights
-**             xc,     array of x coordinates
-**             yc,     array of y coordiantes
-**             dx,     amount to shift x coordinates
-**             dy,     amount to shift y coordiantes
-**             size,   length of the xc and yc arrays
+** Arguments:  celWts, sparse cell weights, which receive the weights of the
+**                     cells with nonzero weight
+**             grid,   grid for the current level
 **             shape,  shape struct that contains header info for the
 **                     shape file we are working with. It is used to store
 **                     a subset of the records at a time.
@@ -886,46 +2025,92 @@ double clipPolygonArea( Cell * cell, Point * points, int start, int end ) {
 **                       used in the calculations
 **             dsgnmd,   array of weights corresponding to the above IDs
 **             dsgSize,  number of IDs in the dsgnmdID array
+**             frags,    fragment table that receives the polygon fragments
+**                       clipped to each cell for use by areaRefinement, or
+**                       NULL if the fragments are not needed
+**             store,    frame store holding the records of the shape file,
+**                       or NULL.  When the store is loaded the records are
+**                       taken from it instead of being read from the file.
+**             blocks,   block storage for processing the records of the
+**                       store with more than one thread, or NULL
 ** Return:     1,   on success
 **             -1,  on error
 ***********************************************************/
-int areaIntersection( double ** celWts, double * xc, double * yc, double dx,
-    double dy, int size, Shape * shape, FILE * fptr, unsigned int * dsgnmdID,
-    double * dsgnmd,int dsgSize ) { 
+int areaIntersection( CellWts * celWts, Grid * grid, Shape * shape,
+    FILE * fptr, unsigned int * dsgnmdID, double * dsgnmd, int dsgSize,
+    FragTable * frags, FrameStore * store, BlockWts * blocks ) { 
 
-  int i, j, k, w;               /* loop counters */
-  int row;                      /* loop counter */
-  Cell cell;                    /* temp storage for a cell */
+  int i, w;                     /* loop counters */
   unsigned int filePosition = 100;  /* byte offset within the shape file */
   Record record;                /* temp record storage */
   unsigned char buffer[4];      /* temp buffer for reading from file */
   Polygon * poly;               /* temp Polygon storage */
   PolygonZ * polyZ;             /* temp PolygonZ storage */
   PolygonM * polyM;             /* temp PolygonM storage */
-  int partNumber = 0;           /* counts which part we are on for a given */
-                                /* record */
-  int partSize;                 /* number of points that make up a part */
-  int pidx;                     /* index into part array */
-  Point * part = NULL;          /* used for determing ring direction for */
-                                /* individual parts */
-  double * areas;
+  CellWts partWts;              /* areas of the parts of a record */
+  ClipBuffer buf;               /* clipping buffer */
+  int error = 0;                /* error indicator */
+  int r;                        /* record index in the frame store */
+  int useStore;                 /* TRUE if the records are in the store */
+  int b;                        /* slot of a block of records */
+  int first;                    /* first record of a round */
+  int numSlots;                 /* number of slots used in a round */
 
   /* initialize the shape struct */
   shape->records = NULL;
 
   /* initialize all the cell weights */
-  for ( row = 0; row < size; ++row ) {
-    (*celWts)[row] = 0.0;
-  }
+  clearCellWts( celWts );
+  initCellWts( &partWts );
+  initClipBuffer( &buf );
+
+  /* when the records are held in memory, take them from the store */
+  useStore = ( store != NULL && store->numRecords >= 0 );
+  if ( useStore && blocks == NULL ) {
+    for ( r = 0; r < store->numRecords && error == 0; ++r ) {
+      if ( areaRecord( celWts, &partWts, grid,
+             &(store->points[store->pointStart[r]]), store->numPts[r],
+             &(store->parts[store->partStart[r]]), store->numParts[r],
+             store->dsgIdx[r], dsgnmd, &buf, frags ) == -1 ) {
+        error = 1;
+      }
+    }
 
-  areas = (double *) malloc( sizeof(double) * size );
+  /* process blocks of records in parallel */
+  } else if ( useStore ) {
+    for ( first = 0; first < store->numRecords && error == 0;
+          first += blocks->numSlots * RECORD_BLOCK_SIZE ) {
+      numSlots = MIN( blocks->numSlots, (store->numRecords - first +
+                      RECORD_BLOCK_SIZE - 1) / RECORD_BLOCK_SIZE );
+#ifdef _OPENMP
+#pragma omp parallel for private(r) schedule(dynamic) \
+        num_threads(blocks->numThreads)
+#endif
+      for ( b = 0; b < numSlots; ++b ) {
+        for ( r = first + b * RECORD_BLOCK_SIZE; r < store->numRecords &&
+              r < first + (b + 1) * RECORD_BLOCK_SIZE; ++r ) {
+          if ( areaRecord( &(blocks->wts[b]), &(blocks->partWts[b]), grid,
+                 &(store->points[store->pointStart[r]]), store->numPts[r],
+                 &(store->parts[store->partStart[r]]), store->numParts[r],
+                 store->dsgIdx[r], dsgnmd, &(blocks->clip[b]),
+                 frags == NULL ? NULL : &(blocks->frags[b]) ) == -1 ) {
+            blocks->error[b] = 1;
+            break;
+          }
+        }
+      }
+      if ( mergeBlockWts( celWts, frags, NULL, blocks, numSlots ) == -1 ) {
+        error = 1;
+      }
+    }
+  }
  
   /* get to the correct spot in the shape file to read all the records */ 
   fseek( fptr, 100, SEEK_SET );
   filePosition = 100;
 
   /* read all the records found in the file */
-  while ( filePosition < shape->fileLength*2 ) {
+  while ( !useStore && filePosition < shape->fileLength*2 ) {
 
     /* ignore record number */
     fread( buffer, sizeof(char), 4, fptr );
@@ -990,113 +2175,18 @@ int areaIntersection( double ** celWts, double * xc, double * yc, double dx,
         filePosition += 8;
       } 
 
-      /* calculate areas of the parts */
-      /* if there is more than one part, check them separately */
-
-      if ( poly->numParts > 1 ) {
-        partNumber = 0;
-
-        /* find the dsgnmd weight array position for this record ID */
-        for ( w = 0; w < dsgSize; ++w ) {
-          if ( dsgnmdID[w] == record.number ) {
-            break; 
-          } 
-        }
-
-        /* zero out the areas */
-        for ( i = 0; i < size; ++i ) {
-          areas[i] = 0.0;
-        }
-
-        for ( k = 0; k < poly->numParts; ++k ) {
-          if ( part ) {
-            free( part );
-            part = NULL;
-          }
-
-          /* check to see if this is the last part */ 
-          if ( k == poly->numParts - 1 ) {
-
-            /* store part data into part array */
-            partSize = poly->numPoints - poly->parts[k];
-            if ( (part = (Point *) malloc( sizeof( Point ) * partSize )) 
-               == NULL ) {
-              Rprintf( "Error: Allocating memory in C function areaIntersection.\n" );
-              return -1;
-            }
-            pidx = 0;
-            for( j=poly->parts[k]; j < poly->numPoints; ++j ) {
-              part[pidx] = poly->points[j];
-              ++pidx; 
-            }
-
-          /* not the last part */
-          } else {
-
-            /* store part data into part array */
-            partSize = poly->parts[k+1] - poly->parts[k];
-            if ( (part = (Point *) malloc( sizeof( Point ) * partSize ))
-               == NULL ) {
-              Rprintf( "Error: Allocating memory in C function areaIntersection.\n" );
-              return -1;
-            }
-            pidx = 0;
-            for(j = poly->parts[k]; j < poly->parts[k+1]; ++j) {
-              part[pidx] = poly->points[j];
-              ++pidx; 
-            }
-
-          }
- 
-          /* go through each cell and calc the area within that cell */
-          for ( i = 0; i < size; ++i ) {
-  
-            /* form the cell's points */
-            cell.xMin = xc[i] - dx;
-            cell.yMin = yc[i] - dy;
-            cell.xMax = xc[i];
-            cell.yMax = yc[i];
-            if ( w < dsgSize ) {
-              areas[i] += clipPolygonArea(&cell,part,0,partSize-1) * dsgnmd[w];
-            }
-          }
-          ++partNumber;
-        }  
-
-        /* if the total area for all the parts is negative, don't add it */
-        for ( i = 0; i < size; ++i ) {
-          if ( areas[i] > 0.0 ) {
-            (*celWts)[i] += areas[i];
-          } 
-        }
-
-        if ( part ) {
-          free( part );
-          part = NULL;
-        }
-
-      /* only one part so according to the ESRI docs it must be positive area*/
-      } else {
-
-        /* find the dsgnmd weight array position for this record ID */
-        for ( w = 0; w < dsgSize; ++w ) {
-          if ( dsgnmdID[w] == record.number ) {
-            break; 
-          } 
-        }
-
-        for ( i = 0; i < size; ++i ) {
+      /* find the dsgnmd weight array position for this record ID */
+      for ( w = 0; w < dsgSize; ++w ) {
+        if ( dsgnmdID[w] == record.number ) {
+          break; 
+        } 
+      }
 
-          /* form the cell's points */
-          cell.xMin = xc[i] - dx;
-          cell.yMin = yc[i] - dy;
-          cell.xMax = xc[i];
-          cell.yMax = yc[i];
-          if ( w < dsgSize ) {
-            (*celWts)[i] +=clipPolygonArea(&cell,poly->points,0,poly->numPoints-
-            1) * dsgnmd[w];
-          }
-        }
+      /* calculate the areas of the record within the cells */
+      if ( w < dsgSize && areaRecord( celWts, &partWts, grid,
+           poly->points, poly->numPoints, poly->parts, poly->numParts,
+           w, dsgnmd, &buf, frags ) == -1 ) {
+        error = 1;
       }
       free( poly->parts );
       free( poly->points );
@@ -1187,115 +2277,18 @@ int areaIntersection( double ** celWts, double * xc, double * yc, double dx,
         filePosition += 8;
       } 
 
-      /* calculate areas of the parts */
-      /* if there is more than one part, check them separately */
-
-      if ( polyZ->numParts > 1 ) {
-        partNumber = 0;
-
-        /* find the dsgnmd weight array position for this record ID */
-        for ( w = 0; w < dsgSize; ++w ) {
-          if ( dsgnmdID[w] == record.number ) {
-            break; 
-          } 
-        }
-
-        /* zero out the areas */
-        for ( i = 0; i < size; ++i ) {
-          areas[i] = 0.0;
-        }
-
-        for ( k = 0; k < polyZ->numParts; ++k ) {
-          if ( part ) {
-            free( part );
-            part = NULL;
-          }
-
-          /* check to see if this is the last part */ 
-          if ( k == polyZ->numParts - 1 ) {
-
-            /* store part data into part array */
-            partSize = polyZ->numPoints - polyZ->parts[k];
-            if ( (part = (Point *) malloc( sizeof( Point ) * partSize )) 
-               == NULL ) {
-              Rprintf( "Error: Allocating memory in C function areaIntersection.\n" );
-              return -1;
-            }
-            pidx = 0;
-            for( j=polyZ->parts[k]; j < polyZ->numPoints; ++j ) {
-              part[pidx] = polyZ->points[j];
-              ++pidx; 
-            }
-
-          /* not the last part */
-          } else {
-
-            /* store part data into part array */
-            partSize = polyZ->parts[k+1] - polyZ->parts[k];
-            if ( (part = (Point *) malloc( sizeof( Point ) * partSize ))
-               == NULL ) {
-              Rprintf( "Error: Allocating memory in C function areaIntersection.\n" );
-              return -1;
-            }
-            pidx = 0;
-            for(j = polyZ->parts[k]; j < polyZ->parts[k+1]; ++j) {
-              part[pidx] = polyZ->points[j];
-              ++pidx; 
-            }
-
-          }
- 
-          /* go through each cell and calc the area within that cell */
-          for ( i = 0; i < size; ++i ) {
-  
-            /* form the cell's points */
-            cell.xMin = xc[i] - dx;
-            cell.yMin = yc[i] - dy;
-            cell.xMax = xc[i];
-            cell.yMax = yc[i];
-
-             if ( w < dsgSize ) {
-              areas[i] += clipPolygonArea(&cell,part,0,partSize-1) * dsgnmd[w];
-            }
-          }
-          ++partNumber;
-        }  
-
-        /* if the total area for all the parts is negative, don't add it */
-        for ( i = 0; i < size; ++i ) {
-          if ( areas[i] > 0.0 ) {
-            (*celWts)[i] += areas[i];
-          } 
-        }
-
-        if ( part ) {
-          free( part );
-          part = NULL;
-        }
-
-      /* only one part so according to the ESRI docs it must be positive area*/
-      } else {
-
-        /* find the dsgnmd weight array position for this record ID */
-        for ( w = 0; w < dsgSize; ++w ) {
-          if ( dsgnmdID[w] == record.number ) {
-            break; 
-          } 
-        }
-
-        for ( i = 0; i < size; ++i ) {
-
-          /* form the cell's points */
-          cell.xMin = xc[i] - dx;
-          cell.yMin = yc[i] - dy;
-          cell.xMax = xc[i];
-          cell.yMax = yc[i];
+      /* find the dsgnmd weight array position for this record ID */
+      for ( w = 0; w < dsgSize; ++w ) {
+        if ( dsgnmdID[w] == record.number ) {
+          break; 
+        } 
+      }
 
-          if ( w < dsgSize ) {
-            (*celWts)[i] +=clipPolygonArea(&cell,polyZ->points,0,
-            polyZ->numPoints-1) * dsgnmd[w];
-          }
-        }
+      /* calculate the areas of the record within the cells */
+      if ( w < dsgSize && areaRecord( celWts, &partWts, grid,
+           polyZ->points, polyZ->numPoints, polyZ->parts, polyZ->numParts,
+           w, dsgnmd, &buf, frags ) == -1 ) {
+        error = 1;
       }
       free( polyZ->parts );
       free( polyZ->points );
@@ -1369,115 +2362,18 @@ int areaIntersection( double ** celWts, double * xc, double * yc, double dx,
         filePosition += 8;
       } 
 
-      /* calculate areas of the parts */
-      /* if there is more than one part, check them separately */
-
-      if ( polyM->numParts > 1 ) {
-        partNumber = 0;
-
-        /* find the dsgnmd weight array position for this record ID */
-        for ( w = 0; w < dsgSize; ++w ) {
-          if ( dsgnmdID[w] == record.number ) {
-            break; 
-          } 
-        }
-
-        /* zero out the areas */
-        for ( i = 0; i < size; ++i ) {
-          areas[i] = 0.0;
-        }
-
-        for ( k = 0; k < polyM->numParts; ++k ) {
-          if ( part ) {
-            free( part );
-            part = NULL;
-          }
-
-          /* check to see if this is the last part */ 
-          if ( k == polyM->numParts - 1 ) {
-
-            /* store part data into part array */
-            partSize = polyM->numPoints - polyM->parts[k];
-            if ( (part = (Point *) malloc( sizeof( Point ) * partSize )) 
-               == NULL ) {
-              Rprintf( "Error: Allocating memory in C function areaIntersection.\n" );
-              return -1;
-            }
-            pidx = 0;
-            for( j=polyM->parts[k]; j < polyM->numPoints; ++j ) {
-              part[pidx] = polyM->points[j];
-              ++pidx; 
-            }
-
-          /* not the last part */
-          } else {
-
-            /* store part data into part array */
-            partSize = polyM->parts[k+1] - polyM->parts[k];
-            if ( (part = (Point *) malloc( sizeof( Point ) * partSize ))
-               == NULL ) {
-              Rprintf( "Error: Allocating memory in C function areaIntersection.\n" );
-              return -1;
-            }
-            pidx = 0;
-            for(j = polyM->parts[k]; j < polyM->parts[k+1]; ++j) {
-              part[pidx] = polyM->points[j];
-              ++pidx; 
-            }
-
-          }
- 
-          /* go through each cell and calc the area within that cell */
-          for ( i = 0; i < size; ++i ) {
-  
-            /* form the cell's points */
-            cell.xMin = xc[i] - dx;
-            cell.yMin = yc[i] - dy;
-            cell.xMax = xc[i];
-            cell.yMax = yc[i];
-
-             if ( w < dsgSize ) {
-              areas[i] += clipPolygonArea(&cell,part,0,partSize-1) * dsgnmd[w];
-            }
-          }
-          ++partNumber;
-        }  
-
-        /* if the total area for all the parts is negative, don't add it */
-        for ( i = 0; i < size; ++i ) {
-          if ( areas[i] > 0.0 ) {
-            (*celWts)[i] += areas[i];
-          } 
-        }
-
-        if ( part ) {
-          free( part );
-          part = NULL;
-        }
-
-      /* only one part so according to the ESRI docs it must be positive area*/
-      } else {
-
-        /* find the dsgnmd weight array position for this record ID */
-        for ( w = 0; w < dsgSize; ++w ) {
-          if ( dsgnmdID[w] == record.number ) {
-            break; 
-          } 
-        }
-
-        for ( i = 0; i < size; ++i ) {
-
-          /* form the cell's points */
-          cell.xMin = xc[i] - dx;
-          cell.yMin = yc[i] - dy;
-          cell.xMax = xc[i];
-          cell.yMax = yc[i];
+      /* find the dsgnmd weight array position for this record ID */
+      for ( w = 0; w < dsgSize; ++w ) {
+        if ( dsgnmdID[w] == record.number ) {
+          break; 
+        } 
+      }
 
-          if ( w < dsgSize ) {
-            (*celWts)[i] +=clipPolygonArea(&cell,polyM->points,0,
-            polyM->numPoints-1) * dsgnmd[w];
-          }
-        }
+      /* calculate the areas of the record within the cells */
+      if ( w < dsgSize && areaRecord( celWts, &partWts, grid,
+           polyM->points, polyM->numPoints, polyM->parts, polyM->numParts,
+           w, dsgnmd, &buf, frags ) == -1 ) {
+        error = 1;
       }
       free( polyM->parts );
       free( polyM->points );
@@ -1487,7 +2383,19 @@ int areaIntersection( double ** celWts, double * xc, double * yc, double dx,
 
   }
 
-  free( areas );
+  freeCellWts( &partWts );
+  freeClipBuffer( &buf );
+  if ( error ) {
+    Rprintf( "Error: Allocating memory in C function areaIntersection.\n" );
+    return -1;
+  }
+  compactCellWts( celWts );
+
+  /* keep the fragments in cells with positive weight for refinement */
+  if ( frags ) {
+    pruneFragments( frags, celWts );
+  }
+
   return 1;
 }
 
@@ -1752,8 +2660,9 @@ SEXP pointInPolygonFile( SEXP fileNamePrefix, SEXP xcsVec, SEXP ycsVec,
 **             ycsVec vectors are inside or outside the polygon represented 
 **             by the sent polyXVec and polyYVec coordinate arrays.
 ** Algorithm:  This function converts the sent R vectors to the necessary
-**             C arrays and then iterates through each point calling the 
-**             insidePolygon() function to determine if the point is inside
+**             C arrays, prepares the polygon with preparePolygon(), and
+**             then iterates through each point calling the 
+**             insidePrepared() function to determine if the point is inside
 **             or outside the sent polygon.  As each point is checked the
 **             result (1 or 0) is written to the matrix array.
 ** Notes:      The matrix array will be the same size as the xcs and ycs
@@ -1774,6 +2683,7 @@ SEXP pointInPolygonObj(SEXP ptXVec, SEXP ptYVec, SEXP polyXVec, SEXP polyYVec) {
   unsigned int ptVecSize = length( ptXVec );  /* number of points */
   SEXP results = NULL;    /* R object used to return the "matrix" back to R */
   Polygon poly;           /* used to store the sent polygon coordinates */
+  PreparedPolygon prep;   /* polygon prepared for testing the points */
 
   /* copy the sent polygon coordinates into a polygon struct */
   poly.numPoints = length( polyXVec );
@@ -1800,13 +2710,25 @@ SEXP pointInPolygonObj(SEXP ptXVec, SEXP ptYVec, SEXP polyXVec, SEXP polyYVec) {
     matrix[i] = 0.0;
   }
 
+  /* prepare the polygon for testing all of the points */
+  initPreparedPolygon( &prep );
+  if ( preparePolygon( &prep, poly.points, poly.numPoints, NULL, 1 ) == -1 ) {
+    Rprintf( "Error: Allocating memory in C function pointInPolygonObj.\n" );
+    freePreparedPolygon( &prep );
+    free( matrix );
+    free( poly.points );
+    PROTECT( results = allocVector( VECSXP, 1 ) );
+    UNPROTECT( 1 ); 
+    return results;  
+  }
+
   /* build the pt in polygon matrix */
   for ( i = 0; i < ptVecSize; ++i ) {
-    if( insidePolygon( poly.points, poly.numPoints , REAL( ptXVec )[i], 
-                                                   REAL( ptYVec )[i] ) == 1 ){
+    if( insidePrepared( &prep, REAL( ptXVec )[i], REAL( ptYVec )[i] ) == 1 ){
       matrix[i] = 1.0;
     }
   }
+  freePreparedPolygon( &prep );
 
   /* convert the matrix into an R object */
   PROTECT( results = allocVector( REALSXP, ptVecSize ) );
@@ -13,6 +13,7 @@
 **  Revised:      May 5, 2015
 **  Revised:      June 15, 2015
 **  Revised:      August 10, 2017
+**  Revised:      October 19, 2026
 ******************************************************************************/
 
 #include <stdio.h>
@@ -25,6 +26,9 @@
 #include "shapeParser.h"
 #include "grts.h"
 
+#define MIN(x,y) (x < y ? x : y)
+#define MAX(x,y) (x > y ? x : y)
+
 #define BOTTOM  1
 #define TOP     2
 #define LEFT    4
@@ -36,6 +40,16 @@ extern unsigned int readLittleEndian( unsigned char * buffer, int length );
 extern unsigned int readBigEndian( unsigned char * buffer, int length );
 
 /* these functions are found in grts.c */
+extern void clearCellWts( CellWts * celWts );
+extern void compactCellWts( CellWts * celWts );
+extern int addCellWt( CellWts * celWts, int idx, double wt );
+extern int addCellExtent( CellExtents * ext, int cell, unsigned int id,
+                          double extent );
+extern int mergeBlockWts( CellWts * celWts, FragTable * frags,
+                          CellExtents * ext, BlockWts * blocks,
+                          int numSlots );
+extern void cellRange( double * edges, int numCols, double width, double min,
+                       double max, int * first, int * last );
 extern int combineShpFiles( FILE * newShp, unsigned int * ids, int numIDs );
 extern int createNewTempShpFile( FILE * newShp, char * shapeFileName, 
 		                       unsigned int * ids, int numIDs );
@@ -82,6 +96,180 @@ void deallocateSegments( Segment * head ) {
 }
 
 
+/**********************************************************
+** Function:   initSegmentTable
+**
+** Purpose:    Initialize an empty segment table.
+** Arguments:  table, segment table to initialize
+** Return:     void
+***********************************************************/
+void initSegmentTable( SegmentTable * table ) {
+
+  table->numSegs = 0;
+  table->maxSegs = 0;
+  table->segs = NULL;
+  table->cumLen = NULL;
+
+  return;
+}
+
+
+/**********************************************************
+** Function:   freeSegmentTable
+**
+** Purpose:    Free the memory used by a segment table and reset it to
+**             an empty table.
+** Arguments:  table, segment table to free
+** Return:     void
+***********************************************************/
+void freeSegmentTable( SegmentTable * table ) {
+
+  free( table->segs );
+  free( table->cumLen );
+  initSegmentTable( table );
+
+  return;
+}
+
+
+/**********************************************************
+** Function:   nextSegment
+**
+** Purpose:    Returns the slot for the next segment in a segment table,
+**             growing the table when it is full.
+** Notes:      The slot is only added to the table when numSegs is
+**             incremented, so it may be filled in and then discarded.
+** Arguments:  table, segment table
+** Return:     pointer to the slot for the next segment, or NULL on error
+***********************************************************/
+Segment * nextSegment( SegmentTable * table ) {
+
+  int newSize;        /* new allocated length */
+  void * ptr;         /* temp pointer for reallocated memory */
+
+  if ( table->numSegs == table->maxSegs ) {
+    newSize = table->maxSegs > 0 ? 2 * table->maxSegs : 64;
+    if ( (ptr = realloc( table->segs, sizeof(Segment) * newSize )) == NULL ) {
+      return NULL;
+    }
+    table->segs = (Segment *) ptr;
+    if ( (ptr = realloc( table->cumLen, sizeof(double) * newSize )) == NULL ) {
+      return NULL;
+    }
+    table->cumLen = (double *) ptr;
+    table->maxSegs = newSize;
+  }
+
+  return &(table->segs[table->numSegs]);
+}
+
+
+/**********************************************************
+** Function:   sumSegments
+**
+** Purpose:    Reverse the order of the segments in a segment table and
+**             calculate the cumulative sum of their lengths.
+** Notes:      Positions were located by walking a linked list that the
+**             segments were pushed onto, so the lengths are summed from
+**             the last segment that was added to the first, in the same
+**             order, and the same positions select the same points.
+** Arguments:  table, segment table
+** Return:     the total length of the segments
+***********************************************************/
+double sumSegments( SegmentTable * table ) {
+
+  int i, j;           /* loop counters */
+  double cumSum;      /* cumulative sum of the lengths */
+  Segment seg;        /* temp storage for swapping segments */
+
+  for ( i = 0, j = table->numSegs - 1; i < j; ++i, --j ) {
+    seg = table->segs[i];
+    table->segs[i] = table->segs[j];
+    table->segs[j] = seg;
+  }
+  cumSum = 0.0;
+  for ( i = 0; i < table->numSegs; ++i ) {
+    cumSum += table->segs[i].length;
+    table->cumLen[i] = cumSum;
+  }
+
+  return cumSum;
+}
+
+
+/**********************************************************
+** Function:   findSegment
+**
+** Purpose:    Find the segment in a segment table that contains a
+**             position along the segments.
+** Algorithm:  A binary search finds the first segment whose cumulative
+**             length is greater than the position, which is the segment
+**             where a walk through the segments would stop.
+** Notes:      sumSegments must be called before this function.  When the
+**             position is not less than the total length, the last
+**             segment is returned.
+** Arguments:  table, segment table
+**             pos,   position along the segments
+** Return:     index of the segment, or -1 if the table is empty
+***********************************************************/
+int findSegment( SegmentTable * table, double pos ) {
+
+  int lo = 0;                     /* first candidate segment */
+  int hi = table->numSegs - 1;    /* last candidate segment */
+  int mid;                        /* middle candidate segment */
+
+  if ( table->numSegs == 0 ) {
+    return -1;
+  }
+  while ( lo < hi ) {
+    mid = lo + (hi - lo) / 2;
+    if ( pos < table->cumLen[mid] ) {
+      hi = mid;
+    } else {
+      lo = mid + 1;
+    }
+  }
+
+  return lo;
+}
+
+
+/**********************************************************
+** Function:   segmentPoint
+**
+** Purpose:    Calculate the coordinates of the point that is the sent
+**             distance from the first end point of a segment.
+** Notes:      The distance is the difference between a position and the
+**             cumulative length of the segment, which is not positive,
+**             and its magnitude is measured from the first end point
+**             toward the second end point.
+** Arguments:  seg,  segment
+**             len,  distance along the segment
+**             x,    x coordinate of the point
+**             y,    y coordinate of the point
+** Return:     void
+***********************************************************/
+void segmentPoint( Segment * seg, double len, double * x, double * y ) {
+
+  double dx, dy;      /* differences between the end points */
+  double lx, ly;      /* offsets from the first end point */
+
+  dx = seg->p2.X - seg->p1.X;
+  dy = seg->p2.Y - seg->p1.Y;
+  if ( dx != 0 ) {
+    lx = sign(dx) * sqrt( (len*len) / ( 1 + (dy*dy)/(dx*dx) ) );
+    ly = lx * (dy/dx);
+  } else {
+    lx = 0.0;
+    ly = -sign(dy) * len;
+  }
+  *x = seg->p1.X + lx;
+  *y = seg->p1.Y + ly;
+
+  return;
+}
+
+
 /**********************************************************
 ** Function:   compOutCode
 **
@@ -199,6 +387,91 @@ double lineLength( double x1, double y1, double x2, double y2, Cell * cell,
 }
 
 
+/**********************************************************
+** Function:   lineRecord
+**
+** Purpose:    Add the length of the segments of one polyline record
+**             within each grid cell to the cell weights.
+** Algorithm:  Each segment is only clipped to the grid cells that
+**             overlap its bounding box.  Lengths are added to the sparse
+**             cell weights in the same order as they were added to the
+**             dense array of cell weights, so the weights are the same.
+**             When ext is not NULL, the unweighted length of each segment
+**             within each cell is also appended to ext as a (cell index,
+**             w, length) triple.
+** Arguments:  celWts, sparse cell weights
+**             grid,   grid for the current level
+**             points, points of the record
+**             numPoints, number of points in the record
+**             parts,  part offsets of the record
+**             numParts, number of parts in the record
+**             w,      index into the dsgnmd array for the record
+**             dsgnmd, array of weights for the records
+**             ext,    triples that receive the clipped segment lengths, or
+**                     NULL
+** Return:     1,  on success
+**             -1, on error
+***********************************************************/
+int lineRecord( CellWts * celWts, Grid * grid, Point * points, int numPoints,
+                int * parts, int numParts, int w, double * dsgnmd,
+                CellExtents * ext ) {
+
+  int i;                        /* loop counter */
+  int ix, iy;                   /* grid column and row */
+  int ixLo, ixHi, iyLo, iyHi;   /* range of columns and rows to visit */
+  int partIndx;                 /* index into polyline parts array */
+  double seg;                   /* length of a segment within a cell */
+  double len;                   /* weighted length of the segment */
+  Cell cell;                    /* temp storage for a cell */
+
+  /* go through each segment in this record */
+  partIndx = 1; 
+  for ( i = 0; i < numPoints-1; ++i ) {
+
+    /* if there are multiple parts, assume the parts are not connected */
+    if ( numParts > 1 && partIndx < numParts ) {
+      if ( (i + 1) == parts[partIndx] ) {
+        ++partIndx;
+        continue;
+      }
+    }
+
+    /* check the segment in each cell that overlaps it */
+    cellRange( grid->colX, grid->numCols, grid->dx,
+               MIN( points[i].X, points[i+1].X ),
+               MAX( points[i].X, points[i+1].X ), &ixLo, &ixHi );
+    cellRange( grid->rowY, grid->numCols, grid->dy,
+               MIN( points[i].Y, points[i+1].Y ),
+               MAX( points[i].Y, points[i+1].Y ), &iyLo, &iyHi );
+    for ( iy = iyLo; iy <= iyHi; ++iy ) {
+      for ( ix = ixLo; ix <= ixHi; ++ix ) {
+
+        /* form the cell's points */
+        cell.xMin = grid->colX[ix] - grid->dx;
+        cell.yMin = grid->rowY[iy] - grid->dy;
+        cell.xMax = grid->colX[ix];
+        cell.yMax = grid->rowY[iy];
+
+        /* add the length of the segment that is in the cell */
+        seg = lineLength( points[i].X, points[i].Y, points[i+1].X, 
+                          points[i+1].Y, &cell, NULL );
+        len = seg * dsgnmd[w];
+        if ( len != 0.0 && 
+             addCellWt( celWts, iy * grid->numCols + ix, len ) == -1 ) {
+          return -1;
+        }
+        if ( ext != NULL && seg != 0.0 &&
+             addCellExtent( ext, iy * grid->numCols + ix, w, seg ) == -1 ) {
+          return -1;
+        }
+      }
+    }
+  }
+
+  return 1;
+}
+
+
 /**********************************************************
 ** Function:   lintFcn
 **
@@ -209,12 +482,9 @@ double lineLength( double x1, double y1, double x2, double y2, Cell * cell,
 **             used to determine the cell weights.
 ** Algorithm:  The function reads one record at a time from the sent shape
 **             file and processes it to save on memory.
-** Arguments:  celWts,   array of doubles representing the cell weights
-**             xc,       array of x coordinates
-**             yc,       array of y coordiantes
-**             dx,       amount to shift x coordinates
-**             dy,       amount to shift y coordiantes
-**             size,     length of the xc and yc arrays
+** Arguments:  celWts,   sparse cell weights, which receive the weights of
+**                       the cells with nonzero weight
+**             grid,     grid for the current level
 **             shape,    shape struct that contains header info for the
 **                       shape file we are working with. It is used to store
 **                       a subset of the records at a time.
@@ -223,30 +493,89 @@ double lineLength( double x1, double y1, double x2, double y2, Cell * cell,
 **                       used in the calculations
 **             dsgnmd,   array of weights corresponding to the above IDs
 **             dsgSize,  number of IDs in the dsgnmdID array
+**             store,    frame store holding the records of the shape file,
+**                       or NULL.  When the store is loaded the records are
+**                       taken from it instead of being read from the file.
+**             blocks,   block storage for processing the records of the
+**                       store with more than one thread, or NULL
+**             ext,      triples that receive the unweighted length of each
+**                       record within each cell as (cell index, index into
+**                       dsgnmd, length) triples, one for each clipped
+**                       segment, or NULL.  The triples of previous calls
+**                       are discarded.
 ** Return:     1,  on success
 **             -1, on error
 ***********************************************************/
-int lintFcn ( double ** celWts, double * xc, double * yc, double dx, double dy,
-              int size, Shape * shape, FILE * fptr, unsigned int * dsgnmdID,
-              double * dsgnmd, int dsgSize ) { 
+int lintFcn ( CellWts * celWts, Grid * grid, Shape * shape, FILE * fptr,
+              unsigned int * dsgnmdID, double * dsgnmd, int dsgSize,
+              FrameStore * store, BlockWts * blocks, CellExtents * ext ) { 
 
   int i, w;                     /* loop counter */
-  int row;                      /* loop counter */
-  int partIndx;                 /* index into polyline parts array */
-  Cell cell;                    /* temp storage for a cell */
   unsigned int filePosition;    /* byte offset within the shape file */
   Record record;                /* temp record storage */
   unsigned char buffer[4];      /* temp buffer for reading from file */
   Polygon * poly;               /* temp Polygon storage */
   PolygonZ * polyZ;             /* temp PolygonZ storage */
   PolygonM * polyM;             /* temp PolygonM storage */
+  int r;                        /* record index in the frame store */
+  int b;                        /* slot of a block of records */
+  int first;                    /* first record of a round */
+  int numSlots;                 /* number of slots used in a round */
+  int error = 0;                /* error indicator */
 
   /* initialize the shape struct */
   shape->records = NULL;
 
   /* initialize all the cell weights */
-  for ( row = 0; row < size; ++row ) {
-    (*celWts)[row] = 0.0;
+  clearCellWts( celWts );
+  if ( ext != NULL ) {
+    ext->numItems = 0;
+  }
+
+  /* when the records are held in memory, take them from the store */
+  /* process blocks of records in parallel */
+  if ( store != NULL && store->numRecords >= 0 && blocks != NULL ) {
+    for ( first = 0; first < store->numRecords;
+          first += blocks->numSlots * RECORD_BLOCK_SIZE ) {
+      numSlots = MIN( blocks->numSlots, (store->numRecords - first +
+                      RECORD_BLOCK_SIZE - 1) / RECORD_BLOCK_SIZE );
+#ifdef _OPENMP
+#pragma omp parallel for private(r) schedule(dynamic) \
+        num_threads(blocks->numThreads)
+#endif
+      for ( b = 0; b < numSlots; ++b ) {
+        for ( r = first + b * RECORD_BLOCK_SIZE; r < store->numRecords &&
+              r < first + (b + 1) * RECORD_BLOCK_SIZE; ++r ) {
+          if ( lineRecord( &(blocks->wts[b]), grid,
+                 &(store->points[store->pointStart[r]]), store->numPts[r],
+                 &(store->parts[store->partStart[r]]), store->numParts[r],
+                 store->dsgIdx[r], dsgnmd,
+                 ext != NULL ? &(blocks->ext[b]) : NULL ) == -1 ) {
+            blocks->error[b] = 1;
+            break;
+          }
+        }
+      }
+      if ( mergeBlockWts( celWts, NULL, ext, blocks, numSlots ) == -1 ) {
+        Rprintf( "Error: Allocating memory in C function lintFcn.\n" );
+        return -1;
+      }
+    }
+    compactCellWts( celWts );
+    return 1;
+  }
+
+  if ( store != NULL && store->numRecords >= 0 ) {
+    for ( r = 0; r < store->numRecords; ++r ) {
+      if ( lineRecord( celWts, grid, &(store->points[store->pointStart[r]]),
+             store->numPts[r], &(store->parts[store->partStart[r]]),
+             store->numParts[r], store->dsgIdx[r], dsgnmd, ext ) == -1 ) {
+        Rprintf( "Error: Allocating memory in C function lintFcn.\n" );
+        return -1;
+      }
+    }
+    compactCellWts( celWts );
+    return 1;
   }
  
   /* get to the correct spot in the shape file to read in all the records */ 
@@ -495,123 +824,34 @@ int lintFcn ( double ** celWts, double * xc, double * yc, double dx, double dy,
         break; 
       } 
     }
-           
-    if ( shape->shapeType == POLYLINE ) {
-
-      /* go through each segment in this record */
-      partIndx = 1; 
-      for ( i = 0; i < record.poly->numPoints-1; ++i ) {
-
-        /* if there are multiple parts, assume the parts are not connected */
-        if ( record.poly->numParts > 1 && partIndx < record.poly->numParts ) {
-          if ( (i + 1) == record.poly->parts[partIndx] ) {
-            ++partIndx;
-            continue;
-          }
-        }
-
-        /* check each segment in each cell */
-        for ( row = 0; row < size; ++row ) {
-
-          /* form the cell's points */
-          cell.xMin = xc[row] - dx;
-          cell.yMin = yc[row] - dy;
-          cell.xMax = xc[row];
-          cell.yMax = yc[row];
 
-          /* add the lenght of the segment that is in the cell */
-          if ( w >= dsgSize ) {
-            (*celWts)[row] += 0;
-          } else {
-            (*celWts)[row] += lineLength(record.poly->points[i].X, 
-                                         record.poly->points[i].Y, 
-                                         record.poly->points[i+1].X, 
-                                         record.poly->points[i+1].Y,
-                                         &cell, NULL) * dsgnmd[w];
-          }
-        }
+    /* add the lengths of the record's segments within the cells */
+    if ( shape->shapeType == POLYLINE ) {
+      if ( w < dsgSize && lineRecord( celWts, grid, record.poly->points,
+           record.poly->numPoints, record.poly->parts, record.poly->numParts,
+           w, dsgnmd, ext ) == -1 ) {
+        error = 1;
       }
-
       free( record.poly->parts );
       free( record.poly->points );
       free( record.poly );
 
     } else if ( shape->shapeType == POLYLINE_Z ) {
-
-      /* go through each segment in this record */
-      partIndx = 1; 
-      for ( i = 0; i < record.polyZ->numPoints-1; ++i ) {
-
-        /* if there are multiple parts, assume the parts are not connected */
-        if ( record.polyZ->numParts > 1 && partIndx < record.polyZ->numParts ) {
-          if ( (i + 1) == record.polyZ->parts[partIndx] ) {
-            ++partIndx;
-            continue;
-          }
-        }
-
-        /* check each segment in each cell */
-        for ( row = 0; row < size; ++row ) {
-
-          /* form the cell's points */
-          cell.xMin = xc[row] - dx;
-          cell.yMin = yc[row] - dy;
-          cell.xMax = xc[row];
-          cell.yMax = yc[row];
-
-          /* add the length of the segment that is in the cell */
-          if ( w >= dsgSize ) {
-            (*celWts)[row] += 0;
-          } else {
-            (*celWts)[row] += lineLength(record.polyZ->points[i].X, 
-                                         record.polyZ->points[i].Y, 
-                                         record.polyZ->points[i+1].X, 
-                                         record.polyZ->points[i+1].Y,
-                                         &cell, NULL) * dsgnmd[w];
-          }
-        }
+      if ( w < dsgSize && lineRecord( celWts, grid, record.polyZ->points,
+           record.polyZ->numPoints, record.polyZ->parts,
+           record.polyZ->numParts, w, dsgnmd, ext ) == -1 ) {
+        error = 1;
       }
-
       free( record.polyZ->parts );
       free( record.polyZ->points );
       free( record.polyZ );
 
     } else {
-
-      /* go through each segment in this record */
-      partIndx = 1; 
-      for ( i = 0; i < record.polyM->numPoints-1; ++i ) {
-
-        /* if there are multiple parts, assume the parts are not connected */
-        if ( record.polyM->numParts > 1 && partIndx < record.polyM->numParts ) {
-          if ( (i + 1) == record.polyM->parts[partIndx] ) {
-            ++partIndx;
-            continue;
-          }
-        }
-
-        /* check each segment in each cell */
-        for ( row = 0; row < size; ++row ) {
-
-          /* form the cell's points */
-          cell.xMin = xc[row] - dx;
-          cell.yMin = yc[row] - dy;
-          cell.xMax = xc[row];
-          cell.yMax = yc[row];
-
-          /* add the length of the segment that is in the cell */
-          if ( w >= dsgSize ) {
-            (*celWts)[row] += 0;
-          } else {
-            (*celWts)[row] += lineLength(record.polyM->points[i].X, 
-                                         record.polyM->points[i].Y, 
-                                         record.polyM->points[i+1].X, 
-                                         record.polyM->points[i+1].Y,
-                                         &cell, NULL) * dsgnmd[w];
-          }
-        }
+      if ( w < dsgSize && lineRecord( celWts, grid, record.polyM->points,
+           record.polyM->numPoints, record.polyM->parts,
+           record.polyM->numParts, w, dsgnmd, ext ) == -1 ) {
+        error = 1;
       }
-
       free( record.polyM->parts );
       free( record.polyM->points );
       free( record.polyM );
@@ -620,6 +860,12 @@ int lintFcn ( double ** celWts, double * xc, double * yc, double dx, double dy,
 
   }
 
+  if ( error ) {
+    Rprintf( "Error: Allocating memory in C function lintFcn.\n" );
+    return -1;
+  }
+  compactCellWts( celWts );
+
   return 1;
 }
 
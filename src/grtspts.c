@@ -4,12 +4,18 @@
 **  Purpose:     This file contains the function cWtFcn() which is used to 
 **               calculate the weights for the sent array of weights for 
 **               dealing with a points shape type.  It is called from the 
-**               numLevels() function found in grts.c.
+**               numLevels() function found in grts.c.  The file also
+**               contains the numLevelsPoints() function, which determines
+**               the number of levels for a finite resource whose points are
+**               held in memory, and the selectCellPoints() function, which
+**               selects the points in the grid cells chosen for a finite
+**               resource.
 **  Programmers: Christian Platt, Tom Kincaid
 **  Created:     October 27, 2004
 **  Revised:     May 10, 2006
 **  Revised:     July 16, 2014
 **  Revised:     June 15, 2015
+**  Revised:     October 19, 2026
 ******************************************************************************/
 
 #include <stdio.h>
@@ -18,7 +24,10 @@
 #include <math.h>
 #include <R.h>
 #include <Rdefines.h>
+#include <Rmath.h>
+#include <Rversion.h>
 #include "shapeParser.h"
+#include "grts.h"
 
 #define MIN(x,y) (x < y ? x : y)
 #define MAX(x,y) (x > y ? x : y)
@@ -27,16 +36,78 @@
 extern unsigned int readLittleEndian( unsigned char * buffer, int length );
 extern unsigned int readBigEndian( unsigned char * buffer, int length );
 
-/* struct for storing a cell's coordinates */
-typedef struct cellStruct Cell;
-struct cellStruct {
-  double xMin;
-  double yMin;
-  double xMax;
-  double yMax;
+/* found in grts.c */
+extern int any( CellWts * celWts, double sint, int value );
+extern double maxWt( CellWts * celWts, double size );
+extern void initCellWts( CellWts * celWts );
+extern void freeCellWts( CellWts * celWts );
+extern void clearCellWts( CellWts * celWts );
+extern void compactCellWts( CellWts * celWts );
+extern int compareCellWt( const void * a, const void * b );
+extern int addCellWt( CellWts * celWts, int idx, double wt );
+extern int mergeBlockWts( CellWts * celWts, FragTable * frags,
+                          CellExtents * ext, BlockWts * blocks,
+                          int numSlots );
+extern void cellRange( double * edges, int numCols, double width, double min,
+                       double max, int * first, int * last );
+
+/* struct used to find a grid cell from its column and row */
+typedef struct cellKeyStruct CellKey;
+struct cellKeyStruct {
+  long long key;     /* row times the number of columns plus column */
+  int cell;          /* position of the cell in the list of cells */
 };
 
 
+/**********************************************************
+** Function:   pointRecord
+**
+** Purpose:    Add the weight of one point to the grid cells that
+**             contain it.
+** Algorithm:  The cell containing the point is found from its coordinates
+**             and the neighboring cells are also checked using the same
+**             test that was used for every cell of the dense grid, so that
+**             a point on a cell edge is counted exactly as before.
+** Arguments:  celWts, sparse cell weights
+**             grid,   grid for the current level
+**             point,  the point
+**             wt,     weight of the point
+** Return:     1,  on success
+**             -1, on error
+***********************************************************/
+int pointRecord( CellWts * celWts, Grid * grid, Point * point, double wt ) {
+
+  int ix, iy;                   /* grid column and row */
+  int ixLo, ixHi, iyLo, iyHi;   /* range of columns and rows to visit */
+  Cell cell;                    /* temp storage for cell coordinates */
+
+  cellRange( grid->colX, grid->numCols, grid->dx, point->X, point->X, &ixLo,
+             &ixHi );
+  cellRange( grid->rowY, grid->numCols, grid->dy, point->Y, point->Y, &iyLo,
+             &iyHi );
+  for ( iy = iyLo; iy <= iyHi; ++iy ) {
+    for ( ix = ixLo; ix <= ixHi; ++ix ) {
+      cell.xMin = grid->colX[ix] - grid->dx;
+      cell.yMin = grid->rowY[iy] - grid->dy;
+      cell.xMax = grid->colX[ix];
+      cell.yMax = grid->rowY[iy];
+
+      /* see if the point is inside the cell */
+      if ( (cell.xMin < point->X) && (point->X <= cell.xMax) &&
+           (cell.yMin < point->Y) && (point->Y <= cell.yMax) ) {
+
+        /* it's inside the cell so add the dsgnmd weight */
+        if ( addCellWt( celWts, iy * grid->numCols + ix, wt ) == -1 ) {
+          return -1;
+        }
+      }
+    }
+  }
+
+  return 1;
+}
+
+
 /**********************************************************
 ** Function:   cWtFcn
 **
@@ -46,12 +117,9 @@ struct cellStruct {
 **             found in grts.c
 ** Notes:      To conserve memory, one record is read from the shape
 **             file and processed at a time.
-** Arguments:  celWts,   array of doubles representing the cell weights
-**             xc,       array of x coordinates
-**             yc,       array of y coordiantes
-**             dx,       amount to shift x coordinates
-**             dy,       amount to shift y coordiantes
-**             size,     length of the xc and yc arrays
+** Arguments:  celWts,   sparse cell weights, which receive the weights of
+**                       the cells with nonzero weight
+**             grid,     grid for the current level
 **             shape,    shape struct that contains header info for the
 **                       shape file we are working with. It is used to store
 **                       a subset of the records at a time.
@@ -60,14 +128,18 @@ struct cellStruct {
 **                       used in the calculations
 **             dsgnmd,   array of weights corresponding to the above IDs
 **             dsgSize,  number of IDs in the dsgnmdID array
+**             store,    frame store holding the records of the shape file,
+**                       or NULL.  When the store is loaded the points are
+**                       taken from it instead of being read from the file.
+**             blocks,   block storage for processing the points of the
+**                       store with more than one thread, or NULL
 ** Return:     1,  on success
 **             -1, on error
 ***********************************************************/
-int cWtFcn( double ** celWts, double * xc, double * yc, double dx, double dy, 
-                       int size , Shape * shape, FILE * fptr,
-                       unsigned int * dsgnmdID, double * dsgnmd, int dsgSize ){
-  int i, w;                         /* loop counters */
-  Cell cell;                        /* temp storage for cell coordinates */
+int cWtFcn( CellWts * celWts, Grid * grid, Shape * shape, FILE * fptr,
+            unsigned int * dsgnmdID, double * dsgnmd, int dsgSize,
+            FrameStore * store, BlockWts * blocks ){
+  int w;                            /* loop counter */
   unsigned int filePosition = 100;  /* byte offset into .shp file */
   Record record;                    /* temp storage for record info */
   unsigned char buffer[4];          /* buffer for reading from file */
@@ -76,11 +148,56 @@ int cWtFcn( double ** celWts, double * xc, double * yc, double dx, double dy,
   PointZ pointZ;                    /* temp storage for a PointZ */
   PointM pointM;                    /* temp storage for a PointM */
   int tempID = -1;                  /* temp ID of record we are looking at */
+  int r;                            /* record index in the frame store */
+  int b;                            /* slot of a block of points */
+  int first;                        /* first point of a round */
+  int numSlots;                     /* number of slots used in a round */
 
 
   /* initialize all the celWts to 0 */
-  for ( i = 0; i < size; ++i ) {
-    (*celWts)[i] = 0.0;
+  clearCellWts( celWts );
+
+  /* when the points are held in memory, take them from the store */
+  /* process blocks of points in parallel */
+  if ( store != NULL && store->numRecords >= 0 && blocks != NULL ) {
+    for ( first = 0; first < store->numRecords;
+          first += blocks->numSlots * RECORD_BLOCK_SIZE ) {
+      numSlots = MIN( blocks->numSlots, (store->numRecords - first +
+                      RECORD_BLOCK_SIZE - 1) / RECORD_BLOCK_SIZE );
+#ifdef _OPENMP
+#pragma omp parallel for private(r) schedule(dynamic) \
+        num_threads(blocks->numThreads)
+#endif
+      for ( b = 0; b < numSlots; ++b ) {
+        for ( r = first + b * RECORD_BLOCK_SIZE; r < store->numRecords &&
+              r < first + (b + 1) * RECORD_BLOCK_SIZE; ++r ) {
+          if ( pointRecord( &(blocks->wts[b]), grid,
+                 &(store->points[store->pointStart[r]]),
+                 dsgnmd[store->dsgIdx[r]] ) == -1 ) {
+            blocks->error[b] = 1;
+            break;
+          }
+        }
+      }
+      if ( mergeBlockWts( celWts, NULL, NULL, blocks, numSlots ) == -1 ) {
+        Rprintf( "Error: Allocating memory in C function cWtFcn.\n" );
+        return -1;
+      }
+    }
+    compactCellWts( celWts );
+    return 1;
+  }
+
+  if ( store != NULL && store->numRecords >= 0 ) {
+    for ( r = 0; r < store->numRecords; ++r ) {
+      if ( pointRecord( celWts, grid, &(store->points[store->pointStart[r]]),
+                        dsgnmd[store->dsgIdx[r]] ) == -1 ) {
+        Rprintf( "Error: Allocating memory in C function cWtFcn.\n" );
+        return -1;
+      }
+    }
+    compactCellWts( celWts );
+    return 1;
   }
 
   /* make sure we are back to the beignning of the records in the file */
@@ -146,6 +263,15 @@ int cWtFcn( double ** celWts, double * xc, double * yc, double dx, double dy,
 
     }
 
+    /* use the same storage for each point type */
+    if ( shape->shapeType == POINTS_Z ) {
+      point.X = pointZ.X;
+      point.Y = pointZ.Y;
+    } else if ( shape->shapeType == POINTS_M ) {
+      point.X = pointM.X;
+      point.Y = pointM.Y;
+    }
+
     /* make sure the record number is in the dsgnmdID array */
     tempID = -1;
     for ( w = 0; w < dsgSize; ++w ) {
@@ -157,47 +283,935 @@ int cWtFcn( double ** celWts, double * xc, double * yc, double dx, double dy,
 
     /* if the record number was in dsgnmd then process this record */
     if ( tempID != -1 ) {
+      if ( pointRecord( celWts, grid, &point, dsgnmd[w] ) == -1 ) {
+        Rprintf( "Error: Allocating memory in C function cWtFcn.\n" );
+        return -1;
+      }
+    }
+  }
+  compactCellWts( celWts );
+  
+  return 1;
+}
 
-      /* look in each cell for the point */
-      for ( i = 0; i < size; ++i ) {
-        cell.xMin = xc[i] - dx;
-        cell.yMin = yc[i] - dy;
-        cell.xMax = xc[i];
-        cell.yMax = yc[i];
 
-        if ( shape->shapeType == POINTS ) {
+/**********************************************************
+** Function:   seqLength
+**
+** Purpose:    Fill an array with evenly spaced values in the same way as
+**             the R expression seq(min, max, length=length).
+** Notes:      Each interior value is min plus a multiple of the spacing
+**             and the last value is max, rather than a running sum of the
+**             spacing, so the values are the same as those that R
+**             computes.
+** Arguments:  seqVec, array of length values to fill
+**             min,    first value
+**             max,    last value
+**             length, number of values
+** Return:     none
+***********************************************************/
+void seqLength( double * seqVec, double min, double max, int length ) {
 
-          /* see if the point is inside the cell */
-          if(tempID != -1 && (cell.xMin < point.X) && (point.X <= cell.xMax) &&
-               (cell.yMin < point.Y) && (point.Y <= cell.yMax) ) {
+  int i;
+  double by = (max - min) / (double) ( length - 1 );
 
-            /* it's inside the cell so add the dsgnmd weight */
-            (*celWts)[i] += dsgnmd[w];
-          }
+  seqVec[0] = min;
+  for ( i = 1; i < length - 1; ++i ) {
+    seqVec[i] = min + i * by;
+  }
+  if ( length > 1 ) {
+    seqVec[length - 1] = max;
+  }
+
+  return;
+}
+
+
+/**********************************************************
+** Function:   sumPointWts
+**
+** Purpose:    Merge the weights that points added to a set of sparse
+**             cell weights so that there is one entry for each cell, in
+**             order of cell index.
+** Notes:      The weights of each cell are summed in the order the points
+**             were added using long double precision, which is how the R
+**             sum function summed the mdm values of the points in a cell.
+**             The weights must have been added with merging turned off.
+**             Cells whose weight is zero are removed.
+** Arguments:  celWts, sparse cell weights
+** Return:     none
+***********************************************************/
+void sumPointWts( CellWts * celWts ) {
 
-        } else if ( shape->shapeType == POINTS_Z ) {
+  int i, j;           /* loop counters */
+  int n = 0;          /* number of merged entries */
+  long double total;  /* weight for a cell */
+  CellWt * cells = celWts->cells;
 
-          /* see if the point is inside the cell */
-          if(tempID != -1 && (cell.xMin < pointZ.X) && (pointZ.X <= cell.xMax) &&
-               (cell.yMin < pointZ.Y) && (pointZ.Y <= cell.yMax) ) {
+  qsort( cells, celWts->numCells, sizeof(CellWt), compareCellWt );
+  for ( i = 0; i < celWts->numCells; i = j ) {
+    total = 0.0;
+    for ( j = i; j < celWts->numCells && cells[j].idx == cells[i].idx; ++j ) {
+      total += cells[j].wt;
+    }
+    if ( (double) total != 0.0 ) {
+      cells[n].idx = cells[i].idx;
+      cells[n].seq = cells[i].seq;
+      cells[n].wt = (double) total;
+      ++n;
+    }
+  }
+  celWts->numCells = n;
+  celWts->numMerged = n;
+
+  return;
+}
 
-            /* it's inside the cell so add the dsgnmd weight */
-            (*celWts)[i] += dsgnmd[w];
+
+/**********************************************************
+** Function:   numLevelsPoints
+**
+** Purpose:    This function does the "Determine the number of levels for
+**             hierarchical randomization" part of the grtspts function
+**             when the points of the frame are held in memory rather than
+**             read from a shapefile.
+** Algorithm:  It is a port of the level search that grtspts did in R.  At
+**             each level every point adds its mdm value to the sparse
+**             weights of the cells that contain it, so the work for a
+**             level is proportional to the number of points rather than
+**             to the number of cells times the number of points.  The grid
+**             coordinates, the cell weights, the sampling interval, and
+**             the increment for the number of levels are computed with
+**             the same arithmetic as the R code, so the results are the
+**             same as before.
+** Notes:      The grid extent is determined from all of the points.  The
+**             coordinates and mdm values must be finite.
+** Arguments:  xVec,         vector of the x coordinates of the points
+**             yVec,         vector of the y coordinates of the points
+**             mdmVec,       vector of the mdm values of the points
+**             nsmpVec,      number of points to select in the sample
+**             shiftGridVec, flag signalling whether to do random shift of
+**                           grid,  1 shift, 0 don't shift
+**             startLevVec,  starting value to use for the number of levels
+**                           of the grid.
+**             maxLevVec,    maximum value to use for the number of levels
+**                           of the grid.
+** Return:     results, an R object containing the same values as the
+**                      results of numLevels and warn, which is TRUE when
+**                      the search stopped because the maximum cell
+**                      weight was not changing.  If an error occurs
+**                      results will return set to NULL
+***********************************************************/
+SEXP numLevelsPoints( SEXP xVec, SEXP yVec, SEXP mdmVec, SEXP nsmpVec,
+                      SEXP shiftGridVec, SEXP startLevVec, SEXP maxLevVec ) {
+
+  int i;                    /* loop counter */
+  int numPts = length( xVec );  /* number of points */
+  int valid = TRUE;         /* FALSE if a point is not finite */
+  int maxlev;
+  int error = FALSE;        /* TRUE if an error occured */
+  int warn = FALSE;         /* TRUE if celMax stopped the search */
+
+  /* vars for calculating the cell weights, names taken from R version */
+  int nlev = 0;
+  int nlv2;
+  double dx = 0.0;
+  double dy = 0.0;
+  double sint;
+  double roffX = 0.0;
+  double roffY = 0.0;
+  Grid grid;                /* grid for the current level */
+  CellWts celWts;           /* sparse cell weights */
+  double gridSize = 0.0;    /* number of cells in the grid */
+  int numCells;             /* number of cells with positive weight */
+  int j;                    /* index of a cell in the results */
+  double celMax = 0.0;      /* maximum cell total inclusion probability */
+  int celMaxInd = 0;        /* indicator for whether celMax is unchanged */
+  int inc;                  /* amount to increase nlev by for each round */
+  double lev;               /* level increment for a cell */
+  long double total;        /* sum of the cell weights */
+  Point point;              /* temp storage for a point */
+
+  /* C versions of sent vars */
+  int nsmp;
+  int shiftGrid = 0;
+  double * ptsX;
+  double * ptsY;
+  double * mdm;
+
+  /* point maxs, mins, and extents */
+  double gridXMin = R_PosInf;
+  double gridYMin = R_PosInf;
+  double gridXMax = R_NegInf;
+  double gridYMax = R_NegInf;
+  double gridExtent;
+
+  /* vars for converting results into an R object */
+  SEXP nlevVec, dxVec, dyVec, xcVec, ycVec, celWtsVec, sintVec, celIdxVec;
+  SEXP warnVec, colNamesVec;
+  SEXP results = NULL;    /* R object for returning final results to R */
+
+  /* copy incoming R arguments to C variables */
+  PROTECT( xVec = AS_NUMERIC( xVec ) );
+  PROTECT( yVec = AS_NUMERIC( yVec ) );
+  PROTECT( mdmVec = AS_NUMERIC( mdmVec ) );
+  ptsX = REAL( xVec );
+  ptsY = REAL( yVec );
+  mdm = REAL( mdmVec );
+  PROTECT( nsmpVec = AS_INTEGER( nsmpVec ) );
+  nsmp = INTEGER( nsmpVec )[0];
+  PROTECT( shiftGridVec = AS_INTEGER( shiftGridVec ) );
+  shiftGrid = INTEGER( shiftGridVec )[0];
+  PROTECT( maxLevVec = AS_INTEGER( maxLevVec ) );
+  maxlev = INTEGER( maxLevVec )[0];
+  if ( startLevVec != R_NilValue ) {
+    PROTECT( startLevVec = AS_INTEGER( startLevVec ) );
+    nlev = INTEGER( startLevVec )[0];
+  } else {
+    PROTECT( startLevVec );
+    nlev = ceil( log(nsmp)/log(4) );
+    if ( nlev == 0 ) {
+    	 nlev = 1;
+    }
+  }
+
+  /* get the min and max for x and y and determine grid extent */
+  if ( length( yVec ) != numPts || length( mdmVec ) != numPts ) {
+    valid = FALSE;
+  }
+  for ( i = 0; i < numPts && valid == TRUE; ++i ) {
+    if ( R_FINITE( ptsX[i] ) && R_FINITE( ptsY[i] ) && R_FINITE( mdm[i] ) ) {
+      gridXMin = MIN( gridXMin, ptsX[i] );
+      gridYMin = MIN( gridYMin, ptsY[i] );
+      gridXMax = MAX( gridXMax, ptsX[i] );
+      gridYMax = MAX( gridYMax, ptsY[i] );
+    } else {
+      valid = FALSE;
+    }
+  }
+  if ( numPts == 0 || valid == FALSE || nsmp < 1 ) {
+    Rprintf( "Error: Invalid points in C function numLevelsPoints.\n" );
+    PROTECT( results = allocVector( VECSXP, 1 ) );
+    UNPROTECT(8);
+    return results;
+  }
+  gridExtent = MAX( (gridXMax - gridXMin), (gridYMax - gridYMin) );
+  gridXMin = gridXMin - 0.04 * gridExtent;
+  gridYMin = gridYMin - 0.04 * gridExtent;
+  gridExtent = 1.08 * gridExtent;
+  gridXMax = gridXMin + gridExtent;
+  gridYMax = gridYMin + gridExtent;
+
+  /* the weights of the points are merged by sumPointWts */
+  initCellWts( &celWts );
+  celWts.merge = 0;
+  grid.numCols = 0;
+  grid.colX = NULL;
+  grid.rowY = NULL;
+
+  /* set the initial cell weights */
+  if ( addCellWt( &celWts, 0, 99999.0 ) == -1 ) {
+    Rprintf( "Error: Allocating memory in C function numLevelsPoints.\n" );
+    PROTECT( results = allocVector( VECSXP, 1 ) );
+    UNPROTECT(8);
+    return results;
+  }
+  gridSize = 1.0;
+
+  /* input the RNG state */
+  GetRNGstate();
+
+  /* start algorithm */
+  sint = 1.0;
+  if ( shiftGrid == 1 ) {
+    roffX = runif( 0.0, 1.0 );
+    roffY = runif( 0.0, 1.0 );
+  }
+  while ( any( &celWts, sint, 1 ) && 
+        ( celMaxInd < 2 ) &&
+        ( nlev <= maxlev ) ) {
+    Rprintf( "Current number of levels: %i \n", nlev );
+    celMax = maxWt( &celWts, gridSize );
+    nlv2 = pow( 2, nlev );
+    dx = gridExtent / nlv2;
+    dy = gridExtent / nlv2;
+
+    /* allocate memory for the column and row edges of the grid */
+    free( grid.colX );
+    free( grid.rowY );
+    grid.colX = (double *) malloc( sizeof(double) * (nlv2+1) );
+    grid.rowY = (double *) malloc( sizeof(double) * (nlv2+1) );
+    if ( grid.colX == NULL || grid.rowY == NULL ) {
+      Rprintf( "Error: Allocating memory in C function numLevelsPoints.\n" );
+      error = TRUE;
+      break;
+    }
+    grid.numCols = nlv2 + 1;
+    grid.dx = dx;
+    grid.dy = dy;
+    gridSize = (double) (nlv2+1) * (double) (nlv2+1);
+
+    /* as necessary, do the random shift of the grid */
+    seqLength( grid.colX, gridXMin, gridXMax, nlv2+1 );
+    seqLength( grid.rowY, gridYMin, gridYMax, nlv2+1 );
+    if ( shiftGrid == 1 ) {
+      for ( i = 0; i <= nlv2; ++i ) {
+        grid.colX[i] = grid.colX[i] + roffX*dx;
+        grid.rowY[i] = grid.rowY[i] + roffY*dy;
+      }
+    }
+
+    /* add the weight of each point to the cells that contain it */
+    clearCellWts( &celWts );
+    for ( i = 0; i < numPts; ++i ) {
+      point.X = ptsX[i];
+      point.Y = ptsY[i];
+      if ( pointRecord( &celWts, &grid, &point, mdm[i] ) == -1 ) {
+        Rprintf( "Error: Allocating memory in C function numLevelsPoints.\n" );
+        error = TRUE;
+        break;
+      }
+    }
+    if ( error == TRUE ) {
+      break;
+    }
+    sumPointWts( &celWts );
+    total = 0.0;
+    for ( i = 0; i < celWts.numCells; ++i ) {
+      total += celWts.cells[i].wt;
+    }
+    sint = (double) total / nsmp;
+
+    /* as, necessary, increment celMaxInd, and signal the warning that */
+    /* grtspts gives when celMaxInd reaches 2 */
+    if ( maxWt( &celWts, gridSize ) == celMax ) {
+    	 ++celMaxInd;
+    	 if ( celMaxInd == 2 ) {
+    	   warn = TRUE;
+      }
+    }
+
+    /* determine the increment for nlev */
+    inc = 1;
+    if ( nlev != maxlev ) {
+      for ( i = 0; i < celWts.numCells; ++i ) {
+        if ( celWts.cells[i].wt > 0 ) {
+          lev = ceil( log( celWts.cells[i].wt/sint )/log(4) );
+          if ( lev > inc ) {
+            inc = (int) lev;
           }
+        }
+      }
+    }
+    nlev = nlev + inc;
+  }
+
+  /* output the RNG state */
+  PutRNGstate();
+
+  if ( error == TRUE || grid.colX == NULL ) {
+    if ( grid.colX == NULL && error == FALSE ) {
+      Rprintf( "Error: Invalid number of levels in C function numLevelsPoints.\n" );
+    }
+    freeCellWts( &celWts );
+    free( grid.colX );
+    free( grid.rowY );
+    PROTECT( results = allocVector( VECSXP, 1 ) );
+    UNPROTECT(8);
+    return results;
+  }
+  Rprintf( "Final number of levels: %i \n", nlev-1 );
+
+  /* count the cells with positive weight */
+  numCells = 0;
+  for ( i = 0; i < celWts.numCells; ++i ) {
+    if ( celWts.cells[i].wt > 0.0 ) {
+      ++numCells;
+    }
+  }
+
+  /* write final results to the R objects */
+  PROTECT( results = allocVector( VECSXP, 9 ) );
+  PROTECT( nlevVec = allocVector( INTSXP, 1 ) );
+  INTEGER( nlevVec )[0] = nlev;
+  PROTECT( dxVec = allocVector( REALSXP, 1 ) );
+  REAL( dxVec )[0] = dx;
+  PROTECT( dyVec = allocVector( REALSXP, 1 ) );
+  REAL( dyVec )[0] = dy;
+  PROTECT( xcVec = allocVector( REALSXP, numCells ) );
+  PROTECT( ycVec = allocVector( REALSXP, numCells ) );
+  PROTECT( celWtsVec = allocVector( REALSXP, numCells ) );
+  PROTECT( celIdxVec = allocVector( INTSXP, numCells ) );
+  j = 0;
+  for ( i = 0; i < celWts.numCells; ++i ) {
+    if ( celWts.cells[i].wt > 0.0 ) {
+      REAL( xcVec )[j] = grid.colX[celWts.cells[i].idx % grid.numCols];
+      REAL( ycVec )[j] = grid.rowY[celWts.cells[i].idx / grid.numCols];
+      REAL( celWtsVec )[j] = celWts.cells[i].wt;
+      INTEGER( celIdxVec )[j] = celWts.cells[i].idx;
+      ++j;
+    }
+  }
+  PROTECT( sintVec = allocVector( REALSXP, 1 ) );
+  REAL( sintVec )[0] = sint;
+  PROTECT( warnVec = allocVector( LGLSXP, 1 ) );
+  LOGICAL( warnVec )[0] = warn;
+
+  /* copy each data vector into the final results vector */  
+  SET_VECTOR_ELT( results, 0, nlevVec); 
+  SET_VECTOR_ELT( results, 1, dxVec ); 
+  SET_VECTOR_ELT( results, 2, dyVec ); 
+  SET_VECTOR_ELT( results, 3, xcVec ); 
+  SET_VECTOR_ELT( results, 4, ycVec ); 
+  SET_VECTOR_ELT( results, 5, celWtsVec ); 
+  SET_VECTOR_ELT( results, 6, sintVec ); 
+  SET_VECTOR_ELT( results, 7, celIdxVec ); 
+  SET_VECTOR_ELT( results, 8, warnVec );
+
+  /* create vector labels */
+  PROTECT( colNamesVec = allocVector( STRSXP, 9 ) );
+  SET_STRING_ELT( colNamesVec, 0, mkChar( "nlev" ) );
+  SET_STRING_ELT( colNamesVec, 1, mkChar( "dx" ) );
+  SET_STRING_ELT( colNamesVec, 2, mkChar( "dy" ) );
+  SET_STRING_ELT( colNamesVec, 3, mkChar( "xc" ) );
+  SET_STRING_ELT( colNamesVec, 4, mkChar( "yc" ) );
+  SET_STRING_ELT( colNamesVec, 5, mkChar( "cel.wt" ) );
+  SET_STRING_ELT( colNamesVec, 6, mkChar( "sint" ) );
+  SET_STRING_ELT( colNamesVec, 7, mkChar( "cel.idx" ) );
+  SET_STRING_ELT( colNamesVec, 8, mkChar( "warn" ) );
+  setAttrib( results, R_NamesSymbol, colNamesVec );
+
+  /* clean up */
+  freeCellWts( &celWts );
+  free( grid.colX );
+  free( grid.rowY );
+  UNPROTECT(18);
+
+  return results;
+}
+
+
+/**********************************************************
+** Function:   compareCellKey
+**
+** Purpose:    qsort comparison function that orders CellKey structs by
+**             key and then by cell.
+***********************************************************/
+int compareCellKey( const void * a, const void * b ) {
+
+  const CellKey * pa = (const CellKey *) a;
+  const CellKey * pb = (const CellKey *) b;
+
+  if ( pa->key != pb->key ) {
+    return pa->key < pb->key ? -1 : 1;
+  }
+  if ( pa->cell != pb->cell ) {
+    return pa->cell < pb->cell ? -1 : 1;
+  }
+  return 0;
+}
+
+
+/**********************************************************
+** Function:   findCellKey
+**
+** Purpose:    Find the first entry for a key in a sorted array of CellKey
+**             structs.
+** Arguments:  keys,     array of keys sorted by compareCellKey
+**             numKeys,  number of entries in the array
+**             key,      key to find
+** Return:     index of the first entry that is not less than key, which
+**             is numKeys if there is no such entry
+***********************************************************/
+int findCellKey( CellKey * keys, int numKeys, long long key ) {
+
+  int lo = 0;
+  int hi = numKeys;
+  int mid;
+
+  while ( lo < hi ) {
+    mid = lo + (hi - lo) / 2;
+    if ( keys[mid].key < key ) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+
+  return lo;
+}
+
+
+/**********************************************************
+** Function:   unifIndex
+**
+** Purpose:    Return a random integer from 0 to n - 1 in the same way as
+**             the R sample function.
+** Notes:      R_unif_index, which follows the sample.kind setting of
+**             RNGkind, is available from R 3.4.0.  Earlier versions of
+**             sample truncated n times a uniform random number.
+** Arguments:  n,  number of integers to choose from
+** Return:     the random integer
+***********************************************************/
+int unifIndex( int n ) {
+
+#if defined(R_VERSION) && R_VERSION >= R_Version(3, 4, 0)
+  return (int) R_unif_index( (double) n );
+#else
+  return (int) ( n * unif_rand() );
+#endif
+}
+
 
-        } else {
+/**********************************************************
+** Function:   probSampleNoReplace
+**
+** Purpose:    Select a sample without replacement with probability
+**             proportional to a vector of weights.
+** Algorithm:  This is the FixupProb and ProbSampleNoReplace code that the
+**             R sample function uses for a sample without replacement with
+**             a prob argument, so the same random numbers select the same
+**             sample as sample.
+** Arguments:  p,     vector of weights, which is overwritten
+**             perm,  vector of the identities of the weights, which is
+**                    overwritten
+**             n,     length of p and perm
+**             nans,  sample size
+**             ans,   vector of length nans that receives the identities
+**                    of the selected weights in the order they were
+**                    selected
+**             fcnName, name of the calling C function, which is used in
+**                    error messages
+** Return:     0 if the sample was selected, or -1 if the weights are not
+**             valid, in which case an error message is printed
+***********************************************************/
+int probSampleNoReplace( double * p, int * perm, int n, int nans,
+                         int * ans, const char * fcnName ) {
 
-          /* see if the point is inside the cell */
-          if(tempID != -1 && (cell.xMin < pointM.X) && (pointM.X <= cell.xMax) &&
-               (cell.yMin < pointM.Y) && (pointM.Y <= cell.yMax) ) {
+  int i, j, k, n1;
+  int npos = 0;
+  double sum = 0.0;
+  double rT, mass, totalmass;
 
-            /* it's inside the cell so add the dsgnmd weight */
-            (*celWts)[i] += dsgnmd[w];
+  /* check and normalize the weights */
+  for ( i = 0; i < n; ++i ) {
+    if ( !R_FINITE( p[i] ) ) {
+      Rprintf( "Error: NA in probability vector in C function %s.\n",
+               fcnName );
+      return -1;
+    }
+    if ( p[i] < 0.0 ) {
+      Rprintf( "Error: Negative probability in C function %s.\n",
+               fcnName );
+      return -1;
+    }
+    if ( p[i] > 0.0 ) {
+      ++npos;
+      sum += p[i];
+    }
+  }
+  if ( npos == 0 || nans > npos ) {
+    Rprintf( "Error: Too few positive probabilities in C function %s.\n",
+             fcnName );
+    return -1;
+  }
+  for ( i = 0; i < n; ++i ) {
+    p[i] /= sum;
+  }
+
+  /* sort the weights into descending order */
+  revsort( p, perm, n );
+
+  /* select the sample */
+  totalmass = 1;
+  for ( i = 0, n1 = n - 1; i < nans; ++i, --n1 ) {
+    rT = totalmass * unif_rand();
+    mass = 0;
+    for ( j = 0; j < n1; ++j ) {
+      mass += p[j];
+      if ( rT <= mass ) {
+        break;
+      }
+    }
+    ans[i] = perm[j];
+    totalmass -= p[j];
+    for ( k = j; k < n1; ++k ) {
+      p[k] = p[k + 1];
+      perm[k] = perm[k + 1];
+    }
+  }
+
+  return 0;
+}
+
+
+/**********************************************************
+** Function:   selectCellPoints
+**
+** Purpose:    Select the sample points for a finite resource from the grid
+**             cells that were chosen for the sample, or order all of the
+**             points in the frame by the order of the cells.
+** Algorithm:  Each cell is given a column and row from the position of its
+**             upper right corner.  Each point is given the column and row
+**             of the cell that contains it, and the cells in the
+**             neighboring columns and rows are checked using the same test
+**             as the previous R code, so that a point on a cell edge is
+**             placed in the same cells as before.  The points are then
+**             counting sorted by cell, keeping the order of the frame
+**             within each cell.  When a cell contains more points than are
+**             to be selected from it, the points are selected without
+**             replacement with probability proportional to mdm, and the
+**             points of a whole cell are put in a random order, using the
+**             same random numbers in the same order as the sample calls in
+**             the previous R code, so a given seed selects the same
+**             sample.
+** Arguments:  cellVec,   vector of the index values of the cells, which
+**                        may repeat a cell once for each sample point that
+**                        is selected from it
+**             xcVec,     vector of the x coordinates of the cells
+**             ycVec,     vector of the y coordinates of the cells
+**             dxVal,     width of the cells
+**             dyVal,     height of the cells
+**             ptsXVec,   vector of the x coordinates of the points
+**             ptsYVec,   vector of the y coordinates of the points
+**             ptsMdmVec, vector of the mdm values of the points
+**             allVal,    TRUE to select all of the points in each cell in
+**                        a random order, which is used for the whole frame
+** Return:     results, an R object containing point, the indices of the
+**                      selected points in the order they were selected,
+**                      and short, the index values of the cells that
+**                      contain fewer points than are to be selected from
+**                      them.  If an error occurs, a list whose single
+**                      element is NULL is returned.
+***********************************************************/
+SEXP selectCellPoints( SEXP cellVec, SEXP xcVec, SEXP ycVec, SEXP dxVal,
+                       SEXP dyVal, SEXP ptsXVec, SEXP ptsYVec,
+                       SEXP ptsMdmVec, SEXP allVal ) {
+
+  int i, j, k;                  /* loop counters */
+  int numCells = length( xcVec );      /* number of cells */
+  int numReq = length( cellVec );      /* number of requested cells */
+  int numPts = length( ptsXVec );      /* number of points */
+  int numUnique = 0;            /* number of distinct requested cells */
+  int all = FALSE;              /* TRUE to select all of the points */
+  int c;                        /* cell index */
+  int col, row;                 /* column and row of a cell or a point */
+  int dc, dr;                   /* offsets to the neighboring cells */
+  int pass;                     /* counting or filling pass */
+  int first;                    /* first key of a column and row */
+  int nsel;                     /* number of points selected from a cell */
+  int size;                     /* number of points in a cell */
+  int numSel = 0;               /* number of selected points */
+  int numShort = 0;             /* number of cells with too few points */
+  long long numCols;            /* number of columns used for the keys */
+  long long key;                /* key of a column and row */
+  double dx, dy;                /* width and height of the cells */
+  double x0, y0;                /* lower left corner of the grid */
+  double x, y;                  /* coordinates of a point */
+  double xMax, yMax;            /* upper right corner of a cell */
+  double * xc;                  /* x coordinates of the cells */
+  double * yc;                  /* y coordinates of the cells */
+  double * ptsX;                /* x coordinates of the points */
+  double * ptsY;                /* y coordinates of the points */
+  double * mdm = NULL;          /* mdm values of the points */
+  int * cells;                  /* requested cells */
+  int * slot = NULL;            /* position of each cell in the distinct */
+                                /* requested cells, or -1 */
+  int * uniq = NULL;            /* distinct requested cells */
+  int * want = NULL;            /* number of points to select from each */
+  int * start = NULL;           /* first entry of each cell in members */
+  int * fill = NULL;            /* next entry to fill for each cell */
+  int * members = NULL;         /* points in each cell */
+  CellKey * keys = NULL;        /* sorted keys of the requested cells */
+  double * prob = NULL;         /* mdm values of the points in a cell */
+  int * perm = NULL;            /* positions of the points in a cell */
+  int * pick = NULL;            /* positions of the selected points */
+  int * sel;                    /* selected points */
+  int * shortCells;             /* cells with too few points */
+
+  /* R objects for returning results to R */
+  SEXP selVec, shortVec, colNamesVec;
+  SEXP results = NULL;
+
+  /* copy the sent values into C variables */
+  PROTECT( cellVec = AS_INTEGER( cellVec ) );
+  PROTECT( xcVec = AS_NUMERIC( xcVec ) );
+  PROTECT( ycVec = AS_NUMERIC( ycVec ) );
+  PROTECT( ptsXVec = AS_NUMERIC( ptsXVec ) );
+  PROTECT( ptsYVec = AS_NUMERIC( ptsYVec ) );
+  cells = INTEGER( cellVec );
+  xc = REAL( xcVec );
+  yc = REAL( ycVec );
+  ptsX = REAL( ptsXVec );
+  ptsY = REAL( ptsYVec );
+  dx = REAL( dxVal )[0];
+  dy = REAL( dyVal )[0];
+  if ( allVal != R_NilValue ) {
+    all = LOGICAL( allVal )[0] == TRUE;
+  }
+  if ( all == FALSE ) {
+    PROTECT( ptsMdmVec = AS_NUMERIC( ptsMdmVec ) );
+    mdm = REAL( ptsMdmVec );
+  } else {
+    PROTECT( ptsMdmVec );
+  }
+
+  /* allocate the arrays for the requested cells */
+  slot = (int *) malloc( sizeof(int) * (numCells + 1) );
+  uniq = (int *) malloc( sizeof(int) * (numReq + 1) );
+  want = (int *) malloc( sizeof(int) * (numReq + 1) );
+  start = (int *) malloc( sizeof(int) * (numReq + 2) );
+  fill = (int *) malloc( sizeof(int) * (numReq + 1) );
+  keys = (CellKey *) malloc( sizeof(CellKey) * (numReq + 1) );
+  if ( slot == NULL || uniq == NULL || want == NULL || start == NULL ||
+       fill == NULL || keys == NULL || dx <= 0.0 || dy <= 0.0 ) {
+    if ( dx <= 0.0 || dy <= 0.0 ) {
+      Rprintf( "Error: Invalid cell size in C function selectCellPoints.\n" );
+    } else {
+      Rprintf( "Error: Allocating memory in C function selectCellPoints.\n" );
+    }
+    free( slot );
+    free( uniq );
+    free( want );
+    free( start );
+    free( fill );
+    free( keys );
+    PROTECT( results = allocVector( VECSXP, 1 ) );
+    UNPROTECT(7);
+    return results;
+  }
+
+  /* find the distinct requested cells in order of first appearance and */
+  /* the number of points to select from each */
+  for ( c = 0; c < numCells; ++c ) {
+    slot[c] = -1;
+  }
+  for ( i = 0; i < numReq; ++i ) {
+    c = cells[i] - 1;
+    if ( c < 0 || c >= numCells ) {
+      continue;
+    }
+    if ( slot[c] == -1 ) {
+      slot[c] = numUnique;
+      uniq[numUnique] = c;
+      want[numUnique] = 0;
+      ++numUnique;
+    }
+    ++want[slot[c]];
+  }
+
+  /* give each requested cell a column and row relative to the lower left */
+  /* corner of the grid */
+  x0 = y0 = R_PosInf;
+  for ( c = 0; c < numCells; ++c ) {
+    if ( xc[c] - dx < x0 ) {
+      x0 = xc[c] - dx;
+    }
+    if ( yc[c] - dy < y0 ) {
+      y0 = yc[c] - dy;
+    }
+  }
+  numCols = 3;
+  for ( c = 0; c < numCells; ++c ) {
+    col = (int) floor( (xc[c] - x0) / dx + 0.5 );
+    if ( col + 3 > numCols ) {
+      numCols = col + 3;
+    }
+  }
+  for ( i = 0; i < numUnique; ++i ) {
+    c = uniq[i];
+    col = (int) floor( (xc[c] - x0) / dx + 0.5 );
+    row = (int) floor( (yc[c] - y0) / dy + 0.5 );
+    keys[i].key = (long long) row * numCols + col;
+    keys[i].cell = i;
+  }
+  qsort( keys, numUnique, sizeof(CellKey), compareCellKey );
+
+  /* count the points in each requested cell and then fill the cells, */
+  /* visiting the points in frame order */
+  for ( i = 0; i <= numUnique; ++i ) {
+    start[i] = 0;
+  }
+  for ( pass = 0; pass < 2; ++pass ) {
+    for ( j = 0; j < numPts; ++j ) {
+      x = ptsX[j];
+      y = ptsY[j];
+      if ( !R_FINITE( x ) || !R_FINITE( y ) ||
+           x <= x0 || y <= y0 ) {
+        continue;
+      }
+      col = (int) ceil( (x - x0) / dx );
+      row = (int) ceil( (y - y0) / dy );
+      if ( col - 1 > numCols ) {
+        continue;
+      }
+      for ( dr = -1; dr <= 1; ++dr ) {
+        for ( dc = -1; dc <= 1; ++dc ) {
+          if ( col + dc < 0 || row + dr < 0 ) {
+            continue;
+          }
+          key = (long long) (row + dr) * numCols + (col + dc);
+          for ( first = findCellKey( keys, numUnique, key );
+                first < numUnique && keys[first].key == key; ++first ) {
+            i = keys[first].cell;
+            xMax = xc[uniq[i]];
+            yMax = yc[uniq[i]];
+            if ( (xMax - dx < x) && (x <= xMax) &&
+                 (yMax - dy < y) && (y <= yMax) ) {
+              if ( pass == 0 ) {
+                ++start[i + 1];
+              } else {
+                members[fill[i]++] = j;
+              }
+            }
           }
         }
       }
     }
+
+    /* turn the counts into the first entry of each cell */
+    if ( pass == 0 ) {
+      for ( i = 0; i < numUnique; ++i ) {
+        start[i + 1] += start[i];
+        fill[i] = start[i];
+      }
+      members = (int *) malloc( sizeof(int) * (start[numUnique] + 1) );
+      prob = (double *) malloc( sizeof(double) * (start[numUnique] + 1) );
+      perm = (int *) malloc( sizeof(int) * (start[numUnique] + 1) );
+      pick = (int *) malloc( sizeof(int) * (start[numUnique] + 1) );
+      if ( members == NULL || prob == NULL || perm == NULL || pick == NULL ) {
+        Rprintf( "Error: Allocating memory in C function selectCellPoints.\n" );
+        free( slot );
+        free( uniq );
+        free( want );
+        free( start );
+        free( fill );
+        free( keys );
+        free( members );
+        free( prob );
+        free( perm );
+        free( pick );
+        PROTECT( results = allocVector( VECSXP, 1 ) );
+        UNPROTECT(7);
+        return results;
+      }
+    }
   }
-  
-  return 1;
+
+  /* count the points that will be selected */
+  for ( i = 0; i < numUnique; ++i ) {
+    size = start[i + 1] - start[i];
+    if ( all == TRUE || want[i] > size ) {
+      numSel += size;
+    } else {
+      numSel += want[i];
+    }
+    if ( all == FALSE && want[i] > size ) {
+      ++numShort;
+    }
+  }
+  PROTECT( selVec = allocVector( INTSXP, numSel ) );
+  PROTECT( shortVec = allocVector( INTSXP, numShort ) );
+  sel = INTEGER( selVec );
+  shortCells = INTEGER( shortVec );
+
+  /* obtain the R random number generator type and seed */
+  GetRNGstate();
+
+  /* select the points from each cell */
+  numSel = 0;
+  numShort = 0;
+  for ( i = 0; i < numUnique; ++i ) {
+    size = start[i + 1] - start[i];
+    if ( all == TRUE ) {
+
+      /* put all of the points in a random order, which sample does not */
+      /* do for a single point */
+      nsel = size;
+      if ( size > 1 ) {
+        for ( k = 0; k < size; ++k ) {
+          perm[k] = k;
+        }
+        c = size;
+        for ( k = 0; k < size; ++k ) {
+          j = unifIndex( c );
+          pick[k] = members[start[i] + perm[j]];
+          perm[j] = perm[--c];
+        }
+        for ( k = 0; k < size; ++k ) {
+          members[start[i] + k] = pick[k];
+        }
+      }
+
+    } else if ( want[i] >= size ) {
+
+      /* select all of the points in frame order */
+      nsel = size;
+      if ( want[i] > size ) {
+        shortCells[numShort++] = uniq[i] + 1;
+      }
+
+    } else {
+
+      /* select the points with probability proportional to mdm */
+      for ( k = 0; k < size; ++k ) {
+        prob[k] = mdm[members[start[i] + k]];
+        perm[k] = k;
+      }
+      if ( probSampleNoReplace( prob, perm, size, want[i], pick,
+                               "selectCellPoints" ) == -1 ) {
+        PutRNGstate();
+        free( slot );
+        free( uniq );
+        free( want );
+        free( start );
+        free( fill );
+        free( keys );
+        free( members );
+        free( prob );
+        free( perm );
+        free( pick );
+        PROTECT( results = allocVector( VECSXP, 1 ) );
+        UNPROTECT(9);
+        return results;
+      }
+      for ( k = 0; k < want[i]; ++k ) {
+        pick[k] = members[start[i] + pick[k]];
+      }
+      for ( k = 0; k < want[i]; ++k ) {
+        members[start[i] + k] = pick[k];
+      }
+      nsel = want[i];
+    }
+    for ( k = 0; k < nsel; ++k ) {
+      sel[numSel++] = members[start[i] + k] + 1;
+    }
+  }
+
+  /* write out the R random number generator type and seed */
+  PutRNGstate();
+
+  /* create the list for returning results to R */
+  PROTECT( results = allocVector( VECSXP, 2 ) );
+  PROTECT( colNamesVec = allocVector( STRSXP, 2 ) );
+  SET_VECTOR_ELT( results, 0, selVec );
+  SET_VECTOR_ELT( results, 1, shortVec );
+  SET_STRING_ELT( colNamesVec, 0, mkChar( "point" ) );
+  SET_STRING_ELT( colNamesVec, 1, mkChar( "short" ) );
+  setAttrib( results, R_NamesSymbol, colNamesVec );
+  UNPROTECT(10);
+
+  /* clean up */
+  free( slot );
+  free( uniq );
+  free( want );
+  free( start );
+  free( fill );
+  free( keys );
+  free( members );
+  free( prob );
+  free( perm );
+  free( pick );
+
+  return results;
 }
@@ -6,6 +6,7 @@
 **  Created:     May 4, 2006
 **  Revised:     February 11, 2010
 **  Revised:     October 8, 2014
+**  Revised:     October 19, 2026
 ******************************************************************************/
 
 #include <R.h>
@@ -29,18 +30,30 @@ static const R_CallMethodDef callMethods[] = {
    {"writeShapeFilePoint", (DL_FUNC) &writeShapeFilePoint, 6},
    {"writeShapeFilePolygon", (DL_FUNC) &writeShapeFilePolygon, 12},
    {"pointInPolygonObj", (DL_FUNC) &pointInPolygonObj, 4},
-   {"numLevels", (DL_FUNC) &numLevels, 7},
-   {"constructAddr", (DL_FUNC) &constructAddr, 5},
+   {"numLevels", (DL_FUNC) &numLevels, 11},
+   {"constructAddr", (DL_FUNC) &constructAddr, 6},
+   {"ranhoKey", (DL_FUNC) &ranhoKey, 2},
    {"pickGridCells", (DL_FUNC) &pickGridCells, 2},
+   {"selectGridCells", (DL_FUNC) &selectGridCells, 9},
    {"insideAreaGridCell", (DL_FUNC) &insideAreaGridCell, 7},
    {"insideLinearGridCell", (DL_FUNC) &insideLinearGridCell, 7},
    {"pointInPolygonFile", (DL_FUNC) &pointInPolygonFile, 5},
-   {"pickAreaSamplePoints", (DL_FUNC) &pickAreaSamplePoints, 8},
+   {"pickAreaSamplePoints", (DL_FUNC) &pickAreaSamplePoints, 12},
    {"pickLinearSamplePoints", (DL_FUNC) &pickLinearSamplePoints, 7},
    {"linSample", (DL_FUNC) &linSample, 7},
    {"getRecordIDs", (DL_FUNC) &getRecordIDs, 3},
    {"getShapeBox", (DL_FUNC) &getShapeBox, 2},
+   {"irsAreaPoints", (DL_FUNC) &irsAreaPoints, 6},
+   {"aliasTable", (DL_FUNC) &aliasTable, 1},
+   {"aliasSample", (DL_FUNC) &aliasSample, 3},
    {"linSampleIRS", (DL_FUNC) &linSampleIRS, 6},
+   {"selectCellPoints", (DL_FUNC) &selectCellPoints, 9},
+   {"numLevelsPoints", (DL_FUNC) &numLevelsPoints, 7},
+   {"tessExtent", (DL_FUNC) &tessExtent, 8},
+   {"sbcExtent", (DL_FUNC) &sbcExtent, 9},
+   {"tessExtentBatch", (DL_FUNC) &tessExtentBatch, 9},
+   {"grtsAreaSample", (DL_FUNC) &grtsAreaSample, 15},
+   {"grtsLinearSample", (DL_FUNC) &grtsLinearSample, 11},
    {NULL, NULL, 0}
 };
 
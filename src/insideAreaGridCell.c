@@ -7,10 +7,16 @@
 **  Revised:     June 15, 2015
 **  Revised:     November 5, 2015
 **  Revised:     August 10, 2017
+**  Revised:     October 19, 2026
 **  Description:
 **    For each grid cell, this function determines the set of shapefile records
 **    contained in the cell and returns the shapefile record IDs and the clipped
-**    area of the polygons in the records 
+**    area of the polygons in the records.  Each record is clipped only to the
+**    cells that can overlap its bounding box, which are found from an index of
+**    the cells ordered by x coordinate.  The (cell, record, area) triples are
+**    stored in a growable array on the heap and are sorted once at the end,
+**    so that the results are in order of the cells and, within a cell, in the
+**    order of the records in the shapefile.
 **  Arguments:
 **    fileNamePrefix = the shapefile name
 **    dsgnmdIDVec = vector of shapefile record IDs to use in the calculations
@@ -51,12 +57,22 @@ extern unsigned int readBigEndian(unsigned char * buffer, int length);
 extern int combineShpFiles(FILE * newShp, unsigned int * ids, int numIDs);
 extern int createNewTempShpFile(FILE * newShp, char * shapeFileName,
                                 unsigned int * ids, int numIDs);
+extern void initCellExtents(CellExtents * ext);
+extern void freeCellExtents(CellExtents * ext);
+extern int addCellExtent(CellExtents * ext, int cell, unsigned int id,
+                         double extent);
+extern void sortCellExtents(CellExtents * ext);
+extern int initCellList(CellList * index, double * xc, double * yc,
+                         int numCells, double dx, double dy);
+extern void freeCellList(CellList * index);
+extern void findCellList(CellList * index, double min, double max,
+                          int * first, int * last);
 
 /* These functions are found in grtsarea.c */
-extern double polygonArea(Point * polygon, int size);
-extern Point intersect(Cell * cell, Point * p1, Point * p2, int side);
-extern int inside(Cell * cell, Point * p, int side);
-extern double clipPolygonArea(Cell * cell, Point * points, int start, int end);
+extern void initClipBuffer(ClipBuffer * buf);
+extern void freeClipBuffer(ClipBuffer * buf);
+extern double clipPolygonArea(Cell * cell, Point * points, int start, int end,
+                              ClipBuffer * buf);
 
 
 SEXP insideAreaGridCell(SEXP fileNamePrefix, SEXP dsgnmdIDVec, SEXP cellIDsVec,
@@ -70,9 +86,8 @@ SEXP insideAreaGridCell(SEXP fileNamePrefix, SEXP dsgnmdIDVec, SEXP cellIDsVec,
   char * restrict shpFileName = NULL;  /* stores the full .shp file name */
   int singleFile = FALSE;
   Shape shape;           /* used to store shapefile info and data */
-  Point * part = NULL;   /* stores points in a part */
-  int partSize;          /* number of points in part */
-  int pidx;              /* index into part array */
+  int partEnd;           /* index of the last point of a part */
+  ClipBuffer clip;       /* scratch storage for clipping the polygons */
   Record * temp = NULL;  /* used for traversing linked list of records */
   unsigned int filePosition = 100;  /* byte offset for the beginning of the */
                                     /* record data */
@@ -85,25 +100,30 @@ SEXP insideAreaGridCell(SEXP fileNamePrefix, SEXP dsgnmdIDVec, SEXP cellIDsVec,
   unsigned int * dsgnmdID = NULL;  /* array of shapefile record IDs to use */
   unsigned int dsgSize = length(dsgnmdIDVec);  /* number of values in the dsgnmdID array */
   unsigned int numCells = length(xcVec); /* number of cells */
-  unsigned int * recordIDs[numCells];  /* array that stores record IDs for each cell */
-  double * recordAreas[numCells];      /* array that stores record areas for each cell */
-  unsigned int * numIDs = NULL;   /* array that stores the number of record IDs for each cell */
+  CellExtents ext;       /* (cell, record, area) triples */
+  CellList index;       /* index of the cells ordered by x coordinate */
+  Point * points;        /* points of the current record */
+  int * parts;           /* parts of the current record */
+  int numParts;          /* number of parts in the current record */
+  int numPoints;         /* number of points in the current record */
+  double boxXMin, boxYMin, boxXMax, boxYMax;  /* bounding box of a record */
+  int first, last;       /* range of the cell list to check */
   unsigned int * cellIDs = NULL;  /* array that stores values found in cellIDsVec R vector */
   double * xc = NULL;   /* array that stores values found in xcVec R vector */
   double * yc = NULL;   /* array that stores values found in ycVec R vector */
   double dx;             /* x-axis size of the grid cells */
   double dy;             /* y-axis size of the grid cells */
-  unsigned int tempID;   /* stores current shapefile record ID */
   double tempArea;       /* stores current shapefile record clipped area */
-  unsigned int * newIDs = NULL;    /* stores new set of record IDs in a cell */
-  double * newAreas = NULL;        /* stores new set of record areas in a cell */
-  int nID;               /* total number of record IDs */
   SEXP results = NULL;   /* R object used to return values to R */
   SEXP colNamesVec;      /* vector used to name the columns in the results object */
   SEXP cellVec;          /* return vector of cell IDs */
   SEXP recordIDsVec;     /* return vector of record IDs */
   SEXP recordAreasVec;   /* return vector of record clipped areas */
 
+  initClipBuffer(&clip);
+  initCellExtents(&ext);
+  index.order = NULL;
+
   /* see if a specific file was sent */
   if(fileNamePrefix != R_NilValue) {
 
@@ -232,8 +252,8 @@ SEXP insideAreaGridCell(SEXP fileNamePrefix, SEXP dsgnmdIDVec, SEXP cellIDsVec,
   dx = REAL(dxVal)[0];
   dy = REAL(dyVal)[0];
 
-  /* create the array for number of record IDs in each cell */  
-  if((numIDs = (unsigned int *) malloc(sizeof(unsigned int) * numCells)) == NULL) {
+  /* create the index of the cells ordered by x coordinate */
+  if(initCellList(&index, xc, yc, numCells, dx, dy) == -1) {
     Rprintf("Error: Allocating memory in C function insideAreaGridCell.\n");
     fclose(fptr);
     remove(TEMP_SHP_FILE);
@@ -241,11 +261,13 @@ SEXP insideAreaGridCell(SEXP fileNamePrefix, SEXP dsgnmdIDVec, SEXP cellIDsVec,
     UNPROTECT(1); 
     return results;  
   }
-  for(i = 0; i < numCells; ++i) {
-    numIDs[i] = 0;
-  }
 
-  /* fill the arrays with the record IDs and clipped areas for each cell */  
+  /* no polygon has been read into the record yet */
+  record.poly = NULL;
+  record.polyZ = NULL;
+  record.polyM = NULL;
+
+  /* find the record IDs and clipped areas for each cell */  
   while (filePosition < shape.fileLength*2) {
 
     /* read the record number */
@@ -535,10 +557,42 @@ SEXP insideAreaGridCell(SEXP fileNamePrefix, SEXP dsgnmdIDVec, SEXP cellIDsVec,
 
     }
 
-    /* build the cell record IDs array */
-    for(i = 0; i < numCells; ++i) {
-      temp = &record;
-      tempID = 0;
+    /* use the same storage for each polygon type */
+    temp = &record;
+    if(shape.shapeType == POLYGON) {
+      points = temp->poly->points;
+      parts = temp->poly->parts;
+      numParts = temp->poly->numParts;
+      numPoints = temp->poly->numPoints;
+    } else if(shape.shapeType == POLYGON_Z) {
+      points = temp->polyZ->points;
+      parts = temp->polyZ->parts;
+      numParts = temp->polyZ->numParts;
+      numPoints = temp->polyZ->numPoints;
+    } else {
+      points = temp->polyM->points;
+      parts = temp->polyM->parts;
+      numParts = temp->polyM->numParts;
+      numPoints = temp->polyM->numPoints;
+    }
+
+    /* determine the bounding box of the record from its points */
+    boxXMin = boxYMin = R_PosInf;
+    boxXMax = boxYMax = R_NegInf;
+    for(j = 0; j < numPoints; ++j) {
+      if(points[j].X < boxXMin) boxXMin = points[j].X;
+      if(points[j].X > boxXMax) boxXMax = points[j].X;
+      if(points[j].Y < boxYMin) boxYMin = points[j].Y;
+      if(points[j].Y > boxYMax) boxYMax = points[j].Y;
+    }
+
+    /* clip the record to each cell that can overlap its bounding box */
+    findCellList(&index, boxXMin, boxXMax, &first, &last);
+    for(j = first; j < last; ++j) {
+      i = index.order[j];
+      if(yc[i] < boxYMin || yc[i] - dy > boxYMax) {
+        continue;
+      }
       tempArea = 0.0;
 
       /* create the cell structure */
@@ -547,287 +601,78 @@ SEXP insideAreaGridCell(SEXP fileNamePrefix, SEXP dsgnmdIDVec, SEXP cellIDsVec,
       cell.xMax = xc[i];
       cell.yMax = yc[i];
 
-      if(shape.shapeType == POLYGON) {
-
       /* if there are more than one part we need to check them separately*/
-        if(temp->poly->numParts > 1) {
-          for(k = 0; k < temp->poly->numParts; ++k) {
-            if(part) {
-              free(part);
-            }
-
-            /* check to see if this is the last part */ 
-            if(k == temp->poly->numParts - 1) {
-
-              /* store part data into part array */
-              partSize = temp->poly->numPoints - temp->poly->parts[k];
-              if((part = (Point *) malloc(sizeof(Point) * partSize)) == NULL) {
-                Rprintf("Error: Allocating memory in C function insideAreaGridCell.\n");
-                fclose(fptr);
-                remove(TEMP_SHP_FILE);
-                PROTECT(results = allocVector(VECSXP, 1));
-                UNPROTECT(1); 
-                return results;  
-              }
-              pidx = 0;
-              for(j=temp->poly->parts[k]; j < temp->poly->numPoints; ++j){
-                part[pidx] = temp->poly->points[j];
-                ++pidx; 
-              }
-
-            /* not the last part */
-            } else {
-
-              /* store part data into part array */
-              partSize = temp->poly->parts[k+1] - temp->poly->parts[k];
-              part = (Point *) malloc(sizeof(Point) * partSize);
-              pidx = 0;
-              for(j=temp->poly->parts[k]; j < temp->poly->parts[k+1]; ++j) {
-                part[pidx] = temp->poly->points[j];
-                ++pidx; 
-              }
-
-            }
-            tempArea += clipPolygonArea(&cell, part, 0, partSize-1);
-
-          }  
-          if(tempArea > 0) {
-            tempID = record.number;
-          }
-
-        /* only one part so check the entire record */
-        } else {
-
-          /* check whether the polygon is inside the cell */
-          tempArea += clipPolygonArea(&cell, temp->poly->points, 0, temp->poly->numPoints-1);
-          if(tempArea > 0) {
-            tempID = record.number;
+      if(numParts > 1) {
+        for(k = 0; k < numParts; ++k) {
+
+          /* find the last point of the part */
+          if(k == numParts - 1) {
+            partEnd = numPoints - 1;
+          } else {
+            partEnd = parts[k+1] - 1;
           }
+          tempArea += clipPolygonArea(&cell, points, parts[k], partEnd,
+                                      &clip);
         }
 
-        if(tempID == 0) {
-          continue;
-        }
-
-      } else if(shape.shapeType == POLYGON_Z) {
-
-      /* if there are more than one part we need to check them separately*/
-        if(temp->polyZ->numParts > 1) {
-            for(k = 0; k < temp->polyZ->numParts; ++k) {
-            if(part) {
-              free(part);
-            }
-
-            /* check to see if this is the last part */ 
-            if(k == temp->polyZ->numParts - 1) {
-
-              /* store part data into part array */
-              partSize = temp->polyZ->numPoints - temp->polyZ->parts[k];
-              if((part = (Point *) malloc(sizeof(Point) * partSize)) == NULL) {
-                Rprintf("Error: Allocating memory in C function insideAreaGridCell.\n");
-                fclose(fptr);
-                remove(TEMP_SHP_FILE);
-                PROTECT(results = allocVector(VECSXP, 1));
-                UNPROTECT(1); 
-                return results;  
-              }
-              pidx = 0;
-              for(j=temp->polyZ->parts[k]; j < temp->polyZ->numPoints; ++j){
-                part[pidx] = temp->polyZ->points[j];
-                ++pidx; 
-              }
-
-            /* not the last part */
-            } else {
-
-              /* store part data into part array */
-              partSize = temp->polyZ->parts[k+1] - temp->polyZ->parts[k];
-              part = (Point *) malloc(sizeof(Point) * partSize);
-              pidx = 0;
-              for(j=temp->polyZ->parts[k]; j < temp->polyZ->parts[k+1]; ++j){
-                part[pidx] = temp->polyZ->points[j];
-                ++pidx; 
-              }
-
-            }
-            tempArea += clipPolygonArea(&cell, part, 0, partSize-1);
-
-          }  
-          if(tempArea > 0) {
-            tempID = record.number;
-          }
-
-          /* only one part so check the entire record */
-        } else {
-
-          /* check whether the polygon is inside the cell */
-          tempArea += clipPolygonArea(&cell,temp->polyZ->points,0,temp->polyZ->numPoints-1);
-          if(tempArea > 0) {
-            tempID = record.number;
-          }
-        }
-
-        if(tempID == 0) {
-          continue;
-        }
-
+      /* only one part so check the entire record */
       } else {
+        tempArea += clipPolygonArea(&cell, points, 0, numPoints-1, &clip);
+      }
 
-      /* if there are more than one part we need to check them separately*/
-        if(temp->polyM->numParts > 1) {
-            for(k = 0; k < temp->polyM->numParts; ++k) {
-            if(part) {
-              free(part);
-            }
-
-            /* check to see if this is the last part */ 
-            if(k == temp->polyM->numParts - 1) {
-
-              /* store part data into part array */
-              partSize = temp->polyM->numPoints - temp->polyM->parts[k];
-              if((part = (Point *) malloc(sizeof(Point) * partSize)) == NULL) {
-                Rprintf("Error: Allocating memory in C function insideAreaGridCell.\n");
-                fclose(fptr);
-                remove(TEMP_SHP_FILE);
-                PROTECT(results = allocVector(VECSXP, 1));
-                UNPROTECT(1); 
-                return results;  
-              }
-              pidx = 0;
-              for(j=temp->polyM->parts[k]; j < temp->polyM->numPoints; ++j){
-                part[pidx] = temp->polyM->points[j];
-                ++pidx; 
-              }
-
-            /* not the last part */
-            } else {
-
-              /* store part data into part array */
-              partSize = temp->polyM->parts[k+1] - temp->polyM->parts[k];
-              part = (Point *) malloc(sizeof(Point) * partSize);
-              pidx = 0;
-              for(j=temp->polyM->parts[k]; j < temp->polyM->parts[k+1]; ++j){
-                part[pidx] = temp->polyM->points[j];
-                ++pidx; 
-              }
-
-            }
-            tempArea += clipPolygonArea(&cell, part, 0, partSize-1);
-
-          }  
-          if(tempArea > 0) {
-            tempID = record.number;
-          }
-
-          /* only one part so check the entire record */
-        } else {
-
-          /* check whether the polygon is inside the cell */
-          tempArea += clipPolygonArea(&cell,temp->polyM->points,0,temp->polyM->numPoints-1);
-          if(tempArea > 0) {
-            tempID = record.number;
-          }
-        }
-
-        if(tempID == 0) {
-          continue;
-        }
-
-      } 
-
-      /* if found, add record ID to recordIDs array */
-      if(tempID > 0) {
-        ++numIDs[i];
-        if(numIDs[i] > 1) {
-          if((newIDs = (unsigned int *) malloc(sizeof(unsigned int) * numIDs[i])) == NULL) {
-            Rprintf("Error: Allocating memory in C function insideAreaGridCell.\n");
-            fclose(fptr);
-            remove(TEMP_SHP_FILE);
-            PROTECT(results = allocVector(VECSXP, 1));
-            UNPROTECT(1);
-            return results;
-          }
-          if((newAreas = (double *) malloc(sizeof(double) * numIDs[i])) == NULL) {
-            Rprintf("Error: Allocating memory in C function insideAreaGridCell.\n");
-            fclose(fptr);
-            remove(TEMP_SHP_FILE);
-            PROTECT(results = allocVector(VECSXP, 1));
-            UNPROTECT(1);
-            return results;
-          }
-          for(j = 0; j < (numIDs[i]-1); ++j) {
-            newIDs[j] = *(recordIDs[i] + j);
-            newAreas[j] = *(recordAreas[i] + j);
-          }
-          newIDs[(numIDs[i]-1)] = tempID;
-          newAreas[(numIDs[i]-1)] = tempArea;
-          recordIDs[i] = newIDs;
-          recordAreas[i] = newAreas;
-        } else {
-          if((newIDs = (unsigned int *) malloc(sizeof(unsigned int))) == NULL) {
-            Rprintf("Error: Allocating memory in C function insideAreaGridCell.\n");
-            fclose(fptr);
-            remove(TEMP_SHP_FILE);
-            PROTECT(results = allocVector(VECSXP, 1));
-            UNPROTECT(1);
-            return results;
-          }
-          if((newAreas = (double *) malloc(sizeof(double))) == NULL) {
-            Rprintf("Error: Allocating memory in C function insideAreaGridCell.\n");
-            fclose(fptr);
-            remove(TEMP_SHP_FILE);
-            PROTECT(results = allocVector(VECSXP, 1));
-            UNPROTECT(1);
-            return results;
-          }
-          newIDs[0] = tempID;
-          newAreas[0] = tempArea;
-          recordIDs[i] = newIDs;
-          recordAreas[i] = newAreas;
+      /* if the polygon is inside the cell, add the triple */
+      if(tempArea > 0) {
+        if(addCellExtent(&ext, i, record.number, tempArea) == -1) {
+          Rprintf("Error: Allocating memory in C function insideAreaGridCell.\n");
+          freeCellExtents(&ext);
+          freeCellList(&index);
+          freeClipBuffer(&clip);
+          fclose(fptr);
+          remove(TEMP_SHP_FILE);
+          PROTECT(results = allocVector(VECSXP, 1));
+          UNPROTECT(1);
+          return results;
         }
       }
-
     }
 
-    if(shape.shapeType == POLYGON) {
+    if(temp->poly != NULL) {
       free(temp->poly->parts);
       free(temp->poly->points);
       free(temp->poly);
-    } else if(shape.shapeType == POLYGON_Z) {
+      temp->poly = NULL;
+    }
+    if(temp->polyZ != NULL) {
       free(temp->polyZ->parts);
       free(temp->polyZ->points);
       free(temp->polyZ->zArray);
       free(temp->polyZ->mArray);
       free(temp->polyZ);
-    } else {
+      temp->polyZ = NULL;
+    }
+    if(temp->polyM != NULL) {
       free(temp->polyM->parts);
       free(temp->polyM->points);
       free(temp->polyM->mArray);
       free(temp->polyM);
+      temp->polyM = NULL;
     }
 
   }
 
-  /* determine the total number of record IDs */
-  nID = 0;
-  for(i = 0; i < numCells; ++i) {
-    nID = nID + numIDs[i];
-  }
+  /* put the triples in order of cell and then of record */
+  sortCellExtents(&ext);
 
   /* create the return R object */
   PROTECT(results = allocVector(VECSXP, 3));
   PROTECT(colNamesVec = allocVector(STRSXP, 3));
-  PROTECT(cellVec = allocVector(INTSXP, nID));
-  PROTECT(recordIDsVec = allocVector(INTSXP, nID));
-  PROTECT(recordAreasVec = allocVector(REALSXP, nID));
-  k = 0;
-  for(i = 0; i < numCells; ++i) {
-    for(j = 0; j < numIDs[i]; ++j) {
-      INTEGER(cellVec)[k] = cellIDs[i];
-      INTEGER(recordIDsVec)[k] = *(recordIDs[i] + j);
-      REAL(recordAreasVec)[k] = *(recordAreas[i] + j);
-      ++k;
-    }
+  PROTECT(cellVec = allocVector(INTSXP, ext.numItems));
+  PROTECT(recordIDsVec = allocVector(INTSXP, ext.numItems));
+  PROTECT(recordAreasVec = allocVector(REALSXP, ext.numItems));
+  for(k = 0; k < ext.numItems; ++k) {
+    INTEGER(cellVec)[k] = cellIDs[ext.items[k].cell];
+    INTEGER(recordIDsVec)[k] = ext.items[k].id;
+    REAL(recordAreasVec)[k] = ext.items[k].extent;
   }
   SET_VECTOR_ELT(results, 0, cellVec);
   SET_VECTOR_ELT(results, 1, recordIDsVec);
@@ -850,15 +695,9 @@ SEXP insideAreaGridCell(SEXP fileNamePrefix, SEXP dsgnmdIDVec, SEXP cellIDsVec,
   if(yc) {
     free(yc);
   }
-  if(numIDs) {
-    free(numIDs);
-  }
-  if(newIDs) {
-    free(newIDs);
-  }
-  if(newAreas) {
-    free(newAreas);
-  }
+  freeCellExtents(&ext);
+  freeCellList(&index);
+  freeClipBuffer(&clip);
   fclose(fptr);
   remove(TEMP_SHP_FILE);
   UNPROTECT(5);
@@ -8,10 +8,16 @@
 **  Revised:     June 15, 2015
 **  Revised:     November 5, 2015
 **  Revised:     August 10, 2017
+**  Revised:     October 19, 2026
 **  Description:
 **    For each grid cell, this function determines the set of shapefile records
 **    contained in the cell and returns the shapefile record IDs and the clipped
-**    length of the polylines in the records 
+**    length of the polylines in the records.  Each record is clipped only to
+**    the cells that can overlap its bounding box, which are found from an index
+**    of the cells ordered by x coordinate.  The (cell, record, length) triples
+**    are stored in a growable array on the heap and are sorted once at the
+**    end, so that the results are in order of the cells and, within a cell,
+**    in the order of the records in the shapefile.
 **  Arguments:
 **    fileNamePrefix = the shapefile name
 **    dsgnmdIDVec = vector of shapefile record IDs to use in the calculations
@@ -52,6 +58,16 @@ extern unsigned int readBigEndian(unsigned char * buffer, int length);
 extern int combineShpFiles(FILE * newShp, unsigned int * ids, int numIDs);
 extern int createNewTempShpFile(FILE * newShp, char * shapeFileName,
                                 unsigned int * ids, int numIDs);
+extern void initCellExtents(CellExtents * ext);
+extern void freeCellExtents(CellExtents * ext);
+extern int addCellExtent(CellExtents * ext, int cell, unsigned int id,
+                         double extent);
+extern void sortCellExtents(CellExtents * ext);
+extern int initCellList(CellList * index, double * xc, double * yc,
+                        int numCells, double dx, double dy);
+extern void freeCellList(CellList * index);
+extern void findCellList(CellList * index, double min, double max,
+                         int * first, int * last);
 
 /* These functions are found in grtslin.c */
 double lineLength(double x1, double y1, double x2, double y2, Cell * cell, 
@@ -79,29 +95,32 @@ SEXP insideLinearGridCell(SEXP fileNamePrefix, SEXP dsgnmdIDVec, SEXP cellIDsVec
   Record * temp = NULL;  /* used for traversing linked list of records */
   Cell cell;             /* temporary storage for a cell */
   int partIndx;          /* index into polyline parts array */
-  Segment * seg = NULL;  /* variable for storing a segment struct */
   unsigned int * dsgnmdID = NULL;  /* array of shapefile record IDs to use */
   unsigned int dsgSize = length(dsgnmdIDVec);  /* number of values in the dsgnmdID array */
   unsigned int numCells = length(xcVec); /* number of cells */
-  unsigned int * recordIDs[numCells];  /* array that stores record IDs for each cell */
-  double * recordLengths[numCells];      /* array that stores record lengths for each cell */
-  unsigned int * numIDs = NULL;   /* array that stores the number of record IDs for each cell */
+  CellExtents ext;       /* (cell, record, length) triples */
+  CellList index;        /* index of the cells ordered by x coordinate */
+  Point * points;        /* points of the current record */
+  int * parts;           /* parts of the current record */
+  int numParts;          /* number of parts in the current record */
+  int numPoints;         /* number of points in the current record */
+  double boxXMin, boxYMin, boxXMax, boxYMax;  /* bounding box of a record */
+  int first, last;       /* range of the cell list to check */
   unsigned int * cellIDs = NULL;  /* array that stores values found in cellIDsVec R vector */
   double * xc = NULL;   /* array that stores values found in xcVec R vector */
   double * yc = NULL;   /* array that stores values found in ycVec R vector */
   double dx;             /* x-axis size of the grid cells */
   double dy;             /* y-axis size of the grid cells */
-  unsigned int tempID;   /* stores current shapefile record ID */
   double tempLength;       /* stores current shapefile record clipped length */
-  unsigned int * newIDs = NULL;    /* stores new set of record IDs in a cell */
-  double * newLengths = NULL;        /* stores new set of record lengths in a cell */
-  int nID;               /* total number of record IDs */
   SEXP results = NULL;   /* R object used to return values to R */
   SEXP colNamesVec;      /* vector used to name the columns in the results object */
   SEXP cellVec;          /* return vector of cell IDs */
   SEXP recordIDsVec;     /* return vector of record IDs */
   SEXP recordLengthsVec;   /* return vector of record clipped lengths */
 
+  initCellExtents(&ext);
+  index.order = NULL;
+
   /* see if a specific file was sent */
   if(fileNamePrefix != R_NilValue) {
 
@@ -229,8 +248,8 @@ SEXP insideLinearGridCell(SEXP fileNamePrefix, SEXP dsgnmdIDVec, SEXP cellIDsVec
   dx = REAL(dxVal)[0];
   dy = REAL(dyVal)[0];
 
-  /* create the array for number of record IDs in each cell */  
-  if((numIDs = (unsigned int *) malloc(sizeof(unsigned int) * numCells)) == NULL) {
+  /* create the index of the cells ordered by x coordinate */
+  if(initCellList(&index, xc, yc, numCells, dx, dy) == -1) {
     Rprintf("Error: Allocating memory in C function insideLinearGridCell.\n");
     fclose(fptr);
     remove(TEMP_SHP_FILE);
@@ -238,11 +257,13 @@ SEXP insideLinearGridCell(SEXP fileNamePrefix, SEXP dsgnmdIDVec, SEXP cellIDsVec
     UNPROTECT(1); 
     return results;  
   }
-  for(i = 0; i < numCells; ++i) {
-    numIDs[i] = 0;
-  }
 
-  /* fill the arrays with the record IDs and clipped lengths for each cell */  
+  /* no polygon has been read into the record yet */
+  record.poly = NULL;
+  record.polyZ = NULL;
+  record.polyM = NULL;
+
+  /* find the record IDs and clipped lengths for each cell */  
   while (filePosition < shape.fileLength*2) {
 
     /* read the record number */
@@ -532,10 +553,42 @@ SEXP insideLinearGridCell(SEXP fileNamePrefix, SEXP dsgnmdIDVec, SEXP cellIDsVec
 
     }
 
-    /* build the cell record IDs array */
-    for(i = 0; i < numCells; ++i) {
-      temp = &record;
-      tempID = 0;
+    /* use the same storage for each polyline type */
+    temp = &record;
+    if(shape.shapeType == POLYLINE) {
+      points = temp->poly->points;
+      parts = temp->poly->parts;
+      numParts = temp->poly->numParts;
+      numPoints = temp->poly->numPoints;
+    } else if(shape.shapeType == POLYLINE_Z) {
+      points = temp->polyZ->points;
+      parts = temp->polyZ->parts;
+      numParts = temp->polyZ->numParts;
+      numPoints = temp->polyZ->numPoints;
+    } else {
+      points = temp->polyM->points;
+      parts = temp->polyM->parts;
+      numParts = temp->polyM->numParts;
+      numPoints = temp->polyM->numPoints;
+    }
+
+    /* determine the bounding box of the record from its points */
+    boxXMin = boxYMin = R_PosInf;
+    boxXMax = boxYMax = R_NegInf;
+    for(j = 0; j < numPoints; ++j) {
+      if(points[j].X < boxXMin) boxXMin = points[j].X;
+      if(points[j].X > boxXMax) boxXMax = points[j].X;
+      if(points[j].Y < boxYMin) boxYMin = points[j].Y;
+      if(points[j].Y > boxYMax) boxYMax = points[j].Y;
+    }
+
+    /* clip the record to each cell that can overlap its bounding box */
+    findCellList(&index, boxXMin, boxXMax, &first, &last);
+    for(j = first; j < last; ++j) {
+      i = index.order[j];
+      if(yc[i] < boxYMin || yc[i] - dy > boxYMax) {
+        continue;
+      }
       tempLength = 0.0;
 
       /* create the cell structure */
@@ -544,227 +597,75 @@ SEXP insideLinearGridCell(SEXP fileNamePrefix, SEXP dsgnmdIDVec, SEXP cellIDsVec
       cell.xMax = xc[i];
       cell.yMax = yc[i];
 
-      if(shape.shapeType == POLYLINE) {
-
-        /* go through each segment in this record */
-        partIndx = 1; 
-        for(k = 0; k < temp->poly->numPoints-1; ++k) {
+      /* go through each segment in this record */
+      partIndx = 1; 
+      for(k = 0; k < numPoints-1; ++k) {
 
-          /* if there are multiple parts, assume the parts are not connected */
-          if(temp->poly->numParts > 1 && partIndx < temp->poly->numParts) {
-            if((k + 1) == temp->poly->parts[partIndx]) {
-              ++partIndx;
-              continue;
-            }
+        /* if there are multiple parts, assume the parts are not connected */
+        if(numParts > 1 && partIndx < numParts) {
+          if((k + 1) == parts[partIndx]) {
+            ++partIndx;
+            continue;
           }
-
-          /* allocate new segment struct */
-          if(seg) {
-            free(seg);
-          }
-          if((seg = (Segment *) malloc(sizeof(Segment))) == NULL) {
-            Rprintf("Error: Allocating memory in C function linSample.\n");
-            fclose(fptr);
-            remove(TEMP_SHP_FILE);
-            PROTECT(results = allocVector(VECSXP, 1));
-            UNPROTECT(1);
-            return results;
-          }
-
-          /* get the length of the line that is inside the cell */
-          tempLength += lineLength(temp->poly->points[k].X, 
-                                   temp->poly->points[k].Y, 
-                                   temp->poly->points[k+1].X, 
-                                   temp->poly->points[k+1].Y, &cell, &seg);
-       
         }
 
-        /* check whether the polyline is inside the cell */ 
-        if(tempLength > 0) {
-          tempID = record.number;
-        } else {
-          continue;
-        }
-
-      } else if(shape.shapeType == POLYLINE_Z) {
-
-        /* go through each segment in this record */
-        partIndx = 1; 
-        for(k = 0; k < temp->polyZ->numPoints-1; ++k) {
-
-          /* if there are multiple parts, assume the parts are not connected */
-          if(temp->polyZ->numParts > 1 && partIndx < temp->polyZ->numParts) {
-            if((k + 1) == temp->polyZ->parts[partIndx]) {
-              ++partIndx;
-              continue;
-            }
-          }
-
-          /* allocate new segment struct */
-          if(seg) {
-            free(seg);
-          }
-          if((seg = (Segment *) malloc(sizeof(Segment))) == NULL) {
-            Rprintf("Error: Allocating memory in C function linSample.\n");
-            fclose(fptr);
-            remove(TEMP_SHP_FILE);
-            PROTECT(results = allocVector(VECSXP, 1));
-            UNPROTECT(1);
-            return results;
-          }
-
-          /* get the length of the line that is inside the cell */
-          tempLength += lineLength(temp->polyZ->points[k].X, 
-                                   temp->polyZ->points[k].Y, 
-                                   temp->polyZ->points[k+1].X, 
-                                   temp->polyZ->points[k+1].Y, &cell, &seg);
-
-        }
-
-        /* check whether the polyline is inside the cell */ 
-        if(tempLength > 0) {
-          tempID = record.number;
-        } else {
-          continue;
-        }
-
-      } else {
-
-        /* go through each segment in this record */
-        partIndx = 1; 
-        for (k = 0; k < temp->polyM->numPoints-1; ++k) {
-
-          /* if there are multiple parts, assume the parts are not connected */
-          if(temp->polyM->numParts > 1 && partIndx < temp->polyM->numParts) {
-            if((k + 1) == temp->polyM->parts[partIndx]) {
-              ++partIndx;
-              continue;
-            }
-          }
-
-          /* allocate new segment struct */
-          if(seg) {
-            free(seg);
-          }
-          if((seg = (Segment *) malloc(sizeof(Segment))) == NULL) {
-            Rprintf("Error: Allocating memory in C function linSample.\n");
-            fclose(fptr);
-            remove(TEMP_SHP_FILE);
-            PROTECT(results = allocVector(VECSXP, 1));
-            UNPROTECT(1);
-            return results;
-          }
-
-          /* get the length of the line that is inside the cell */
-          tempLength += lineLength(temp->polyM->points[k].X, 
-                                   temp->polyM->points[k].Y, 
-                                   temp->polyM->points[k+1].X, 
-                                   temp->polyM->points[k+1].Y, &cell, &seg);
-       
-        }
-
-        /* check whether the polyline is inside the cell */ 
-        if(tempLength > 0) {
-          tempID = record.number;
-        } else {
-          continue;
-        }
-
-      } 
+        /* get the length of the line that is inside the cell */
+        tempLength += lineLength(points[k].X, points[k].Y, points[k+1].X,
+                                 points[k+1].Y, &cell, NULL);
+      }
 
-      /* if found, add record ID to recordIDs array */
-      if(tempID > 0) {
-        ++numIDs[i];
-        if(numIDs[i] > 1) {
-          if((newIDs = (unsigned int *) malloc(sizeof(unsigned int) * numIDs[i])) == NULL) {
-            Rprintf("Error: Allocating memory in C function insideLinearGridCell.\n");
-            fclose(fptr);
-            remove(TEMP_SHP_FILE);
-            PROTECT(results = allocVector(VECSXP, 1));
-            UNPROTECT(1);
-            return results;
-          }
-          if((newLengths = (double *) malloc(sizeof(double) * numIDs[i])) == NULL) {
-            Rprintf("Error: Allocating memory in C function insideLinearGridCell.\n");
-            fclose(fptr);
-            remove(TEMP_SHP_FILE);
-            PROTECT(results = allocVector(VECSXP, 1));
-            UNPROTECT(1);
-            return results;
-          }
-          for(j = 0; j < (numIDs[i]-1); ++j) {
-            newIDs[j] = *(recordIDs[i] + j);
-            newLengths[j] = *(recordLengths[i] + j);
-          }
-          newIDs[(numIDs[i]-1)] = tempID;
-          newLengths[(numIDs[i]-1)] = tempLength;
-          recordIDs[i] = newIDs;
-          recordLengths[i] = newLengths;
-        } else {
-          if((newIDs = (unsigned int *) malloc(sizeof(unsigned int))) == NULL) {
-            Rprintf("Error: Allocating memory in C function insideLinearGridCell.\n");
-            fclose(fptr);
-            remove(TEMP_SHP_FILE);
-            PROTECT(results = allocVector(VECSXP, 1));
-            UNPROTECT(1);
-            return results;
-          }
-          if((newLengths = (double *) malloc(sizeof(double))) == NULL) {
-            Rprintf("Error: Allocating memory in C function insideLinearGridCell.\n");
-            fclose(fptr);
-            remove(TEMP_SHP_FILE);
-            PROTECT(results = allocVector(VECSXP, 1));
-            UNPROTECT(1);
-            return results;
-          }
-          newIDs[0] = tempID;
-          newLengths[0] = tempLength;
-          recordIDs[i] = newIDs;
-          recordLengths[i] = newLengths;
+      /* if the polyline is inside the cell, add the triple */ 
+      if(tempLength > 0) {
+        if(addCellExtent(&ext, i, record.number, tempLength) == -1) {
+          Rprintf("Error: Allocating memory in C function insideLinearGridCell.\n");
+          freeCellExtents(&ext);
+          freeCellList(&index);
+          fclose(fptr);
+          remove(TEMP_SHP_FILE);
+          PROTECT(results = allocVector(VECSXP, 1));
+          UNPROTECT(1);
+          return results;
         }
       }
-
     }
 
-    if(shape.shapeType == POLYLINE) {
+    if(temp->poly != NULL) {
       free(temp->poly->parts);
       free(temp->poly->points);
       free(temp->poly);
-    } else if(shape.shapeType == POLYLINE_Z) {
+      temp->poly = NULL;
+    }
+    if(temp->polyZ != NULL) {
       free(temp->polyZ->parts);
       free(temp->polyZ->points);
       free(temp->polyZ->zArray);
       free(temp->polyZ->mArray);
       free(temp->polyZ);
-    } else {
+      temp->polyZ = NULL;
+    }
+    if(temp->polyM != NULL) {
       free(temp->polyM->parts);
       free(temp->polyM->points);
       free(temp->polyM->mArray);
       free(temp->polyM);
+      temp->polyM = NULL;
     }
 
   }
 
-  /* determine the total number of record IDs */
-  nID = 0;
-  for(i = 0; i < numCells; ++i) {
-    nID = nID + numIDs[i];
-  }
+  /* put the triples in order of cell and then of record */
+  sortCellExtents(&ext);
 
   /* create the return R object */
   PROTECT(results = allocVector(VECSXP, 3));
   PROTECT(colNamesVec = allocVector(STRSXP, 3));
-  PROTECT(cellVec = allocVector(INTSXP, nID));
-  PROTECT(recordIDsVec = allocVector(INTSXP, nID));
-  PROTECT(recordLengthsVec = allocVector(REALSXP, nID));
-  k = 0;
-  for(i = 0; i < numCells; ++i) {
-    for(j = 0; j < numIDs[i]; ++j) {
-      INTEGER(cellVec)[k] = cellIDs[i];
-      INTEGER(recordIDsVec)[k] = *(recordIDs[i] + j);
-      REAL(recordLengthsVec)[k] = *(recordLengths[i] + j);
-      ++k;
-    }
+  PROTECT(cellVec = allocVector(INTSXP, ext.numItems));
+  PROTECT(recordIDsVec = allocVector(INTSXP, ext.numItems));
+  PROTECT(recordLengthsVec = allocVector(REALSXP, ext.numItems));
+  for(k = 0; k < ext.numItems; ++k) {
+    INTEGER(cellVec)[k] = cellIDs[ext.items[k].cell];
+    INTEGER(recordIDsVec)[k] = ext.items[k].id;
+    REAL(recordLengthsVec)[k] = ext.items[k].extent;
   }
   SET_VECTOR_ELT(results, 0, cellVec);
   SET_VECTOR_ELT(results, 1, recordIDsVec);
@@ -787,15 +688,8 @@ SEXP insideLinearGridCell(SEXP fileNamePrefix, SEXP dsgnmdIDVec, SEXP cellIDsVec
   if(yc) {
     free(yc);
   }
-  if(numIDs) {
-    free(numIDs);
-  }
-  if(newIDs) {
-    free(newIDs);
-  }
-  if(newLengths) {
-    free(newLengths);
-  }
+  freeCellExtents(&ext);
+  freeCellList(&index);
   fclose(fptr);
   remove(TEMP_SHP_FILE);
   UNPROTECT(5);
@@ -1,10 +1,12 @@
 /****************************************************************************** 
 **  File:       irsarea.c
 **  
-**  Purpose:     This file contains code for the getShapeBox() function and
-**               pertains to polygon shapefile types.  The getShapeBox()
-**               function is used to obtain shapefile minimum and maximum values
-**               for the x and y coordinates.
+**  Purpose:     This file contains code for the getRecordIDs(), getShapeBox()
+**               and irsAreaPoints() functions and pertains to polygon
+**               shapefile types.  The getShapeBox() function is used to
+**               obtain shapefile minimum and maximum values for the x and y
+**               coordinates.  The irsAreaPoints() function selects the
+**               sample points for an IRS of an area resource.
 **  Programmer:  Tom Kincaid
 **  Created:     November 30, 2005
 **  Revised:     February 23, 2007
@@ -12,6 +14,7 @@
 **  Revised:     May 5, 2015
 **  Revised:     June 15, 2015
 **  Revised:     July 8, 2015
+**  Revised:     October 19, 2026
 ******************************************************************************/
 
 #include <stdio.h>
@@ -24,6 +27,7 @@
 #include <fcntl.h>
 #include "shapeParser.h"
 #include "grts.h"
+#include "rngStream.h"
 
 /* these functions are found in grts.c */
 extern int combineShpFiles( FILE * newShp, unsigned int * ids, int numIDs );
@@ -32,6 +36,45 @@ extern int createNewTempShpFile( FILE * newShp, char * shapeFileName,
 
 /* these functions are found in shapeParser.c */
 extern int parseHeader( FILE * fptr, Shape * shape );
+extern unsigned int readLittleEndian( unsigned char * buffer, int length );
+extern unsigned int readBigEndian( unsigned char * buffer, int length );
+
+/* these functions are found in grtsarea.c */
+extern int insidePolygon( Point * polygon, int N , double x, double y );
+extern void initPreparedPolygon( PreparedPolygon * prep );
+extern void freePreparedPolygon( PreparedPolygon * prep );
+extern int preparePolygon( PreparedPolygon * prep, Point * points,
+  int numPoints, int * parts, int numParts );
+extern int insidePrepared( PreparedPolygon * prep, double x, double y );
+
+/* these functions are found in pickAreaSamplePoints.c */
+extern void initTriangleSet( TriangleSet * tris );
+extern void freeTriangleSet( TriangleSet * tris );
+extern int triangulateRecord( TriangleSet * tris, Point * points,
+  int numPoints, int * parts, int numParts, Cell * cell );
+extern void pickTrianglePoint( TriangleSet * tris, RngStream * rng,
+  double * xs, double * ys );
+
+/* struct used to sort record IDs together with a position, which is the */
+/* position of a sample point in the vector of sample IDs, the position of */
+/* a record in the vector of design IDs, or the byte offset of a record in */
+/* the temporary shapefile */
+typedef struct idPosStruct IdPos;
+struct idPosStruct {
+  unsigned int id;
+  unsigned int pos;
+};
+
+/* struct for a record that contains sample points, where the points */
+/* are assigned to the positions from start to start + count - 1 of the */
+/* output vectors */
+typedef struct sampRecordStruct SampRecord;
+struct sampRecordStruct {
+  unsigned int id;
+  unsigned int first;  /* position of the first sample point for the record */
+  int count;           /* number of sample points in the record */
+  int start;           /* first position in the output vectors */
+};
 
 
 /****************************************************************************** 
@@ -324,3 +367,543 @@ SEXP getShapeBox( SEXP fileNamePrefix, SEXP dsgnIDVec ) {
   /* return the results */
   return results;
 }
+
+
+/**********************************************************
+** Function:   compareIdPos
+**
+** Purpose:    qsort comparison function that orders IdPos structs by ID
+**             and then by position.
+***********************************************************/
+int compareIdPos( const void * a, const void * b ) {
+
+  const IdPos * pa = (const IdPos *) a;
+  const IdPos * pb = (const IdPos *) b;
+
+  if ( pa->id != pb->id ) {
+    return pa->id < pb->id ? -1 : 1;
+  }
+  if ( pa->pos != pb->pos ) {
+    return pa->pos < pb->pos ? -1 : 1;
+  }
+  return 0;
+}
+
+
+/**********************************************************
+** Function:   compareSampRecord
+**
+** Purpose:    qsort comparison function that orders SampRecord structs by
+**             the position of their first sample point.
+***********************************************************/
+int compareSampRecord( const void * a, const void * b ) {
+
+  const SampRecord * pa = (const SampRecord *) a;
+  const SampRecord * pb = (const SampRecord *) b;
+
+  if ( pa->first != pb->first ) {
+    return pa->first < pb->first ? -1 : 1;
+  }
+  return 0;
+}
+
+
+/**********************************************************
+** Function:   findIdPos
+**
+** Purpose:    Find the first entry for an ID in a sorted array of IdPos
+**             structs.
+** Arguments:  ids,    array of IDs and positions sorted by compareIdPos
+**             numIDs, number of entries in the array
+**             id,     ID to find
+** Return:     index of the first entry for the ID, or
+**             -1 if the ID is not found
+***********************************************************/
+int findIdPos( IdPos * ids, int numIDs, unsigned int id ) {
+
+  int lo = 0;
+  int hi = numIDs;
+  int mid;
+
+  /* find the first entry with an ID that is not less than id */
+  while ( lo < hi ) {
+    mid = lo + (hi - lo) / 2;
+    if ( ids[mid].id < id ) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+
+  if ( lo < numIDs && ids[lo].id == id ) {
+    return lo;
+  }
+  return -1;
+}
+
+
+/**********************************************************
+** Function:   readAreaRecord
+**
+** Purpose:    Read the bounding box, parts and points of the polygon
+**             record that starts at a byte offset in a shapefile.
+** Notes:      Polygon, PolygonZ and PolygonM records all begin with the
+**             box, parts and points, so the Z and M values are not read.
+**             The parts and points arrays are reallocated when they are
+**             too small, so that they can be reused for every record.
+** Arguments:  fptr,      pointer to the shapefile
+**             offset,    byte offset of the record header
+**             box,       array of four values for the bounding box
+**             parts,     array of part offsets
+**             maxParts,  allocated length of the parts array
+**             numParts,  number of parts in the record
+**             points,    array of points
+**             maxPoints, allocated length of the points array
+**             numPoints, number of points in the record
+** Return:     1,  on success
+**             -1, on error
+***********************************************************/
+int readAreaRecord( FILE * fptr, unsigned int offset, double * box,
+                    int ** parts, int * maxParts, int * numParts,
+                    Point ** points, int * maxPoints, int * numPoints ) {
+
+  unsigned char buffer[4];  /* temp buffer for reading from file */
+  void * ptr;               /* temp pointer for reallocated memory */
+
+  /* skip the record header and the shape type */
+  fseek( fptr, offset + 12, SEEK_SET );
+
+  /* read box data */
+  if ( fread( box, sizeof(double), 4, fptr ) != 4 ) {
+    Rprintf( "Error: Reading shape file in C function readAreaRecord.\n" );
+    return -1;
+  }
+
+  /* read the number of parts and the number of points */
+  fread( buffer, sizeof(char), 4, fptr );
+  *numParts = readLittleEndian( buffer, 4 );
+  fread( buffer, sizeof(char), 4, fptr );
+  *numPoints = readLittleEndian( buffer, 4 );
+  if ( *numParts < 0 || *numPoints < 0 ) {
+    Rprintf( "Error: Reading shape file in C function readAreaRecord.\n" );
+    return -1;
+  }
+
+  /* make sure the arrays are large enough */
+  if ( *numParts > *maxParts ) {
+    if ( (ptr = realloc( *parts, sizeof(int) * (*numParts) )) == NULL ) {
+      Rprintf( "Error: Allocating memory in C function readAreaRecord.\n" );
+      return -1;
+    }
+    *parts = (int *) ptr;
+    *maxParts = *numParts;
+  }
+  if ( *numPoints > *maxPoints ) {
+    if ( (ptr = realloc( *points, sizeof(Point) * (*numPoints) )) == NULL ) {
+      Rprintf( "Error: Allocating memory in C function readAreaRecord.\n" );
+      return -1;
+    }
+    *points = (Point *) ptr;
+    *maxPoints = *numPoints;
+  }
+
+  /* read the parts and points data */
+  if ( fread( *parts, sizeof(int), *numParts, fptr ) != *numParts ||
+       fread( *points, sizeof(double), 2 * (*numPoints), fptr ) != 
+       2 * (*numPoints) ) {
+    Rprintf( "Error: Reading shape file in C function readAreaRecord.\n" );
+    return -1;
+  }
+
+  return 1;
+}
+
+
+/**********************************************************
+** Function:   irsAreaPoints
+**
+** Purpose:    This function selects the sample points for an IRS of an
+**             area resource.
+** Algorithm:  The temporary shapefile is created once for the records that
+**             contain sample points, and the byte offset of each record is
+**             found by reading only the record headers.  The records are
+**             then visited in the order in which they first appear in
+**             sampIDVec, and each record is read once.  By default, points
+**             for all of the record's sample points that have not been
+**             placed are drawn uniformly from the bounding box of the
+**             record, first the x coordinates and then the y coordinates,
+**             and the points that are inside the record are kept.  This is
+**             repeated at most maxTryVal times.  The random numbers are
+**             used in the same order as the previous R code, which called
+**             the getShapeBox and pointInPolygonFile functions for each
+**             record, so that the same seed selects the same sample.  When
+**             exactVal is TRUE, each point is instead drawn from triangles
+**             that cover the record.
+** Notes:      A point that is not placed has an mdm value of zero and an
+**             ID of -1.
+** Arguments:  fileNamePrefix, name of the shapefile (without the .shp
+**                             extension), which may be NULL.
+**             sampIDVec,  vector of record IDs, one for each sample point
+**             dsgnIDVec,  vector of the polygon IDs in the frame
+**             dsgnMdmVec, vector of the mdm values for the polygons
+**             maxTryVal,  maximum number of attempts to place the points
+**             exactVal,   TRUE to select each point exactly from triangles
+**                         that cover the record, which may be NULL
+** Return:     results, an R object containing the x and y coordinates, the
+**                      record IDs, and the mdm values for the sample points.
+**                      If an error occurs, a list whose single element is
+**                      NULL is returned.
+***********************************************************/
+SEXP irsAreaPoints( SEXP fileNamePrefix, SEXP sampIDVec, SEXP dsgnIDVec,
+                    SEXP dsgnMdmVec, SEXP maxTryVal, SEXP exactVal ) {
+
+  int i, j, k;                  /* loop counters */
+  int numSamp = length( sampIDVec );   /* number of sample points */
+  int dsgSize = length( dsgnIDVec );   /* number of IDs in the frame */
+  int numRecs = 0;              /* number of records with sample points */
+  int numOffsets = 0;           /* number of records in the shapefile */
+  int numPending;               /* number of points that are not placed */
+  int maxTry = 0;               /* maximum number of attempts */
+  int exact = FALSE;            /* TRUE if the points are selected exactly */
+  int ntry;                     /* number of attempts */
+  int w;                        /* index of an entry in a sorted array */
+  int inside;                   /* TRUE if a point is inside the record */
+  double mdmVal;                /* mdm value for the current record */
+  IdPos * sites = NULL;         /* sample IDs sorted with their positions */
+  IdPos * dsgn = NULL;          /* frame IDs sorted with their positions */
+  IdPos * offsets = NULL;       /* shapefile IDs sorted with their offsets */
+  SampRecord * recs = NULL;     /* records that contain sample points */
+  unsigned int * ids = NULL;    /* IDs of the records with sample points */
+  int * pending = NULL;         /* positions of the points not placed */
+  unsigned int fileNameLen = 0; /* length of the shapefile name */
+  char * restrict shpFileName = NULL;  /* stores the full .shp file name */
+  int singleFile = FALSE;       /* indicator for the number of shapefiles */
+  FILE * newShp = NULL;         /* pointer to the temporary shapefile */
+  FILE * fptr = NULL;           /* pointer to the temporary shapefile */
+  Shape shape;                  /* Shape struct for the file header */
+  unsigned int filePosition;    /* byte offset within the shapefile */
+  unsigned char buffer[4];      /* temp buffer for reading from file */
+  double box[4];                /* bounding box of the current record */
+  Point bdrBox[5];              /* bounding box of the current record */
+  int * parts = NULL;           /* part offsets of the current record */
+  int maxParts = 0;             /* allocated length of parts */
+  int numParts;                 /* number of parts in the current record */
+  Point * points = NULL;        /* points of the current record */
+  int maxPoints = 0;            /* allocated length of points */
+  int numPoints;                /* number of points in the current record */
+  PreparedPolygon prep;         /* prepared record */
+  TriangleSet tris;             /* triangles used to select points exactly */
+  Cell cell;                    /* bounding box of the record as a cell */
+  int error = FALSE;            /* TRUE if an error occurred */
+
+  /* output vectors */
+  double * x;
+  double * y;
+  int * id;
+  double * mdm;
+
+  /* R objects for returning results to R */
+  SEXP xVec, yVec, idVec, mdmVec, colNamesVec;
+  SEXP results = NULL;
+
+  /* copy the option values into C variables */
+  PROTECT( maxTryVal = AS_INTEGER( maxTryVal ) );
+  maxTry = INTEGER( maxTryVal )[0];
+  UNPROTECT(1);
+  if ( exactVal != R_NilValue ) {
+    PROTECT( exactVal = AS_LOGICAL( exactVal ) );
+    exact = LOGICAL( exactVal )[0] == TRUE;
+    UNPROTECT(1);
+  }
+
+  /* allocate the sorted ID arrays */
+  sites = (IdPos *) malloc( sizeof(IdPos) * (numSamp + 1) );
+  dsgn = (IdPos *) malloc( sizeof(IdPos) * (dsgSize + 1) );
+  recs = (SampRecord *) malloc( sizeof(SampRecord) * (numSamp + 1) );
+  ids = (unsigned int *) malloc( sizeof(unsigned int) * (numSamp + 1) );
+  pending = (int *) malloc( sizeof(int) * (numSamp + 1) );
+  if ( sites == NULL || dsgn == NULL || recs == NULL || ids == NULL ||
+       pending == NULL ) {
+    Rprintf( "Error: Allocating memory in C function irsAreaPoints.\n" );
+    free( sites );
+    free( dsgn );
+    free( recs );
+    free( ids );
+    free( pending );
+    PROTECT( results = allocVector( VECSXP, 1 ) );
+    UNPROTECT(1);
+    return results;
+  }
+
+  /* group the sample points by record, where the records are ordered by */
+  /* the first appearance of their IDs in sampIDVec */
+  for ( i = 0; i < numSamp; ++i ) {
+    sites[i].id = INTEGER( sampIDVec )[i];
+    sites[i].pos = i;
+  }
+  qsort( sites, numSamp, sizeof(IdPos), compareIdPos );
+  for ( i = 0; i < numSamp; i = j ) {
+    for ( j = i + 1; j < numSamp && sites[j].id == sites[i].id; ++j );
+    recs[numRecs].id = sites[i].id;
+    recs[numRecs].first = sites[i].pos;
+    recs[numRecs].count = j - i;
+    ids[numRecs] = sites[i].id;
+    ++numRecs;
+  }
+  qsort( recs, numRecs, sizeof(SampRecord), compareSampRecord );
+  for ( k = 0, i = 0; i < numRecs; ++i ) {
+    recs[i].start = k;
+    k += recs[i].count;
+  }
+
+  /* sort the frame IDs so that the mdm value of a record can be found */
+  for ( i = 0; i < dsgSize; ++i ) {
+    dsgn[i].id = INTEGER( dsgnIDVec )[i];
+    dsgn[i].pos = i;
+  }
+  qsort( dsgn, dsgSize, sizeof(IdPos), compareIdPos );
+
+  /* see if a specific file was sent */
+  if ( fileNamePrefix != R_NilValue ) {
+
+    /* create the full .shp file name */
+    fileNameLen = strlen(CHAR(STRING_ELT(fileNamePrefix, 0))) + strlen(".shp");
+    if ((shpFileName = (char * restrict) malloc(fileNameLen + 1)) == NULL ) {
+      Rprintf( "Error: Allocating memory in C function irsAreaPoints.\n" );
+      error = TRUE;
+    } else {
+      strcpy( shpFileName, CHAR(STRING_ELT(fileNamePrefix, 0)));
+      strcat( shpFileName, ".shp" );
+      singleFile = TRUE;
+    }
+  }
+
+  /* create the temporary shapefile for the records with sample points */
+  if ( error == FALSE ) {
+    if ( ( newShp = fopen( TEMP_SHP_FILE, "wb" )) == NULL ) {
+      Rprintf( "Error: Creating temporary shapefile %s.\n", TEMP_SHP_FILE );
+      Rprintf( "Error: Occured in C function irsAreaPoints.\n" );
+      error = TRUE;
+    } else if ( singleFile == FALSE ) {
+      if ( combineShpFiles( newShp, ids, numRecs ) == -1 ) {
+        Rprintf( "Error: Combining multiple shapefiles in C function irsAreaPoints.\n" );
+        error = TRUE;
+      }
+      fclose( newShp );
+    } else {
+      if ( createNewTempShpFile( newShp, shpFileName, ids, numRecs ) == -1 ) {
+        Rprintf( "Error: Creating temporary shapefile in C function irsAreaPoints.\n" );
+        error = TRUE;
+      }
+      fclose( newShp );
+    }
+  }
+
+  /* open the temporary shapefile and parse the main file header */
+  shape.records = NULL;
+  shape.numRecords = 0;
+  if ( error == FALSE ) {
+    if ( (fptr = fopen( TEMP_SHP_FILE, "rb" )) == NULL ) {
+      Rprintf( "Error: Opening shapefile in C function irsAreaPoints.\n" );
+      error = TRUE;
+    } else if ( parseHeader( fptr, &shape ) == -1 ) {
+      Rprintf( "Error: Reading main file header in C function irsAreaPoints.\n" );
+      error = TRUE;
+    } else if ( shape.shapeType != POLYGON && shape.shapeType != POLYGON_Z &&
+                shape.shapeType != POLYGON_M ) {
+      Rprintf( "Error: The shapefile type must be polygon in C function irsAreaPoints.\n" );
+      error = TRUE;
+    }
+  }
+
+  /* read the record headers to find the byte offset of each record */
+  if ( error == FALSE ) {
+    if ( (offsets = (IdPos *) malloc( sizeof(IdPos) * (numRecs + 1) )) 
+         == NULL ) {
+      Rprintf( "Error: Allocating memory in C function irsAreaPoints.\n" );
+      error = TRUE;
+    } else {
+      fseek( fptr, 100, SEEK_SET );
+      filePosition = 100;
+      while ( filePosition < shape.fileLength*2 && numOffsets < numRecs ) {
+        fread( buffer, sizeof(char), 4, fptr );
+        offsets[numOffsets].id = readBigEndian( buffer, 4 );
+        offsets[numOffsets].pos = filePosition;
+        if ( fread( buffer, sizeof(char), 4, fptr ) == 0 ) {
+          Rprintf( "Error: Reading shape file in C function irsAreaPoints.\n" );
+          error = TRUE;
+          break;
+        }
+        ++numOffsets;
+        filePosition += 8 + readBigEndian( buffer, 4 ) * 2;
+        fseek( fptr, filePosition, SEEK_SET );
+      }
+      qsort( offsets, numOffsets, sizeof(IdPos), compareIdPos );
+    }
+  }
+
+  /* return when an error occurred */
+  if ( error == TRUE ) {
+    if ( fptr ) {
+      fclose( fptr );
+    }
+    remove( TEMP_SHP_FILE );
+    if ( singleFile == TRUE ) {
+      free( shpFileName );
+    }
+    free( sites );
+    free( dsgn );
+    free( recs );
+    free( ids );
+    free( pending );
+    free( offsets );
+    PROTECT( results = allocVector( VECSXP, 1 ) );
+    UNPROTECT(1);
+    return results;
+  }
+
+  /* allocate the output vectors, where points that are not placed keep */
+  /* zero values */
+  PROTECT( xVec = allocVector( REALSXP, numSamp ) );
+  PROTECT( yVec = allocVector( REALSXP, numSamp ) );
+  PROTECT( idVec = allocVector( INTSXP, numSamp ) );
+  PROTECT( mdmVec = allocVector( REALSXP, numSamp ) );
+  x = REAL( xVec );
+  y = REAL( yVec );
+  id = INTEGER( idVec );
+  mdm = REAL( mdmVec );
+  for ( i = 0; i < numSamp; ++i ) {
+    x[i] = y[i] = mdm[i] = 0.0;
+    id[i] = 0;
+  }
+
+  /* obtain the R random number generator type and seed */
+  GetRNGstate();
+
+  /* place the sample points for each record */
+  initPreparedPolygon( &prep );
+  initTriangleSet( &tris );
+  for ( i = 0; i < numRecs && error == FALSE; ++i ) {
+
+    /* find the record in the shapefile and its mdm value */
+    if ( (w = findIdPos( offsets, numOffsets, recs[i].id )) == -1 ) {
+      continue;
+    }
+    if ( readAreaRecord( fptr, offsets[w].pos, box, &parts, &maxParts,
+                         &numParts, &points, &maxPoints, &numPoints ) == -1 ) {
+      error = TRUE;
+      break;
+    }
+    w = findIdPos( dsgn, dsgSize, recs[i].id );
+    mdmVal = w >= 0 ? REAL( dsgnMdmVec )[dsgn[w].pos] : 0.0;
+
+    if ( exact == TRUE ) {
+
+      /* draw each point from the triangles that cover the record */
+      cell.xMin = box[0];
+      cell.yMin = box[1];
+      cell.xMax = box[2];
+      cell.yMax = box[3];
+      if ( triangulateRecord( &tris, points, numPoints, parts, numParts,
+                              &cell ) == -1 ) {
+        error = TRUE;
+        break;
+      }
+      for ( k = recs[i].start; k < recs[i].start + recs[i].count; ++k ) {
+        if ( tris.numTris > 0 ) {
+          pickTrianglePoint( &tris, NULL, &x[k], &y[k] );
+          mdm[k] = mdmVal;
+        }
+        id[k] = mdm[k] > 0.0 ? recs[i].id : -1;
+      }
+
+    } else {
+
+      /* prepare the record and its bounding box */
+      if ( preparePolygon( &prep, points, numPoints, parts, numParts )
+           == -1 ) {
+        Rprintf( "Error: Allocating memory in C function irsAreaPoints.\n" );
+        error = TRUE;
+        break;
+      }
+      bdrBox[0].X = box[0];
+      bdrBox[0].Y = box[1];
+      bdrBox[1].X = box[0];
+      bdrBox[1].Y = box[3];
+      bdrBox[2].X = box[2];
+      bdrBox[2].Y = box[3];
+      bdrBox[3].X = box[2];
+      bdrBox[3].Y = box[1];
+      bdrBox[4].X = box[0];
+      bdrBox[4].Y = box[1];
+
+      /* draw points for the points that are not placed until all of them */
+      /* are inside the record */
+      numPending = recs[i].count;
+      for ( k = 0; k < numPending; ++k ) {
+        pending[k] = recs[i].start + k;
+      }
+      for ( ntry = 0; numPending > 0 && ntry < maxTry; ++ntry ) {
+        for ( k = 0; k < numPending; ++k ) {
+          x[pending[k]] = runif( box[0], box[2] );
+        }
+        for ( k = 0; k < numPending; ++k ) {
+          y[pending[k]] = runif( box[1], box[3] );
+        }
+        for ( j = 0, k = 0; k < numPending; ++k ) {
+          inside = insidePolygon( bdrBox, 5, x[pending[k]], y[pending[k]] )
+                   == 1 &&
+                   insidePrepared( &prep, x[pending[k]], y[pending[k]] ) == 1;
+          mdm[pending[k]] = inside ? mdmVal : 0.0;
+          id[pending[k]] = mdm[pending[k]] > 0.0 ? recs[i].id : -1;
+          if ( mdm[pending[k]] == 0.0 ) {
+            pending[j++] = pending[k];
+          }
+        }
+        numPending = j;
+      }
+    }
+  }
+  freePreparedPolygon( &prep );
+  freeTriangleSet( &tris );
+
+  /* write out the R random number generator type and seed */
+  PutRNGstate();
+
+  if ( error == FALSE ) {
+
+    /* create the list for returning results to R */
+    PROTECT( results = allocVector( VECSXP, 4 ) );
+    PROTECT( colNamesVec = allocVector( STRSXP, 4 ) );
+    SET_VECTOR_ELT( results, 0, xVec );
+    SET_VECTOR_ELT( results, 1, yVec );
+    SET_VECTOR_ELT( results, 2, idVec );
+    SET_VECTOR_ELT( results, 3, mdmVec );
+    SET_STRING_ELT( colNamesVec, 0, mkChar( "x" ) );
+    SET_STRING_ELT( colNamesVec, 1, mkChar( "y" ) );
+    SET_STRING_ELT( colNamesVec, 2, mkChar( "id" ) );
+    SET_STRING_ELT( colNamesVec, 3, mkChar( "mdm" ) );
+    setAttrib( results, R_NamesSymbol, colNamesVec );
+    UNPROTECT(6);
+  } else {
+    PROTECT( results = allocVector( VECSXP, 1 ) );
+    UNPROTECT(5);
+  }
+
+  /* clean up */
+  fclose( fptr );
+  remove( TEMP_SHP_FILE );
+  if ( singleFile == TRUE ) {
+    free( shpFileName );
+  }
+  free( sites );
+  free( dsgn );
+  free( recs );
+  free( ids );
+  free( pending );
+  free( offsets );
+  free( parts );
+  free( points );
+
+  return results;
+}
@@ -12,6 +12,7 @@
 **  Revised:      May 5, 2015
 **  Revised:      June 15, 2015
 **  Revised:      August 10, 2017
+**  Revised:      October 19, 2026
 ******************************************************************************/
 
 #include <stdio.h>
@@ -36,8 +37,12 @@ extern unsigned int readLittleEndian( unsigned char * buffer, int length );
 extern unsigned int readBigEndian( unsigned char * buffer, int length );
 
 /* these functions are found in grtslin.c */
-extern void addSegment( Segment ** head, Segment * seg );
-extern void deallocateSegments( Segment * head );
+extern void initSegmentTable( SegmentTable * table );
+extern void freeSegmentTable( SegmentTable * table );
+extern Segment * nextSegment( SegmentTable * table );
+extern double sumSegments( SegmentTable * table );
+extern int findSegment( SegmentTable * table, double pos );
+extern void segmentPoint( Segment * seg, double len, double * x, double * y );
 
 /****************************************************************************** 
 ** Function:   linSampleIRS
@@ -47,7 +52,10 @@ extern void deallocateSegments( Segment * head );
 ** Notes:      It is assumed that if a record has multiple parts 
 **             they are not connected.
 **             To save memory one record at a time is read from the shape
-**             file and processed before reading in the next.
+**             file and processed before reading in the next.  The segments
+**             of a record that contains sample positions are stored once
+**             in a table with their cumulative lengths, and the segment
+**             for each position is found by a binary search.
 ** Arguments:  fileNamePrefix, name of the shapefile (without the .shp
 **                             extension), which may be NULL.
 **             lenCumSumVec, vector of cumulative sum of polyline (record)
@@ -83,19 +91,19 @@ SEXP linSampleIRS( SEXP fileNamePrefix, SEXP lenCumSumVec, SEXP sampPosVec,
   PolygonM * polyM;           /* temp PolygonM data storage */
   unsigned char buffer[4];    /* buffer used for reading from file */
 
-  /* variables for storing linked list of segment structs and traversing them */
-  Segment * seg;
-  Segment * segmentList = NULL;
-  Segment * temp;
+  /* variables for storing the segments of a record */
+  Segment * seg;              /* slot for the next segment in the table */
+  SegmentTable segments;      /* segments of the current record */
+  int numParts;               /* number of parts in the current record */
+  int numPoints;              /* number of points in the current record */
+  int * parts;                /* part offsets of the current record */
+  Point * points;             /* points of the current record */
 
   /* vars used for picking sample points */
   unsigned int * id = NULL;  /* the polyline ID array for sample positions */
   double * pos = NULL;       /* the sample position within a polyline */
   double dx, dy;
   double length;
-  double cumSum;  /* accumulative sum of lengths up to selected point */
-  double len;
-  double lx, ly;
   unsigned int * samp = NULL;  
   double * x = NULL;
   double * y = NULL;
@@ -299,11 +307,8 @@ SEXP linSampleIRS( SEXP fileNamePrefix, SEXP lenCumSumVec, SEXP sampPosVec,
   fseek( fptr, 100, SEEK_SET );
   filePosition = 100;
 
-  /* deallocate any memory used for the segment list */
-  deallocateSegments( segmentList );
-  segmentList = NULL;
-
   /* determine the coordinates for each sample point */
+  initSegmentTable( &segments );
   while ( filePosition < shape.fileLength*2 && sampInd < smpSize ) {
 
     /* read the record number */
@@ -599,23 +604,45 @@ SEXP linSampleIRS( SEXP fileNamePrefix, SEXP lenCumSumVec, SEXP sampPosVec,
 
     }
 
+    /* find the parts and points of the record */
     if ( shape.shapeType == POLYLINE ) {
+      numParts = record.poly->numParts;
+      numPoints = record.poly->numPoints;
+      parts = record.poly->parts;
+      points = record.poly->points;
+    } else if ( shape.shapeType == POLYLINE_Z ) {
+      numParts = record.polyZ->numParts;
+      numPoints = record.polyZ->numPoints;
+      parts = record.polyZ->parts;
+      points = record.polyZ->points;
+    } else {
+      numParts = record.polyM->numParts;
+      numPoints = record.polyM->numPoints;
+      parts = record.polyM->parts;
+      points = record.polyM->points;
+    }
+
+    /* store the segments of the record once for all of the sample */
+    /* positions that are in it */
+    segments.numSegs = 0;
+    if ( id[sampInd] == record.number ) {
 
       /* go through each segment in this record */
       partIndx = 1; 
-      for ( i = 0; i < record.poly->numPoints-1; ++i ) {
+      for ( i = 0; i < numPoints-1; ++i ) {
 
         /* if there are multiple parts assume that the parts are not connected*/
-        if ( record.poly->numParts > 1 && partIndx < record.poly->numParts ) {
-          if ( (i + 1) == record.poly->parts[partIndx] ) {
+        if ( numParts > 1 && partIndx < numParts ) {
+          if ( (i + 1) == parts[partIndx] ) {
             ++partIndx;
             continue;
           }
         }
 
-        /* allocate new segment struct */
-        if ( (seg = (Segment *) malloc( sizeof( Segment ) )) == NULL ) {
+        /* get the slot for the next segment */
+        if ( (seg = nextSegment( &segments )) == NULL ) {
           Rprintf( "Error: Allocating memory in C function linSampleIRS.\n" );
+          freeSegmentTable( &segments );
           PROTECT( results = allocVector( VECSXP, 1 ) );
           UNPROTECT( 1 );
           fclose( fptr );
@@ -624,148 +651,50 @@ SEXP linSampleIRS( SEXP fileNamePrefix, SEXP lenCumSumVec, SEXP sampPosVec,
         }
 
         /* get length of the line segment */
-        dx = record.poly->points[i+1].X - record.poly->points[i].X;
-        dy = record.poly->points[i+1].Y - record.poly->points[i].Y;
+        dx = points[i+1].X - points[i].X;
+        dy = points[i+1].Y - points[i].Y;
         length = sqrt( dx*dx + dy*dy );
    
-        /* assign values and add the segment to the segment list */ 
-        seg->p1.X = record.poly->points[i].X;
-        seg->p1.Y = record.poly->points[i].Y;
-        seg->p2.X = record.poly->points[i+1].X;
-        seg->p2.Y = record.poly->points[i+1].Y;
+        /* assign values and add the segment to the segment table */ 
+        seg->p1.X = points[i].X;
+        seg->p1.Y = points[i].Y;
+        seg->p2.X = points[i+1].X;
+        seg->p2.Y = points[i+1].Y;
         seg->recordNumber = record.number;
         seg->length = length;
-        addSegment( &segmentList, seg );
+        ++segments.numSegs;
 
       }
+      sumSegments( &segments );
+    }
 
-      /* deallocate memory for the record */
+    /* deallocate memory for the record */
+    if ( shape.shapeType == POLYLINE ) {
       free( record.poly->points );
       free( record.poly->parts );
       free( record.poly );
-
     } else if ( shape.shapeType == POLYLINE_Z ) {
-
-      /* go through each segment in this record */
-      partIndx = 1; 
-      for ( i = 0; i < record.polyZ->numPoints-1; ++i ) {
-
-        /* if there are multiple parts assume that the parts are not connected*/
-        if ( record.polyZ->numParts > 1 && partIndx < record.polyZ->numParts ) {
-          if ( (i + 1) == record.polyZ->parts[partIndx] ) {
-            ++partIndx;
-            continue;
-          }
-        }
-
-        /* allocate new segment struct */
-        if ( (seg = (Segment *) malloc( sizeof( Segment ) )) == NULL ) {
-          Rprintf( "Error: Allocating memory in C function linSampleIRS.\n" );
-          PROTECT( results = allocVector( VECSXP, 1 ) );
-          UNPROTECT( 1 );
-          fclose( fptr );
-          remove( TEMP_SHP_FILE );
-          return results;
-        }
-
-        /* get length of the line segment */
-        dx = record.polyZ->points[i+1].X - record.polyZ->points[i].X;
-        dy = record.polyZ->points[i+1].Y - record.polyZ->points[i].Y;
-        length = sqrt( dx*dx + dy*dy );
-   
-        /* assign values and add the segment to the segment list */ 
-        seg->p1.X = record.polyZ->points[i].X;
-        seg->p1.Y = record.polyZ->points[i].Y;
-        seg->p2.X = record.polyZ->points[i+1].X;
-        seg->p2.Y = record.polyZ->points[i+1].Y;
-        seg->recordNumber = record.number;
-        seg->length = length;
-        addSegment( &segmentList, seg );
-
-      }
-
-      /* deallocate memory for the record */
       free( record.polyZ->mArray );
       free( record.polyZ->zArray );
       free( record.polyZ->points );
       free( record.polyZ->parts );
       free( record.polyZ );
-
     } else {
-
-      /* go through each segment in this record */
-      partIndx = 1; 
-      for ( i = 0; i < record.polyM->numPoints-1; ++i ) {
-
-        /* if there are multiple parts assume that the parts are not connected*/
-        if ( record.polyM->numParts > 1 && partIndx < record.polyM->numParts ) {
-          if ( (i + 1) == record.polyM->parts[partIndx] ) {
-            ++partIndx;
-            continue;
-          }
-        }
-
-        /* allocate new segment struct */
-        if ( (seg = (Segment *) malloc( sizeof( Segment ) )) == NULL ) {
-          Rprintf( "Error: Allocating memory in C function linSampleIRS.\n" );
-          PROTECT( results = allocVector( VECSXP, 1 ) );
-          UNPROTECT( 1 );
-          fclose( fptr );
-          remove( TEMP_SHP_FILE );
-          return results;
-        }
-
-        /* get length of the line segment */
-        dx = record.polyM->points[i+1].X - record.polyM->points[i].X;
-        dy = record.polyM->points[i+1].Y - record.polyM->points[i].Y;
-        length = sqrt( dx*dx + dy*dy );
-   
-        /* assign values and add the segment to the segment list */ 
-        seg->p1.X = record.polyM->points[i].X;
-        seg->p1.Y = record.polyM->points[i].Y;
-        seg->p2.X = record.polyM->points[i+1].X;
-        seg->p2.Y = record.polyM->points[i+1].Y;
-        seg->recordNumber = record.number;
-        seg->length = length;
-        addSegment( &segmentList, seg );
-
-      }
-
-      /* deallocate memory for the record */
       free( record.polyM->mArray );
       free( record.polyM->points );
       free( record.polyM->parts );
       free( record.polyM );
-
     }
 
     /* while the sample ID equals the shapefile record number, determine sample
     ** coordinates */
-    while ( id[sampInd] == record.number ) {
-      temp = segmentList;
-      cumSum = 0.0;
-      while ( TRUE && temp != NULL ) {
-        cumSum += temp->length;
-        if ( pos[sampInd] < cumSum ) {
-          break;
-        }
-        temp = temp->next;
-      }
-      samp[sampInd] = temp->recordNumber;
+    while ( id[sampInd] == record.number && segments.numSegs > 0 ) {
+      j = findSegment( &segments, pos[sampInd] );
+      samp[sampInd] = segments.segs[j].recordNumber;
 
       /* determine coordinates for the sample point */
-      len =  pos[sampInd] - cumSum;
-      dx = temp->p2.X - temp->p1.X;
-      dy = temp->p2.Y - temp->p1.Y;
-      if ( dx != 0 ) {
-        lx = sign(dx) * sqrt( (len*len) / ( 1 + (dy*dy)/(dx*dx) ));
-        ly = lx * (dy/dx);
-      } else {
-        lx = 0.0;
-        ly = -sign(dy) * len;
-      }
-      x[sampInd] = temp->p1.X + lx;
-      y[sampInd] = temp->p1.Y + ly;
+      segmentPoint( &segments.segs[j], pos[sampInd] - segments.cumLen[j],
+                    &x[sampInd], &y[sampInd] );
       ++sampInd;
       if ( sampInd == smpSize ) {
     	   break;
@@ -773,11 +702,8 @@ SEXP linSampleIRS( SEXP fileNamePrefix, SEXP lenCumSumVec, SEXP sampPosVec,
 
     }
 
-    /* deallocate memory for the segment list */
-    deallocateSegments( segmentList );
-    segmentList = NULL;
-
   }
+  freeSegmentTable( &segments );
 
   /* convert arrays to an R object */
   PROTECT( results = allocVector( VECSXP, 3 ) );
@@ -8,9 +8,20 @@
 **  Revised:     June 15, 2015
 **  Revised:     November 5, 2015
 **  Revised:     August 10, 2017
+**  Revised:     October 19, 2026
 **  Description:
 **    For each value in the set of shapefile record IDs, select a sample point
-**    from the shapefile record 
+**    from the shapefile record.  By default the points are selected using
+**    R's random number generator in the order of the records in the
+**    shapefile.  When random number streams are requested, the points for
+**    each cell are selected using a stream whose number is the position of
+**    the cell, so the cells can be processed in parallel when the records
+**    fit in memory and the sample does not depend on the number of threads.
+**    When exact selection is requested, each point is drawn from triangles
+**    that cover the intersection of the record and the cell, so the point is
+**    found using one set of draws and is only missed when the intersection
+**    has no area.  Otherwise records with many points are prepared once for
+**    the repeated point in polygon tests of rejection sampling.
 **  Arguments:
 **    fileNamePrefix = the shapefile name
 **    shpIDsVec = vector of shapefile record IDs to use in the calculations
@@ -20,6 +31,15 @@
 **    dxVal = x-axis size of the grid cells
 **    dyVal = y-axis size of the grid cells
 **    maxTryVal = maximum number of tries to obtain a sample point
+**    rngStreamsVal = TRUE to select the points using random number streams,
+**      FALSE or NULL to use R's random number generator
+**    frameBudgetVal = memory budget in megabytes for holding the records in
+**      memory when streams are used, or NULL to use the default budget
+**    threadsVal = number of threads used when streams are used and the
+**      records are held in memory, or NULL to use the OpenMP default
+**    exactVal = TRUE to select each point exactly from triangles that cover
+**      the intersection of the record and the cell, FALSE or NULL to select
+**      the point by rejection sampling using up to maxTryVal tries
 **  Results
 **    An R list object of named results that contains the following items:
 **    bp = logical vector indicating whether a grid cell did not receive a
@@ -38,6 +58,10 @@
 #include <Rmath.h>
 #include "shapeParser.h"
 #include "grts.h"
+#include "rngStream.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 #define LEFT   1
 #define RIGHT  2
@@ -54,14 +78,938 @@ extern int combineShpFiles(FILE * newShp, unsigned int * ids, int numIDs);
 extern int createNewTempShpFile(FILE * newShp, char * shapeFileName,
                                 unsigned int * ids, int numIDs);
 
-/* This function is found in grtsarea.c */
+/* These functions are found in grtsarea.c */
 extern int insidePolygon(Point * polygon, int N , double x, double y);
+extern void initPreparedPolygon(PreparedPolygon * prep);
+extern void freePreparedPolygon(PreparedPolygon * prep);
+extern int preparePolygon(PreparedPolygon * prep, Point * points,
+                          int numPoints, int * parts, int numParts);
+extern int insidePrepared(PreparedPolygon * prep, double x, double y);
+
+/* These functions are found in frameStore.c */
+extern void initFrameStore(FrameStore * store);
+extern void freeFrameStore(FrameStore * store);
+extern int loadFrameStore(FrameStore * store, Shape * shape, FILE * fptr,
+                          unsigned int * dsgnmdID, int dsgSize, double budget);
+
+/* These functions are found in rngStream.c */
+extern unsigned long long rngStreamSeed(void);
+extern void initRngStream(RngStream * rng, unsigned long long seed,
+                          unsigned long long stream);
+extern double rngStreamRunif(RngStream * rng, double a, double b);
+
+/* These functions are found in grtsarea.c */
+extern void initClipBuffer(ClipBuffer * buf);
+extern void freeClipBuffer(ClipBuffer * buf);
+extern double clipPolygonArea(Cell * cell, Point * points, int start, int end,
+                              ClipBuffer * buf);
+
+/* struct used to find the record in the frame store for a record ID */
+typedef struct recIndexStruct RecIndex;
+struct recIndexStruct {
+  unsigned int id;
+  int rec;
+};
+
+
+/* struct used to sort the cells by the record in the frame store that */
+/* they select a point from */
+typedef struct cellIndexStruct CellIndex;
+struct cellIndexStruct {
+  int rec;
+  int cell;
+};
+
+
+/**********************************************************
+** Function:   compareRecIndex
+**
+** Purpose:    qsort and bsearch comparison function that orders RecIndex
+**             structs by ID.
+***********************************************************/
+int compareRecIndex(const void * a, const void * b) {
+
+  const RecIndex * pa = (const RecIndex *) a;
+  const RecIndex * pb = (const RecIndex *) b;
+
+  if(pa->id != pb->id) {
+    return pa->id < pb->id ? -1 : 1;
+  }
+  return 0;
+}
+
+
+/**********************************************************
+** Function:   compareCellIndex
+**
+** Purpose:    qsort comparison function that orders CellIndex structs by
+**             record and then by cell.
+***********************************************************/
+int compareCellIndex(const void * a, const void * b) {
+
+  const CellIndex * pa = (const CellIndex *) a;
+  const CellIndex * pb = (const CellIndex *) b;
+
+  if(pa->rec != pb->rec) {
+    return pa->rec < pb->rec ? -1 : 1;
+  }
+  if(pa->cell != pb->cell) {
+    return pa->cell < pb->cell ? -1 : 1;
+  }
+  return 0;
+}
+
+
+/**********************************************************
+** Function:   initTriangleSet
+**
+** Purpose:    Initialize an empty triangle set.
+** Arguments:  tris, triangle set to initialize
+** Return:     none
+***********************************************************/
+void initTriangleSet(TriangleSet * tris) {
+
+  tris->numTris = 0;
+  tris->maxTris = 0;
+  tris->tri = NULL;
+  tris->cumArea = NULL;
+  tris->numEdges = 0;
+  tris->maxEdges = 0;
+  tris->edges = NULL;
+  tris->ys = NULL;
+  tris->live = NULL;
+  tris->active = NULL;
+  initClipBuffer(&tris->clip);
+
+  return;
+}
+
+
+/**********************************************************
+** Function:   freeTriangleSet
+**
+** Purpose:    Free the memory used by a triangle set and reset it to an
+**             empty set.
+** Arguments:  tris, triangle set to free
+** Return:     none
+***********************************************************/
+void freeTriangleSet(TriangleSet * tris) {
+
+  free(tris->tri);
+  free(tris->cumArea);
+  free(tris->edges);
+  free(tris->ys);
+  free(tris->live);
+  free(tris->active);
+  freeClipBuffer(&tris->clip);
+  initTriangleSet(tris);
+
+  return;
+}
+
+
+/**********************************************************
+** Function:   compareDouble
+**
+** Purpose:    qsort comparison function that orders doubles.
+***********************************************************/
+int compareDouble(const void * a, const void * b) {
+
+  double da = *(const double *) a;
+  double db = *(const double *) b;
+
+  return da < db ? -1 : (da > db ? 1 : 0);
+}
+
+
+/**********************************************************
+** Function:   compareEdge
+**
+** Purpose:    qsort comparison function that orders edges by their
+**             lower y value.
+***********************************************************/
+int compareEdge(const void * a, const void * b) {
+
+  return compareDouble(&((const Edge *) a)->y0, &((const Edge *) b)->y0);
+}
+
+
+/**********************************************************
+** Function:   compareSlabEdge
+**
+** Purpose:    qsort comparison function that orders the edges that cross
+**             a slab by their x value at the middle of the slab.
+***********************************************************/
+int compareSlabEdge(const void * a, const void * b) {
+
+  return compareDouble(&((const SlabEdge *) a)->xMid,
+                       &((const SlabEdge *) b)->xMid);
+}
+
+
+/**********************************************************
+** Function:   addTriangle
+**
+** Purpose:    Add a triangle to a triangle set when its area is positive.
+** Arguments:  tris,   triangle set
+**             x0..y2, vertices of the triangle
+** Return:     1,  on success
+**             -1, on error
+***********************************************************/
+int addTriangle(TriangleSet * tris, double x0, double y0, double x1,
+                double y1, double x2, double y2) {
+
+  double area;           /* area of the triangle */
+  double * t;            /* vertices of the new triangle */
+  void * ptr;            /* temp pointer for reallocated memory */
+  int newMax;            /* new allocated number of triangles */
+
+  area = 0.5 * fabs((x1 - x0) * (y2 - y0) - (x2 - x0) * (y1 - y0));
+  if(area <= 0.0) {
+    return 1;
+  }
+  if(tris->numTris == tris->maxTris) {
+    newMax = tris->maxTris > 0 ? 2 * tris->maxTris : 64;
+    if((ptr = realloc(tris->tri, sizeof(double) * 6 * newMax)) == NULL) {
+      return -1;
+    }
+    tris->tri = (double *) ptr;
+    if((ptr = realloc(tris->cumArea, sizeof(double) * newMax)) == NULL) {
+      return -1;
+    }
+    tris->cumArea = (double *) ptr;
+    tris->maxTris = newMax;
+  }
+  t = &tris->tri[6 * tris->numTris];
+  t[0] = x0; t[1] = y0;
+  t[2] = x1; t[3] = y1;
+  t[4] = x2; t[5] = y2;
+  tris->cumArea[tris->numTris] = area +
+    (tris->numTris > 0 ? tris->cumArea[tris->numTris - 1] : 0.0);
+  ++tris->numTris;
+
+  return 1;
+}
+
+
+/**********************************************************
+** Function:   triangulateRecord
+**
+** Purpose:    Find triangles that exactly cover the intersection of a
+**             polygon record and a grid cell.
+** Algorithm:  Each part of the record is clipped to the cell, and the
+**             non-horizontal edges of the clipped parts are collected.
+**             The y values of the vertices divide the cell into slabs.
+**             No vertex lies inside a slab, so every edge that crosses a
+**             slab crosses all of it, and, since the rings do not cross
+**             each other, the edges keep their left to right order across
+**             the slab.  Taking the edges in that order, the region between
+**             the first and second edges, the third and fourth edges, and
+**             so on, is inside an odd number of parts, which is the rule
+**             used by pickRecordPoint.  Each such region is a trapezoid
+**             that is divided into two triangles.
+** Arguments:  tris,      triangle set, which is cleared first
+**             points,    points of the record
+**             numPoints, number of points in the record
+**             parts,     offsets of the first point of each part
+**             numParts,  number of parts in the record
+**             cell,      grid cell
+** Return:     1,  on success
+**             -1, on error
+***********************************************************/
+int triangulateRecord(TriangleSet * tris, Point * points, int numPoints,
+                      int * parts, int numParts, Cell * cell) {
+
+  int j, k;              /* loop counters */
+  int end;               /* index of the last point of a part */
+  int numYs;             /* number of distinct y values */
+  int numLive;           /* number of edges that have not ended */
+  int numActive;         /* number of edges that cross the current slab */
+  int next;              /* next edge to enter the sweep */
+  int newMax;            /* new allocated number of edges */
+  double yLo, yHi;       /* bottom and top of the current slab */
+  double yMid;           /* middle of the current slab */
+  double t;              /* position of a y value along an edge */
+  void * ptr;            /* temp pointer for reallocated memory */
+  Edge * e;              /* current edge */
+  SlabEdge * a, * b;     /* edges on the left and right of a trapezoid */
+  ClipBuffer * buf = &tris->clip;
+
+  tris->numTris = 0;
+  tris->numEdges = 0;
+
+  /* clip each part to the cell and collect the non-horizontal edges */
+  for(k = 0; k < numParts; ++k) {
+    end = (k == numParts - 1 ? numPoints : parts[k+1]) - 1;
+    clipPolygonArea(cell, points, parts[k], end, buf);
+    if(buf->numPts == -1) {
+      return -1;
+    }
+    if(tris->numEdges + buf->numPts > tris->maxEdges) {
+      newMax = tris->maxEdges > 0 ? tris->maxEdges : 64;
+      while(newMax < tris->numEdges + buf->numPts) {
+        newMax *= 2;
+      }
+      if((ptr = realloc(tris->edges, sizeof(Edge) * newMax)) == NULL) {
+        return -1;
+      }
+      tris->edges = (Edge *) ptr;
+      if((ptr = realloc(tris->ys, sizeof(double) * 2 * newMax)) == NULL) {
+        return -1;
+      }
+      tris->ys = (double *) ptr;
+      if((ptr = realloc(tris->live, sizeof(int) * newMax)) == NULL) {
+        return -1;
+      }
+      tris->live = (int *) ptr;
+      if((ptr = realloc(tris->active, sizeof(SlabEdge) * newMax)) == NULL) {
+        return -1;
+      }
+      tris->active = (SlabEdge *) ptr;
+      tris->maxEdges = newMax;
+    }
+    for(j = 0; j < buf->numPts - 1; ++j) {
+      if(buf->y[j] == buf->y[j+1]) {
+        continue;
+      }
+      e = &tris->edges[tris->numEdges++];
+      if(buf->y[j] < buf->y[j+1]) {
+        e->x0 = buf->x[j];   e->y0 = buf->y[j];
+        e->x1 = buf->x[j+1]; e->y1 = buf->y[j+1];
+      } else {
+        e->x0 = buf->x[j+1]; e->y0 = buf->y[j+1];
+        e->x1 = buf->x[j];   e->y1 = buf->y[j];
+      }
+    }
+  }
+  if(tris->numEdges < 2) {
+    return 1;
+  }
+
+  /* find the distinct y values and order the edges by their lower ends */
+  for(j = 0; j < tris->numEdges; ++j) {
+    tris->ys[2*j] = tris->edges[j].y0;
+    tris->ys[2*j + 1] = tris->edges[j].y1;
+  }
+  qsort(tris->ys, 2 * tris->numEdges, sizeof(double), compareDouble);
+  numYs = 1;
+  for(j = 1; j < 2 * tris->numEdges; ++j) {
+    if(tris->ys[j] != tris->ys[numYs - 1]) {
+      tris->ys[numYs++] = tris->ys[j];
+    }
+  }
+  qsort(tris->edges, tris->numEdges, sizeof(Edge), compareEdge);
+
+  /* sweep the slabs from the bottom to the top */
+  next = 0;
+  numLive = 0;
+  for(k = 0; k < numYs - 1; ++k) {
+    yLo = tris->ys[k];
+    yHi = tris->ys[k+1];
+    yMid = 0.5 * (yLo + yHi);
+
+    /* add the edges that start at the bottom of the slab and drop the */
+    /* edges that end there, so that the rest cross the whole slab */
+    while(next < tris->numEdges && tris->edges[next].y0 <= yLo) {
+      tris->live[numLive++] = next++;
+    }
+    numActive = 0;
+    for(j = 0; j < numLive; ++j) {
+      e = &tris->edges[tris->live[j]];
+      if(e->y1 <= yLo) {
+        continue;
+      }
+      tris->live[numActive] = tris->live[j];
+      t = (yLo - e->y0) / (e->y1 - e->y0);
+      tris->active[numActive].xLo = e->x0 + t * (e->x1 - e->x0);
+      t = (yHi - e->y0) / (e->y1 - e->y0);
+      tris->active[numActive].xHi = e->x0 + t * (e->x1 - e->x0);
+      t = (yMid - e->y0) / (e->y1 - e->y0);
+      tris->active[numActive].xMid = e->x0 + t * (e->x1 - e->x0);
+      ++numActive;
+    }
+    numLive = numActive;
+    qsort(tris->active, numActive, sizeof(SlabEdge), compareSlabEdge);
+
+    /* divide the trapezoids between pairs of edges into triangles */
+    for(j = 0; j + 1 < numActive; j += 2) {
+      a = &tris->active[j];
+      b = &tris->active[j+1];
+      if(addTriangle(tris, a->xLo, yLo, b->xLo, yLo, b->xHi, yHi) == -1 ||
+         addTriangle(tris, a->xLo, yLo, b->xHi, yHi, a->xHi, yHi) == -1) {
+        return -1;
+      }
+    }
+  }
+
+  return 1;
+}
+
+
+/**********************************************************
+** Function:   pickTrianglePoint
+**
+** Purpose:    Select a random point from the area covered by a triangle
+**             set.
+** Algorithm:  A triangle is chosen with probability proportional to its
+**             area and a point is chosen uniformly from the triangle using
+**             barycentric coordinates, reflecting the coordinates when
+**             they fall outside the triangle.
+** Arguments:  tris, triangle set, which must have at least one triangle
+**             rng,  random number stream, or NULL to use R's random number
+**                   generator
+**             xs,   x-coordinate of the sample point
+**             ys,   y-coordinate of the sample point
+** Return:     none
+***********************************************************/
+void pickTrianglePoint(TriangleSet * tris, RngStream * rng, double * xs,
+                       double * ys) {
+
+  int lo, hi, mid;       /* bounds for the binary search */
+  double u, r1, r2;      /* random values */
+  double * t;            /* vertices of the chosen triangle */
+
+  if(rng) {
+    u = rngStreamRunif(rng, 0.0, tris->cumArea[tris->numTris - 1]);
+    r1 = rngStreamRunif(rng, 0.0, 1.0);
+    r2 = rngStreamRunif(rng, 0.0, 1.0);
+  } else {
+    u = runif(0.0, tris->cumArea[tris->numTris - 1]);
+    r1 = unif_rand();
+    r2 = unif_rand();
+  }
+
+  /* find the first triangle whose cumulative area is not less than u */
+  lo = 0;
+  hi = tris->numTris - 1;
+  while(lo < hi) {
+    mid = lo + (hi - lo) / 2;
+    if(tris->cumArea[mid] < u) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  t = &tris->tri[6 * lo];
+
+  if(r1 + r2 > 1.0) {
+    r1 = 1.0 - r1;
+    r2 = 1.0 - r2;
+  }
+  *xs = t[0] + r1 * (t[2] - t[0]) + r2 * (t[4] - t[0]);
+  *ys = t[1] + r1 * (t[3] - t[1]) + r2 * (t[5] - t[1]);
+
+  return;
+}
+
+
+/**********************************************************
+** Function:   pickRecordPoint
+**
+** Purpose:    Select a random point that is inside both a polygon record
+**             and a grid cell.
+** Algorithm:  When a triangle set is sent, the point is drawn from the
+**             triangles that cover the intersection of the record and the
+**             cell.  Otherwise up to maxTry points are drawn uniformly from
+**             the intersection of the bounding box of the record and the
+**             cell until a point is inside an odd number of the parts of
+**             the record, where a prepared record is tested only against
+**             the edges near the point.
+** Arguments:  points,    points of the record
+**             numPoints, number of points in the record
+**             parts,     offsets of the first point of each part
+**             numParts,  number of parts in the record
+**             box,       bounding box of the record, or NULL to compute
+**                        the box from the points
+**             cell,      grid cell
+**             maxTry,    maximum number of attempts
+**             rng,       random number stream, or NULL to use R's random
+**                        number generator
+**             tris,      triangle set used to select the point exactly, or
+**                        NULL to select the point by rejection
+**             prep,      the record prepared by preparePolygon, or NULL to
+**                        test the points against each part of the record
+**             xs,        x-coordinate of the sample point
+**             ys,        y-coordinate of the sample point
+** Return:     TRUE,  if a sample point was selected
+**             FALSE, otherwise
+**             -1,    on error
+***********************************************************/
+int pickRecordPoint(Point * points, int numPoints, int * parts, int numParts,
+                    double * box, Cell * cell, unsigned int maxTry,
+                    RngStream * rng, TriangleSet * tris,
+                    PreparedPolygon * prep, double * xs, double * ys) {
+
+  unsigned int j;        /* loop counter */
+  int k;                 /* loop counter */
+  int check;             /* number of parts that contain the point */
+  int partSize;          /* number of points in a part */
+  double pbox[4];        /* bounding box computed from the points */
+  double xMin;           /* minimum x-axis value for the sample point bounding box */
+  double yMin;           /* minimum y-axis value for the sample point bounding box */
+  double xMax;           /* maximum x-axis value for the sample point bounding box */
+  double yMax;           /* maximum y-axis value for the sample point bounding box */
+  double xtemp;          /* x-coordinate for potential sample point */
+  double ytemp;          /* y-coordinate for potential sample point */
+
+  /* select the point from the triangles that cover the intersection of */
+  /* the record and the cell, which takes one set of draws and only fails */
+  /* when the intersection has no area */
+  if(tris) {
+    if(triangulateRecord(tris, points, numPoints, parts, numParts, cell)
+       == -1) {
+      return -1;
+    }
+    if(tris->numTris == 0) {
+      return FALSE;
+    }
+    pickTrianglePoint(tris, rng, xs, ys);
+    return TRUE;
+  }
+
+  /* compute the bounding box of the record when it was not sent */
+  if(box == NULL) {
+    pbox[0] = pbox[2] = points[0].X;
+    pbox[1] = pbox[3] = points[0].Y;
+    for(k = 1; k < numPoints; ++k) {
+      if(points[k].X < pbox[0]) pbox[0] = points[k].X;
+      if(points[k].Y < pbox[1]) pbox[1] = points[k].Y;
+      if(points[k].X > pbox[2]) pbox[2] = points[k].X;
+      if(points[k].Y > pbox[3]) pbox[3] = points[k].Y;
+    }
+    box = pbox;
+  }
+
+  /* assign the sample point bounding box */
+  xMin = box[0] < cell->xMin ? cell->xMin : box[0];
+  yMin = box[1] < cell->yMin ? cell->yMin : box[1];
+  xMax = box[2] > cell->xMax ? cell->xMax : box[2];
+  yMax = box[3] > cell->yMax ? cell->yMax : box[3];
+
+  /* make maxTry attempts to obtain a sample point */
+  for(j = 0; j < maxTry; ++j) {
+    if(rng) {
+      xtemp = rngStreamRunif(rng, xMin, xMax);
+      ytemp = rngStreamRunif(rng, yMin, yMax);
+    } else {
+      xtemp = runif(xMin, xMax);
+      ytemp = runif(yMin, yMax);
+    }
+
+    /* if there are more than one part we need to check them separately */
+    check = 0;
+    if(prep) {
+      check = insidePrepared(prep, xtemp, ytemp);
+    } else if(numParts > 1) {
+      for(k = 0; k < numParts; ++k) {
+        if(k == numParts - 1) {
+          partSize = numPoints - parts[k];
+        } else {
+          partSize = parts[k+1] - parts[k];
+        }
+        if(insidePolygon(&points[parts[k]], partSize, xtemp, ytemp) == 1) {
+          ++check;
+        }
+      }
+
+    /* only one part so check the entire record */
+    } else if(insidePolygon(points, numPoints, xtemp, ytemp) == 1) {
+      ++check;
+    }
+
+    if((check % 2) == 1) {
+      *xs = xtemp;
+      *ys = ytemp;
+      return TRUE;
+    }
+  }
+
+  return FALSE;
+}
+
+
+/**********************************************************
+** Function:   pickStorePoints
+**
+** Purpose:    Select a sample point in each cell from the records held in
+**             a frame store.
+** Notes:      The cells are grouped by record, so that each record is
+**             prepared once for rejection sampling.  When streams are
+**             used, the points for each cell are selected using a stream
+**             whose number is the position of the cell, and the groups are
+**             processed in parallel.  Otherwise the points are selected
+**             using R's random number generator in the order of the
+**             records in the store and then of the cells, which is the
+**             order in which they are selected from the shapefile, and the
+**             calling function must bracket the call with GetRNGstate and
+**             PutRNGstate.  The bounding box of a record is computed from
+**             its points.
+** Arguments:  store,      frame store that contains the records
+**             recordIDs,  shapefile record ID for each cell
+**             xc,         x-coordinate of the right edge of each cell
+**             yc,         y-coordinate of the top edge of each cell
+**             sampleSize, number of cells
+**             dx,         x-axis size of the grid cells
+**             dy,         y-axis size of the grid cells
+**             maxTry,     maximum number of tries to obtain a sample point
+**             useStreams, TRUE to select the points using streams
+**             seed,       seed for the streams
+**             exact,      TRUE to select the points exactly from triangles
+**             numThreads, number of threads used when streams are used
+**             bp,         set to FALSE for each cell that gets a point
+**             xcs,        x-coordinates of the sample points
+**             ycs,        y-coordinates of the sample points
+** Return:     1,  on success
+**             0,  if memory could not be allocated, in which case no
+**                 points were selected
+**             -1, on error
+***********************************************************/
+int pickStorePoints(FrameStore * store, unsigned int * recordIDs, double * xc,
+                    double * yc, int sampleSize, double dx, double dy,
+                    unsigned int maxTry, int useStreams,
+                    unsigned long long seed, int exact, int numThreads,
+                    int * bp, double * xcs, double * ycs) {
+
+  int i, r;              /* loop counters */
+  int g, c;              /* loop counters */
+  Cell cell;             /* temporary storage for a cell */
+  RngStream rng;         /* random number stream for a cell */
+  RecIndex * recs = NULL;  /* records in the store sorted by ID */
+  RecIndex key;          /* record ID to find */
+  RecIndex * found;      /* record found for a cell */
+  CellIndex * cellRecs = NULL;  /* cells sorted by record in the store */
+  int * groupStart = NULL;  /* index in cellRecs of each record's first cell */
+  int numCellRecs = 0;   /* number of cells with a record in the store */
+  int numGroups = 0;     /* number of records that have a cell */
+  PreparedPolygon prep;  /* record prepared for rejection sampling */
+  int prepared;          /* 1 if the current record is prepared */
+  TriangleSet tris;      /* triangles used to select the points exactly */
+  int status;            /* result of selecting a point */
+  int error = FALSE;     /* TRUE if an error occurred selecting a point */
+
+  recs = (RecIndex *) malloc(sizeof(RecIndex) * (store->numRecords + 1));
+  cellRecs = (CellIndex *) malloc(sizeof(CellIndex) * (sampleSize + 1));
+  groupStart = (int *) malloc(sizeof(int) * (sampleSize + 1));
+  if(recs == NULL || cellRecs == NULL || groupStart == NULL) {
+    free(recs);
+    free(cellRecs);
+    free(groupStart);
+    return 0;
+  }
+  if(!useStreams) {
+    numThreads = 1;
+  }
+  for(r = 0; r < store->numRecords; ++r) {
+    recs[r].id = store->recNum[r];
+    recs[r].rec = r;
+  }
+  qsort(recs, store->numRecords, sizeof(RecIndex), compareRecIndex);
+
+  /* find the record for each cell and group the cells by record, so */
+  /* that each record is prepared once for rejection sampling */
+  for(i = 0; i < sampleSize; ++i) {
+    key.id = recordIDs[i];
+    found = (RecIndex *) bsearch(&key, recs, store->numRecords,
+                                 sizeof(RecIndex), compareRecIndex);
+    if(found != NULL) {
+      cellRecs[numCellRecs].rec = found->rec;
+      cellRecs[numCellRecs].cell = i;
+      ++numCellRecs;
+    }
+  }
+  qsort(cellRecs, numCellRecs, sizeof(CellIndex), compareCellIndex);
+  for(c = 0; c < numCellRecs; ++c) {
+    if(c == 0 || cellRecs[c].rec != cellRecs[c-1].rec) {
+      groupStart[numGroups++] = c;
+    }
+  }
+  groupStart[numGroups] = numCellRecs;
+
+  /* each thread uses its own triangle set and prepared record */
+#ifdef _OPENMP
+  #pragma omp parallel private(i, r, g, c, cell, rng, tris, prep, prepared, status) num_threads(numThreads)
+#endif
+  {
+    initTriangleSet(&tris);
+    initPreparedPolygon(&prep);
+#ifdef _OPENMP
+    #pragma omp for schedule(dynamic)
+#endif
+    for(g = 0; g < numGroups; ++g) {
+      r = cellRecs[groupStart[g]].rec;
+      prepared = 0;
+      if(!exact && store->numPts[r] >= PREPARED_MIN_POINTS) {
+        prepared = preparePolygon(&prep,
+                                  &store->points[store->pointStart[r]],
+                                  store->numPts[r],
+                                  &store->parts[store->partStart[r]],
+                                  store->numParts[r]);
+        if(prepared == -1) {
+          error = TRUE;
+          continue;
+        }
+      }
+      for(c = groupStart[g]; c < groupStart[g+1]; ++c) {
+        i = cellRecs[c].cell;
+        cell.xMin = xc[i] - dx;
+        cell.yMin = yc[i] - dy;
+        cell.xMax = xc[i];
+        cell.yMax = yc[i];
+        if(useStreams) {
+          initRngStream(&rng, seed, i);
+        }
+        status = pickRecordPoint(&store->points[store->pointStart[r]],
+                                 store->numPts[r],
+                                 &store->parts[store->partStart[r]],
+                                 store->numParts[r], NULL, &cell, maxTry,
+                                 useStreams ? &rng : NULL,
+                                 exact ? &tris : NULL,
+                                 prepared == 1 ? &prep : NULL, &xcs[i],
+                                 &ycs[i]);
+        if(status == -1) {
+          error = TRUE;
+        } else {
+          bp[i] = !status;
+        }
+      }
+    }
+    freePreparedPolygon(&prep);
+    freeTriangleSet(&tris);
+  }
+
+  free(recs);
+  free(cellRecs);
+  free(groupStart);
+
+  return error ? -1 : 1;
+}
+
+
+/**********************************************************
+** Function:   readShapeRecord
+**
+** Purpose:    Read the next polygon or polyline record of a shapefile.
+** Notes:      The box, parts and points of the record are read into the
+**             poly struct, where the parts and points arrays are allocated
+**             and must be freed by the calling function.  The Z and M
+**             values of the record are skipped.
+** Arguments:  fptr,         pointer to the shapefile, positioned at the
+**                           start of a record
+**             poly,         polygon struct that receives the record
+**             number,       set to the record number
+**             filePosition, byte offset of the record within the
+**                           shapefile, which is advanced to the next
+**                           record
+** Return:     1,  on success
+**             -1, on error, in which case the arrays are freed
+***********************************************************/
+int readShapeRecord(FILE * fptr, Polygon * poly, int * number,
+                    unsigned int * filePosition) {
+
+  int i;                        /* loop counter */
+  unsigned char buffer[4];      /* temp buffer for reading from file */
+  unsigned int contentLength;   /* record content length in bytes */
+
+  poly->parts = NULL;
+  poly->points = NULL;
+
+  /* read the record number and content length and skip the shape type */
+  fread(buffer, sizeof(char), 4, fptr);
+  *number = readBigEndian(buffer, 4);
+  fread(buffer, sizeof(char), 4, fptr);
+  contentLength = readBigEndian(buffer, 4) * 2;
+  fread(buffer, sizeof(char), 4, fptr);
+
+  /* read box data and the number of parts and points */
+  for(i = 0; i < 4; ++i) {
+    fread(&(poly->box[i]), sizeof(double), 1, fptr);
+  }
+  fread(buffer, sizeof(char), 4, fptr);
+  poly->numParts = readLittleEndian(buffer, 4);
+  fread(buffer, sizeof(char), 4, fptr);
+  poly->numPoints = readLittleEndian(buffer, 4);
+
+  /* read parts info and points data */
+  poly->parts = (int *) malloc(sizeof(int) * (poly->numParts + 1));
+  poly->points = (Point *) malloc(sizeof(Point) * (poly->numPoints + 1));
+  if(poly->parts == NULL || poly->points == NULL) {
+    Rprintf("Error: Allocating memory in C function readShapeRecord.\n");
+    free(poly->parts);
+    free(poly->points);
+    poly->parts = NULL;
+    poly->points = NULL;
+    return -1;
+  }
+  for(i = 0; i < poly->numParts; ++i) {
+    fread(&(poly->parts[i]), sizeof(char), 4, fptr);
+  }
+  if(fread(poly->points, sizeof(double), 2 * poly->numPoints, fptr) !=
+     2 * poly->numPoints) {
+    Rprintf("Error: Reading shape file in C function readShapeRecord.\n");
+    free(poly->parts);
+    free(poly->points);
+    poly->parts = NULL;
+    poly->points = NULL;
+    return -1;
+  }
+
+  /* skip the Z and M values */
+  *filePosition += 8 + contentLength;
+  fseek(fptr, *filePosition, SEEK_SET);
+
+  return 1;
+}
+
+
+/**********************************************************
+** Function:   pickFilePoints
+**
+** Purpose:    Select a sample point in each cell from the records of the
+**             temporary shapefile.
+** Notes:      When streams are used, the records of the cells are held in
+**             a frame store if they fit within the memory budget, and the
+**             points are selected by pickStorePoints.  Otherwise the
+**             records are read one at a time, and the points are selected
+**             in the order of the records in the shapefile and then of the
+**             cells.  Records that do not have a cell are skipped, so the
+**             shapefile may contain every record of the frame.  When
+**             streams are not used, the calling function must bracket the
+**             call with GetRNGstate and PutRNGstate.
+** Arguments:  fptr,        pointer to the temporary shapefile
+**             shape,       shape struct that contains the header info for
+**                          the shapefile
+**             recordIDs,   shapefile record ID for each cell
+**             xc,          x-coordinate of the right edge of each cell
+**             yc,          y-coordinate of the top edge of each cell
+**             sampleSize,  number of cells
+**             dx,          x-axis size of the grid cells
+**             dy,          y-axis size of the grid cells
+**             maxTry,      maximum number of tries to obtain a sample point
+**             useStreams,  TRUE to select the points using streams
+**             seed,        seed for the streams
+**             exact,       TRUE to select the points exactly from triangles
+**             frameBudget, memory budget in megabytes for holding the
+**                          records in memory when streams are used
+**             numThreads,  number of threads used when streams are used
+**             bp,          set to FALSE for each cell that gets a point
+**             xcs,         x-coordinates of the sample points
+**             ycs,         y-coordinates of the sample points
+** Return:     1,  on success
+**             -1, on error
+***********************************************************/
+int pickFilePoints(FILE * fptr, Shape * shape, unsigned int * recordIDs,
+                   double * xc, double * yc, int sampleSize, double dx,
+                   double dy, unsigned int maxTry, int useStreams,
+                   unsigned long long seed, int exact, double frameBudget,
+                   int numThreads, int * bp, double * xcs, double * ycs) {
+
+  int i;                 /* loop counter */
+  unsigned int filePosition = 100;  /* byte offset for the beginning of the */
+                                    /* record data */
+  Polygon poly;          /* current record */
+  int number;            /* record number of the current record */
+  Cell cell;             /* temporary storage for a cell */
+  RngStream rng;         /* random number stream for a cell */
+  FrameStore store;      /* records held in memory */
+  int loaded;            /* 1 if the records are held in memory */
+  PreparedPolygon prep;  /* record prepared for rejection sampling */
+  int prepared;          /* 1 if the current record is prepared */
+  TriangleSet tris;      /* triangles used to select the points exactly */
+  int status;            /* result of selecting a point */
+  int error = FALSE;     /* TRUE if an error occurred selecting a point */
+
+  /* when streams are used, hold the records in memory if they fit within */
+  /* the budget and select the sample points for the cells in parallel */
+  if(useStreams) {
+    initFrameStore(&store);
+    loaded = loadFrameStore(&store, shape, fptr, recordIDs, sampleSize,
+                            frameBudget);
+    if(loaded == -1) {
+      return -1;
+    }
+    if(loaded == 1) {
+      status = pickStorePoints(&store, recordIDs, xc, yc, sampleSize, dx, dy,
+                               maxTry, TRUE, seed, exact, numThreads, bp,
+                               xcs, ycs);
+      freeFrameStore(&store);
+      if(status != 0) {
+        return status;
+      }
+    }
+  }
+
+  /* select sample points */
+  fseek(fptr, 100, SEEK_SET);
+  initTriangleSet(&tris);
+  initPreparedPolygon(&prep);
+  while(filePosition < shape->fileLength*2) {
+
+    /* read the record */
+    if(readShapeRecord(fptr, &poly, &number, &filePosition) == -1) {
+      error = TRUE;
+      break;
+    }
+
+    /* loop through each cell requiring a sample point, where a large */
+    /* record is prepared for rejection sampling at its first cell */
+    prepared = 0;
+    for(i = 0; i < sampleSize; ++i) {
+      if(bp[i] == FALSE || recordIDs[i] != number) {
+        continue;
+      }
+      if(!exact && prepared == 0 && poly.numPoints >= PREPARED_MIN_POINTS) {
+        if((prepared = preparePolygon(&prep, poly.points, poly.numPoints,
+                                      poly.parts, poly.numParts)) == -1) {
+          error = TRUE;
+        }
+      }
+
+      /* create the cell structure */
+      cell.xMin = xc[i] - dx;
+      cell.yMin = yc[i] - dy;
+      cell.xMax = xc[i];
+      cell.yMax = yc[i];
+
+      /* make maxTry attempts to obtain a sample point, where the streams */
+      /* use a bounding box computed from the points so that they give the */
+      /* same points as when the records are held in memory */
+      if(useStreams) {
+        initRngStream(&rng, seed, i);
+        status = pickRecordPoint(poly.points, poly.numPoints, poly.parts,
+                                 poly.numParts, NULL, &cell, maxTry, &rng,
+                                 exact ? &tris : NULL,
+                                 prepared == 1 ? &prep : NULL, &xcs[i],
+                                 &ycs[i]);
+      } else {
+        status = pickRecordPoint(poly.points, poly.numPoints, poly.parts,
+                                 poly.numParts, poly.box, &cell, maxTry,
+                                 NULL, exact ? &tris : NULL,
+                                 prepared == 1 ? &prep : NULL, &xcs[i],
+                                 &ycs[i]);
+      }
+      if(status == -1) {
+        error = TRUE;
+      } else {
+        bp[i] = !status;
+      }
+    }
+
+    free(poly.parts);
+    free(poly.points);
+  }
+  freeTriangleSet(&tris);
+  freePreparedPolygon(&prep);
+
+  return error ? -1 : 1;
+}
 
 
 SEXP pickAreaSamplePoints(SEXP fileNamePrefix, SEXP shpIDsVec, SEXP recordIDsVec,
-     SEXP xcVec, SEXP ycVec, SEXP dxVal, SEXP dyVal, SEXP maxTryVal) {
+     SEXP xcVec, SEXP ycVec, SEXP dxVal, SEXP dyVal, SEXP maxTryVal,
+     SEXP rngStreamsVal, SEXP frameBudgetVal, SEXP threadsVal,
+     SEXP exactVal) {
 
-  int i, j, k, l;             /* loop counters */
+  int i;                      /* loop counter */
   FILE * fptr = NULL;         /* pointer to the shapefile */
   FILE * newShp = NULL;       /* pointer to the temporary .shp file */
   unsigned int fileNameLen = 0;  /* length of the shapefile name */
@@ -69,18 +1017,6 @@ SEXP pickAreaSamplePoints(SEXP fileNamePrefix, SEXP shpIDsVec, SEXP recordIDsVec
   char * restrict shpFileName = NULL;  /* stores the full .shp file name */
   int singleFile = FALSE;
   Shape shape;           /* used to store shapefile info and data */
-  Point * part = NULL;   /* stores points in a part */
-  int partSize;          /* number of points in part */
-  int pidx;              /* index into part array */
-  Record * temp = NULL;  /* used for traversing linked list of records */
-  unsigned int filePosition = 100;  /* byte offset for the beginning of the */
-                                    /* record data */
-  unsigned char buffer[4];  /* temp buffer for reading from file */
-  Polygon * poly;        /* temp Polygon storage */
-  PolygonZ * polyZ;      /* temp PolygonZ storage */
-  PolygonM * polyM;      /* temp PolygonM storage */
-  Record record;         /* record used for parsing records */
-  Cell cell;             /* temporary storage for a cell */
   unsigned int * shpIDs = NULL;  /* array of shapefile record IDs to use */
   unsigned int dsgSize = length(shpIDsVec);  /* number of values in the shpIDs array */
   unsigned int * recordIDs = NULL;  /* array of shapefile record IDs that get a sample point */
@@ -93,13 +1029,11 @@ SEXP pickAreaSamplePoints(SEXP fileNamePrefix, SEXP shpIDsVec, SEXP recordIDsVec
   double * xcs = NULL;   /* array of sample x-coordinates */
   double * ycs = NULL;   /* array array of sample x-coordinates */
   unsigned int maxTry;   /* maximum number of tries to obtain a sample point */
-  double xMin;           /* minimum x-axis value for the sample point bounding box */
-  double yMin;           /* minimum y-axis value for the sample point bounding box */
-  double xMax;           /* maximum x-axis value for the sample point bounding box */
-  double yMax;           /* maximum y-axis value for the sample point bounding box */
-  int check  = 0;        /* value for determining validity of a potential sample point */
-  double xtemp = 0.0;    /* x-coordinate for potential sample point */
-  double ytemp = 0.0;    /* y-coordinate for potential sample point */
+  int useStreams = FALSE;  /* TRUE if random number streams are used */
+  unsigned long long seed = 0;  /* seed for the random number streams */
+  double frameBudget = FRAME_STORE_BUDGET;  /* memory budget for the store */
+  int numThreads = 1;    /* number of threads */
+  int exact = FALSE;     /* TRUE if the points are selected exactly */
   SEXP results = NULL;   /* R object used to return values to R */
   SEXP colNamesVec;      /* vector used to name the columns in the results object */
   SEXP bpVec;            /* return vector of cell IDs */
@@ -240,6 +1174,34 @@ SEXP pickAreaSamplePoints(SEXP fileNamePrefix, SEXP shpIDsVec, SEXP recordIDsVec
   /* copy maxTry from the R value to a C value */
   maxTry = INTEGER(maxTryVal)[0];
 
+  /* random number streams, memory budget and number of threads */
+  if(rngStreamsVal != R_NilValue) {
+    PROTECT(rngStreamsVal = AS_LOGICAL(rngStreamsVal));
+    useStreams = LOGICAL(rngStreamsVal)[0] == TRUE;
+    UNPROTECT(1);
+  }
+  if(exactVal != R_NilValue) {
+    PROTECT(exactVal = AS_LOGICAL(exactVal));
+    exact = LOGICAL(exactVal)[0] == TRUE;
+    UNPROTECT(1);
+  }
+  if(frameBudgetVal != R_NilValue) {
+    PROTECT(frameBudgetVal = AS_NUMERIC(frameBudgetVal));
+    frameBudget = REAL(frameBudgetVal)[0];
+    UNPROTECT(1);
+  }
+#ifdef _OPENMP
+  numThreads = omp_get_max_threads();
+#endif
+  if(threadsVal != R_NilValue) {
+    PROTECT(threadsVal = AS_INTEGER(threadsVal));
+    numThreads = INTEGER(threadsVal)[0];
+    UNPROTECT(1);
+  }
+  if(numThreads == NA_INTEGER || numThreads < 1) {
+    numThreads = 1;
+  }
+
   /* allocate memory and initialize the sample point logical array and the */
   /* sample point coordinate arrays */
   if((bp = (int *) malloc(sizeof(int) * sampleSize)) == NULL) {
@@ -272,615 +1234,27 @@ SEXP pickAreaSamplePoints(SEXP fileNamePrefix, SEXP shpIDsVec, SEXP recordIDsVec
     ycs[i] = 0.0;
   }
 
-  /* select sample points */  
-  while (filePosition < shape.fileLength*2) {
-
-    /* read the record number */
-    fread(buffer, sizeof(char), 4, fptr);
-    record.number = readBigEndian(buffer, 4); 
-    filePosition += 4;
-
-    /* ignore content length */
-    fread(buffer, sizeof(char), 4, fptr);
-    filePosition += 4;
-
-    /* ignore shape type */
-    fread(buffer, sizeof(char), 4, fptr);
-    filePosition += 4;
-
-    if(shape.shapeType == POLYGON) {
-
-      /* allocate a new polygon */
-      if((poly = (Polygon *) malloc(sizeof(Polygon))) == NULL) {
-        Rprintf("Error: Allocating memory in C function pickAreaSamplePoints.\n");
-        fclose(fptr);
-        remove(TEMP_SHP_FILE);
-        PROTECT(results = allocVector(VECSXP, 1));
-        UNPROTECT(1); 
-        return results;  
-      }
-
-      /* read box data */
-      for(i = 0; i < 4; ++i) {
-        fread(&(poly->box[i]), sizeof(double), 1, fptr);
-        filePosition += 8;
-      }
-
-      /* read the number of parts */
-      fread(buffer, sizeof(char), 4, fptr);
-      poly->numParts = readLittleEndian(buffer, 4);
-      filePosition += 4;
-
-      /* read the number of points */
-      fread(buffer, sizeof(char), 4, fptr);
-      poly->numPoints = readLittleEndian(buffer, 4);
-      filePosition += 4;
-
-      /* read parts info */ 
-      if((poly->parts = (int *) malloc(sizeof(int) * poly->numParts))==NULL) {
-        Rprintf("Error: Allocating memory in C function pickAreaSamplePoints.\n");
-        fclose(fptr);
-        remove(TEMP_SHP_FILE);
-        PROTECT(results = allocVector(VECSXP, 1));
-        UNPROTECT(1); 
-        return results;  
-      }
-      for(i = 0; i < poly->numParts; ++i) {
-        fread(&(poly->parts[i]), sizeof(char), 4, fptr);
-        filePosition += 4;
-      } 
-
-      /* read points data */
-      if((poly->points = (Point *) malloc(sizeof(Point) * poly->numPoints))
-         == NULL) {
-        Rprintf("Error: Allocating memory in C function pickAreaSamplePoints.\n");
-        fclose(fptr);
-        remove(TEMP_SHP_FILE);
-        PROTECT(results = allocVector(VECSXP, 1));
-        UNPROTECT(1); 
-        return results;  
-      }
-      for(i = 0; i < poly->numPoints; ++i) {
-        fread(&(poly->points[i].X), sizeof(double), 1, fptr);
-        filePosition += 8;
-        if(fread(&(poly->points[i].Y), sizeof(double), 1, fptr) == 0) {
-          Rprintf("Error: reading shape file in C function pickAreaSamplePoints.\n");
-          fclose(fptr);
-          remove(TEMP_SHP_FILE);
-          PROTECT(results = allocVector(VECSXP, 1));
-          UNPROTECT(1); 
-          return results;  
-        }
-        filePosition += 8;
-      } 
-
-      /* add new polygon to the record struct */
-      record.poly = poly;
-
-    } else if(shape.shapeType == POLYGON_Z) {
-
-      /* allocate a new polygon */
-      if((polyZ = (PolygonZ *) malloc(sizeof(PolygonZ))) == NULL) {
-        Rprintf("Error: Allocating memory in C function pickAreaSamplePoints.\n");
-        fclose(fptr);
-        remove(TEMP_SHP_FILE);
-        PROTECT(results = allocVector(VECSXP, 1));
-        UNPROTECT(1); 
-        return results;  
-      }
-
-      /* read box data */
-      for(i = 0; i < 4; ++i) {
-        fread(&(polyZ->box[i]), sizeof(double), 1, fptr);
-        filePosition += 8;
-      }
-
-      /* read the number of parts */
-      fread(buffer, sizeof(char), 4, fptr);
-      polyZ->numParts = readLittleEndian(buffer, 4);
-      filePosition += 4;
-
-      /* read the number of points */
-      fread(buffer, sizeof(char), 4, fptr);
-      polyZ->numPoints = readLittleEndian(buffer, 4);
-      filePosition += 4;
-
-      /* read parts info */ 
-      if((polyZ->parts = (int *) malloc(sizeof(int) * polyZ->numParts))
-      	== NULL) {
-        Rprintf("Error: Allocating memory in C function pickAreaSamplePoints.\n");
-        fclose(fptr);
-        remove(TEMP_SHP_FILE);
-        PROTECT(results = allocVector(VECSXP, 1));
-        UNPROTECT(1); 
-        return results;  
-      }
-      for(i = 0; i < polyZ->numParts; ++i) {
-        fread(&(polyZ->parts[i]), sizeof(char), 4, fptr);
-        filePosition += 4;
-      } 
-
-      /* read points data */
-      if((polyZ->points = (Point *) malloc(sizeof(Point) * polyZ->numPoints))
-         == NULL) {
-        Rprintf("Error: Allocating memory in C function pickAreaSamplePoints.\n");
-        fclose(fptr);
-        remove(TEMP_SHP_FILE);
-        PROTECT(results = allocVector(VECSXP, 1));
-        UNPROTECT(1); 
-        return results;  
-      }
-      for(i = 0; i < polyZ->numPoints; ++i) {
-        fread(&(polyZ->points[i].X), sizeof(double), 1, fptr);
-        filePosition += 8;
-        if(fread(&(polyZ->points[i].Y), sizeof(double), 1, fptr) == 0) {
-          Rprintf("Error: reading shape file in C function pickAreaSamplePoints.\n");
-          fclose(fptr);
-          remove(TEMP_SHP_FILE);
-          PROTECT(results = allocVector(VECSXP, 1));
-          UNPROTECT(1); 
-          return results;  
-        }
-        filePosition += 8;
-      } 
-
-      /* read Z range */
-      for(i = 0; i < 2; ++i) {
-        fread(&(polyZ->zRange[i]), sizeof(double), 1, fptr);
-        filePosition += 8;
-      }
-
-      /* read Z values */
-      if((polyZ->zArray = (double *) malloc(sizeof(double)*polyZ->numPoints))
-         == NULL) {
-        Rprintf("Error: Allocating memory in C function pickAreaSamplePoints.\n");
-        fclose(fptr);
-        remove(TEMP_SHP_FILE);
-        PROTECT(results = allocVector(VECSXP, 1));
-        UNPROTECT(1); 
-        return results;  
-      }
-      for(i = 0; i < polyZ->numPoints; ++i) {
-        fread(&(polyZ->zArray[i]), sizeof(double), 1, fptr);
-        filePosition += 8;
-      } 
-
-      /* read M range */
-      for(i = 0; i < 2; ++i) {
-        fread(&(polyZ->mRange[i]), sizeof(double), 1, fptr);
-        filePosition += 8;
-      }
-
-      /* read M values */
-      if((polyZ->mArray = (double *) malloc(sizeof(double)*polyZ->numPoints))
-         == NULL) {
-        Rprintf("Error: Allocating memory in C function pickAreaSamplePoints.\n");
-        fclose(fptr);
-        remove(TEMP_SHP_FILE);
-        PROTECT(results = allocVector(VECSXP, 1));
-        UNPROTECT(1); 
-        return results;  
-      }
-      for(i = 0; i < polyZ->numPoints; ++i) {
-        fread(&(polyZ->mArray[i]), sizeof(double), 1, fptr);
-        filePosition += 8;
-      } 
-
-      /* add new polygon to the record struct */
-      record.polyZ = polyZ;
-
-    } else {
-
-      /* allocate a new polygon */
-      if((polyM = (PolygonM *) malloc(sizeof(PolygonM))) == NULL) {
-        Rprintf("Error: Allocating memory in C function pickAreaSamplePoints.\n");
-        fclose(fptr);
-        remove(TEMP_SHP_FILE);
-        PROTECT(results = allocVector(VECSXP, 1));
-        UNPROTECT(1); 
-        return results;  
-      }
-
-      /* read box data */
-      for(i = 0; i < 4; ++i) {
-        fread(&(polyM->box[i]), sizeof(double), 1, fptr);
-        filePosition += 8;
-      }
-
-      /* read the number of parts */
-      fread(buffer, sizeof(char), 4, fptr);
-      polyM->numParts = readLittleEndian(buffer, 4);
-      filePosition += 4;
-
-      /* read the number of points */
-      fread(buffer, sizeof(char), 4, fptr);
-      polyM->numPoints = readLittleEndian(buffer, 4);
-      filePosition += 4;
-
-      /* read parts info */ 
-      if((polyM->parts = (int *) malloc(sizeof(int) * polyM->numParts))
-      	== NULL) {
-        Rprintf("Error: Allocating memory in C function pickAreaSamplePoints.\n");
-        fclose(fptr);
-        remove(TEMP_SHP_FILE);
-        PROTECT(results = allocVector(VECSXP, 1));
-        UNPROTECT(1); 
-        return results;  
-      }
-      for(i = 0; i < polyM->numParts; ++i) {
-        fread(&(polyM->parts[i]), sizeof(char), 4, fptr);
-        filePosition += 4;
-      } 
-
-      /* read points data */
-      if((polyM->points = (Point *) malloc(sizeof(Point) * polyM->numPoints))
-         == NULL) {
-        Rprintf("Error: Allocating memory in C function pickAreaSamplePoints.\n");
-        fclose(fptr);
-        remove(TEMP_SHP_FILE);
-        PROTECT(results = allocVector(VECSXP, 1));
-        UNPROTECT(1); 
-        return results;  
-      }
-      for(i = 0; i < polyM->numPoints; ++i) {
-        fread(&(polyM->points[i].X), sizeof(double), 1, fptr);
-        filePosition += 8;
-        if(fread(&(polyM->points[i].Y), sizeof(double), 1, fptr) == 0) {
-          Rprintf("Error: reading shape file in C function pickAreaSamplePoints.\n");
-          fclose(fptr);
-          remove(TEMP_SHP_FILE);
-          PROTECT(results = allocVector(VECSXP, 1));
-          UNPROTECT(1); 
-          return results;  
-        }
-        filePosition += 8;
-      } 
-
-      /* read M range */
-      for(i = 0; i < 2; ++i) {
-        fread(&(polyM->mRange[i]), sizeof(double), 1, fptr);
-        filePosition += 8;
-      }
-
-      /* read M values */
-      if((polyM->mArray = (double *) malloc(sizeof(double)*polyM->numPoints))
-         == NULL) {
-        Rprintf("Error: Allocating memory in C function lintFcn.\n");
-        fclose(fptr);
-        remove(TEMP_SHP_FILE);
-        PROTECT(results = allocVector(VECSXP, 1));
-        UNPROTECT(1); 
-        return results;  
-      }
-      for(i = 0; i < polyM->numPoints; ++i) {
-        fread(&(polyM->mArray[i]), sizeof(double), 1, fptr);
-        filePosition += 8;
-      } 
-
-      /* add new polygon to the record struct */
-      record.polyM = polyM;
-
-    }
-
-    /* loop through each cell requiring a sample point */
-    for(i = 0; i < sampleSize; ++i) {
-      if(bp[i] == FALSE || recordIDs[i] != record.number) {
-        continue;
-       }
-      temp = &record;
-
-      /* create the cell structure */
-      cell.xMin = xc[i] - dx;
-      cell.yMin = yc[i] - dy;
-      cell.xMax = xc[i];
-      cell.yMax = yc[i];
-
-      if(shape.shapeType == POLYGON) {
-
-        /* assign the sample point bounding box */
-        if(temp->poly->box[0] < cell.xMin) {
-          xMin = cell.xMin;
-        } else {
-          xMin = temp->poly->box[0];
-        }
-        if(temp->poly->box[1] < cell.yMin) {
-          yMin = cell.yMin;
-        } else {
-          yMin = temp->poly->box[1];
-        }
-        if(temp->poly->box[2] > cell.xMax) {
-          xMax = cell.xMax;
-        } else {
-          xMax = temp->poly->box[2];
-        }
-        if(temp->poly->box[3] > cell.yMax) {
-          yMax = cell.yMax;
-        } else {
-          yMax = temp->poly->box[3];
-        }
-
-        /* make maxTry attempts to obtain a sample point */
-        for(j = 0; j < maxTry; ++j) {
-          check = 0;
-          xtemp = runif(xMin, xMax);
-          ytemp = runif(yMin, yMax);
-
-          /* if there are more than one part we need to check them separately*/
-          if(temp->poly->numParts > 1) {
-            for(k = 0; k < temp->poly->numParts; ++k) {
-              if(part) {
-                free(part);
-              }
-
-              /* check to see if this is the last part */ 
-              if(k == temp->poly->numParts - 1) {
-
-                /* store part data into part array */
-                partSize = temp->poly->numPoints - temp->poly->parts[k];
-                if((part = (Point *) malloc(sizeof(Point) * partSize)) == NULL) {
-                  Rprintf("Error: Allocating memory in C function pickAreaSamplePoints.\n");
-                  fclose(fptr);
-                  remove(TEMP_SHP_FILE);
-                  PROTECT(results = allocVector(VECSXP, 1));
-                  UNPROTECT(1); 
-                  return results;  
-                }
-                pidx = 0;
-                for(l=temp->poly->parts[k]; l < temp->poly->numPoints; ++l) {
-                  part[pidx] = temp->poly->points[l];
-                  ++pidx; 
-                }
-
-              /* not the last part */
-              } else {
-
-                /* store part data into part array */
-                partSize = temp->poly->parts[k+1] - temp->poly->parts[k];
-                part = (Point *) malloc(sizeof(Point) * partSize);
-                pidx = 0;
-                for(l=temp->poly->parts[k]; l < temp->poly->parts[k+1]; ++l) {
-                  part[pidx] = temp->poly->points[l];
-                  ++pidx; 
-                }
-
-              }
-
-              /* determine whether the point is inside this part */
-              if(insidePolygon(part,partSize, xtemp, ytemp ) == 1) {
-                ++check;
-              }
-
-            }  
-
-          /* only one part so check the entire record */
-          } else {
-
-            /* determine whether the point is inside polygon */
-            if(insidePolygon( temp->poly->points, temp->poly->numPoints, xtemp, ytemp) == 1) {
-              ++check;
-            }
-          }
-
-          if((check % 2) == 1) {
-            bp[i] = FALSE;
-            xcs[i] = xtemp;
-            ycs[i] = ytemp;
-            break;
-          }
-
-        }
-
-      } else if(shape.shapeType == POLYGON_Z) {
-
-        /* assign the sample point bounding box */
-        if(temp->polyZ->box[0] < cell.xMin) {
-          xMin = cell.xMin;
-        } else {
-          xMin = temp->polyZ->box[0];
-        }
-        if(temp->polyZ->box[1] < cell.yMin) {
-          yMin = cell.yMin;
-        } else {
-          yMin = temp->polyZ->box[1];
-        }
-        if(temp->polyZ->box[2] > cell.xMax) {
-          xMax = cell.xMax;
-        } else {
-          xMax = temp->polyZ->box[2];
-        }
-        if(temp->polyZ->box[3] > cell.yMax) {
-          yMax = cell.yMax;
-        } else {
-          yMax = temp->polyZ->box[3];
-        }
-
-        /* make maxTry attempts to obtain a sample point */
-        for(j = 0; j < maxTry; ++j) {
-          check = 0;
-          xtemp = runif(xMin, xMax);
-          ytemp = runif(yMin, yMax);
-
-          /* if there are more than one part we need to check them separately */
-          if(temp->polyZ->numParts > 1) {
-            for(k = 0; k < temp->polyZ->numParts; ++k) {
-              if(part) {
-                free(part);
-              }
-
-              /* check to see if this is the last part */ 
-              if(k == temp->polyZ->numParts - 1) {
-
-                /* store part data into part array */
-                partSize = temp->polyZ->numPoints - temp->polyZ->parts[k];
-                if((part = (Point *) malloc(sizeof(Point) * partSize)) == NULL) {
-                  Rprintf("Error: Allocating memory in C function pickAreaSamplePoints.\n");
-                  fclose(fptr);
-                  remove(TEMP_SHP_FILE);
-                  PROTECT(results = allocVector(VECSXP, 1));
-                  UNPROTECT(1); 
-                  return results;  
-                }
-                pidx = 0;
-                for(l=temp->polyZ->parts[k]; l < temp->polyZ->numPoints; ++l) {
-                  part[pidx] = temp->polyZ->points[l];
-                  ++pidx; 
-                }
-
-              /* not the last part */
-              } else {
-
-                /* store part data into part array */
-                partSize = temp->polyZ->parts[k+1] - temp->polyZ->parts[k];
-                part = (Point *) malloc(sizeof(Point) * partSize);
-                pidx = 0;
-                for(l=temp->polyZ->parts[k]; l < temp->polyZ->parts[k+1]; ++l) {
-                  part[pidx] = temp->polyZ->points[l];
-                  ++pidx; 
-                }
-
-              }
-
-              /* determine whether the point is inside this part */
-              if(insidePolygon(part,partSize, xtemp, ytemp) == 1) {
-                ++check;
-              }
-
-            }  
-
-            /* only one part so check the entire record */
-          } else {
-
-            /* determine whether the point is inside polygon */
-            if(insidePolygon(temp->polyZ->points, temp->polyZ->numPoints, xtemp, ytemp) == 1) {
-              ++check;
-            }
-          }
-
-          if((check % 2) == 1) {
-            bp[i] = FALSE;
-            xcs[i] = xtemp;
-            ycs[i] = ytemp;
-            break;
-          }
-
-        }
-
-      } else {
-
-        /* assign the sample point bounding box */
-        if(temp->polyM->box[0] < cell.xMin) {
-          xMin = cell.xMin;
-        } else {
-          xMin = temp->polyM->box[0];
-        }
-        if(temp->polyM->box[1] < cell.yMin) {
-          yMin = cell.yMin;
-        } else {
-          yMin = temp->polyM->box[1];
-        }
-        if(temp->polyM->box[2] > cell.xMax) {
-          xMax = cell.xMax;
-        } else {
-          xMax = temp->polyM->box[2];
-        }
-        if(temp->polyM->box[3] > cell.yMax) {
-          yMax = cell.yMax;
-        } else {
-          yMax = temp->polyM->box[3];
-        }
-
-        /* make maxTry attempts to obtain a sample point */
-        for(j = 0; j < maxTry; ++j) {
-          check = 0;
-          xtemp = runif(xMin, xMax);
-          ytemp = runif(yMin, yMax);
-
-          /* if there are more than one part we need to check them separately */
-          if(temp->polyM->numParts > 1) {
-            for(k = 0; k < temp->polyM->numParts; ++k) {
-              if(part) {
-                free(part);
-              }
-
-              /* check to see if this is the last part */ 
-              if(k == temp->polyM->numParts - 1) {
-
-                /* store part data into part array */
-                partSize = temp->polyM->numPoints - temp->polyM->parts[k];
-                if((part = (Point *) malloc(sizeof(Point) * partSize)) == NULL) {
-                  Rprintf("Error: Allocating memory in C function pickAreaSamplePoints.\n");
-                  fclose(fptr);
-                  remove(TEMP_SHP_FILE);
-                  PROTECT(results = allocVector(VECSXP, 1));
-                  UNPROTECT(1); 
-                  return results;  
-                }
-                pidx = 0;
-                for(l=temp->polyM->parts[k]; l < temp->polyM->numPoints; ++l) {
-                  part[pidx] = temp->polyM->points[l];
-                  ++pidx; 
-                }
-
-              /* not the last part */
-              } else {
-
-                /* store part data into part array */
-                partSize = temp->polyM->parts[k+1] - temp->polyM->parts[k];
-                part = (Point *) malloc(sizeof(Point) * partSize);
-                pidx = 0;
-                for(l=temp->polyM->parts[k]; l < temp->polyM->parts[k+1]; ++l) {
-                  part[pidx] = temp->polyM->points[l];
-                  ++pidx; 
-                }
-
-              }
-
-              /* determine whether the point is inside this part */
-              if(insidePolygon(part,partSize, xtemp, ytemp) == 1) {
-                ++check;
-              }
-
-            }  
-
-            /* only one part so check the entire record */
-          } else {
-
-            /* determine whether the point is inside polygon */
-            if(insidePolygon(temp->polyM->points, temp->polyM->numPoints, xtemp, ytemp) == 1) {
-              ++check;
-            }
-          }
-
-          if((check % 2) == 1) {
-            bp[i] = FALSE;
-            xcs[i] = xtemp;
-            ycs[i] = ytemp;
-            break;
-          }
-
-        }
-
-      } 
-
-    }
-
-    if(shape.shapeType == POLYGON) {
-      free(temp->poly->parts);
-      free(temp->poly->points);
-      free(temp->poly);
-    } else if(shape.shapeType == POLYGON_Z) {
-      free(temp->polyZ->parts);
-      free(temp->polyZ->points);
-      free(temp->polyZ->zArray);
-      free(temp->polyZ->mArray);
-      free(temp->polyZ);
-    } else {
-      free(temp->polyM->parts);
-      free(temp->polyM->points);
-      free(temp->polyM->mArray);
-      free(temp->polyM);
-    }
-
+  /* select the sample points */
+  if(useStreams) {
+    seed = rngStreamSeed();
+  }
+  if(pickFilePoints(fptr, &shape, recordIDs, xc, yc, sampleSize, dx, dy,
+                    maxTry, useStreams, seed, exact, frameBudget, numThreads,
+                    bp, xcs, ycs) == -1) {
+    Rprintf("Error: Selecting the sample points in C function pickAreaSamplePoints.\n");
+    free(shpIDs);
+    free(recordIDs);
+    free(xc);
+    free(yc);
+    free(bp);
+    free(xcs);
+    free(ycs);
+    fclose(fptr);
+    remove(TEMP_SHP_FILE);
+    PutRNGstate();
+    PROTECT(results = allocVector(VECSXP, 1));
+    UNPROTECT(1);
+    return results;
   }
 
   /* create the return R object */
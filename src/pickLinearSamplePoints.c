@@ -7,9 +7,17 @@
 **  Revised:     June 15, 2015
 **  Revised:     November 5, 2015
 **  Revised:     August 10, 2017
+**  Revised:     October 19, 2026
 **  Description:
 **    For each value in the set of shapefile record IDs, select a sample point
-**    from the shapefile record 
+**    from the shapefile record.  The segments of the record that are inside
+**    the cell are stored in a table with their cumulative lengths, so the
+**    segment containing the random position is found by a binary search.
+**    The cells are sorted by record ID, so that only the cells for a record
+**    are visited when the record is read.
+**    The point for each cell is picked by pickLinePoint, which is also used
+**    by pickStoreLinePoints to pick the points from the records held in a
+**    frame store.
 **  Arguments:
 **    fileNamePrefix = the shapefile name
 **    shpIDsVec = vector of shapefile record IDs to use in the calculations
@@ -50,17 +58,332 @@ extern int combineShpFiles(FILE * newShp, unsigned int * ids, int numIDs);
 extern int createNewTempShpFile(FILE * newShp, char * shapeFileName,
                                 unsigned int * ids, int numIDs);
 
+/* This function is found in pickAreaSamplePoints.c */
+extern int readShapeRecord(FILE * fptr, Polygon * poly, int * number,
+                           unsigned int * filePosition);
+
 /* These functions are found in grtslin.c */
-extern void addSegment( Segment ** head, Segment * seg );
-extern void deallocateSegments( Segment * head );
+extern void initSegmentTable(SegmentTable * table);
+extern void freeSegmentTable(SegmentTable * table);
+extern Segment * nextSegment(SegmentTable * table);
+extern double sumSegments(SegmentTable * table);
+extern int findSegment(SegmentTable * table, double pos);
+extern void segmentPoint(Segment * seg, double len, double * x, double * y);
 extern double lineLength(double x1, double y1, double x2, double y2, Cell * cell, 
                          Segment ** newSeg);
 
+/* struct used to sort the cells by the record ID that they select a point */
+/* from */
+typedef struct cellRecordStruct CellRecord;
+struct cellRecordStruct {
+  unsigned int id;
+  int cell;
+};
+
+
+/**********************************************************
+** Function:   compareCellRecord
+**
+** Purpose:    qsort comparison function that orders CellRecord structs
+**             by record ID and then by cell.
+***********************************************************/
+int compareCellRecord(const void * a, const void * b) {
+
+  const CellRecord * pa = (const CellRecord *) a;
+  const CellRecord * pb = (const CellRecord *) b;
+
+  if(pa->id != pb->id) {
+    return pa->id < pb->id ? -1 : 1;
+  }
+  if(pa->cell != pb->cell) {
+    return pa->cell < pb->cell ? -1 : 1;
+  }
+  return 0;
+}
+
+
+/**********************************************************
+** Function:   pickLinePoint
+**
+** Purpose:    Select a sample point in a cell from the segments of a
+**             polyline record that are inside the cell.
+** Notes:      The point is selected using R's random number generator, so
+**             the calling function must bracket the call with GetRNGstate
+**             and PutRNGstate.  When the record has no length inside the
+**             cell, the coordinates of the point are not changed.
+** Arguments:  points,    points of the record
+**             numPoints, number of points in the record
+**             parts,     part offsets of the record
+**             numParts,  number of parts in the record
+**             recNum,    record number
+**             cell,      the cell
+**             segments,  table used to hold the segments of the record that
+**                        are inside the cell
+**             xs,        x-coordinate of the sample point
+**             ys,        y-coordinate of the sample point
+** Return:     1,  if a point was selected
+**             0,  if the record has no length inside the cell
+**             -1, if memory could not be allocated
+***********************************************************/
+int pickLinePoint(Point * points, int numPoints, int * parts, int numParts,
+                  unsigned int recNum, Cell * cell, SegmentTable * segments,
+                  double * xs, double * ys) {
+
+  int k;                 /* loop counter */
+  int partIndx;          /* index into polyline parts array */
+  Segment * seg;         /* slot for the next segment in the table */
+  double tempLength;     /* stores current shapefile record clipped length */
+  double sumWl;          /* sum of the segment lengths in a cell */
+  double pos;            /* position along the line of all segment lengths in a cell */
+
+  /* go through each segment in this record */
+  segments->numSegs = 0;
+  partIndx = 1; 
+  for(k = 0; k < numPoints-1; ++k) {
+
+    /* if there are multiple parts, assume the parts are not connected */
+    if(numParts > 1 && partIndx < numParts) {
+      if((k + 1) == parts[partIndx]) {
+        ++partIndx;
+        continue;
+      }
+    }
+
+    /* get the slot for the next segment */
+    if((seg = nextSegment(segments)) == NULL) {
+      return -1;
+    }
+
+    /* get the length of the line that is inside the cell */
+    tempLength = lineLength(points[k].X, points[k].Y, points[k+1].X,
+                            points[k+1].Y, cell, &seg);
+
+    /* if this segment was inside the cell, then add it to the table */ 
+    if(tempLength > 0.0) {
+      seg->recordNumber = recNum;
+      seg->length = tempLength;
+      ++segments->numSegs;
+    }
+  }
+
+  /* get the total length of all the segments in this cell */
+  sumWl = sumSegments(segments);
+
+  /* randomly pick a point along the line of segments and find the */
+  /* segment that contains it */
+  pos = runif(0.0, sumWl);
+  if((k = findSegment(segments, pos)) == -1) {
+    return 0;
+  }
+
+  /* determine the coordinates for the sample point */
+  segmentPoint(&segments->segs[k], pos - segments->cumLen[k], xs, ys);
+
+  return 1;
+}
+
+
+/**********************************************************
+** Function:   pickStoreLinePoints
+**
+** Purpose:    Select a sample point in each cell from the polyline records
+**             held in a frame store.
+** Notes:      The points are selected using R's random number generator
+**             in the order of the records in the store and then of the
+**             cells, which is the order in which they are selected from
+**             the shapefile by pickLinearSamplePoints, so the calling
+**             function must bracket the call with GetRNGstate and
+**             PutRNGstate.  The coordinates of a point are left at zero
+**             when its record has no length inside the cell.
+** Arguments:  store,      frame store that contains the records
+**             recordIDs,  shapefile record ID for each cell
+**             xc,         x-coordinate of the right edge of each cell
+**             yc,         y-coordinate of the top edge of each cell
+**             sampleSize, number of cells
+**             dx,         x-axis size of the grid cells
+**             dy,         y-axis size of the grid cells
+**             xcs,        x-coordinates of the sample points
+**             ycs,        y-coordinates of the sample points
+** Return:     1,  on success
+**             -1, if memory could not be allocated
+***********************************************************/
+int pickStoreLinePoints(FrameStore * store, unsigned int * recordIDs,
+                        double * xc, double * yc, int sampleSize, double dx,
+                        double dy, double * xcs, double * ycs) {
+
+  int i, r;                    /* loop counters */
+  int c, lo, hi;               /* indices into the cellRecs array */
+  CellRecord * cellRecs = NULL;  /* cells sorted by record ID */
+  Cell cell;             /* temporary storage for a cell */
+  SegmentTable segments; /* segments of the record inside the cell */
+  int error = FALSE;     /* TRUE if memory could not be allocated */
+
+  /* sort the cells by record ID, keeping the cells for a record in order */
+  if((cellRecs = (CellRecord *) malloc(sizeof(CellRecord) * (sampleSize + 1)))
+     == NULL) {
+    return -1;
+  }
+  for(i = 0; i < sampleSize; ++i) {
+    cellRecs[i].id = recordIDs[i];
+    cellRecs[i].cell = i;
+    xcs[i] = 0.0;
+    ycs[i] = 0.0;
+  }
+  qsort(cellRecs, sampleSize, sizeof(CellRecord), compareCellRecord);
+
+  /* select sample points */  
+  initSegmentTable(&segments);
+  for(r = 0; r < store->numRecords && !error; ++r) {
+
+    /* find the first cell requiring a sample point from this record */
+    lo = 0;
+    hi = sampleSize;
+    while(lo < hi) {
+      c = lo + (hi - lo) / 2;
+      if(cellRecs[c].id < store->recNum[r]) {
+        lo = c + 1;
+      } else {
+        hi = c;
+      }
+    }
+
+    /* loop through each cell requiring a sample point from this record */
+    for(c = lo; c < sampleSize && cellRecs[c].id == store->recNum[r]; ++c) {
+      i = cellRecs[c].cell;
+      cell.xMin = xc[i] - dx;
+      cell.yMin = yc[i] - dy;
+      cell.xMax = xc[i];
+      cell.yMax = yc[i];
+      if(pickLinePoint(&store->points[store->pointStart[r]],
+                       store->numPts[r], &store->parts[store->partStart[r]],
+                       store->numParts[r], store->recNum[r], &cell,
+                       &segments, &xcs[i], &ycs[i]) == -1) {
+        error = TRUE;
+        break;
+      }
+    }
+  }
+
+  freeSegmentTable(&segments);
+  free(cellRecs);
+
+  return error ? -1 : 1;
+}
+
+
+/**********************************************************
+** Function:   pickFileLinePoints
+**
+** Purpose:    Select a sample point in each cell from the records of the
+**             temporary shapefile.
+** Notes:      The records are read one at a time by readShapeRecord, and
+**             the points are selected in the order of the records in the
+**             shapefile and then of the cells.  Records that do not have a
+**             cell are skipped, so the shapefile may contain every record
+**             of the frame.  The calling function must bracket the call
+**             with GetRNGstate and PutRNGstate.
+** Arguments:  fptr,       pointer to the temporary shapefile
+**             shape,      shape struct that contains the header info for
+**                         the shapefile
+**             recordIDs,  shapefile record ID for each cell
+**             xc,         x-coordinate of the right edge of each cell
+**             yc,         y-coordinate of the top edge of each cell
+**             sampleSize, number of cells
+**             dx,         x-axis size of the grid cells
+**             dy,         y-axis size of the grid cells
+**             xcs,        x-coordinates of the sample points
+**             ycs,        y-coordinates of the sample points
+** Return:     1,  on success
+**             -1, on error
+***********************************************************/
+int pickFileLinePoints(FILE * fptr, Shape * shape, unsigned int * recordIDs,
+                       double * xc, double * yc, int sampleSize, double dx,
+                       double dy, double * xcs, double * ycs) {
+
+  int i;                       /* loop counter */
+  int c, lo, hi;               /* indices into the cellRecs array */
+  CellRecord * cellRecs = NULL;  /* cells sorted by record ID */
+  unsigned int filePosition = 100;  /* byte offset for the beginning of the */
+                                    /* record data */
+  Polygon poly;          /* current record */
+  int number;            /* record number of the current record */
+  Cell cell;             /* temporary storage for a cell */
+  SegmentTable segments; /* segments of the record inside the cell */
+  int error = FALSE;     /* TRUE if an error occurred */
+
+  /* sort the cells by record ID, keeping the cells for a record in order, */
+  /* so that the cells for each record are found by a binary search */
+  if((cellRecs = (CellRecord *) malloc(sizeof(CellRecord) * (sampleSize + 1)))
+     == NULL) {
+    Rprintf("Error: Allocating memory in C function pickFileLinePoints.\n");
+    return -1;
+  }
+  for(i = 0; i < sampleSize; ++i) {
+    cellRecs[i].id = recordIDs[i];
+    cellRecs[i].cell = i;
+    xcs[i] = 0.0;
+    ycs[i] = 0.0;
+  }
+  qsort(cellRecs, sampleSize, sizeof(CellRecord), compareCellRecord);
+
+  /* select sample points */
+  fseek(fptr, 100, SEEK_SET);
+  initSegmentTable(&segments);
+  while(!error && filePosition < shape->fileLength*2) {
+
+    /* read the record */
+    if(readShapeRecord(fptr, &poly, &number, &filePosition) == -1) {
+      error = TRUE;
+      break;
+    }
+
+    /* find the first cell requiring a sample point from this record */
+    lo = 0;
+    hi = sampleSize;
+    while(lo < hi) {
+      c = lo + (hi - lo) / 2;
+      if(cellRecs[c].id < number) {
+        lo = c + 1;
+      } else {
+        hi = c;
+      }
+    }
+
+    /* loop through each cell requiring a sample point from this record, */
+    /* which are in the same order as the cells */
+    for(c = lo; c < sampleSize && cellRecs[c].id == number; ++c) {
+      i = cellRecs[c].cell;
+
+      /* create the cell structure */
+      cell.xMin = xc[i] - dx;
+      cell.yMin = yc[i] - dy;
+      cell.xMax = xc[i];
+      cell.yMax = yc[i];
+
+      /* pick the sample point */
+      if(pickLinePoint(poly.points, poly.numPoints, poly.parts,
+                       poly.numParts, number, &cell, &segments, &xcs[i],
+                       &ycs[i]) == -1) {
+        Rprintf("Error: Allocating memory in C function pickFileLinePoints.\n");
+        error = TRUE;
+        break;
+      }
+    }
+
+    free(poly.parts);
+    free(poly.points);
+  }
+  freeSegmentTable(&segments);
+  free(cellRecs);
+
+  return error ? -1 : 1;
+}
+
 
 SEXP pickLinearSamplePoints(SEXP fileNamePrefix, SEXP shpIDsVec,
      SEXP recordIDsVec, SEXP xcVec, SEXP ycVec, SEXP dxVal, SEXP dyVal) {
 
-  int i, k;                    /* loop counters */
+  int i;                       /* loop counter */
   FILE * fptr = NULL;         /* pointer to the shapefile */
   FILE * newShp = NULL;       /* pointer to the temporary .shp file */
   unsigned int fileNameLen = 0;  /* length of the shapefile name */
@@ -68,19 +391,6 @@ SEXP pickLinearSamplePoints(SEXP fileNamePrefix, SEXP shpIDsVec,
   char * restrict shpFileName = NULL;  /* stores the full .shp file name */
   int singleFile = FALSE;
   Shape shape;           /* used to store shapefile info and data */
-  Record * temp = NULL;  /* used for traversing linked list of records */
-  int partIndx;          /* index into polyline parts array */
-  unsigned int filePosition = 100;  /* byte offset for the beginning of the */
-                                    /* record data */
-  unsigned char buffer[4];  /* temp buffer for reading from file */
-  Polygon * poly;        /* temp Polygon storage */
-  PolygonZ * polyZ;      /* temp PolygonZ storage */
-  PolygonM * polyM;      /* temp PolygonM storage */
-  Record record;         /* record used for parsing records */
-  Cell cell;             /* temporary storage for a cell */
-  Segment * seg;         /* variable for storing a segment struct */
-  Segment * segmentList = NULL;  /* variable for storing a linked list of segment structs */
-  Segment * tempSeg;     /* variables for traversing the list of segment structs */
   unsigned int * shpIDs = NULL;     /* array of shapefile record IDs to use */
   unsigned int dsgSize = length(shpIDsVec);  /* number of values in the shpIDs array */
   unsigned int sampleSize = length(xcVec); /* sample size */
@@ -91,13 +401,6 @@ SEXP pickLinearSamplePoints(SEXP fileNamePrefix, SEXP shpIDsVec,
   double dy;             /* y-axis size of the grid cells */
   SEXP xcsVec;           /* return vector of record IDs */
   SEXP ycsVec;          /* return vector of record clipped areas */
-  double tempLength;     /* stores current shapefile record clipped length */
-  double sumWl;          /* sum of the segment lengths in a cell */
-  double pos;            /* position along the line of all segment lengths in a cell */
-  double cumSum;         /* cumulative sum of lengths up to selected point */
-  double len;            /* variable for determining coordinates of the sample point */
-  double dx2, dy2;       /* variables for determining coordinates of the sample point */
-  double lx, ly;         /* variables for determining coordinates of the sample point */
   double * xcs = NULL;   /* array of sample x-coordinates */
   double * ycs = NULL;   /* array array of sample x-coordinates */
   SEXP results = NULL;   /* R object used to return values to R */
@@ -256,492 +559,21 @@ SEXP pickLinearSamplePoints(SEXP fileNamePrefix, SEXP shpIDsVec,
     ycs[i] = 0.0;
   }
 
-  /* select sample points */  
-  while (filePosition < shape.fileLength*2) {
-    /* read the record number */
-    fread(buffer, sizeof(char), 4, fptr);
-    record.number = readBigEndian(buffer, 4); 
-    filePosition += 4;
-
-    /* ignore content length */
-    fread(buffer, sizeof(char), 4, fptr);
-    filePosition += 4;
-
-    /* ignore shape type */
-    fread(buffer, sizeof(char), 4, fptr);
-    filePosition += 4;
-
-    if(shape.shapeType == POLYLINE) {
-
-      /* allocate a new polygon */
-      if((poly = (Polygon *) malloc(sizeof(Polygon))) == NULL) {
-        Rprintf("Error: Allocating memory in C function pickLinearSamplePoints.\n");
-        fclose(fptr);
-        remove(TEMP_SHP_FILE);
-        PROTECT(results = allocVector(VECSXP, 1));
-        UNPROTECT(1); 
-        return results;  
-      }
-
-      /* read box data */
-      for(i = 0; i < 4; ++i) {
-        fread(&(poly->box[i]), sizeof(double), 1, fptr);
-        filePosition += 8;
-      }
-
-      /* read the number of parts */
-      fread(buffer, sizeof(char), 4, fptr);
-      poly->numParts = readLittleEndian(buffer, 4);
-      filePosition += 4;
-
-      /* read the number of points */
-      fread(buffer, sizeof(char), 4, fptr);
-      poly->numPoints = readLittleEndian(buffer, 4);
-      filePosition += 4;
-
-      /* read parts info */ 
-      if((poly->parts = (int *) malloc(sizeof(int) * poly->numParts))==NULL) {
-        Rprintf("Error: Allocating memory in C function pickLinearSamplePoints.\n");
-        fclose(fptr);
-        remove(TEMP_SHP_FILE);
-        PROTECT(results = allocVector(VECSXP, 1));
-        UNPROTECT(1); 
-        return results;  
-      }
-      for(i = 0; i < poly->numParts; ++i) {
-        fread(&(poly->parts[i]), sizeof(char), 4, fptr);
-        filePosition += 4;
-      } 
-
-      /* read points data */
-      if((poly->points = (Point *) malloc(sizeof(Point) * poly->numPoints))
-         == NULL) {
-        Rprintf("Error: Allocating memory in C function pickLinearSamplePoints.\n");
-        fclose(fptr);
-        remove(TEMP_SHP_FILE);
-        PROTECT(results = allocVector(VECSXP, 1));
-        UNPROTECT(1); 
-        return results;  
-      }
-      for(i = 0; i < poly->numPoints; ++i) {
-        fread(&(poly->points[i].X), sizeof(double), 1, fptr);
-        filePosition += 8;
-        if(fread(&(poly->points[i].Y), sizeof(double), 1, fptr) == 0) {
-          Rprintf("Error: reading shape file in C function pickLinearSamplePoints.\n");
-          fclose(fptr);
-          remove(TEMP_SHP_FILE);
-          PROTECT(results = allocVector(VECSXP, 1));
-          UNPROTECT(1); 
-          return results;  
-        }
-        filePosition += 8;
-      } 
-
-      /* add new polygon to the record struct */
-      record.poly = poly;
-
-    } else if(shape.shapeType == POLYLINE_Z) {
-
-      /* allocate a new polygon */
-      if((polyZ = (PolygonZ *) malloc(sizeof(PolygonZ))) == NULL) {
-        Rprintf("Error: Allocating memory in C function pickLinearSamplePoints.\n");
-        fclose(fptr);
-        remove(TEMP_SHP_FILE);
-        PROTECT(results = allocVector(VECSXP, 1));
-        UNPROTECT(1); 
-        return results;  
-      }
-
-      /* read box data */
-      for(i = 0; i < 4; ++i) {
-        fread(&(polyZ->box[i]), sizeof(double), 1, fptr);
-        filePosition += 8;
-      }
-
-      /* read the number of parts */
-      fread(buffer, sizeof(char), 4, fptr);
-      polyZ->numParts = readLittleEndian(buffer, 4);
-      filePosition += 4;
-
-      /* read the number of points */
-      fread(buffer, sizeof(char), 4, fptr);
-      polyZ->numPoints = readLittleEndian(buffer, 4);
-      filePosition += 4;
-
-      /* read parts info */ 
-      if((polyZ->parts = (int *) malloc(sizeof(int) * polyZ->numParts))
-      	== NULL) {
-        Rprintf("Error: Allocating memory in C function pickLinearSamplePoints.\n");
-        fclose(fptr);
-        remove(TEMP_SHP_FILE);
-        PROTECT(results = allocVector(VECSXP, 1));
-        UNPROTECT(1); 
-        return results;  
-      }
-      for(i = 0; i < polyZ->numParts; ++i) {
-        fread(&(polyZ->parts[i]), sizeof(char), 4, fptr);
-        filePosition += 4;
-      } 
-
-      /* read points data */
-      if((polyZ->points = (Point *) malloc(sizeof(Point) * polyZ->numPoints))
-         == NULL) {
-        Rprintf("Error: Allocating memory in C function pickLinearSamplePoints.\n");
-        fclose(fptr);
-        remove(TEMP_SHP_FILE);
-        PROTECT(results = allocVector(VECSXP, 1));
-        UNPROTECT(1); 
-        return results;  
-      }
-      for(i = 0; i < polyZ->numPoints; ++i) {
-        fread(&(polyZ->points[i].X), sizeof(double), 1, fptr);
-        filePosition += 8;
-        if(fread(&(polyZ->points[i].Y), sizeof(double), 1, fptr) == 0) {
-          Rprintf("Error: reading shape file in C function pickLinearSamplePoints.\n");
-          fclose(fptr);
-          remove(TEMP_SHP_FILE);
-          PROTECT(results = allocVector(VECSXP, 1));
-          UNPROTECT(1); 
-          return results;  
-        }
-        filePosition += 8;
-      } 
-
-      /* read Z range */
-      for(i = 0; i < 2; ++i) {
-        fread(&(polyZ->zRange[i]), sizeof(double), 1, fptr);
-        filePosition += 8;
-      }
-
-      /* read Z values */
-      if((polyZ->zArray = (double *) malloc(sizeof(double)*polyZ->numPoints))
-         == NULL) {
-        Rprintf("Error: Allocating memory in C function pickLinearSamplePoints.\n");
-        fclose(fptr);
-        remove(TEMP_SHP_FILE);
-        PROTECT(results = allocVector(VECSXP, 1));
-        UNPROTECT(1); 
-        return results;  
-      }
-      for(i = 0; i < polyZ->numPoints; ++i) {
-        fread(&(polyZ->zArray[i]), sizeof(double), 1, fptr);
-        filePosition += 8;
-      } 
-
-      /* read M range */
-      for(i = 0; i < 2; ++i) {
-        fread(&(polyZ->mRange[i]), sizeof(double), 1, fptr);
-        filePosition += 8;
-      }
-
-      /* read M values */
-      if((polyZ->mArray = (double *) malloc(sizeof(double)*polyZ->numPoints))
-         == NULL) {
-        Rprintf("Error: Allocating memory in C function pickLinearSamplePoints.\n");
-        fclose(fptr);
-        remove(TEMP_SHP_FILE);
-        PROTECT(results = allocVector(VECSXP, 1));
-        UNPROTECT(1); 
-        return results;  
-      }
-      for(i = 0; i < polyZ->numPoints; ++i) {
-        fread(&(polyZ->mArray[i]), sizeof(double), 1, fptr);
-        filePosition += 8;
-      } 
-
-      /* add new polygon to the record struct */
-      record.polyZ = polyZ;
-
-    } else {
-
-      /* allocate a new polygon */
-      if((polyM = (PolygonM *) malloc(sizeof(PolygonM))) == NULL) {
-        Rprintf("Error: Allocating memory in C function pickLinearSamplePoints.\n");
-        fclose(fptr);
-        remove(TEMP_SHP_FILE);
-        PROTECT(results = allocVector(VECSXP, 1));
-        UNPROTECT(1); 
-        return results;  
-      }
-
-      /* read box data */
-      for(i = 0; i < 4; ++i) {
-        fread(&(polyM->box[i]), sizeof(double), 1, fptr);
-        filePosition += 8;
-      }
-
-      /* read the number of parts */
-      fread(buffer, sizeof(char), 4, fptr);
-      polyM->numParts = readLittleEndian(buffer, 4);
-      filePosition += 4;
-
-      /* read the number of points */
-      fread(buffer, sizeof(char), 4, fptr);
-      polyM->numPoints = readLittleEndian(buffer, 4);
-      filePosition += 4;
-
-      /* read parts info */ 
-      if((polyM->parts = (int *) malloc(sizeof(int) * polyM->numParts))
-      	== NULL) {
-        Rprintf("Error: Allocating memory in C function pickLinearSamplePoints.\n");
-        fclose(fptr);
-        remove(TEMP_SHP_FILE);
-        PROTECT(results = allocVector(VECSXP, 1));
-        UNPROTECT(1); 
-        return results;  
-      }
-      for(i = 0; i < polyM->numParts; ++i) {
-        fread(&(polyM->parts[i]), sizeof(char), 4, fptr);
-        filePosition += 4;
-      } 
-
-      /* read points data */
-      if((polyM->points = (Point *) malloc(sizeof(Point) * polyM->numPoints))
-         == NULL) {
-        Rprintf("Error: Allocating memory in C function pickLinearSamplePoints.\n");
-        fclose(fptr);
-        remove(TEMP_SHP_FILE);
-        PROTECT(results = allocVector(VECSXP, 1));
-        UNPROTECT(1); 
-        return results;  
-      }
-      for(i = 0; i < polyM->numPoints; ++i) {
-        fread(&(polyM->points[i].X), sizeof(double), 1, fptr);
-        filePosition += 8;
-        if(fread(&(polyM->points[i].Y), sizeof(double), 1, fptr) == 0) {
-          Rprintf("Error: reading shape file in C function pickLinearSamplePoints.\n");
-          fclose(fptr);
-          remove(TEMP_SHP_FILE);
-          PROTECT(results = allocVector(VECSXP, 1));
-          UNPROTECT(1); 
-          return results;  
-        }
-        filePosition += 8;
-      } 
-
-      /* read M range */
-      for(i = 0; i < 2; ++i) {
-        fread(&(polyM->mRange[i]), sizeof(double), 1, fptr);
-        filePosition += 8;
-      }
-
-      /* read M values */
-      if((polyM->mArray = (double *) malloc(sizeof(double)*polyM->numPoints))
-         == NULL) {
-        Rprintf("Error: Allocating memory in C function lintFcn.\n");
-        fclose(fptr);
-        remove(TEMP_SHP_FILE);
-        PROTECT(results = allocVector(VECSXP, 1));
-        UNPROTECT(1); 
-        return results;  
-      }
-      for(i = 0; i < polyM->numPoints; ++i) {
-        fread(&(polyM->mArray[i]), sizeof(double), 1, fptr);
-        filePosition += 8;
-      } 
-
-      /* add new polygon to the record struct */
-      record.polyM = polyM;
-
-    }
-
-    /* loop through each cell requiring a sample point */
-    for(i = 0; i < sampleSize; ++i) {
-      if(recordIDs[i] != record.number) {
-        continue;
-       }
-      temp = &record;
-
-      /* create the cell structure */
-      cell.xMin = xc[i] - dx;
-      cell.yMin = yc[i] - dy;
-      cell.xMax = xc[i];
-      cell.yMax = yc[i];
-
-      if(shape.shapeType == POLYLINE) {
-
-        /* go through each segment in this record */
-        partIndx = 1; 
-        for(k = 0; k < temp->poly->numPoints-1; ++k) {
-
-          /* if there are multiple parts, assume the parts are not connected */
-          if(temp->poly->numParts > 1 && partIndx < temp->poly->numParts) {
-            if((k + 1) == temp->poly->parts[partIndx]) {
-              ++partIndx;
-              continue;
-            }
-          }
-
-          /* allocate new segment struct */
-          if((seg = (Segment *) malloc(sizeof(Segment))) == NULL) {
-            Rprintf("Error: Allocating memory in C function linSample.\n");
-            fclose(fptr);
-            remove(TEMP_SHP_FILE);
-            PROTECT(results = allocVector(VECSXP, 1));
-            UNPROTECT(1);
-            return results;
-          }
-
-          /* get the length of the line that is inside the cell */
-          tempLength = lineLength(temp->poly->points[k].X, 
-                                  temp->poly->points[k].Y, 
-                                  temp->poly->points[k+1].X, 
-                                  temp->poly->points[k+1].Y, &cell, &seg);
- 
-          /* if this segment was inside the cell, then add it to the list */ 
-          if(tempLength > 0.0) {
-            seg->recordNumber = record.number;
-            seg->length = tempLength;
-            addSegment(&segmentList, seg);
-          } else {
-            free( seg );
-          }
-
-
-        }
-
-      } else if(shape.shapeType == POLYLINE_Z) {
-
-        /* go through each segment in this record */
-        partIndx = 1; 
-        for(k = 0; k < temp->polyZ->numPoints-1; ++k) {
-
-          /* if there are multiple parts, assume the parts are not connected */
-          if(temp->polyZ->numParts > 1 && partIndx < temp->polyZ->numParts) {
-            if((k + 1) == temp->polyZ->parts[partIndx]) {
-              ++partIndx;
-              continue;
-            }
-          }
-
-          /* allocate new segment struct */
-          if((seg = (Segment *) malloc(sizeof(Segment))) == NULL) {
-            Rprintf("Error: Allocating memory in C function linSample.\n");
-            fclose(fptr);
-            remove(TEMP_SHP_FILE);
-            PROTECT(results = allocVector(VECSXP, 1));
-            UNPROTECT(1);
-            return results;
-          }
-
-          /* get the length of the line that is inside the cell */
-          tempLength = lineLength(temp->polyZ->points[k].X, 
-                                  temp->polyZ->points[k].Y, 
-                                  temp->polyZ->points[k+1].X, 
-                                  temp->polyZ->points[k+1].Y, &cell, &seg);
-
-          /* if this segment was inside the cell, then add it to the list */ 
-          if(tempLength > 0.0) {
-            seg->recordNumber = record.number;
-            seg->length = tempLength;
-            addSegment(&segmentList, seg);
-          } else {
-            free( seg );
-          }
-
-
-        }
-
-      } else {
-
-        /* go through each segment in this record */
-        partIndx = 1; 
-        for (k = 0; k < temp->polyM->numPoints-1; ++k) {
-
-          /* if there are multiple parts, assume the parts are not connected */
-          if(temp->polyM->numParts > 1 && partIndx < temp->polyM->numParts) {
-            if((k + 1) == temp->polyM->parts[partIndx]) {
-              ++partIndx;
-              continue;
-            }
-          }
-
-          /* allocate new segment struct */
-          if((seg = (Segment *) malloc(sizeof(Segment))) == NULL) {
-            Rprintf("Error: Allocating memory in C function linSample.\n");
-            fclose(fptr);
-            remove(TEMP_SHP_FILE);
-            PROTECT(results = allocVector(VECSXP, 1));
-            UNPROTECT(1);
-            return results;
-          }
-
-          /* get the length of the line that is inside the cell */
-          tempLength = lineLength(temp->polyM->points[k].X, 
-                                  temp->polyM->points[k].Y, 
-                                  temp->polyM->points[k+1].X, 
-                                  temp->polyM->points[k+1].Y, &cell, &seg);
-       
-          /* if this segment was inside the cell, then add it to the list */ 
-          if(tempLength > 0.0) {
-            seg->recordNumber = record.number;
-            seg->length = tempLength;
-            addSegment(&segmentList, seg);
-          } else {
-            free( seg );
-          }
-
-        }
-
-      } 
-
-      /* get the total length of all the segments in this cell */
-      tempSeg = segmentList;
-      sumWl = 0.0;
-      while(tempSeg != NULL) {
-        sumWl += tempSeg->length;
-        tempSeg = tempSeg->next;
-      }
-
-      /* randomly pick a point along the line of segments */
-      pos = runif(0.0, sumWl);
-      tempSeg = segmentList;
-      cumSum = 0.0;
-      while(TRUE && tempSeg != NULL) {
-        cumSum += tempSeg->length;
-        if(pos < cumSum) {
-          break;
-        }
-        tempSeg = tempSeg->next;
-      }
-
-      /* determine the coordinates for the sample point */
-      len = (pos - cumSum);
-      dx2 = tempSeg->p2.X - tempSeg->p1.X;
-      dy2 = tempSeg->p2.Y - tempSeg->p1.Y;
-      if(dx2 != 0) {
-        lx = sign(dx2) * sqrt((len*len) / (1 + (dy2*dy2)/(dx2*dx2)));
-        ly = lx * (dy2/dx2);
-      } else {
-        lx = 0.0;
-        ly = -sign(dy2) * len;
-      }
-      xcs[i] = tempSeg->p1.X + lx;
-      ycs[i] = tempSeg->p1.Y + ly;
-
-      /* deallocate any memory used for the segment list */
-      deallocateSegments(segmentList);
-      segmentList = NULL;
-
-    }
-
-    if(shape.shapeType == POLYLINE) {
-      free(temp->poly->parts);
-      free(temp->poly->points);
-      free(temp->poly);
-    } else if(shape.shapeType == POLYLINE_Z) {
-      free(temp->polyZ->parts);
-      free(temp->polyZ->points);
-      free(temp->polyZ->zArray);
-      free(temp->polyZ->mArray);
-      free(temp->polyZ);
-    } else {
-      free(temp->polyM->parts);
-      free(temp->polyM->points);
-      free(temp->polyM->mArray);
-      free(temp->polyM);
-    }
-
+  /* select sample points */
+  if(pickFileLinePoints(fptr, &shape, recordIDs, xc, yc, sampleSize, dx, dy,
+                        xcs, ycs) == -1) {
+    free(shpIDs);
+    free(recordIDs);
+    free(xc);
+    free(yc);
+    free(xcs);
+    free(ycs);
+    fclose(fptr);
+    remove(TEMP_SHP_FILE);
+    PutRNGstate();
+    PROTECT(results = allocVector(VECSXP, 1));
+    UNPROTECT(1);
+    return results;
   }
 
   /* create the return R object */
@@ -6,32 +6,19 @@
 **               4-fold hierarchical addresses.
 **  Programmers: Christian Platt, Tom Kincaid
 **  Algorithm:   The entry point from R is in the ranho function.  The 
-**               algorithm behaves just like the R version in that this
-**               entry function then calls the recursive permFcn which 
-**               generates the hierarchical addresses.  The new addresses
+**               algorithm behaves just like the R version in that it
+**               generates one random perm for each prefix of the addresses,
+**               visiting the prefixes depth first and taking the digits in
+**               order.  Rather than recursing over linked lists of the
+**               addresses, the addresses are sorted so that the prefixes are
+**               visited by taking the addresses in turn.  The new addresses
 **               are written over the sent addresses so R needs to retrieve
 **               them from the original structure that holds the addresses.
-**
-**               To implement some of the build in R functions that were used
-**               in the R version to linked lists are used.  One is used to
-**               store temporary subset of pointers to the addresses and 
-**               behaves like the 'b' variable in the R version of ranho.  
-**               The other list is used to store columns values of the 
-**               addresses at a specific column level. The nodes in this list
-**               also store a pointer to the address so that it can be
-**               referenced from the node.  
-**
-**               The reason that two different node types were used instead of
-**               combining them into one was to save memory space.  Since the
-**               number of addresses can get large storing an unecessary char
-**               in each address node would of been a waste of memory.
-**  Notes:       The perm array (in permFcn) can be changed to be only 4 
-**               chars in length. It is at 5 so that the '\0' could be 
-**               added so that they could be printed out using Rprintf.
 **  Created:     August 11, 2004
 **  Revised:     April 24, 2006
 **  Revised:     January 27, 2012
 **  Revised:     June 15, 2015
+**  Revised:     October 19, 2026
 ******************************************************************************/
 
 #include <stdio.h>
@@ -41,21 +28,7 @@
 #include <R.h>
 #include <Rmath.h>
 #include <Rdefines.h>
-
-/* node type for the linked list of addresses */
-typedef struct AddrNode addrNode;
-struct AddrNode {
-  char * addr;                  /* address (i.e. "4311", "321324", etc. ) */
-  struct AddrNode * next;       /* pointer to next node in the list */
-};
-
-/* node type for the linked list of column chars assoicated with addresses */
-typedef struct ColCharNode colCharNode;
-struct ColCharNode {
-  char colChar;                 /* character found at column position(i.e. 4)*/
-  char * addr;                  /* address (i.e. "4311", "321324", etc. ) */
-  struct ColCharNode * next;    /* pointer to next node in the list */
-};
+#include "ranho.h"
 
 /* all possible perms to be used with the genPerm function */
 char * perms[24] = { "1234", "1243", "1324", "1342", "1423", "1432",
@@ -65,128 +38,51 @@ char * perms[24] = { "1234", "1243", "1324", "1342", "1423", "1432",
 
 
 /**********************************************************
-** Function:   genPerm
-**
-** Purpose:    Randomly generates a new perm.  This is done by
-**             randomly choosing a string from the perms[] array.
-** Arguments:  perm, character array to store the new perm in
-** Return:     void
-***********************************************************/
-void genPerm( char * perm ) {
-
-  /* pick and copy the perm into the sent char array */
-  strncpy( perm, perms[(int) (24.0*runif( 0.0, RAND_MAX )/(RAND_MAX+1.0)) ] , 4 );
-
-  return;
-}
-
-
-/**********************************************************
-** Function:   addAddrNode
+** Function:   genPermIdx
 **
-** Purpose:    Allocates and adds a new node to the front of
-**             addrList that is pointed to by head.  This node's
-**             addr pointer will then point to the sent addr. This
-**             list is used to store a temporary subset of the addresses.
-** Arguments:  head, pointer to pointer to beginning of the linked list
-**             addr, pointer to array of chars that store address
-** Return:     1,  on success
-**             -1, on error 
+** Purpose:    Randomly chooses one of the perms in the perms[] array.
+** Arguments:  none
+** Return:     index of the perm in the perms[] array
 ***********************************************************/
-int addAddrNode( addrNode ** head, char * addr ) {
-  addrNode * temp;
-
-  /* check to see if there is already a node in the list */
-  if ( *head ) {
-    if ( (temp = (addrNode *) malloc( sizeof(addrNode) )) == NULL ) {
-      return -1;
-    }
-    temp->addr = addr;
-    temp->next = *head;
-
-    *head = temp;
+int genPermIdx( void ) {
 
-  /* else list is empty so create the first node */
-  } else {
-    if ( (*head = (addrNode *) malloc( sizeof(addrNode) )) == NULL ) {
-      return -1;
-    }
-    (*head)->addr = addr;
-    (*head)->next = NULL;
-  }
-
-  return 1;
+  return (int) (24.0*runif( 0.0, RAND_MAX )/(RAND_MAX+1.0));
 }
 
 
 /**********************************************************
-** Function:   addColCharNode
+** Function:   addrDigits
 **
-** Purpose:    Allocates and adds a new node to the front of
-**             colCharList that is pointed to by head.  This node's
-**             addr pointer will then point to the sent addr and it's
-**             colCh will be set to the sent ch.  
-**             This linked list is equivalent to the 'a' variable in the
-**             ranho R version.  It stores all the column values, as a char,
-**             at the specified column value (level).
-** Algorithm:  The order in which the column values are added is important
-**             so each new node needs to be added at the end of the list.
-**             This is the reason for the sent last pointer which will
-**             always point to the last node in the list.  This allows
-**             the function to quickly add at the end.
-** Arguments:  head, pointer to pointer to beginning of the linked list
-**             ch, character found in the column of the current level
-**             addr, pointer to array of chars that store address
-** Return:     1,  on success
-**             -1, on error
+** Purpose:    To construct the digits of the hierarchical address of a
+**             cell.
+** Arguments:  xc,   x coordinate for the cell
+**             yc,   y coordinate for the cell
+**             dx,   x offset
+**             dy,   y offset
+**             nlev, number of levels
+**             addr, array of size nlev in which the digits, each from 1
+**                   to 4, are stored with the first level first
+** Return:     void
 ***********************************************************/
-int addColCharNode( colCharNode ** head, char ch, char * addr,
-                                                  colCharNode ** last ) {
-  colCharNode * temp;
-
-  /* check to see if there is already a node in the list */
-  if ( *head ) {
-
-    if ( (temp = (colCharNode *) malloc( sizeof(colCharNode) )) == NULL ) {
-      return -1;
+void addrDigits( double xc, double yc, double dx, double dy, int nlev,
+                 int * addr ) {
+  int j;                             /* loop counter */
+  int x = (int) ceil( xc / dx );     /* temp x addr */
+  int y = (int) ceil( yc / dy );     /* temp y addr */
+
+  for ( j = nlev-1; j >= 0; --j ) {
+    addr[j] = 2 * abs( x % 2 ) + abs( y % 2 ) + 1;
+
+    if ( (x % 2) == -1 ) {
+      x = (x / 2) - 1;
+    } else {
+      x = x / 2;
     }
-    temp->colChar = ch;
-    temp->addr = addr;
-    temp->next = NULL;
-
-    (*last)->next = temp;
-    *last = temp;
-
-  /* else list is empty so create the first node */
-  } else {
-    if ( (*head = (colCharNode *) malloc( sizeof(colCharNode) )) == NULL ) {
-      return -1;
+    if ( (y % 2) == -1 ) {
+      y = (y / 2) - 1;
+    } else {
+      y = y / 2;
     }
-    (*head)->colChar = ch;
-    (*head)->addr = addr;
-    (*head)->next = NULL;
-    *last = *head;
-  }
-
-  return 1;
-}
-
-
-/**********************************************************
-** Function:   deallocateAddrList
-**
-** Purpose:    Deallocates all memory used by the nodes for 
-**             the addrList pointed to by head.
-** Arguments:  head, pointer to beginning of the linked list
-** Return:     void
-***********************************************************/
-void deallocateAddrList( addrNode * head ) {
-  addrNode * temp;
-
-  while( head ) {
-    temp = head->next;
-    free( head ); 
-    head = temp;
   }
 
   return;
@@ -194,23 +90,32 @@ void deallocateAddrList( addrNode * head ) {
 
 
 /**********************************************************
-** Function:   deallocateColCharList
+** Function:   addrKey
 **
-** Purpose:    Deallocates all memory used by the nodes for 
-**             the colCharList pointed to by head.
-** Arguments:  head, pointer to beginning of the linked list
-** Return:     void
+** Purpose:    To construct the hierarchical address of a cell as a
+**             numeric key, in which the digits of the address, less one,
+**             are the base 4 digits of the key, with the first digit of
+**             the address the most significant.
+** Arguments:  xc,   x coordinate for the cell
+**             yc,   y coordinate for the cell
+**             dx,   x offset
+**             dy,   y offset
+**             nlev, number of levels, which must not be greater than
+**                   MAX_KEY_LEVELS
+**             addr, work array of size nlev for the digits
+** Return:     the numeric key
 ***********************************************************/
-void deallocateColCharList( colCharNode * head ) {
-  colCharNode * temp;
-
-  while( head ) {
-    temp = head->next;
-    free( head ); 
-    head = temp;
+unsigned long long addrKey( double xc, double yc, double dx, double dy,
+                            int nlev, int * addr ) {
+  int j;                             /* loop counter */
+  unsigned long long key = 0;        /* numeric key for the address */
+
+  addrDigits( xc, yc, dx, dy, nlev, addr );
+  for ( j = 0; j < nlev; ++j ) {
+    key = ( key << 2 ) | (unsigned long long) ( addr[j] - 1 );
   }
 
-  return;
+  return key;
 }
 
 
@@ -218,24 +123,41 @@ void deallocateColCharList( colCharNode * head ) {
 ** Function:   constructAddr
 **
 ** Purpose:    To construct the hierarchical addresses.
+** Notes:      When keyVec is TRUE each address is returned as a numeric
+**             key in which the digits of the address, less one, are the
+**             base 4 digits of the key, with the first digit of the
+**             address the most significant.  Keys are in the same order as
+**             the strings, so they can be ordered as numbers.
 ** Arguments:  xcVec,   vector of x coordinates for the cells
 **             ycVec,   vector of y coordinates for the cells
 **             dxVec,   x offset 
 **             dyVec,   y offset
 **             nlevVec, number of levels
-** Return:     results, vector of strings representing the hierarchical address 
+**             keyVec,  flag signalling whether to return numeric keys,
+**                      TRUE keys, FALSE or NULL strings
+** Return:     results, vector of strings representing the hierarchical
+**                      address or vector of numeric keys
 ***********************************************************/
 SEXP constructAddr( SEXP xcVec, SEXP ycVec, SEXP dxVec, SEXP dyVec, 
-                                                              SEXP nlevVec ) {
+                    SEXP nlevVec, SEXP keyVec ) {
   int i, j;                          /* loop counters */
   int vecSize = length( xcVec );     /* size of incoming xc and yc vcectors */
-  int x;                             /* temp x addr */
-  int y;                             /* temp y addr */
   unsigned int nlev = INTEGER( nlevVec )[0];  /* number of levels */
   int * addr;                        /* temp array of addresses as integers */
   char * addrStr;                    /* char string representation of the addr*/
+  int useKey = FALSE;                /* TRUE if numeric keys are returned */
   SEXP results = NULL;               /* returing R object */
  
+  if ( keyVec != R_NilValue && LOGICAL( keyVec )[0] == TRUE ) {
+    useKey = TRUE;
+    if ( nlev > MAX_KEY_LEVELS ) {
+      Rprintf( "Error: The number of levels is too large for numeric keys in C function constructAddr.\n" );
+      PROTECT( results = allocVector(VECSXP, 1 ) );
+      UNPROTECT( 1 );
+      return results;
+    }
+  }
+
 
   /* allocate the necessary memory */
   if ( (addr = (int *) malloc( sizeof(int) * nlev )) == NULL ) {
@@ -252,27 +174,24 @@ SEXP constructAddr( SEXP xcVec, SEXP ycVec, SEXP dxVec, SEXP dyVec,
   }
 
   /* create the R object for results */
-  PROTECT( results = allocVector( STRSXP, vecSize ) );
+  if ( useKey ) {
+    PROTECT( results = allocVector( REALSXP, vecSize ) );
+  } else {
+    PROTECT( results = allocVector( STRSXP, vecSize ) );
+  }
 
   /* go through each cell */
   for ( i = 0; i < vecSize; ++i ) {
-    x = (int) ceil( REAL( xcVec )[i] / REAL( dxVec )[0] );
-    y = (int) ceil( REAL( ycVec )[i] / REAL( dyVec )[0] );
 
-    /* build the address */
-    for ( j = nlev-1; j >= 0; --j ) {
-      addr[j] = 2 * abs( x % 2 ) + abs( y % 2 ) + 1;
-
-      if ( (x % 2) == -1 ) {
-        x = (x / 2) - 1;
-      } else {
-        x = x / 2;
-      }
-      if ( (y % 2) == -1 ) {
-        y = (y / 2) - 1;
-      } else {
-        y = y / 2;
-      }
+    /* build the address as a key or as a string */
+    if ( useKey ) {
+      REAL( results )[i] = (double) addrKey( REAL( xcVec )[i],
+        REAL( ycVec )[i], REAL( dxVec )[0], REAL( dyVec )[0], nlev, addr );
+      continue;
+    }
+    addrDigits( REAL( xcVec )[i], REAL( ycVec )[i], REAL( dxVec )[0],
+                REAL( dyVec )[0], nlev, addr );
+    for ( j = 0; j < nlev; ++j ) {
 
       /* convert the address to a char */ 
       switch( addr[j] ) {
@@ -304,201 +223,264 @@ SEXP constructAddr( SEXP xcVec, SEXP ycVec, SEXP dxVec, SEXP dyVec,
 
 
 /**********************************************************
-** Function:   permFcn 
+** Function:   compareAddr
 **
-** Purpose:    To generate random hierarchical addresses.
-** Algorithm:  This recursive function uses the same algorithm that 
-**             the R version uses.
-** Arguments:  level, current columns position in the address
-**             fin,   max number of columns in the address
-**             prevAddrList, pointer to linked list of addresses generated
-**                           from the previous function call
+** Purpose:    qsort comparison function that orders pointers to address
+**             strings by address.
+***********************************************************/
+int compareAddr( const void * a, const void * b ) {
+
+  return strcmp( *(char * const *) a, *(char * const *) b );
+}
+
+
+/**********************************************************
+** Function:   ranho
+**
+** Purpose:    This is the entry point from R.  This function is sent
+**             the array of addresses and the number of addresses in
+**             the set.  The addresses in adr are modified in place and
+**             R will retrieve the new addresses from the same sent adr
+**             structure.
+** Algorithm:  The R version visits the tree of address prefixes depth
+**             first, taking the children of a prefix in digit order, and
+**             generates one perm for each prefix whose length is less than
+**             the length of the addresses.  The perm for a prefix replaces
+**             the next digit of every address that begins with the prefix.
+**             Here the addresses are sorted, so that the prefixes are
+**             visited in the same order by taking the addresses in turn.
+**             For each address, a perm is generated for each of its
+**             prefixes that is not a prefix of the previous address, and
+**             the perms for the other prefixes are the ones that were
+**             generated for the previous address.  The random numbers are
+**             therefore used in the same order as by the R version.
+** Arguments:  adr,  array of strings representing all the addresses
+**             size, pointer to integer representing the number of 
+**                   addresses that are in adr
 ** Return:     void
 ***********************************************************/
-void permFcn( int level, int fin, addrNode * prevAddrList ) {
-  char perm[5];                      /* perm for this level */
-  addrNode * tempAddrNode;           /* temp node pointer */
-  addrNode * currAddrList = NULL;    /* linked list of addresses */
-  colCharNode * tempColCharNode;     /* temp node pointer */
-  colCharNode * colCharList = NULL;  /* linked list of column values */
-  colCharNode * lastPtr = NULL;      /* used for adding nodes to the */
-                                     /* colChar list */
-
-  /* check level */
-  if( level >= fin )  return;
-
-  /* generate new perm for this level */
-  genPerm( perm );
-
-  /* create the list of the characters for this column level from the */
-  /* sent addr list */
-  tempAddrNode = prevAddrList;
-  while( tempAddrNode ) {
-    if ( addColCharNode( &colCharList, tempAddrNode->addr[level]
-                                   , tempAddrNode->addr, &lastPtr ) == -1 ) {
-      Rprintf( "Error: Allocating memory in ranho.c\n" );
-      return;
-    }
-    tempAddrNode = tempAddrNode->next;
+void ranho( char ** adr, int * size ) {
+  int i, l;                     /* loop counters */
+  int n = *size;                /* number of addresses */
+  int nlev;                     /* number of levels */
+  int first;                    /* first level with a new prefix */
+  int * levPerm;                /* index of the perm for each level */
+  char * prev;                  /* previous address before randomization */
+  char ** sorted;               /* pointers to the sorted addresses */
+
+  if ( n < 1 ) {
+    return;
   }
+  nlev = strlen( adr[0] );
 
+  /* allocate the necessary memory */
+  if ( (sorted = (char **) malloc( sizeof(char *) * n )) == NULL ) {
+    Rprintf( "Error: Allocating memory in ranho.c\n" );
+    return;
+  }
+  if ( (levPerm = (int *) malloc( sizeof(int) * (nlev + 1) )) == NULL ) {
+    Rprintf( "Error: Allocating memory in ranho.c\n" );
+    free( sorted );
+    return;
+  }
+  if ( (prev = (char *) malloc( sizeof(char) * (nlev + 1) )) == NULL ) {
+    Rprintf( "Error: Allocating memory in ranho.c\n" );
+    free( sorted );
+    free( levPerm );
+    return;
+  }
+
+  /* sort the addresses */
+  for ( i = 0; i < n; ++i ) {
+    sorted[i] = adr[i];
+  }
+  qsort( sorted, n, sizeof(char *), compareAddr );
+
+  /* obtain the R random number generator type and seed */
+  GetRNGstate();
 
-  /* create list of all the addresses that have a '1' at the current */
-  /* column level */
-  tempColCharNode = colCharList;
-  while( tempColCharNode ) {
-    if ( tempColCharNode->colChar == '1' ) {
-      if ( addAddrNode( &currAddrList, tempColCharNode->addr ) == -1 ) {
-        Rprintf( "Error: Allocating memory in ranho.c\n" );
-        return;
+  for ( i = 0; i < n; ++i ) {
+
+    /* find the first level whose prefix was not shared with the previous */
+    /* address, where the prefix for a level is the digits that precede it */
+    first = 0;
+    if ( i > 0 ) {
+      first = nlev;
+      for ( l = 0; l < nlev; ++l ) {
+        if ( sorted[i][l] != prev[l] ) {
+          first = l + 1;
+          break;
+        }
       }
     }
-    tempColCharNode = tempColCharNode->next;
-  } 
-
-  /* if list is not empty call permFcn again and then modify the addresses */
-  /* based on the current perm */
-  if( currAddrList != NULL ) {
-    permFcn( level+1, fin, currAddrList );
-    tempAddrNode = currAddrList;
-    while( tempAddrNode ) {
-      tempAddrNode->addr[level] = perm[0];
-      tempAddrNode = tempAddrNode->next;
+
+    /* generate the perms for the prefixes that have not been visited */
+    for ( l = first; l < nlev; ++l ) {
+      levPerm[l] = genPermIdx();
+    }
+
+    /* keep the address and then replace each digit using the perm for */
+    /* the prefix that precedes it */
+    memcpy( prev, sorted[i], nlev );
+    for ( l = 0; l < nlev; ++l ) {
+      sorted[i][l] = perms[levPerm[l]][sorted[i][l] - '1'];
     }
   }
  
-  /* clear the addr list */
-  deallocateAddrList( currAddrList ); 
-  currAddrList = NULL;
-
-
-  /* create list of all the addresses that have a '2' at the current */
-  /* column level */
-  tempColCharNode = colCharList;
-  while( tempColCharNode ) {
-    if ( tempColCharNode->colChar == '2' ) {
-      if ( addAddrNode( &currAddrList, tempColCharNode->addr ) == -1 ) {
-        Rprintf( "Error: Allocating memory in ranho.c\n" );
-        return;
-      }
-    }
-    tempColCharNode = tempColCharNode->next;
-  } 
-
-  /* if list is not empty call permFcn again and then modify the addresses */
-  /* based on the current perm */
-  if( currAddrList != NULL ) {
-    permFcn( level+1, fin, currAddrList );
-    tempAddrNode = currAddrList;
-    while( tempAddrNode ) {
-      tempAddrNode->addr[level] = perm[1];
-      tempAddrNode = tempAddrNode->next;
-    }
-  }  
+  /* write out the R random number generator type and seed */
+  PutRNGstate();
+
+  /* free up memory used */ 
+  free( sorted );
+  free( levPerm );
+  free( prev );
 
-  /* clear the addr list */
-  deallocateAddrList( currAddrList ); 
-  currAddrList = NULL;
+  return;
+}
 
 
-  /* create list of all the addresses that have a '3' at the current */
-  /* column level */
-  tempColCharNode = colCharList;
-  while( tempColCharNode ) {
-    if ( tempColCharNode->colChar == '3' ) {
-      if ( addAddrNode( &currAddrList, tempColCharNode->addr ) == -1 ) {
-        Rprintf( "Error: Allocating memory in ranho.c\n" );
-        return;
-      }
-    }
-    tempColCharNode = tempColCharNode->next;
-  } 
-
-  /* if list is not empty call permFcn again and then modify the addresses */
-  /* based on the current perm */
-  if( currAddrList != NULL ) {
-    permFcn( level+1, fin, currAddrList );
-    tempAddrNode = currAddrList;
-    while( tempAddrNode ) {
-      tempAddrNode->addr[level] = perm[2];
-      tempAddrNode = tempAddrNode->next;
-    }
-  }  
+/**********************************************************
+** Function:   compareKeyPos
+**
+** Purpose:    qsort comparison function that orders KeyPos structs by
+**             key and then by position.
+***********************************************************/
+int compareKeyPos( const void * a, const void * b ) {
+
+  const KeyPos * pa = (const KeyPos *) a;
+  const KeyPos * pb = (const KeyPos *) b;
 
-  /* clear the addr list */
-  deallocateAddrList( currAddrList );
-  currAddrList = NULL;
+  if ( pa->key != pb->key ) {
+    return pa->key < pb->key ? -1 : 1;
+  }
+  if ( pa->pos != pb->pos ) {
+    return pa->pos < pb->pos ? -1 : 1;
+  }
+  return 0;
+}
 
 
-  /* create list of all the addresses that have a '4' at the current */
-  /* column level */
-  tempColCharNode = colCharList;
-  while( tempColCharNode ) {
-    if ( tempColCharNode->colChar == '4' ) {
-      if ( addAddrNode( &currAddrList, tempColCharNode->addr ) == -1 ) {
-        Rprintf( "Error: Allocating memory in ranho.c\n" );
-        return;
+/**********************************************************
+** Function:   randomizeKeys
+**
+** Purpose:    To replace hierarchical addresses stored as numeric keys
+**             with randomized addresses.
+** Algorithm:  Uses the same algorithm as ranho, with the keys sorted in
+**             place of the strings, so the random numbers are used in the
+**             same order and the keys that result equal the randomized
+**             string addresses.  The caller must bracket the call with
+**             GetRNGstate and PutRNGstate.
+** Arguments:  keys, array of keys and their positions.  On return the
+**                   array is sorted by the original keys and each key
+**                   has been replaced by its randomized key
+**             n,    number of keys
+**             nlev, number of levels, which must be from 1 to
+**                   MAX_KEY_LEVELS
+** Return:     void
+***********************************************************/
+void randomizeKeys( KeyPos * keys, int n, int nlev ) {
+
+  int i, l;                     /* loop counters */
+  int first;                    /* first level with a new prefix */
+  int shift;                    /* bit position of the digit at a level */
+  int levPerm[MAX_KEY_LEVELS];  /* index of the perm for each level */
+  unsigned long long key;       /* original key */
+  unsigned long long prevKey = 0;  /* original key of the previous address */
+  unsigned long long diff;      /* bits that differ between two keys */
+  unsigned long long newKey;    /* randomized key */
+
+  qsort( keys, n, sizeof(KeyPos), compareKeyPos );
+
+  for ( i = 0; i < n; ++i ) {
+    key = keys[i].key;
+
+    /* find the first level whose prefix was not shared with the previous */
+    /* address, where the prefix for a level is the digits that precede it */
+    first = 0;
+    if ( i > 0 ) {
+      diff = key ^ prevKey;
+      first = nlev;
+      for ( l = 0; l < nlev; ++l ) {
+        if ( (diff >> (2 * (nlev - 1 - l))) & 3 ) {
+          first = l + 1;
+          break;
+        }
       }
     }
-    tempColCharNode = tempColCharNode->next;
-  } 
-
-  /* if list is not empty call permFcn again and then modify the addresses */
-  /* based on the current perm */
-  if( currAddrList != NULL ) {
-    permFcn( level+1, fin, currAddrList );
-    tempAddrNode = currAddrList;
-    while( tempAddrNode ) {
-      tempAddrNode->addr[level] = perm[3];
-      tempAddrNode = tempAddrNode->next;
-    }
-  }  
 
+    /* generate the perms for the prefixes that have not been visited */
+    for ( l = first; l < nlev; ++l ) {
+      levPerm[l] = genPermIdx();
+    }
 
-  /* free up memory */
-  deallocateAddrList( currAddrList );
-  deallocateColCharList( colCharList );
+    /* replace each digit using the perm for the prefix that precedes it */
+    newKey = 0;
+    for ( l = 0; l < nlev; ++l ) {
+      shift = 2 * (nlev - 1 - l);
+      newKey = ( newKey << 2 ) | (unsigned long long)
+               ( perms[levPerm[l]][(key >> shift) & 3] - '1' );
+    }
+    keys[i].key = newKey;
+    prevKey = key;
+  }
 
   return;
 }
 
 
 /**********************************************************
-** Function:   ranho
+** Function:   ranhoKey
 **
-** Purpose:    This is the entry point from R.  This function is sent
-**             the array of addresses and the number of addresses in
-**             the set.  It starts off the algorithm by calling the 
-**             recursive function permFcn and the addresses in adr are
-**             modified as the alogirithm works.  R will retrieve the
-**             new addresses from the same sent adr structure.
-** Arguments:  adr,  array of strings representing all the addresses
-**             size, pointer to integer representing the number of 
-**                   addresses that are in adr
-** Return:     void
+** Purpose:    This is the entry point from R for generating randomized
+**             hierarchical addresses from addresses that are stored as
+**             numeric keys by constructAddr.
+** Arguments:  keyVec,  vector of numeric keys
+**             nlevVec, number of levels
+** Return:     results, vector of randomized numeric keys in the same order
+**                      as the sent keys.  If an error occurs results will
+**                      return set to NULL
 ***********************************************************/
-void ranho( char ** adr, int * size ) {
-  int i;
-  addrNode * head = NULL;  /* pointer to linked list of addresses */
+SEXP ranhoKey( SEXP keyVec, SEXP nlevVec ) {
+
+  int i;                        /* loop counter */
+  int n = length( keyVec );     /* number of keys */
+  int nlev = INTEGER( nlevVec )[0];  /* number of levels */
+  KeyPos * keys;                /* sorted keys */
+  SEXP results = NULL;          /* returning R object */
+
+  if ( nlev < 1 || nlev > MAX_KEY_LEVELS ) {
+    Rprintf( "Error: Invalid number of levels in C function ranhoKey.\n" );
+    PROTECT( results = allocVector( VECSXP, 1 ) );
+    UNPROTECT( 1 );
+    return results;
+  }
+  if ( (keys = (KeyPos *) malloc( sizeof(KeyPos) * (n > 0 ? n : 1) ))
+       == NULL ) {
+    Rprintf( "Error: Allocating memory in C function ranhoKey.\n" );
+    PROTECT( results = allocVector( VECSXP, 1 ) );
+    UNPROTECT( 1 );
+    return results;
+  }
+  for ( i = 0; i < n; ++i ) {
+    keys[i].key = (unsigned long long) REAL( keyVec )[i];
+    keys[i].pos = i;
+  }
+
+  PROTECT( results = allocVector( REALSXP, n ) );
 
   /* obtain the R random number generator type and seed */
   GetRNGstate();
 
-  /* create the initial linked list of all the original addresses */
-  for ( i=0; i < *size; ++i ) {
-    if ( addAddrNode( &head, adr[i] ) == -1 ) {
-      Rprintf( "Error: Allocating memory in ranho.c\n" );
-    }
+  randomizeKeys( keys, n, nlev );
+  for ( i = 0; i < n; ++i ) {
+    REAL( results )[keys[i].pos] = (double) keys[i].key;
   }
 
-  /* start the algorithm */
-  permFcn( 0, strlen(adr[0]), head );
- 
   /* write out the R random number generator type and seed */
   PutRNGstate();
 
-  /* free up memory used */ 
-  deallocateAddrList(head);
+  free( keys );
+  UNPROTECT( 1 );
 
-  return;
+  return results;
 }
@@ -0,0 +1,38 @@
+/****************************************************************************** 
+**  File:        ranho.h  
+**
+**  Purpose:     This file contains the struct and the functions from ranho.c
+**               that are used to construct and randomize hierarchical
+**               addresses stored as numeric keys.
+**  Programmers: Tom Kincaid
+**  Created:     October 19, 2026
+******************************************************************************/
+
+#ifndef RANHO_H
+#define RANHO_H
+
+/* maximum number of levels for addresses stored as numeric keys, so that */
+/* every key is exactly representable as a double */
+#define MAX_KEY_LEVELS  26
+
+/* struct used to sort the numeric keys while keeping their positions */
+typedef struct keyPosStruct KeyPos;
+struct keyPosStruct {
+  unsigned long long key;       /* numeric key of the address */
+  int pos;                      /* position of the key in the sent vector */
+};
+
+
+/* function prototypes */
+
+void addrDigits( double xc, double yc, double dx, double dy, int nlev,
+                 int * addr );
+
+unsigned long long addrKey( double xc, double yc, double dx, double dy,
+                            int nlev, int * addr );
+
+int compareKeyPos( const void * a, const void * b );
+
+void randomizeKeys( KeyPos * keys, int n, int nlev );
+
+#endif
@@ -0,0 +1,180 @@
+/****************************************************************************** 
+**  File:        rngStream.c
+**  
+**  Purpose:     This file contains the functions that generate random
+**               numbers from independent streams, so that sampling
+**               functions can select the sample points for different grid
+**               cells in any order, or in parallel, and obtain the same
+**               sample.  A stream is identified by a seed, which is drawn
+**               from R's random number generator, and a stream number,
+**               which is normally the position of the grid cell in the
+**               sample.
+**  Programmer:  Tom Kincaid
+**  Algorithm:   The streams use the Philox4x32-10 generator of Salmon,
+**               Moraes, Dror and Shaw (2011), "Parallel random numbers: as
+**               easy as 1, 2, 3".  Each value of the counter is encrypted
+**               by ten rounds of multiplication and key addition to give
+**               four 32 bit random values.
+**  Created:     October 19, 2026
+******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <R.h>
+#include <Rmath.h>
+#include "rngStream.h"
+
+/* multipliers and key increments of the Philox4x32 generator */
+#define PHILOX_M0  0xD2511F53U
+#define PHILOX_M1  0xCD9E8D57U
+#define PHILOX_W0  0x9E3779B9U
+#define PHILOX_W1  0xBB67AE85U
+
+/* number of rounds */
+#define PHILOX_ROUNDS  10
+
+
+/**********************************************************
+** Function:   philox4x32
+**
+** Purpose:    Encrypt a counter value using the Philox4x32-10 generator.
+** Arguments:  ctr, counter value
+**             key, key
+**             out, array in which the four random values are stored
+** Return:     none
+***********************************************************/
+void philox4x32( const unsigned int * ctr, const unsigned int * key,
+                 unsigned int * out ) {
+
+  int r;                        /* loop counter */
+  unsigned int c0 = ctr[0], c1 = ctr[1], c2 = ctr[2], c3 = ctr[3];
+  unsigned int k0 = key[0], k1 = key[1];
+  unsigned long long p0, p1;    /* products of the multiplications */
+
+  for ( r = 0; r < PHILOX_ROUNDS; ++r ) {
+    if ( r > 0 ) {
+      k0 += PHILOX_W0;
+      k1 += PHILOX_W1;
+    }
+    p0 = (unsigned long long) PHILOX_M0 * c0;
+    p1 = (unsigned long long) PHILOX_M1 * c2;
+    c0 = (unsigned int) (p1 >> 32) ^ c1 ^ k0;
+    c2 = (unsigned int) (p0 >> 32) ^ c3 ^ k1;
+    c1 = (unsigned int) p1;
+    c3 = (unsigned int) p0;
+  }
+  out[0] = c0;
+  out[1] = c1;
+  out[2] = c2;
+  out[3] = c3;
+
+  return;
+}
+
+
+/**********************************************************
+** Function:   rngStreamSeed
+**
+** Purpose:    Draw a seed for a set of streams from R's random number
+**             generator.
+** Notes:      Two values are drawn from R's generator, so the calling
+**             function must bracket the call with GetRNGstate and
+**             PutRNGstate.
+** Arguments:  none
+** Return:     the seed
+***********************************************************/
+unsigned long long rngStreamSeed( void ) {
+
+  unsigned long long hi;        /* upper 32 bits of the seed */
+  unsigned long long lo;        /* lower 32 bits of the seed */
+
+  hi = (unsigned long long) ( unif_rand() * 4294967296.0 );
+  lo = (unsigned long long) ( unif_rand() * 4294967296.0 );
+
+  return ( (hi & 0xFFFFFFFFULL) << 32 ) | ( lo & 0xFFFFFFFFULL );
+}
+
+
+/**********************************************************
+** Function:   initRngStream
+**
+** Purpose:    Initialize a stream so that it starts at its first value.
+** Arguments:  rng,    stream to initialize
+**             seed,   seed drawn by rngStreamSeed
+**             stream, stream number
+** Return:     none
+***********************************************************/
+void initRngStream( RngStream * rng, unsigned long long seed,
+                    unsigned long long stream ) {
+
+  rng->key[0] = (unsigned int) seed;
+  rng->key[1] = (unsigned int) (seed >> 32);
+  rng->ctr[0] = 0;
+  rng->ctr[1] = 0;
+  rng->ctr[2] = (unsigned int) stream;
+  rng->ctr[3] = (unsigned int) (stream >> 32);
+  rng->pos = 4;
+
+  return;
+}
+
+
+/**********************************************************
+** Function:   rngStreamNext
+**
+** Purpose:    Obtain the next 32 bit random value from a stream.
+** Arguments:  rng, stream
+** Return:     the random value
+***********************************************************/
+unsigned int rngStreamNext( RngStream * rng ) {
+
+  if ( rng->pos == 4 ) {
+    philox4x32( rng->ctr, rng->key, rng->out );
+    if ( ++rng->ctr[0] == 0 ) {
+      ++rng->ctr[1];
+    }
+    rng->pos = 0;
+  }
+
+  return rng->out[rng->pos++];
+}
+
+
+/**********************************************************
+** Function:   rngStreamUnif
+**
+** Purpose:    Obtain a uniform random value between zero and one from a
+**             stream.
+** Notes:      The value has 53 random bits and is never equal to zero or
+**             one.
+** Arguments:  rng, stream
+** Return:     the random value
+***********************************************************/
+double rngStreamUnif( RngStream * rng ) {
+
+  unsigned int a = rngStreamNext( rng ) >> 5;   /* upper 27 bits */
+  unsigned int b = rngStreamNext( rng ) >> 6;   /* lower 26 bits */
+
+  return ( (double) a * 67108864.0 + (double) b + 0.5 ) /
+         9007199254740992.0;
+}
+
+
+/**********************************************************
+** Function:   rngStreamRunif
+**
+** Purpose:    Obtain a uniform random value between a and b from a
+**             stream, in the same way as the runif function.
+** Arguments:  rng, stream
+**             a,   minimum value
+**             b,   maximum value
+** Return:     the random value
+***********************************************************/
+double rngStreamRunif( RngStream * rng, double a, double b ) {
+
+  if ( a == b ) {
+    return a;
+  }
+
+  return a + ( b - a ) * rngStreamUnif( rng );
+}
@@ -0,0 +1,30 @@
+/****************************************************************************** 
+**  File:        rngStream.h  
+**
+**  Purpose:     This file contains the struct used for the counter-based
+**               random number streams that are used by the sampling
+**               functions when the sample points for different cells are
+**               selected in parallel.
+**  Programmers: Tom Kincaid
+**  Created:     October 19, 2026
+******************************************************************************/
+
+#ifndef RNG_STREAM_H
+#define RNG_STREAM_H
+
+/* struct for one random number stream.  The numbers are generated by the */
+/* Philox4x32-10 counter-based generator, which encrypts a counter using a */
+/* key.  The key is derived from R's random number generator and the stream */
+/* number is stored in the upper half of the counter, so every stream is */
+/* independent and can be generated without any shared state. */
+typedef struct rngStreamStruct RngStream;
+struct rngStreamStruct {
+  unsigned int key[2];     /* key for the generator */
+  unsigned int ctr[4];     /* counter, where ctr[2] and ctr[3] hold the */
+                           /* stream number */
+  unsigned int out[4];     /* output for the current counter value */
+  int pos;                 /* position of the next unused output, 4 if */
+                           /* the output has been used */
+};
+
+#endif
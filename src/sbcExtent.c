@@ -0,0 +1,555 @@
+/******************************************************************************
+**  File:        sbcExtent.c
+**
+**  Purpose:     This file contains the sbcExtent function, which determines
+**               the extent of a survey design frame or sample within each
+**               cell of one or more rectangular spatial balance grids for
+**               the sbcframe and sbcsamp functions.  The extent is the
+**               number of points, the clipped length of the lines, or the
+**               clipped area of the polygons that are located in the cell.
+**  Programmer:  Tom Kincaid
+**  Algorithm:   The coordinates are taken from memory rather than from a
+**               shapefile, and every grid is computed during a single pass
+**               through the features.  A point is assigned to its cell from
+**               its coordinates, using the same test as the cell.wt
+**               function, so that n points are binned in time proportional
+**               to n.  Each line segment or polygon feature is clipped only
+**               to the cells that overlap its bounding box, using the same
+**               functions as insideLinearGridCell and insideAreaGridCell.
+**               As in those functions, the clipped area of a polygon
+**               feature within a cell is added only when it is positive.
+**  Created:     October 19, 2026
+******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <R.h>
+#include <Rdefines.h>
+#include "shapeParser.h"
+#include "grts.h"
+
+#define MIN(x,y) (x < y ? x : y)
+#define MAX(x,y) (x > y ? x : y)
+
+/* these functions are found in grts.c */
+extern void initCellWts( CellWts * celWts );
+extern void freeCellWts( CellWts * celWts );
+extern void clearCellWts( CellWts * celWts );
+extern void compactCellWts( CellWts * celWts );
+extern int addCellWt( CellWts * celWts, int idx, double wt );
+extern void cellRange( double * edges, int numCols, double width, double min,
+                       double max, int * first, int * last );
+
+/* these functions are found in grtsarea.c */
+extern double clipPolygonArea( Cell * cell, Point * points, int start,
+                               int end, ClipBuffer * buf );
+extern void initClipBuffer( ClipBuffer * buf );
+extern void freeClipBuffer( ClipBuffer * buf );
+
+/* this function is found in grtslin.c */
+extern double lineLength( double x1, double y1, double x2, double y2,
+                          Cell * cell, Segment ** newSeg );
+
+/* struct for a spatial balance grid.  The columns and rows are the sorted */
+/* unique values of the cell x and y coordinates, which are the right and */
+/* top edges of the cells, and cell[j*numCols + i] is the position of the */
+/* cell in column i and row j in the vectors of cell coordinates, or -1 */
+/* when there is no such cell. */
+typedef struct sbcGridStruct SbcGrid;
+struct sbcGridStruct {
+  int numCols;       /* number of columns */
+  int numRows;       /* number of rows */
+  double dx;         /* width of a cell */
+  double dy;         /* height of a cell */
+  double * colX;     /* right edge of each column */
+  double * rowY;     /* top edge of each row */
+  int * cell;        /* position of the cell in each column and row */
+};
+
+
+/**********************************************************
+** Function:   compareSbcDouble
+**
+** Purpose:    qsort comparison function for doubles.
+***********************************************************/
+int compareSbcDouble( const void * a, const void * b ) {
+
+  double da = *(const double *) a;
+  double db = *(const double *) b;
+
+  return da < db ? -1 : ( da > db ? 1 : 0 );
+}
+
+
+/**********************************************************
+** Function:   uniqueEdges
+**
+** Purpose:    Sort a vector of cell coordinates and remove duplicates.
+** Arguments:  values, coordinates, which are replaced by the sorted unique
+**                     values
+**             n,      number of coordinates
+** Return:     number of unique values
+***********************************************************/
+int uniqueEdges( double * values, int n ) {
+
+  int i;              /* loop counter */
+  int m = 0;          /* number of unique values */
+
+  qsort( values, n, sizeof(double), compareSbcDouble );
+  for ( i = 0; i < n; ++i ) {
+    if ( m == 0 || values[i] != values[m-1] ) {
+      values[m++] = values[i];
+    }
+  }
+
+  return m;
+}
+
+
+/**********************************************************
+** Function:   findEdge
+**
+** Purpose:    Find the position of a value in a sorted vector of unique
+**             values.
+** Arguments:  values, sorted unique values
+**             n,      number of values
+**             v,      value to find, which must be in the vector
+** Return:     position of the value
+***********************************************************/
+int findEdge( double * values, int n, double v ) {
+
+  int lo = 0;         /* lower end of the search */
+  int hi = n - 1;     /* upper end of the search */
+  int mid;            /* middle of the search */
+
+  while ( lo < hi ) {
+    mid = (lo + hi) / 2;
+    if ( values[mid] < v ) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+
+  return lo;
+}
+
+
+/**********************************************************
+** Function:   freeSbcGrid
+**
+** Purpose:    Free the memory used by a spatial balance grid.
+** Arguments:  grid, grid to free
+** Return:     none
+***********************************************************/
+void freeSbcGrid( SbcGrid * grid ) {
+
+  free( grid->colX );
+  free( grid->rowY );
+  free( grid->cell );
+  grid->colX = NULL;
+  grid->rowY = NULL;
+  grid->cell = NULL;
+
+  return;
+}
+
+
+/**********************************************************
+** Function:   buildSbcGrid
+**
+** Purpose:    Build a spatial balance grid from the vectors of cell
+**             coordinates.
+** Arguments:  grid,     grid to build
+**             xc,       x coordinates of the cells
+**             yc,       y coordinates of the cells
+**             numCells, number of cells
+**             dx,       width of a cell
+**             dy,       height of a cell
+** Return:     1,  on success
+**             -1, on error
+***********************************************************/
+int buildSbcGrid( SbcGrid * grid, double * xc, double * yc, int numCells,
+                  double dx, double dy ) {
+
+  int i;              /* loop counter */
+  int ix, iy;         /* column and row of a cell */
+
+  grid->dx = dx;
+  grid->dy = dy;
+  grid->colX = (double *) malloc( sizeof(double) * (numCells + 1) );
+  grid->rowY = (double *) malloc( sizeof(double) * (numCells + 1) );
+  grid->cell = NULL;
+  if ( grid->colX == NULL || grid->rowY == NULL ) {
+    freeSbcGrid( grid );
+    return -1;
+  }
+  memcpy( grid->colX, xc, sizeof(double) * numCells );
+  memcpy( grid->rowY, yc, sizeof(double) * numCells );
+  grid->numCols = uniqueEdges( grid->colX, numCells );
+  grid->numRows = uniqueEdges( grid->rowY, numCells );
+  if ( (grid->cell = (int *) malloc( sizeof(int) *
+                     ((double) grid->numCols * grid->numRows + 1) )) == NULL ) {
+    freeSbcGrid( grid );
+    return -1;
+  }
+  for ( i = 0; i < grid->numCols * grid->numRows; ++i ) {
+    grid->cell[i] = -1;
+  }
+  for ( i = 0; i < numCells; ++i ) {
+    ix = findEdge( grid->colX, grid->numCols, xc[i] );
+    iy = findEdge( grid->rowY, grid->numRows, yc[i] );
+    if ( grid->cell[iy * grid->numCols + ix] == -1 ) {
+      grid->cell[iy * grid->numCols + ix] = i;
+    }
+  }
+
+  return 1;
+}
+
+
+/**********************************************************
+** Function:   pointColumns
+**
+** Purpose:    Find the columns or rows of a grid whose cells contain a
+**             coordinate, where a cell contains the values greater than
+**             its edge minus its width and less than or equal to its edge,
+**             as in the cell.wt function.
+** Notes:      The position is computed from the coordinate and then
+**             corrected by comparison with the edges, so that the result
+**             is the same as testing every cell.  Because of rounding,
+**             a coordinate on the boundary between two cells can belong
+**             to both or to neither of them.
+** Arguments:  edges, right edges of the columns or top edges of the rows
+**             n,     number of columns or rows
+**             width, width or height of a cell
+**             v,     coordinate
+**             first, receives the first column or row
+**             last,  receives the last column or row, which is less than
+**                    first when no cell contains the coordinate
+** Return:     none
+***********************************************************/
+void pointColumns( double * edges, int n, double width, double v,
+                   int * first, int * last ) {
+
+  double pos = ceil( (v - edges[0]) / width );   /* computed position */
+  int i;                                          /* column or row */
+
+  *first = 0;
+  *last = -1;
+  if ( n < 1 || !(pos > -2.0) || !(pos < n + 1.0) ) {
+    return;
+  }
+  i = (int) pos;
+  if ( i < 0 ) {
+    i = 0;
+  } else if ( i > n - 1 ) {
+    i = n - 1;
+  }
+
+  /* move to the first column whose edge is at least the coordinate */
+  while ( i > 0 && edges[i-1] >= v ) {
+    --i;
+  }
+  while ( i < n && edges[i] < v ) {
+    ++i;
+  }
+
+  /* find the columns whose cells contain the coordinate */
+  *first = i;
+  while ( *first > 0 && edges[*first - 1] - width < v &&
+          edges[*first - 1] >= v ) {
+    --(*first);
+  }
+  *last = *first - 1;
+  while ( *last + 1 < n && edges[*last + 1] - width < v &&
+          v <= edges[*last + 1] ) {
+    ++(*last);
+  }
+
+  return;
+}
+
+
+/**********************************************************
+** Function:   sbcExtent
+**
+** Purpose:    Determine the extent of a set of features within each cell
+**             of one or more spatial balance grids.
+** Arguments:  xcList,     list containing the vector of cell x coordinates
+**                         for each grid
+**             ycList,     list containing the vector of cell y coordinates
+**                         for each grid
+**             dxVec,      cell width for each grid
+**             dyVec,      cell height for each grid
+**             ftypeVal,   type of feature, which is "Points", "Lines" or
+**                         "Polygons"
+**             xVec,       x coordinates of the features
+**             yVec,       y coordinates of the features
+**             partLenVec, number of coordinates of each line or polygon
+**                         ring, which is NULL for points
+**             featLenVec, number of lines or rings of each feature.  When
+**                         it is NULL for lines or polygons each line or ring
+**                         is a feature.  For points it is either NULL, in
+**                         which case every point is counted in every grid,
+**                         or the number of points for each grid, in which
+**                         case consecutive sets of points are counted in
+**                         the grids in turn, so that the samples of several
+**                         replicates can be counted in copies of one grid.
+** Return:     results, an R list that contains the vector of extents for
+**             the cells of each grid.  If an error occurs, a list whose
+**             single element is NULL is returned.
+***********************************************************/
+SEXP sbcExtent( SEXP xcList, SEXP ycList, SEXP dxVec, SEXP dyVec,
+                SEXP ftypeVal, SEXP xVec, SEXP yVec, SEXP partLenVec,
+                SEXP featLenVec ) {
+
+  int g, i, j, k, f;            /* loop counters */
+  int ix, iy;                   /* column and row of a cell */
+  int numGrids = length( xcList );  /* number of grids */
+  int numPts = length( xVec );  /* number of coordinates */
+  int numParts;                 /* number of lines or rings */
+  int numFeats;                 /* number of features */
+  int part;                     /* first line or ring of a feature */
+  int numFeatParts;             /* number of lines or rings of a feature */
+  int first, last;              /* range of the points counted in a grid */
+  int * partStart = NULL;       /* first coordinate of each line or ring */
+  int ixLo, ixHi, iyLo, iyHi;   /* range of columns and rows */
+  int ftype;                    /* 1 points, 2 lines, 3 polygons */
+  int error = 0;                /* error indicator */
+  double * x = REAL( xVec );    /* x coordinates */
+  double * y = REAL( yVec );    /* y coordinates */
+  double bxMin, bxMax, byMin, byMax;  /* bounding box */
+  double extent;                /* clipped length or area */
+  double ** ext = NULL;         /* extents for the cells of each grid */
+  const char * type;            /* type of feature */
+  Point * points = NULL;        /* coordinates as Point structs */
+  Cell cell;                    /* temp storage for a cell */
+  SbcGrid * grids = NULL;       /* spatial balance grids */
+  CellWts partWts;              /* areas of a polygon feature */
+  ClipBuffer buf;               /* clipping buffer */
+
+  /* R objects for returning results to R */
+  SEXP results = NULL;
+  SEXP extentVec;
+
+  /* determine the type of feature */
+  type = CHAR( STRING_ELT( ftypeVal, 0 ) );
+  if ( strcmp( type, "Points" ) == 0 ) {
+    ftype = 1;
+  } else if ( strcmp( type, "Lines" ) == 0 ) {
+    ftype = 2;
+  } else if ( strcmp( type, "Polygons" ) == 0 ) {
+    ftype = 3;
+  } else {
+    Rprintf( "Error: Invalid feature type in C function sbcExtent.\n" );
+    PROTECT( results = allocVector( VECSXP, 1 ) );
+    UNPROTECT(1);
+    return results;
+  }
+
+  /* when each grid counts its own points, they must account for every point */
+  if ( ftype == 1 && featLenVec != R_NilValue ) {
+    last = 0;
+    for ( g = 0; g < length( featLenVec ) && error == 0; ++g ) {
+      if ( INTEGER( featLenVec )[g] < 0 ) {
+        error = 1;
+      }
+      last += INTEGER( featLenVec )[g];
+    }
+    if ( error || length( featLenVec ) != numGrids || last != numPts ) {
+      Rprintf( "Error: Invalid number of points in C function sbcExtent.\n" );
+      PROTECT( results = allocVector( VECSXP, 1 ) );
+      UNPROTECT(1);
+      return results;
+    }
+  }
+  numParts = ftype == 1 ? 0 : length( partLenVec );
+  numFeats = ftype == 1 || featLenVec == R_NilValue ? numParts :
+             length( featLenVec );
+
+  /* build the grids and allocate the result vectors */
+  PROTECT( results = allocVector( VECSXP, numGrids ) );
+  grids = (SbcGrid *) calloc( numGrids + 1, sizeof(SbcGrid) );
+  ext = (double **) malloc( sizeof(double *) * (numGrids + 1) );
+  if ( grids == NULL || ext == NULL ) {
+    error = 1;
+  }
+  for ( g = 0; g < numGrids && error == 0; ++g ) {
+    PROTECT( extentVec = allocVector( REALSXP,
+                                      length( VECTOR_ELT( xcList, g ) ) ) );
+    SET_VECTOR_ELT( results, g, extentVec );
+    UNPROTECT(1);
+    ext[g] = REAL( extentVec );
+    for ( i = 0; i < length( extentVec ); ++i ) {
+      ext[g][i] = 0.0;
+    }
+    if ( buildSbcGrid( &grids[g], REAL( VECTOR_ELT( xcList, g ) ),
+           REAL( VECTOR_ELT( ycList, g ) ), length( extentVec ),
+           REAL( dxVec )[g], REAL( dyVec )[g] ) == -1 ) {
+      error = 1;
+    }
+  }
+  if ( error == 0 && ftype != 1 ) {
+    partStart = (int *) malloc( sizeof(int) * (numParts + 1) );
+    points = (Point *) malloc( sizeof(Point) * (numPts + 1) );
+    if ( partStart == NULL || points == NULL ) {
+      error = 1;
+    } else {
+      partStart[0] = 0;
+      for ( k = 0; k < numParts; ++k ) {
+        partStart[k+1] = partStart[k] + INTEGER( partLenVec )[k];
+      }
+      for ( i = 0; i < numPts; ++i ) {
+        points[i].X = x[i];
+        points[i].Y = y[i];
+      }
+    }
+  }
+  initCellWts( &partWts );
+  initClipBuffer( &buf );
+
+  /* count the points within each cell, where a grid either counts every */
+  /* point or the next featLenVec[g] points */
+  if ( ftype == 1 ) {
+    first = 0;
+    for ( g = 0; g < numGrids && error == 0; ++g ) {
+      last = featLenVec == R_NilValue ? numPts :
+             first + INTEGER( featLenVec )[g];
+      for ( i = first; i < last; ++i ) {
+        pointColumns( grids[g].colX, grids[g].numCols, grids[g].dx, x[i],
+                      &ixLo, &ixHi );
+        pointColumns( grids[g].rowY, grids[g].numRows, grids[g].dy, y[i],
+                      &iyLo, &iyHi );
+        for ( iy = iyLo; iy <= iyHi; ++iy ) {
+          for ( ix = ixLo; ix <= ixHi; ++ix ) {
+            k = grids[g].cell[iy * grids[g].numCols + ix];
+            if ( k >= 0 ) {
+              ext[g][k] += 1.0;
+            }
+          }
+        }
+      }
+      if ( featLenVec != R_NilValue ) {
+        first = last;
+      }
+    }
+
+  /* sum the length of the line segments within each cell */
+  } else if ( ftype == 2 ) {
+    for ( k = 0; k < numParts && error == 0; ++k ) {
+      for ( i = partStart[k]; i < partStart[k+1] - 1; ++i ) {
+        for ( g = 0; g < numGrids; ++g ) {
+          cellRange( grids[g].colX, grids[g].numCols, grids[g].dx,
+                     MIN( x[i], x[i+1] ), MAX( x[i], x[i+1] ), &ixLo, &ixHi );
+          cellRange( grids[g].rowY, grids[g].numRows, grids[g].dy,
+                     MIN( y[i], y[i+1] ), MAX( y[i], y[i+1] ), &iyLo, &iyHi );
+          for ( iy = iyLo; iy <= iyHi; ++iy ) {
+            for ( ix = ixLo; ix <= ixHi; ++ix ) {
+              j = grids[g].cell[iy * grids[g].numCols + ix];
+              if ( j < 0 ) {
+                continue;
+              }
+              cell.xMin = grids[g].colX[ix] - grids[g].dx;
+              cell.yMin = grids[g].rowY[iy] - grids[g].dy;
+              cell.xMax = grids[g].colX[ix];
+              cell.yMax = grids[g].rowY[iy];
+              ext[g][j] += lineLength( x[i], y[i], x[i+1], y[i+1], &cell,
+                                       NULL );
+            }
+          }
+        }
+      }
+    }
+
+  /* sum the positive area of each polygon feature within each cell */
+  } else {
+    part = 0;
+    for ( f = 0; f < numFeats && error == 0; ++f ) {
+      numFeatParts = featLenVec == R_NilValue ? 1 :
+                     INTEGER( featLenVec )[f];
+      if ( part + numFeatParts > numParts ) {
+        numFeatParts = numParts - part;
+      }
+      if ( numFeatParts < 1 || partStart[part + numFeatParts] ==
+           partStart[part] ) {
+        part += MAX( numFeatParts, 0 );
+        continue;
+      }
+
+      /* find the bounding box of the feature */
+      bxMin = bxMax = x[partStart[part]];
+      byMin = byMax = y[partStart[part]];
+      for ( i = partStart[part]; i < partStart[part + numFeatParts]; ++i ) {
+        bxMin = MIN( bxMin, x[i] );
+        bxMax = MAX( bxMax, x[i] );
+        byMin = MIN( byMin, y[i] );
+        byMax = MAX( byMax, y[i] );
+      }
+
+      for ( g = 0; g < numGrids && error == 0; ++g ) {
+        cellRange( grids[g].colX, grids[g].numCols, grids[g].dx, bxMin,
+                   bxMax, &ixLo, &ixHi );
+        cellRange( grids[g].rowY, grids[g].numRows, grids[g].dy, byMin,
+                   byMax, &iyLo, &iyHi );
+        clearCellWts( &partWts );
+        for ( k = part; k < part + numFeatParts && error == 0; ++k ) {
+          if ( partStart[k+1] - partStart[k] < 2 ) {
+            continue;
+          }
+          for ( iy = iyLo; iy <= iyHi && error == 0; ++iy ) {
+            for ( ix = ixLo; ix <= ixHi; ++ix ) {
+              j = grids[g].cell[iy * grids[g].numCols + ix];
+              if ( j < 0 ) {
+                continue;
+              }
+              cell.xMin = grids[g].colX[ix] - grids[g].dx;
+              cell.yMin = grids[g].rowY[iy] - grids[g].dy;
+              cell.xMax = grids[g].colX[ix];
+              cell.yMax = grids[g].rowY[iy];
+              extent = clipPolygonArea( &cell, points, partStart[k],
+                                        partStart[k+1] - 1, &buf );
+              if ( buf.numPts < 0 ||
+                   (extent != 0.0 && addCellWt( &partWts, j, extent ) == -1) ) {
+                error = 1;
+                break;
+              }
+            }
+          }
+        }
+
+        /* if the total area of the feature is not positive, don't add it */
+        compactCellWts( &partWts );
+        for ( i = 0; i < partWts.numCells; ++i ) {
+          if ( partWts.cells[i].wt > 0.0 ) {
+            ext[g][partWts.cells[i].idx] += partWts.cells[i].wt;
+          }
+        }
+      }
+      part += numFeatParts;
+    }
+  }
+
+  /* clean up */
+  freeCellWts( &partWts );
+  freeClipBuffer( &buf );
+  for ( g = 0; grids != NULL && g < numGrids; ++g ) {
+    freeSbcGrid( &grids[g] );
+  }
+  free( grids );
+  free( ext );
+  free( partStart );
+  free( points );
+
+  if ( error ) {
+    Rprintf( "Error: Allocating memory in C function sbcExtent.\n" );
+    PROTECT( results = allocVector( VECSXP, 1 ) );
+    UNPROTECT(2);
+    return results;
+  }
+  UNPROTECT(1);
+
+  return results;
+}
@@ -0,0 +1,171 @@
+/******************************************************************************
+**  Function:    selectGridCells
+**  Programmer:  Tom Kincaid
+**  Date:        October 19, 2026
+**  Description:
+**    This function constructs the randomized hierarchical addresses for the
+**    grid cells, determines the order of the randomized addresses, and
+**    determines the grid cells from which sample points will be selected.
+**    It combines the steps that used the constructAddr, ranhoKey, and
+**    pickGridCells C functions and the R functions order, runif, and cumsum,
+**    and it uses the random numbers in the same order, so that the same seed
+**    selects the same cells.  The cumulative sum of the cell weights is
+**    accumulated in long double precision as R's cumsum does.
+**  Arguments:
+**    xcVec = the vector of x coordinates for the grid cells
+**    ycVec = the vector of y coordinates for the grid cells
+**    celWtVec = the vector of weights for the grid cells
+**    dxVec = the grid cell width
+**    dyVec = the grid cell height
+**    nlevVec = the number of hierarchical levels
+**    samplesize = the sample size
+**    sintVec = the sampling interval
+**    doSampleVec = the option to select grid cells, where TRUE means select
+**      grid cells and FALSE means only determine the order of the randomized
+**      addresses
+**  Results
+**    An R object that contains rord, the order of the randomized
+**    hierarchical addresses, and rdx, the index values for cells from which
+**    sample points will be selected, which is NULL when doSampleVec is
+**    FALSE.  If an error occurs, a list whose single element is NULL is
+**    returned.
+******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <R.h>
+#include <Rdefines.h>
+#include <Rmath.h>
+#include "ranho.h"
+
+SEXP selectGridCells( SEXP xcVec, SEXP ycVec, SEXP celWtVec, SEXP dxVec,
+                      SEXP dyVec, SEXP nlevVec, SEXP samplesize,
+                      SEXP sintVec, SEXP doSampleVec ) {
+
+  int i, j;                                 /* loop counters */
+  int n = length( xcVec );                  /* number of grid cells */
+  int nlev = INTEGER( nlevVec )[0];         /* number of levels */
+  int smpSize;                              /* sample size */
+  int doSample;                             /* TRUE if cells are selected */
+  int addr[MAX_KEY_LEVELS];                 /* digits of an address */
+  double dx = REAL( dxVec )[0];             /* grid cell width */
+  double dy = REAL( dyVec )[0];             /* grid cell height */
+  double sint = REAL( sintVec )[0];         /* sampling interval */
+  double rstrt;                             /* random start */
+  double * ttlWt = NULL;                    /* cumulative cell weights */
+  long double sum;                          /* running sum of cell weights */
+  KeyPos * keys = NULL;                     /* randomized keys */
+  int * rord;                               /* order of the addresses */
+  int * rdx;                                /* selected cells */
+
+  /* R objects for returning results to R */
+  SEXP rordVec, rdxVec;
+  SEXP results = NULL;
+  SEXP names;
+
+  /* copy the sample size into a C variable */
+
+  PROTECT( samplesize = AS_INTEGER( samplesize ) );
+  smpSize = INTEGER( samplesize )[0];
+  UNPROTECT(1);
+  doSample = doSampleVec != R_NilValue && LOGICAL( doSampleVec )[0] == TRUE;
+
+  if ( nlev < 1 || nlev > MAX_KEY_LEVELS ) {
+    Rprintf( "Error: Invalid number of levels in C function selectGridCells.\n" );
+    PROTECT( results = allocVector( VECSXP, 1 ) );
+    UNPROTECT(1);
+    return results;
+  }
+
+  /* allocate the keys and the cumulative weights */
+
+  if ( (keys = (KeyPos *) malloc( sizeof(KeyPos) * (n > 0 ? n : 1) ))
+       == NULL ) {
+    Rprintf( "Error: Allocating memory in selectGridCells.c.\n" );
+    PROTECT( results = allocVector( VECSXP, 1 ) );
+    UNPROTECT(1);
+    return results;
+  }
+  if ( doSample ) {
+    if ( (ttlWt = (double *) malloc( sizeof(double) * (n + 1) )) == NULL ) {
+      Rprintf( "Error: Allocating memory in selectGridCells.c.\n" );
+      free( keys );
+      PROTECT( results = allocVector( VECSXP, 1 ) );
+      UNPROTECT(1);
+      return results;
+    }
+  }
+
+  /* construct the hierarchical addresses */
+
+  for ( i = 0; i < n; ++i ) {
+    keys[i].key = addrKey( REAL( xcVec )[i], REAL( ycVec )[i], dx, dy, nlev,
+                           addr );
+    keys[i].pos = i;
+  }
+
+  /* obtain the R random number generator type and seed */
+
+  GetRNGstate();
+
+  /* randomize the addresses and determine their order, where ties are */
+  /* broken by position as R's order function does */
+
+  randomizeKeys( keys, n, nlev );
+  qsort( keys, n, sizeof(KeyPos), compareKeyPos );
+
+  PROTECT( rordVec = allocVector( INTSXP, n ) );
+  rord = INTEGER( rordVec );
+  for ( i = 0; i < n; ++i ) {
+    rord[i] = keys[i].pos + 1;
+  }
+
+  /* select the grid cells that get a sample point */
+
+  if ( doSample ) {
+    rstrt = runif( 0.0, sint );
+    ttlWt[0] = 0.0;
+    sum = 0.0;
+    for ( i = 0; i < n; ++i ) {
+      sum += REAL( celWtVec )[rord[i] - 1];
+      ttlWt[i + 1] = (double) sum;
+    }
+
+    PROTECT( rdxVec = allocVector( INTSXP, smpSize ) );
+    rdx = INTEGER( rdxVec );
+    j = 0;
+    for ( i = 0; i < smpSize; ++i ) {
+      while ( j < n && (int) ceil( (ttlWt[j] - rstrt)/sint ) < (i + 1) ) {
+        ++j;
+      }
+      rdx[i] = j > 0 ? rord[j - 1] : rord[0];
+    }
+  } else {
+    PROTECT( rdxVec = R_NilValue );
+  }
+
+  /* write out the R random number generator type and seed */
+
+  PutRNGstate();
+
+  /* create the list for returning results to R */
+
+  PROTECT( results = allocVector( VECSXP, 2 ) );
+  PROTECT( names = allocVector( STRSXP, 2 ) );
+  SET_VECTOR_ELT( results, 0, rordVec );
+  SET_VECTOR_ELT( results, 1, rdxVec );
+  SET_STRING_ELT( names, 0, mkChar( "rord" ) );
+  SET_STRING_ELT( names, 1, mkChar( "rdx" ) );
+  setAttrib( results, R_NamesSymbol, names );
+  UNPROTECT(4);
+
+  /* clean up */
+
+  free( keys );
+  if ( ttlWt ) {
+    free( ttlWt );
+  }
+
+  return results;
+}
@@ -42,10 +42,16 @@ void writeShapeFilePolygon(SEXP shapeTypeVal, SEXP fileLengthVal,
   SEXP fileNamePrefix);
 SEXP pointInPolygonObj(SEXP ptXVec, SEXP ptYVec, SEXP polyXVec, SEXP polyYVec);
 SEXP numLevels(SEXP fileNamePrefix, SEXP nsmpVec, SEXP shiftGridVec,
-   SEXP startLevVec, SEXP maxLevVec, SEXP dsgnmdIDVec, SEXP dsgnmdVec);
+   SEXP startLevVec, SEXP maxLevVec, SEXP dsgnmdIDVec, SEXP dsgnmdVec,
+   SEXP refineGridVec, SEXP frameBudgetVec, SEXP threadsVec,
+   SEXP keepExtentsVec);
 SEXP constructAddr(SEXP xcVec, SEXP ycVec, SEXP dxVec, SEXP dyVec,
-   SEXP nlevVec);
+   SEXP nlevVec, SEXP keyVec);
+SEXP ranhoKey(SEXP keyVec, SEXP nlevVec);
 SEXP pickGridCells(SEXP samplesize, SEXP idxVec);
+SEXP selectGridCells(SEXP xcVec, SEXP ycVec, SEXP celWtVec, SEXP dxVec,
+   SEXP dyVec, SEXP nlevVec, SEXP samplesize, SEXP sintVec,
+   SEXP doSampleVec);
 SEXP insideAreaGridCell(SEXP fileNamePrefix, SEXP dsgnmdIDVec, SEXP cellIDsVec,
      SEXP xcsVec, SEXP ycsVec, SEXP dxVal, SEXP dyVal);
 SEXP insideLinearGridCell(SEXP fileNamePrefix, SEXP dsgnmdIDVec, SEXP cellIDsVec,
@@ -54,14 +60,37 @@ SEXP pointInPolygonFile(SEXP fileNamePrefix, SEXP xcsVec, SEXP ycsVec,
    SEXP dsgnmdIDVec, SEXP dsgnmdVec);
 SEXP pickAreaSamplePoints(SEXP fileNamePrefix, SEXP shpIDsVec, 
    SEXP recordIDsVec, SEXP xcVec, SEXP ycVec, SEXP dxVal, SEXP dyVal, 
-   SEXP maxTryVal);
+   SEXP maxTryVal, SEXP rngStreamsVal, SEXP frameBudgetVal, SEXP threadsVal,
+   SEXP exactVal);
 SEXP pickLinearSamplePoints(SEXP fileNamePrefix, SEXP shpIDsVec, 
    SEXP recordIDsVec, SEXP xcVec, SEXP ycVec, SEXP dxVal, SEXP dyVal);
 SEXP linSample(SEXP fileNamePrefix, SEXP xcVec, SEXP ycVec, SEXP dxVec, 
    SEXP dyVec, SEXP dsgnmdIDVec, SEXP dsgnmdVec);
 SEXP getRecordIDs(SEXP areaCumSumVec, SEXP sampPosVec, SEXP dsgnIDVec);
 SEXP getShapeBox(SEXP fileNamePrefix, SEXP dsgnIDVec);
+SEXP irsAreaPoints(SEXP fileNamePrefix, SEXP sampIDVec, SEXP dsgnIDVec,
+   SEXP dsgnMdmVec, SEXP maxTryVal, SEXP exactVal);
+SEXP aliasTable(SEXP wtVec);
+SEXP aliasSample(SEXP wtVec, SEXP sizeVal, SEXP replaceVal);
 SEXP linSampleIRS(SEXP fileNamePrefix, SEXP lenCumSumVec, SEXP sampPosVec,
    SEXP dsgnIDVec, SEXP dsgnLenVec, SEXP dsgnMdmVec);
+SEXP selectCellPoints(SEXP cellVec, SEXP xcVec, SEXP ycVec, SEXP dxVal,
+   SEXP dyVal, SEXP ptsXVec, SEXP ptsYVec, SEXP ptsMdmVec, SEXP allVal);
+SEXP numLevelsPoints(SEXP xVec, SEXP yVec, SEXP mdmVec, SEXP nsmpVec,
+   SEXP shiftGridVec, SEXP startLevVec, SEXP maxLevVec);
+SEXP tessExtent(SEXP tileXVec, SEXP tileYVec, SEXP tileLenVec,
+   SEXP ftypeVal, SEXP xVec, SEXP yVec, SEXP partLenVec, SEXP holeVec);
+SEXP sbcExtent(SEXP xcList, SEXP ycList, SEXP dxVec, SEXP dyVec,
+   SEXP ftypeVal, SEXP xVec, SEXP yVec, SEXP partLenVec, SEXP featLenVec);
+SEXP tessExtentBatch(SEXP tileXList, SEXP tileYList, SEXP tileLenList,
+   SEXP ftypeVal, SEXP xVec, SEXP yVec, SEXP partLenVec, SEXP holeVec,
+   SEXP threadsVec);
+SEXP grtsAreaSample(SEXP fileNamePrefix, SEXP dsgnmdIDVec, SEXP dsgnmdVec,
+   SEXP mdcatyVec, SEXP nsmpVec, SEXP siteBeginVec, SEXP shiftGridVec,
+   SEXP startLevVec, SEXP maxLevVec, SEXP maxTryVal, SEXP refineGridVec,
+   SEXP rngStreamsVal, SEXP frameBudgetVal, SEXP threadsVal, SEXP exactVal);
+SEXP grtsLinearSample(SEXP fileNamePrefix, SEXP dsgnmdIDVec, SEXP dsgnmdVec,
+   SEXP mdcatyVec, SEXP nsmpVec, SEXP siteBeginVec, SEXP shiftGridVec,
+   SEXP startLevVec, SEXP maxLevVec, SEXP frameBudgetVal, SEXP threadsVal);
  
 #endif
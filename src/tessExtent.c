@@ -0,0 +1,1045 @@
+/******************************************************************************
+**  File:        tessExtent.c
+**
+**  Purpose:     This file contains the tessExtent function, which determines
+**               the extent of a survey design frame within each Dirichlet
+**               tesselation polygon for the spbalance function, and the
+**               tessExtentBatch function, which does the same for the
+**               tesselations of several replicate samples for the
+**               spbalance.batch function.  The extent is the number of
+**               points, the clipped length of the lines, or the clipped
+**               area of the polygons of the frame that are located in the
+**               tesselation polygon.
+**  Programmer:  Tom Kincaid
+**  Algorithm:   The tesselation polygons, which are convex, are placed in
+**               a grid of buckets by their bounding boxes.  Each point,
+**               line segment or polygon ring of the frame is only compared
+**               with the tesselation polygons in the buckets that overlap
+**               its bounding box.  A point is counted when it is inside or
+**               on the boundary of a tesselation polygon, a line segment is
+**               clipped by the Cyrus-Beck algorithm, and a polygon ring is
+**               clipped by the Sutherland-Hodgman algorithm.  The area of a
+**               ring that is a hole is subtracted.  The extents are summed
+**               in the order of the frame elements, so the results do not
+**               depend on the bucket grid.  The coordinates of the frame
+**               are prepared once, so that replicate tesselations can share
+**               them and be processed in parallel.
+**  Created:     October 19, 2026
+******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <R.h>
+#include <Rdefines.h>
+#include "shapeParser.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#define MIN(x,y) (x < y ? x : y)
+#define MAX(x,y) (x > y ? x : y)
+
+/* struct for the tesselation polygons and the grid of buckets used to find */
+/* the polygons that overlap a box.  The polygons in each bucket are stored */
+/* consecutively, starting at position start[b] of the tiles array. */
+typedef struct tessIndexStruct TessIndex;
+struct tessIndexStruct {
+  int numTiles;      /* number of tesselation polygons */
+  int * first;       /* position of the first vertex of each polygon */
+  int * numPts;      /* number of vertices of each polygon */
+  double * orient;   /* 1 if the vertices are counterclockwise, else -1 */
+  double * xMin;     /* bounding box of each polygon */
+  double * xMax;
+  double * yMin;
+  double * yMax;
+  Point * points;    /* vertices of the polygons */
+  int numCols;       /* number of columns and rows of buckets */
+  double gxMin;      /* lower left corner of the grid of buckets */
+  double gyMin;
+  double bw;         /* width of a bucket */
+  double bh;         /* height of a bucket */
+  int * start;       /* start of each bucket in the tiles array */
+  int * tiles;       /* polygons in each bucket */
+  int * mark;        /* last query that found each polygon */
+  int query;         /* number of the current query */
+};
+
+/* struct for the vertices of a ring as it is clipped */
+typedef struct tessBufferStruct TessBuffer;
+struct tessBufferStruct {
+  int maxPts;        /* allocated number of vertices */
+  Point * in;        /* vertices before clipping to an edge */
+  Point * out;       /* vertices after clipping to an edge */
+};
+
+/* struct for the coordinates of a survey design frame, which are prepared */
+/* once so that they can be intersected with several sets of tesselation */
+/* polygons.  For polygons, each ring is stored without its closing vertex */
+/* starting at position start[k] of the rings array, and len[k] is 0 for */
+/* rings with fewer than three vertices. */
+typedef struct tessFrameStruct TessFrame;
+struct tessFrameStruct {
+  int ftype;         /* 1 points, 2 lines, 3 polygons */
+  int numPts;        /* number of coordinates */
+  double * x;        /* x coordinates */
+  double * y;        /* y coordinates */
+  int numParts;      /* number of lines or rings */
+  int * start;       /* first coordinate of each line or ring */
+  int * len;         /* number of coordinates of each line or ring */
+  double * sign;     /* -1 for rings that are holes and 1 otherwise */
+  double * xMin;     /* bounding box of each ring */
+  double * xMax;
+  double * yMin;
+  double * yMax;
+  Point * rings;     /* vertices of the rings */
+};
+
+
+/**********************************************************
+** Function:   freeTessIndex
+**
+** Purpose:    Free the memory used by a TessIndex struct.
+** Arguments:  index, index to free
+** Return:     none
+***********************************************************/
+void freeTessIndex( TessIndex * index ) {
+
+  free( index->first );
+  free( index->numPts );
+  free( index->orient );
+  free( index->xMin );
+  free( index->xMax );
+  free( index->yMin );
+  free( index->yMax );
+  free( index->points );
+  free( index->start );
+  free( index->tiles );
+  free( index->mark );
+  memset( index, 0, sizeof(TessIndex) );
+
+  return;
+}
+
+
+/**********************************************************
+** Function:   tessBucket
+**
+** Purpose:    Determine the range of bucket columns or rows that overlap
+**             an interval.
+** Arguments:  min,     lower end of the interval
+**             max,     upper end of the interval
+**             origin,  lower edge of the grid of buckets
+**             width,   width of a bucket
+**             numCols, number of columns of buckets
+**             lo,      receives the first column
+**             hi,      receives the last column
+** Return:     none
+***********************************************************/
+void tessBucket( double min, double max, double origin, double width,
+                 int numCols, int * lo, int * hi ) {
+
+  double a = floor( (min - origin) / width );
+  double b = floor( (max - origin) / width );
+
+  *lo = !(a > 0.0) ? 0 : ( a > numCols - 1 ? numCols - 1 : (int) a );
+  *hi = !(b > 0.0) ? 0 : ( b > numCols - 1 ? numCols - 1 : (int) b );
+
+  return;
+}
+
+
+/**********************************************************
+** Function:   buildTessIndex
+**
+** Purpose:    Copy the tesselation polygons and place them in a grid of
+**             buckets.
+** Notes:      The grid has about one bucket for each polygon.  A closing
+**             vertex that repeats the first vertex is dropped.
+** Arguments:  index,    index to build
+**             x,        x coordinates of the vertices of the polygons
+**             y,        y coordinates of the vertices of the polygons
+**             lens,     number of vertices of each polygon
+**             numTiles, number of polygons
+** Return:     1,  on success
+**             -1, on error
+***********************************************************/
+int buildTessIndex( TessIndex * index, double * x, double * y, int * lens,
+                    int numTiles ) {
+
+  int i, j, t;                  /* loop counters */
+  int pos = 0;                  /* position of a vertex in x and y */
+  int n;                        /* number of vertices of a polygon */
+  int cx0, cx1, cy0, cy1;       /* range of buckets of a polygon */
+  int numBuckets;               /* number of buckets */
+  int * fill = NULL;            /* next free position of each bucket */
+  double area;                  /* twice the signed area of a polygon */
+  double gxMax, gyMax;          /* upper right corner of the buckets */
+  Point * p;                    /* vertices of a polygon */
+
+  memset( index, 0, sizeof(TessIndex) );
+  index->numTiles = numTiles;
+  n = 0;
+  for ( t = 0; t < numTiles; ++t ) {
+    n += lens[t];
+  }
+  index->first = (int *) malloc( sizeof(int) * (numTiles + 1) );
+  index->numPts = (int *) malloc( sizeof(int) * (numTiles + 1) );
+  index->orient = (double *) malloc( sizeof(double) * (numTiles + 1) );
+  index->xMin = (double *) malloc( sizeof(double) * (numTiles + 1) );
+  index->xMax = (double *) malloc( sizeof(double) * (numTiles + 1) );
+  index->yMin = (double *) malloc( sizeof(double) * (numTiles + 1) );
+  index->yMax = (double *) malloc( sizeof(double) * (numTiles + 1) );
+  index->points = (Point *) malloc( sizeof(Point) * (n + 1) );
+  index->mark = (int *) calloc( numTiles + 1, sizeof(int) );
+  if ( index->first == NULL || index->numPts == NULL ||
+       index->orient == NULL || index->xMin == NULL || index->xMax == NULL ||
+       index->yMin == NULL || index->yMax == NULL || index->points == NULL ||
+       index->mark == NULL ) {
+    freeTessIndex( index );
+    return -1;
+  }
+
+  /* copy the vertices and find the bounding box and orientation of each */
+  /* polygon */
+  n = 0;
+  for ( t = 0; t < numTiles; ++t ) {
+    index->first[t] = n;
+    p = &(index->points[n]);
+    for ( i = 0; i < lens[t]; ++i ) {
+      p[i].X = x[pos + i];
+      p[i].Y = y[pos + i];
+    }
+    pos += lens[t];
+    j = lens[t];
+    if ( j > 1 && p[j-1].X == p[0].X && p[j-1].Y == p[0].Y ) {
+      --j;
+    }
+    index->numPts[t] = j;
+    n += j;
+    area = 0.0;
+    index->xMin[t] = index->xMax[t] = j > 0 ? p[0].X : 0.0;
+    index->yMin[t] = index->yMax[t] = j > 0 ? p[0].Y : 0.0;
+    for ( i = 0; i < j; ++i ) {
+      area += p[i].X * p[(i+1) % j].Y - p[(i+1) % j].X * p[i].Y;
+      index->xMin[t] = MIN( index->xMin[t], p[i].X );
+      index->xMax[t] = MAX( index->xMax[t], p[i].X );
+      index->yMin[t] = MIN( index->yMin[t], p[i].Y );
+      index->yMax[t] = MAX( index->yMax[t], p[i].Y );
+    }
+    index->orient[t] = area < 0.0 ? -1.0 : 1.0;
+    if ( j < 3 ) {
+      index->numPts[t] = 0;
+    }
+  }
+
+  /* determine the grid of buckets */
+  index->gxMin = index->gyMin = 0.0;
+  gxMax = gyMax = 1.0;
+  for ( t = 0; t < numTiles; ++t ) {
+    if ( t == 0 || index->xMin[t] < index->gxMin ) {
+      index->gxMin = index->xMin[t];
+    }
+    if ( t == 0 || index->yMin[t] < index->gyMin ) {
+      index->gyMin = index->yMin[t];
+    }
+    if ( t == 0 || index->xMax[t] > gxMax ) {
+      gxMax = index->xMax[t];
+    }
+    if ( t == 0 || index->yMax[t] > gyMax ) {
+      gyMax = index->yMax[t];
+    }
+  }
+  index->numCols = (int) ceil( sqrt( (double) numTiles ) );
+  if ( index->numCols < 1 ) {
+    index->numCols = 1;
+  }
+  index->bw = (gxMax - index->gxMin) / index->numCols;
+  index->bh = (gyMax - index->gyMin) / index->numCols;
+  if ( !(index->bw > 0.0) ) {
+    index->bw = 1.0;
+  }
+  if ( !(index->bh > 0.0) ) {
+    index->bh = 1.0;
+  }
+
+  /* count the polygons in each bucket and then store them */
+  numBuckets = index->numCols * index->numCols;
+  index->start = (int *) calloc( numBuckets + 1, sizeof(int) );
+  fill = (int *) malloc( sizeof(int) * (numBuckets + 1) );
+  if ( index->start == NULL || fill == NULL ) {
+    free( fill );
+    freeTessIndex( index );
+    return -1;
+  }
+  for ( t = 0; t < numTiles; ++t ) {
+    if ( index->numPts[t] == 0 ) {
+      continue;
+    }
+    tessBucket( index->xMin[t], index->xMax[t], index->gxMin, index->bw,
+                index->numCols, &cx0, &cx1 );
+    tessBucket( index->yMin[t], index->yMax[t], index->gyMin, index->bh,
+                index->numCols, &cy0, &cy1 );
+    for ( j = cy0; j <= cy1; ++j ) {
+      for ( i = cx0; i <= cx1; ++i ) {
+        ++index->start[j * index->numCols + i + 1];
+      }
+    }
+  }
+  for ( i = 0; i < numBuckets; ++i ) {
+    index->start[i + 1] += index->start[i];
+    fill[i] = index->start[i];
+  }
+  if ( (index->tiles = (int *) malloc( sizeof(int) *
+                       (index->start[numBuckets] + 1) )) == NULL ) {
+    free( fill );
+    freeTessIndex( index );
+    return -1;
+  }
+  for ( t = 0; t < numTiles; ++t ) {
+    if ( index->numPts[t] == 0 ) {
+      continue;
+    }
+    tessBucket( index->xMin[t], index->xMax[t], index->gxMin, index->bw,
+                index->numCols, &cx0, &cx1 );
+    tessBucket( index->yMin[t], index->yMax[t], index->gyMin, index->bh,
+                index->numCols, &cy0, &cy1 );
+    for ( j = cy0; j <= cy1; ++j ) {
+      for ( i = cx0; i <= cx1; ++i ) {
+        index->tiles[fill[j * index->numCols + i]++] = t;
+      }
+    }
+  }
+  free( fill );
+
+  return 1;
+}
+
+
+/**********************************************************
+** Function:   findTiles
+**
+** Purpose:    Find the tesselation polygons whose bounding boxes overlap
+**             a box.
+** Arguments:  index, index of the polygons
+**             xmin,  bounding box
+**             xmax,
+**             ymin,
+**             ymax,
+**             found, receives the polygons
+** Return:     number of polygons found
+***********************************************************/
+int findTiles( TessIndex * index, double xmin, double xmax, double ymin,
+               double ymax, int * found ) {
+
+  int i, j, k;                  /* loop counters */
+  int t;                        /* polygon */
+  int n = 0;                    /* number of polygons found */
+  int cx0, cx1, cy0, cy1;       /* range of buckets of the box */
+
+  ++index->query;
+  tessBucket( xmin, xmax, index->gxMin, index->bw, index->numCols,
+              &cx0, &cx1 );
+  tessBucket( ymin, ymax, index->gyMin, index->bh, index->numCols,
+              &cy0, &cy1 );
+  for ( j = cy0; j <= cy1; ++j ) {
+    for ( i = cx0; i <= cx1; ++i ) {
+      for ( k = index->start[j * index->numCols + i];
+            k < index->start[j * index->numCols + i + 1]; ++k ) {
+        t = index->tiles[k];
+        if ( index->mark[t] != index->query &&
+             index->xMin[t] <= xmax && index->xMax[t] >= xmin &&
+             index->yMin[t] <= ymax && index->yMax[t] >= ymin ) {
+          index->mark[t] = index->query;
+          found[n++] = t;
+        }
+      }
+    }
+  }
+
+  return n;
+}
+
+
+/**********************************************************
+** Function:   tessSide
+**
+** Purpose:    Determine the side of an edge of a tesselation polygon on
+**             which a point is located.
+** Arguments:  a,      first vertex of the edge
+**             b,      second vertex of the edge
+**             orient, orientation of the polygon
+**             x,      coordinates of the point
+**             y,
+** Return:     a value that is positive when the point is inside the edge,
+**             zero when it is on the edge, and negative otherwise
+***********************************************************/
+double tessSide( Point * a, Point * b, double orient, double x, double y ) {
+
+  return orient * ( (b->X - a->X) * (y - a->Y) - (b->Y - a->Y) * (x - a->X) );
+}
+
+
+/**********************************************************
+** Function:   insideTile
+**
+** Purpose:    Determine whether a point is inside or on the boundary of
+**             a tesselation polygon.
+** Arguments:  index, index of the polygons
+**             t,     polygon
+**             x,     coordinates of the point
+**             y,
+** Return:     1, if the point is inside or on the boundary
+**             0, otherwise
+***********************************************************/
+int insideTile( TessIndex * index, int t, double x, double y ) {
+
+  int i;                        /* loop counter */
+  int n = index->numPts[t];     /* number of vertices */
+  Point * p = &(index->points[index->first[t]]);
+
+  for ( i = 0; i < n; ++i ) {
+    if ( tessSide( &p[i], &p[(i+1) % n], index->orient[t], x, y ) < 0.0 ) {
+      return 0;
+    }
+  }
+
+  return 1;
+}
+
+
+/**********************************************************
+** Function:   clipSegmentTile
+**
+** Purpose:    Determine the length of a line segment within a tesselation
+**             polygon by the Cyrus-Beck algorithm.
+** Arguments:  index, index of the polygons
+**             t,     polygon
+**             x0,    coordinates of the first end of the segment
+**             y0,
+**             x1,    coordinates of the second end of the segment
+**             y1,
+** Return:     length of the segment within the polygon
+***********************************************************/
+double clipSegmentTile( TessIndex * index, int t, double x0, double y0,
+                        double x1, double y1 ) {
+
+  int i;                        /* loop counter */
+  int n = index->numPts[t];     /* number of vertices */
+  double d0, d1;                /* sides of the segment ends */
+  double tIn = 0.0;             /* segment parameter where it enters */
+  double tOut = 1.0;            /* segment parameter where it leaves */
+  double s;                     /* parameter where it crosses an edge */
+  Point * p = &(index->points[index->first[t]]);
+
+  for ( i = 0; i < n && tIn < tOut; ++i ) {
+    d0 = tessSide( &p[i], &p[(i+1) % n], index->orient[t], x0, y0 );
+    d1 = tessSide( &p[i], &p[(i+1) % n], index->orient[t], x1, y1 );
+    if ( d0 < 0.0 && d1 < 0.0 ) {
+      return 0.0;
+    }
+    if ( d0 < 0.0 || d1 < 0.0 ) {
+      s = d0 / (d0 - d1);
+      if ( d0 < 0.0 ) {
+        tIn = MAX( tIn, s );
+      } else {
+        tOut = MIN( tOut, s );
+      }
+    }
+  }
+  if ( tOut <= tIn ) {
+    return 0.0;
+  }
+
+  return (tOut - tIn) * sqrt( (x1 - x0)*(x1 - x0) + (y1 - y0)*(y1 - y0) );
+}
+
+
+/**********************************************************
+** Function:   clipRingTile
+**
+** Purpose:    Determine the area of a polygon ring within a tesselation
+**             polygon by the Sutherland-Hodgman algorithm.
+** Notes:      Since the tesselation polygon is convex, the signed area of
+**             the clipped ring is correct even when the clipped ring has
+**             edges that overlap.
+** Arguments:  index, index of the polygons
+**             t,     polygon
+**             ring,  vertices of the ring
+**             m,     number of vertices of the ring
+**             buf,   buffer for the clipped vertices
+** Return:     area of the ring within the polygon, or -1 if an error
+**             occurs
+***********************************************************/
+double clipRingTile( TessIndex * index, int t, Point * ring, int m,
+                     TessBuffer * buf ) {
+
+  int i, k;                     /* loop counters */
+  int n = index->numPts[t];     /* number of vertices of the polygon */
+  int numIn = m;                /* number of vertices before an edge */
+  int numOut;                   /* number of vertices after an edge */
+  int newMax;                   /* new allocated number of vertices */
+  double ds, de;                /* sides of the ends of a ring edge */
+  double s;                     /* parameter where it crosses the edge */
+  double area = 0.0;            /* twice the signed area */
+  Point * p = &(index->points[index->first[t]]);
+  Point * tmp;                  /* temp pointer */
+  Point * ps, * pe;             /* ends of a ring edge */
+
+  if ( buf->maxPts < 2 * m + 2 ) {
+    newMax = 2 * m + 2;
+    if ( (tmp = (Point *) realloc( buf->in, sizeof(Point) * newMax ))
+         == NULL ) {
+      return -1.0;
+    }
+    buf->in = tmp;
+    if ( (tmp = (Point *) realloc( buf->out, sizeof(Point) * newMax ))
+         == NULL ) {
+      return -1.0;
+    }
+    buf->out = tmp;
+    buf->maxPts = newMax;
+  }
+  memcpy( buf->in, ring, sizeof(Point) * m );
+
+  for ( k = 0; k < n && numIn > 0; ++k ) {
+
+    /* each edge of the ring gives at most two vertices */
+    if ( buf->maxPts < 2 * numIn ) {
+      newMax = 2 * numIn;
+      if ( (tmp = (Point *) realloc( buf->in, sizeof(Point) * newMax ))
+           == NULL ) {
+        return -1.0;
+      }
+      buf->in = tmp;
+      if ( (tmp = (Point *) realloc( buf->out, sizeof(Point) * newMax ))
+           == NULL ) {
+        return -1.0;
+      }
+      buf->out = tmp;
+      buf->maxPts = newMax;
+    }
+    numOut = 0;
+    for ( i = 0; i < numIn; ++i ) {
+      ps = &(buf->in[ i == 0 ? numIn - 1 : i - 1 ]);
+      pe = &(buf->in[i]);
+      ds = tessSide( &p[k], &p[(k+1) % n], index->orient[t], ps->X, ps->Y );
+      de = tessSide( &p[k], &p[(k+1) % n], index->orient[t], pe->X, pe->Y );
+      if ( (ds < 0.0 && de >= 0.0) || (ds >= 0.0 && de < 0.0) ) {
+        s = ds / (ds - de);
+        buf->out[numOut].X = ps->X + s * (pe->X - ps->X);
+        buf->out[numOut].Y = ps->Y + s * (pe->Y - ps->Y);
+        ++numOut;
+      }
+      if ( de >= 0.0 ) {
+        buf->out[numOut++] = *pe;
+      }
+    }
+    tmp = buf->in;
+    buf->in = buf->out;
+    buf->out = tmp;
+    numIn = numOut;
+  }
+
+  for ( i = 0; i < numIn; ++i ) {
+    k = (i + 1) % numIn;
+    area += buf->in[i].X * buf->in[k].Y - buf->in[k].X * buf->in[i].Y;
+  }
+
+  return fabs( area ) / 2.0;
+}
+
+
+/**********************************************************
+** Function:   freeTessFrame
+**
+** Purpose:    Free the memory used by a TessFrame struct.
+** Arguments:  frame, frame to free
+** Return:     none
+***********************************************************/
+void freeTessFrame( TessFrame * frame ) {
+
+  free( frame->start );
+  free( frame->len );
+  free( frame->sign );
+  free( frame->xMin );
+  free( frame->xMax );
+  free( frame->yMin );
+  free( frame->yMax );
+  free( frame->rings );
+  memset( frame, 0, sizeof(TessFrame) );
+
+  return;
+}
+
+
+/**********************************************************
+** Function:   buildTessFrame
+**
+** Purpose:    Prepare the coordinates of a survey design frame so that
+**             they can be intersected with one or more sets of
+**             tesselation polygons.
+** Notes:      For polygons, the rings are stored as Point structs without
+**             the closing vertex, and the bounding box and sign of each
+**             ring are computed.
+** Arguments:  frame,    frame to build
+**             ftype,    type of frame, which is 1 for points, 2 for lines
+**                       and 3 for polygons
+**             x,        x coordinates of the frame
+**             y,        y coordinates of the frame
+**             numPts,   number of coordinates
+**             partLens, number of coordinates of each line or ring
+**             numParts, number of lines or rings
+**             hole,     for polygons, TRUE for each ring that is a hole,
+**                       which can be NULL
+** Return:     1,  on success
+**             -1, on error
+***********************************************************/
+int buildTessFrame( TessFrame * frame, int ftype, double * x, double * y,
+                    int numPts, int * partLens, int numParts, int * hole ) {
+
+  int i, k;                     /* loop counters */
+  int pos = 0;                  /* first coordinate of a line or ring */
+  int m;                        /* number of coordinates of a ring */
+  Point * ring;                 /* vertices of a ring */
+
+  memset( frame, 0, sizeof(TessFrame) );
+  frame->ftype = ftype;
+  frame->x = x;
+  frame->y = y;
+  frame->numPts = numPts;
+  frame->numParts = ftype == 1 ? 0 : numParts;
+  if ( ftype == 1 ) {
+    return 1;
+  }
+  frame->start = (int *) malloc( sizeof(int) * (numParts + 1) );
+  frame->len = (int *) malloc( sizeof(int) * (numParts + 1) );
+  if ( frame->start == NULL || frame->len == NULL ) {
+    freeTessFrame( frame );
+    return -1;
+  }
+  for ( k = 0; k < numParts; ++k ) {
+    frame->start[k] = pos;
+    frame->len[k] = partLens[k];
+    pos += partLens[k];
+  }
+  if ( ftype == 2 ) {
+    return 1;
+  }
+
+  frame->sign = (double *) malloc( sizeof(double) * (numParts + 1) );
+  frame->xMin = (double *) malloc( sizeof(double) * (numParts + 1) );
+  frame->xMax = (double *) malloc( sizeof(double) * (numParts + 1) );
+  frame->yMin = (double *) malloc( sizeof(double) * (numParts + 1) );
+  frame->yMax = (double *) malloc( sizeof(double) * (numParts + 1) );
+  frame->rings = (Point *) malloc( sizeof(Point) * (numPts + 1) );
+  if ( frame->sign == NULL || frame->xMin == NULL || frame->xMax == NULL ||
+       frame->yMin == NULL || frame->yMax == NULL || frame->rings == NULL ) {
+    freeTessFrame( frame );
+    return -1;
+  }
+  for ( k = 0; k < numParts; ++k ) {
+    m = frame->len[k];
+    ring = &(frame->rings[frame->start[k]]);
+    frame->sign[k] = hole != NULL && hole[k] == TRUE ? -1.0 : 1.0;
+    for ( i = 0; i < m; ++i ) {
+      ring[i].X = x[frame->start[k] + i];
+      ring[i].Y = y[frame->start[k] + i];
+    }
+    if ( m > 1 && ring[m-1].X == ring[0].X && ring[m-1].Y == ring[0].Y ) {
+      --m;
+    }
+    if ( m < 3 ) {
+      m = 0;
+    }
+    frame->len[k] = m;
+    frame->xMin[k] = frame->xMax[k] = m > 0 ? ring[0].X : 0.0;
+    frame->yMin[k] = frame->yMax[k] = m > 0 ? ring[0].Y : 0.0;
+    for ( i = 1; i < m; ++i ) {
+      frame->xMin[k] = MIN( frame->xMin[k], ring[i].X );
+      frame->xMax[k] = MAX( frame->xMax[k], ring[i].X );
+      frame->yMin[k] = MIN( frame->yMin[k], ring[i].Y );
+      frame->yMax[k] = MAX( frame->yMax[k], ring[i].Y );
+    }
+  }
+
+  return 1;
+}
+
+
+/**********************************************************
+** Function:   frameTileExtent
+**
+** Purpose:    Determine the extent of a survey design frame within each
+**             tesselation polygon of an index.
+** Arguments:  frame,  coordinates of the frame
+**             index,  index of the tesselation polygons
+**             extent, receives the extent for each tesselation polygon
+**             found,  storage for the tesselation polygons found, which
+**                     must hold the number of polygons
+**             buf,    buffer for clipping rings
+** Return:     1,  on success
+**             -1, on error
+***********************************************************/
+int frameTileExtent( TessFrame * frame, TessIndex * index, double * extent,
+                     int * found, TessBuffer * buf ) {
+
+  int i, j, k;                  /* loop counters */
+  int pos;                      /* first coordinate of a line or ring */
+  int m;                        /* number of coordinates of a line or ring */
+  int n;                        /* number of tesselation polygons found */
+  double * x = frame->x;        /* x coordinates of the frame */
+  double * y = frame->y;        /* y coordinates of the frame */
+  double area;                  /* clipped area of a ring */
+
+  for ( i = 0; i < index->numTiles; ++i ) {
+    extent[i] = 0.0;
+  }
+
+  /* count the points within each tesselation polygon */
+  if ( frame->ftype == 1 ) {
+    for ( i = 0; i < frame->numPts; ++i ) {
+      n = findTiles( index, x[i], x[i], y[i], y[i], found );
+      for ( j = 0; j < n; ++j ) {
+        if ( insideTile( index, found[j], x[i], y[i] ) ) {
+          extent[found[j]] += 1.0;
+        }
+      }
+    }
+
+  /* sum the length of the line segments within each tesselation polygon */
+  } else if ( frame->ftype == 2 ) {
+    for ( k = 0; k < frame->numParts; ++k ) {
+      pos = frame->start[k];
+      m = frame->len[k];
+      for ( i = pos; i < pos + m - 1; ++i ) {
+        n = findTiles( index, MIN( x[i], x[i+1] ), MAX( x[i], x[i+1] ),
+                       MIN( y[i], y[i+1] ), MAX( y[i], y[i+1] ), found );
+        for ( j = 0; j < n; ++j ) {
+          extent[found[j]] += clipSegmentTile( index, found[j], x[i], y[i],
+                                               x[i+1], y[i+1] );
+        }
+      }
+    }
+
+  /* sum the area of the polygon rings within each tesselation polygon */
+  } else {
+    for ( k = 0; k < frame->numParts; ++k ) {
+      if ( frame->len[k] == 0 ) {
+        continue;
+      }
+      n = findTiles( index, frame->xMin[k], frame->xMax[k], frame->yMin[k],
+                     frame->yMax[k], found );
+      for ( j = 0; j < n; ++j ) {
+        if ( (area = clipRingTile( index, found[j],
+                                   &(frame->rings[frame->start[k]]),
+                                   frame->len[k], buf )) < 0.0 ) {
+          return -1;
+        }
+        extent[found[j]] += frame->sign[k] * area;
+      }
+    }
+  }
+
+  return 1;
+}
+
+
+/**********************************************************
+** Function:   tessFrameType
+**
+** Purpose:    Determine the type of a survey design frame.
+** Arguments:  ftypeVal, type of frame, which is "Points", "Lines" or
+**                       "Polygons"
+** Return:     1 for points, 2 for lines, 3 for polygons, or -1 if the type
+**             is not valid
+***********************************************************/
+int tessFrameType( SEXP ftypeVal ) {
+
+  const char * type = CHAR( STRING_ELT( ftypeVal, 0 ) );
+
+  if ( strcmp( type, "Points" ) == 0 ) {
+    return 1;
+  } else if ( strcmp( type, "Lines" ) == 0 ) {
+    return 2;
+  } else if ( strcmp( type, "Polygons" ) == 0 ) {
+    return 3;
+  }
+
+  return -1;
+}
+
+
+/**********************************************************
+** Function:   tessExtent
+**
+** Purpose:    Determine the extent of a survey design frame within each
+**             Dirichlet tesselation polygon.
+** Arguments:  tileXVec,   x coordinates of the vertices of the tesselation
+**                         polygons
+**             tileYVec,   y coordinates of the vertices of the tesselation
+**                         polygons
+**             tileLenVec, number of vertices of each tesselation polygon
+**             ftypeVal,   type of frame, which is "Points", "Lines" or
+**                         "Polygons"
+**             xVec,       x coordinates of the frame
+**             yVec,       y coordinates of the frame
+**             partLenVec, number of coordinates of each line or polygon
+**                         ring of the frame, which is NULL for points
+**             holeVec,    for polygons, TRUE for each ring that is a hole
+**                         and FALSE otherwise, which is NULL for points and
+**                         lines
+** Return:     results, an R object that contains extent, the number of
+**             points, the length of the lines, or the area of the polygons
+**             of the frame within each tesselation polygon.  If an error
+**             occurs, a list whose single element is NULL is returned.
+***********************************************************/
+SEXP tessExtent( SEXP tileXVec, SEXP tileYVec, SEXP tileLenVec,
+                 SEXP ftypeVal, SEXP xVec, SEXP yVec, SEXP partLenVec,
+                 SEXP holeVec ) {
+
+  int numTiles = length( tileLenVec );  /* number of tesselation polygons */
+  int ftype;                    /* 1 points, 2 lines, 3 polygons */
+  int error = 0;                /* error indicator */
+  int * found = NULL;           /* tesselation polygons found */
+  TessFrame frame;              /* coordinates of the frame */
+  TessIndex index;              /* index of the tesselation polygons */
+  TessBuffer buf;               /* buffer for clipping rings */
+
+  /* R objects for returning results to R */
+  SEXP extentVec;
+  SEXP results = NULL;
+  SEXP names;
+
+  /* determine the type of frame */
+  if ( (ftype = tessFrameType( ftypeVal )) == -1 ) {
+    Rprintf( "Error: Invalid frame type in C function tessExtent.\n" );
+    PROTECT( results = allocVector( VECSXP, 1 ) );
+    UNPROTECT(1);
+    return results;
+  }
+
+  /* prepare the frame and place the tesselation polygons in the grid of */
+  /* buckets */
+  if ( buildTessFrame( &frame, ftype, REAL( xVec ), REAL( yVec ),
+         length( xVec ), ftype == 1 ? NULL : INTEGER( partLenVec ),
+         ftype == 1 ? 0 : length( partLenVec ),
+         holeVec == R_NilValue ? NULL : LOGICAL( holeVec ) ) == -1 ) {
+    Rprintf( "Error: Allocating memory in C function tessExtent.\n" );
+    PROTECT( results = allocVector( VECSXP, 1 ) );
+    UNPROTECT(1);
+    return results;
+  }
+  if ( buildTessIndex( &index, REAL( tileXVec ), REAL( tileYVec ),
+                       INTEGER( tileLenVec ), numTiles ) == -1 ||
+       (found = (int *) malloc( sizeof(int) * (numTiles + 1) )) == NULL ) {
+    Rprintf( "Error: Allocating memory in C function tessExtent.\n" );
+    freeTessIndex( &index );
+    freeTessFrame( &frame );
+    PROTECT( results = allocVector( VECSXP, 1 ) );
+    UNPROTECT(1);
+    return results;
+  }
+  buf.maxPts = 0;
+  buf.in = NULL;
+  buf.out = NULL;
+
+  PROTECT( extentVec = allocVector( REALSXP, numTiles ) );
+  if ( frameTileExtent( &frame, &index, REAL( extentVec ), found,
+                        &buf ) == -1 ) {
+    error = 1;
+  }
+
+  /* clean up */
+  free( buf.in );
+  free( buf.out );
+  free( found );
+  freeTessIndex( &index );
+  freeTessFrame( &frame );
+
+  if ( error ) {
+    Rprintf( "Error: Allocating memory in C function tessExtent.\n" );
+    PROTECT( results = allocVector( VECSXP, 1 ) );
+    UNPROTECT(2);
+    return results;
+  }
+
+  /* create the list for returning results to R */
+  PROTECT( results = allocVector( VECSXP, 1 ) );
+  PROTECT( names = allocVector( STRSXP, 1 ) );
+  SET_VECTOR_ELT( results, 0, extentVec );
+  SET_STRING_ELT( names, 0, mkChar( "extent" ) );
+  setAttrib( results, R_NamesSymbol, names );
+  UNPROTECT(3);
+
+  return results;
+}
+
+
+/**********************************************************
+** Function:   tessExtentBatch
+**
+** Purpose:    Determine the extent of a survey design frame within each
+**             Dirichlet tesselation polygon for each of several sets of
+**             tesselation polygons, such as the tesselations for replicate
+**             samples.
+** Notes:      The frame is prepared once and shared by the sets, which
+**             are processed in parallel when spsurvey was built with
+**             OpenMP support.  Each set has its own index and buffers, so
+**             the extents are the same as those from tessExtent and do not
+**             depend on the number of threads.
+** Arguments:  tileXList,   list containing the x coordinates of the
+**                          vertices of the tesselation polygons for each
+**                          set
+**             tileYList,   list containing the y coordinates of the
+**                          vertices of the tesselation polygons for each
+**                          set
+**             tileLenList, list containing the number of vertices of each
+**                          tesselation polygon for each set
+**             ftypeVal,    type of frame, which is "Points", "Lines" or
+**                          "Polygons"
+**             xVec,        x coordinates of the frame
+**             yVec,        y coordinates of the frame
+**             partLenVec,  number of coordinates of each line or polygon
+**                          ring of the frame, which is NULL for points
+**             holeVec,     for polygons, TRUE for each ring that is a hole
+**                          and FALSE otherwise, which is NULL for points
+**                          and lines
+**             threadsVec,  number of threads, where NULL uses the OpenMP
+**                          default number of threads
+** Return:     results, an R list that contains the vector of extents for
+**             each set.  If an error occurs, a list whose single element
+**             is NULL is returned.
+***********************************************************/
+SEXP tessExtentBatch( SEXP tileXList, SEXP tileYList, SEXP tileLenList,
+                      SEXP ftypeVal, SEXP xVec, SEXP yVec, SEXP partLenVec,
+                      SEXP holeVec, SEXP threadsVec ) {
+
+  int r;                        /* loop counter */
+  int numSets = length( tileLenList );  /* number of sets */
+  int numThreads = 1;           /* number of threads */
+  int ftype;                    /* 1 points, 2 lines, 3 polygons */
+  int error = 0;                /* error indicator */
+  int * setError = NULL;        /* error indicator for each set */
+  int * numTiles = NULL;        /* number of polygons of each set */
+  int ** tileLens = NULL;       /* number of vertices of each polygon */
+  double ** tileX = NULL;       /* x coordinates of the vertices */
+  double ** tileY = NULL;       /* y coordinates of the vertices */
+  double ** extents = NULL;     /* extents for each set */
+  TessFrame frame;              /* coordinates of the frame */
+
+  /* R objects for returning results to R */
+  SEXP results = NULL;
+  SEXP extentVec;
+
+  /* determine the type of frame */
+  if ( (ftype = tessFrameType( ftypeVal )) == -1 ) {
+    Rprintf( "Error: Invalid frame type in C function tessExtentBatch.\n" );
+    PROTECT( results = allocVector( VECSXP, 1 ) );
+    UNPROTECT(1);
+    return results;
+  }
+
+  /* number of threads */
+#ifdef _OPENMP
+  numThreads = omp_get_max_threads();
+#endif
+  if ( threadsVec != R_NilValue ) {
+    PROTECT( threadsVec = AS_INTEGER( threadsVec ) );
+    numThreads = INTEGER( threadsVec )[0];
+    UNPROTECT(1);
+  }
+  if ( numThreads == NA_INTEGER || numThreads < 1 ) {
+    numThreads = 1;
+  }
+
+  /* prepare the frame */
+  if ( buildTessFrame( &frame, ftype, REAL( xVec ), REAL( yVec ),
+         length( xVec ), ftype == 1 ? NULL : INTEGER( partLenVec ),
+         ftype == 1 ? 0 : length( partLenVec ),
+         holeVec == R_NilValue ? NULL : LOGICAL( holeVec ) ) == -1 ) {
+    Rprintf( "Error: Allocating memory in C function tessExtentBatch.\n" );
+    PROTECT( results = allocVector( VECSXP, 1 ) );
+    UNPROTECT(1);
+    return results;
+  }
+
+  /* allocate the result vectors and obtain pointers to the tesselation */
+  /* polygons, since R objects must not be created by the threads */
+  PROTECT( results = allocVector( VECSXP, numSets ) );
+  setError = (int *) calloc( numSets + 1, sizeof(int) );
+  numTiles = (int *) malloc( sizeof(int) * (numSets + 1) );
+  tileLens = (int **) malloc( sizeof(int *) * (numSets + 1) );
+  tileX = (double **) malloc( sizeof(double *) * (numSets + 1) );
+  tileY = (double **) malloc( sizeof(double *) * (numSets + 1) );
+  extents = (double **) malloc( sizeof(double *) * (numSets + 1) );
+  if ( setError == NULL || numTiles == NULL || tileLens == NULL ||
+       tileX == NULL || tileY == NULL || extents == NULL ) {
+    error = 1;
+  }
+  for ( r = 0; r < numSets && error == 0; ++r ) {
+    numTiles[r] = length( VECTOR_ELT( tileLenList, r ) );
+    tileLens[r] = INTEGER( VECTOR_ELT( tileLenList, r ) );
+    tileX[r] = REAL( VECTOR_ELT( tileXList, r ) );
+    tileY[r] = REAL( VECTOR_ELT( tileYList, r ) );
+    PROTECT( extentVec = allocVector( REALSXP, numTiles[r] ) );
+    SET_VECTOR_ELT( results, r, extentVec );
+    UNPROTECT(1);
+    extents[r] = REAL( extentVec );
+  }
+
+  /* intersect each set of tesselation polygons with the frame */
+  if ( error == 0 ) {
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic) num_threads(numThreads)
+#endif
+    for ( r = 0; r < numSets; ++r ) {
+      int * found = NULL;
+      TessIndex index;
+      TessBuffer buf;
+
+      buf.maxPts = 0;
+      buf.in = NULL;
+      buf.out = NULL;
+      if ( buildTessIndex( &index, tileX[r], tileY[r], tileLens[r],
+                           numTiles[r] ) == -1 ) {
+        setError[r] = 1;
+        continue;
+      }
+      if ( (found = (int *) malloc( sizeof(int) * (numTiles[r] + 1) ))
+           == NULL || frameTileExtent( &frame, &index, extents[r], found,
+                                       &buf ) == -1 ) {
+        setError[r] = 1;
+      }
+      free( buf.in );
+      free( buf.out );
+      free( found );
+      freeTessIndex( &index );
+    }
+    for ( r = 0; r < numSets; ++r ) {
+      if ( setError[r] ) {
+        error = 1;
+      }
+    }
+  }
+
+  /* clean up */
+  free( setError );
+  free( numTiles );
+  free( tileLens );
+  free( tileX );
+  free( tileY );
+  free( extents );
+  freeTessFrame( &frame );
+
+  if ( error ) {
+    Rprintf( "Error: Allocating memory in C function tessExtentBatch.\n" );
+    PROTECT( results = allocVector( VECSXP, 1 ) );
+    UNPROTECT(2);
+    return results;
+  }
+  UNPROTECT(1);
+
+  return results;
+}